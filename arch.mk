@@ -2045,6 +2045,14 @@ ifeq ($(ARCH),sim)
       CFLAGS+=-DWOLFSSL_SP_DIV_WORD_HALF
     endif
   endif
+  ifneq ($(filter 1,$(IMG_CHUNKS_PARALLEL) $(MP_DISPATCH)),)
+    # hal_verify_image_chunks() and the emulated secondary cores of
+    # MP_DISPATCH run on pthreads
+    LDFLAGS+=-pthread
+    ifneq ($(IMG_CHUNKS_THREADS),)
+      CFLAGS+=-DSIM_CHUNK_THREADS=$(IMG_CHUNKS_THREADS)
+    endif
+  endif
   ifeq ($(WOLFHSM_CLIENT),1)
     WOLFHSM_OBJS += $(WOLFBOOT_LIB_WOLFHSM)/port/posix/posix_transport_tcp.o
   endif
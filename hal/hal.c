@@ -295,6 +295,13 @@ WEAKFUNCTION int hal_uds_derive_key(uint8_t *out, size_t out_len)
     return -1;
 }
 
+#ifdef WOLFBOOT_VERIFY_CACHE
+WEAKFUNCTION int hal_verify_cache_secret(uint8_t *out, size_t out_len)
+{
+    return hal_uds_derive_key(out, out_len);
+}
+#endif /* WOLFBOOT_VERIFY_CACHE */
+
 WEAKFUNCTION int hal_attestation_get_lifecycle(uint32_t *lifecycle)
 {
     (void)lifecycle;
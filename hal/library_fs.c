@@ -151,6 +151,89 @@ static int cmd_success(void)
     return 0;
 }
 
+#ifdef WOLFBOOT_PERSIST_FAILURE_STATUS
+static const char* failure_phase_name(uint8_t phase)
+{
+    switch (phase) {
+        case WOLFBOOT_FAILURE_PHASE_UPDATE:
+            return "UPDATE";
+        case WOLFBOOT_FAILURE_PHASE_BOOT:
+            return "BOOT";
+        case WOLFBOOT_FAILURE_PHASE_ROLLBACK:
+            return "ROLLBACK";
+        case WOLFBOOT_FAILURE_PHASE_RECOVERY:
+            return "RECOVERY";
+        case WOLFBOOT_FAILURE_PHASE_SELF_UPDATE:
+            return "SELF_UPDATE";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+static const char* failure_cause_name(uint8_t cause)
+{
+    switch (cause) {
+        case WOLFBOOT_FAILURE_CAUSE_HEADER:
+            return "HEADER";
+        case WOLFBOOT_FAILURE_CAUSE_HASH:
+            return "HASH";
+        case WOLFBOOT_FAILURE_CAUSE_SIGNATURE:
+            return "SIGNATURE";
+        case WOLFBOOT_FAILURE_CAUSE_NOT_CONFIRMED:
+            return "NOT_CONFIRMED";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+/* Print the failure records, newest first */
+static int cmd_get_failure(void)
+{
+    struct wolfBoot_failure_record rec;
+    int i, n;
+
+    n = wolfBoot_get_failure_count();
+    wolfBoot_printf("Failure records: %d\n", n);
+    for (i = 0; i < n; i++) {
+        if (wolfBoot_get_failure(i, &rec) != 0)
+            break;
+        wolfBoot_printf("  #%lu: phase %s, cause %s, partition %s, "
+            "version 0x%lx\n", (unsigned long)rec.seq,
+            failure_phase_name(rec.phase), failure_cause_name(rec.cause),
+            partition_name(rec.partition), (unsigned long)rec.fw_version);
+    }
+    return 0;
+}
+
+#ifdef WOLFBOOT_BOOT_TIMING
+/* Print the boot timing records, newest first */
+static int cmd_get_timing(void)
+{
+    static const char* phase_names[WOLFBOOT_TIMING_PHASES] = {
+        "hash", "signature", "decrypt", "copy", "delta", "total"
+    };
+    struct wolfBoot_timing_record rec;
+    int i, n, p;
+
+    n = wolfBoot_get_timing_count();
+    wolfBoot_printf("Boot timing records: %d\n", n);
+    for (i = 0; i < n; i++) {
+        if (wolfBoot_get_timing(i, &rec) != 0)
+            break;
+        wolfBoot_printf("  #%lu: partition %s, version 0x%lx%s\n",
+            (unsigned long)rec.seq, partition_name(rec.partition),
+            (unsigned long)rec.fw_version,
+            (rec.flags & WOLFBOOT_TIMING_F_UPDATE) ? ", update" : "");
+        for (p = 0; p < WOLFBOOT_TIMING_PHASES; p++) {
+            wolfBoot_printf("    %s: %lu us\n", phase_names[p],
+                (unsigned long)wolfBoot_timing_us(&rec, p));
+        }
+    }
+    return 0;
+}
+#endif /* WOLFBOOT_BOOT_TIMING */
+#endif /* WOLFBOOT_PERSIST_FAILURE_STATUS */
+
 /* Print usage information */
 static void print_usage(const char* prog_name)
 {
@@ -163,6 +246,12 @@ static void print_usage(const char* prog_name)
     wolfBoot_printf("  success             - Mark BOOT partition as SUCCESS\n");
     wolfBoot_printf("  verify-boot         - Verify integrity and authenticity of BOOT partition\n");
     wolfBoot_printf("  verify-update       - Verify integrity and authenticity of UPDATE partition\n");
+#ifdef WOLFBOOT_PERSIST_FAILURE_STATUS
+    wolfBoot_printf("  get-failure         - Show the recorded update/boot failures\n");
+#ifdef WOLFBOOT_BOOT_TIMING
+    wolfBoot_printf("  get-timing          - Show the recorded boot timings\n");
+#endif
+#endif
     wolfBoot_printf("  help                - Show this help message\n");
     wolfBoot_printf("\nPartitions:\n");
     wolfBoot_printf("  BOOT                - Currently running firmware partition\n");
@@ -244,6 +333,16 @@ int main(int argc, const char* argv[])
     else if (strcmp(command, "verify-update") == 0) {
         ret = cmd_verify(PART_UPDATE);
     }
+#ifdef WOLFBOOT_PERSIST_FAILURE_STATUS
+    else if (strcmp(command, "get-failure") == 0) {
+        ret = cmd_get_failure();
+    }
+#ifdef WOLFBOOT_BOOT_TIMING
+    else if (strcmp(command, "get-timing") == 0) {
+        ret = cmd_get_timing();
+    }
+#endif
+#endif
     else if (strcmp(command, "help") == 0 || strcmp(command, "--help") == 0 ||
              strcmp(command, "-h") == 0) {
         print_usage(argv[0]);
@@ -43,6 +43,7 @@
 #include "printf.h"
 #include "loader.h"
 #include "hal.h"
+#include "mp_dispatch.h"
 #include "gpt.h"
 #include "fdt.h"
 
@@ -166,6 +167,30 @@ static void mpfs_signal_main_hart_started(void)
     __asm__ volatile("fence iorw, iorw" ::: "memory");
 }
 
+#ifdef WOLFBOOT_MP_DISPATCH
+/* Work dispatch to the U54 harts while the E51 verifies the image
+ * (src/mp_dispatch.c). The shared block lives in the E51 DTIM, like the
+ * other cross-hart state, and workers 1..4 are harts 1..4. The kick is the
+ * same MSIP write as the boot hart release: it takes a parked hart out of
+ * the eNVM gate (boot_riscv_start.S) or out of the WFI in
+ * secondary_hart_entry(), which then polls its mailbox. */
+struct wolfBoot_mp_shared *hal_mp_shared(void)
+{
+    return (struct wolfBoot_mp_shared *)MPFS_DTIM_MP_DISPATCH_ADDR;
+}
+
+unsigned int hal_mp_workers(void)
+{
+    return (unsigned int)(MPFS_LAST_U54_HART - MPFS_FIRST_U54_HART + 1);
+}
+
+void hal_mp_kick(unsigned int w)
+{
+    CLINT_MSIP_REG(MPFS_FIRST_U54_HART + w - 1) = 0x01;
+    __asm__ volatile("fence iorw, iorw" ::: "memory");
+}
+#endif /* WOLFBOOT_MP_DISPATCH */
+
 #if defined(MPFS_DDR_INIT) && defined(WOLFBOOT_MMODE_SMODE_BOOT)
 /* Per-hart S-mode start mailboxes, written by the E51 (boot hart release)
  * or by the SBI HSM hart_start backend (on the calling U54), and consumed
@@ -206,6 +231,14 @@ void secondary_hart_entry(unsigned long hartid, HLS_DATA* hls)
     (void)hls;
 
     while (1) {
+#ifdef WOLFBOOT_MP_DISPATCH
+        /* Run the boot-time job posted by the E51, if any */
+        if (hartid >= (unsigned long)MPFS_FIRST_U54_HART &&
+            hartid <= (unsigned long)MPFS_LAST_U54_HART) {
+            wolfBoot_mp_worker_poll(
+                (unsigned int)(hartid - MPFS_FIRST_U54_HART + 1));
+        }
+#endif
 #if defined(MPFS_DDR_INIT) && defined(WOLFBOOT_MMODE_SMODE_BOOT)
         /* Check the hand-off context BEFORE sleeping: the release IPI was
          * already consumed (MSIP cleared) by the eNVM wake path, so a
@@ -236,6 +269,10 @@ void secondary_hart_entry(unsigned long hartid, HLS_DATA* hls)
         __asm__ volatile("fence iorw, iorw" ::: "memory");
 #else
         __asm__ volatile("wfi");
+#ifdef WOLFBOOT_MP_DISPATCH
+        CLINT_MSIP_REG(hartid) = 0;
+        __asm__ volatile("fence iorw, iorw" ::: "memory");
+#endif
 #endif /* MPFS_DDR_INIT && WOLFBOOT_MMODE_SMODE_BOOT */
     }
 }
@@ -444,6 +481,18 @@ void hal_init(void)
 #endif
 
     mpfs_config_l2_cache();
+#ifdef WOLFBOOT_MP_DISPATCH
+    /* DTIM content is undefined at power-on */
+    {
+        volatile uint32_t *mp = (volatile uint32_t *)MPFS_DTIM_MP_DISPATCH_ADDR;
+        unsigned int i;
+        for (i = 0; i < (sizeof(struct wolfBoot_mp_shared) /
+                sizeof(uint32_t)); i++) {
+            mp[i] = 0;
+        }
+        __asm__ volatile("fence iorw, iorw" ::: "memory");
+    }
+#endif
     mpfs_signal_main_hart_started();
 #endif
 
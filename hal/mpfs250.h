@@ -351,6 +351,11 @@ typedef struct {
  * No UL suffix: also used from assembly (boot_riscv_start.S). */
 #define MPFS_DTIM_MAIN_STARTED_ADDR 0x010000F0
 
+/* DTIM address of the secondary-hart work dispatch block (struct
+ * wolfBoot_mp_shared, src/mp_dispatch.c, up to 0x100 bytes), past the
+ * hart-start mailboxes. */
+#define MPFS_DTIM_MP_DISPATCH_ADDR  0x01000200UL
+
 /* Number of harts on MPFS */
 #define MPFS_NUM_HARTS              5
 #define MPFS_FIRST_HART             0   /* E51 is hart 0 */
@@ -91,6 +91,18 @@
 #define SPI_FREQUENCY     *((volatile uint32_t *)(SPI + 0x524))
 #define SPI_CONFIG        *((volatile uint32_t *)(SPI + 0x554))
 
+/* SPIM (EasyDMA) registers of the same instance */
+#define SPIM_RXD_PTR      *((volatile uint32_t *)(SPI + 0x534))
+#define SPIM_RXD_MAXCNT   *((volatile uint32_t *)(SPI + 0x538))
+#define SPIM_TXD_PTR      *((volatile uint32_t *)(SPI + 0x544))
+#define SPIM_TXD_MAXCNT   *((volatile uint32_t *)(SPI + 0x548))
+#define SPIM_ORC          *((volatile uint32_t *)(SPI + 0x5C0))
+#define SPI_ENABLE_SPI    1
+#define SPI_ENABLE_SPIM   7
+#define SPIM_MAXCNT       0xFF /* 8-bit MAXCNT on nRF52832 */
+#define NRF52_RAM_BASE    (0x20000000)
+#define NRF52_RAM_END     (0x20040000)
+
 #define K125 0x02000000
 #define K250 0x04000000
 #define K500 0x08000000
@@ -33,6 +33,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
 
 #ifdef __APPLE__
 #include <mach-o/loader.h>
@@ -48,6 +49,14 @@
 #include "elf.h"
 #endif
 
+#if defined(WOLFBOOT_IMG_CHUNKS_PARALLEL) || defined(WOLFBOOT_MP_DISPATCH)
+#include <pthread.h>
+#include "image.h"
+#endif
+#ifdef WOLFBOOT_MP_DISPATCH
+#include "mp_dispatch.h"
+#endif
+
 #if defined(WOLFBOOT_TEST_SIM_CRYPTOCB) && defined(__WOLFBOOT)
 #include <wolfssl/wolfcrypt/error-crypt.h>
 #include <wolfssl/wolfcrypt/cryptocb.h>
@@ -143,6 +152,196 @@ static void sim_dualbank_register_store(void);
 uint32_t hal_sim_get_dualbank_state(void);
 #endif
 
+/* Flash cost model.
+ *
+ * When SIM_FLASH_COST is set in the environment, every erase and program
+ * operation is accounted against a simple latency model, and a one-line
+ * report is appended to the file named by SIM_FLASH_COST ("-" for stderr)
+ * when wolfBoot exits or starts the application. The latencies can be
+ * tuned to the target device:
+ *
+ *   SIM_FLASH_ERASE_US      internal flash, per sector erased
+ *   SIM_FLASH_PROG_US       internal flash, per program unit
+ *   SIM_FLASH_PAGE          internal flash program unit, in bytes
+ *   SIM_EXT_FLASH_ERASE_US  same for the external flash
+ *   SIM_EXT_FLASH_PROG_US
+ *   SIM_EXT_FLASH_PAGE
+ *   SIM_FLASH_SWAP_US       dual-bank swap (option bytes + reset)
+ *
+ * Sectors are WOLFBOOT_SECTOR_SIZE. The defaults are in the range of a
+ * Cortex-M internal flash (double-word programming) and of a SPI NOR.
+ *
+ * The erase count of each sector is kept across runs in a file next to the
+ * flash image (e.g. internal_flash.dd.wear), so the wear reported after an
+ * update that spans several boots covers all of them. Remove the file to
+ * start counting again.
+ */
+#define SIM_FLASH_INT 0
+#define SIM_FLASH_EXT 1
+
+struct sim_flash_cost {
+    const char *name;
+    uint32_t erase_us;
+    uint32_t prog_us;
+    uint32_t page;
+    uint64_t erased_sectors;
+    uint64_t prog_units;
+    uint64_t prog_bytes;
+    uint32_t *wear;         /* erase count per sector */
+    uint32_t n_sectors;
+    char wear_file[64];     /* wear[] persisted across runs */
+};
+
+static struct sim_flash_cost sim_cost[2] = {
+    { "int", 20000, 80, 8, 0, 0, 0, NULL, 0 },
+    { "ext", 45000, 700, 256, 0, 0, 0, NULL, 0 }
+};
+static uint32_t sim_swap_us = 25000;
+static uint32_t sim_swaps;
+static const char *sim_cost_report_path;
+static int sim_cost_reported;
+
+static void sim_env_u32(const char *name, uint32_t *val)
+{
+    const char *s = getenv(name);
+    if (s != NULL && *s != '\0')
+        *val = (uint32_t)strtoul(s, NULL, 0);
+}
+
+static void sim_flash_cost_alloc(struct sim_flash_cost *c, const char *path)
+{
+    struct stat st = { 0 };
+
+    if (stat(path, &st) != 0 || st.st_size <= 0)
+        return;
+    c->n_sectors = (uint32_t)((st.st_size + WOLFBOOT_SECTOR_SIZE - 1) /
+        WOLFBOOT_SECTOR_SIZE);
+    c->wear = (uint32_t *)calloc(c->n_sectors, sizeof(uint32_t));
+    if (c->wear == NULL) {
+        c->n_sectors = 0;
+        return;
+    }
+    snprintf(c->wear_file, sizeof(c->wear_file), "%s.wear", path);
+    /* Counts of the previous runs, unless the flash size changed */
+    if (stat(c->wear_file, &st) == 0 &&
+            st.st_size == (off_t)(c->n_sectors * sizeof(uint32_t))) {
+        FILE *f = fopen(c->wear_file, "rb");
+        if (f != NULL) {
+            if (fread(c->wear, sizeof(uint32_t), c->n_sectors, f) !=
+                    c->n_sectors)
+                memset(c->wear, 0, c->n_sectors * sizeof(uint32_t));
+            fclose(f);
+        }
+    }
+}
+
+static void sim_flash_cost_save_wear(struct sim_flash_cost *c)
+{
+    FILE *f;
+
+    if (c->n_sectors == 0)
+        return;
+    f = fopen(c->wear_file, "wb");
+    if (f == NULL)
+        return;
+    (void)fwrite(c->wear, sizeof(uint32_t), c->n_sectors, f);
+    fclose(f);
+}
+
+static void sim_flash_cost_erase(int dev, uintptr_t off, int len)
+{
+    struct sim_flash_cost *c = &sim_cost[dev];
+    uintptr_t s, first, last;
+
+    if (sim_cost_report_path == NULL || len <= 0)
+        return;
+    first = off / WOLFBOOT_SECTOR_SIZE;
+    last = (off + len - 1) / WOLFBOOT_SECTOR_SIZE;
+    for (s = first; s <= last; s++) {
+        c->erased_sectors++;
+        if (s < c->n_sectors)
+            c->wear[s]++;
+    }
+}
+
+static void sim_flash_cost_prog(int dev, uintptr_t off, int len)
+{
+    struct sim_flash_cost *c = &sim_cost[dev];
+
+    if (sim_cost_report_path == NULL || len <= 0)
+        return;
+    c->prog_units += (off + len - 1) / c->page - off / c->page + 1;
+    c->prog_bytes += (uint64_t)len;
+}
+
+static void sim_flash_cost_report(void)
+{
+    FILE *f;
+    uint64_t time_us = (uint64_t)sim_swaps * sim_swap_us;
+    uint32_t max_wear[2] = { 0, 0 };
+    uint32_t i;
+    int d;
+
+    if (sim_cost_report_path == NULL || sim_cost_reported)
+        return;
+    sim_cost_reported = 1;
+    for (d = 0; d < 2; d++) {
+        struct sim_flash_cost *c = &sim_cost[d];
+        time_us += c->erased_sectors * c->erase_us +
+            c->prog_units * c->prog_us;
+        for (i = 0; i < c->n_sectors; i++) {
+            if (c->wear[i] > max_wear[d])
+                max_wear[d] = c->wear[i];
+        }
+        sim_flash_cost_save_wear(c);
+    }
+    if (strcmp(sim_cost_report_path, "-") == 0)
+        f = stderr;
+    else
+        f = fopen(sim_cost_report_path, "a");
+    if (f == NULL)
+        return;
+    fprintf(f, "sim_flash_cost time_us=%llu swaps=%u",
+        (unsigned long long)time_us, sim_swaps);
+    for (d = 0; d < 2; d++) {
+        fprintf(f, " %s_erased_sectors=%llu %s_prog_bytes=%llu"
+            " %s_max_wear=%u",
+            sim_cost[d].name, (unsigned long long)sim_cost[d].erased_sectors,
+            sim_cost[d].name, (unsigned long long)sim_cost[d].prog_bytes,
+            sim_cost[d].name, max_wear[d]);
+    }
+    fprintf(f, "\n");
+    if (f != stderr)
+        fclose(f);
+    else
+        fflush(f);
+}
+
+static void sim_flash_cost_init(void)
+{
+    sim_cost_report_path = getenv("SIM_FLASH_COST");
+    if (sim_cost_report_path == NULL || *sim_cost_report_path == '\0') {
+        sim_cost_report_path = NULL;
+        return;
+    }
+    sim_env_u32("SIM_FLASH_ERASE_US", &sim_cost[SIM_FLASH_INT].erase_us);
+    sim_env_u32("SIM_FLASH_PROG_US", &sim_cost[SIM_FLASH_INT].prog_us);
+    sim_env_u32("SIM_FLASH_PAGE", &sim_cost[SIM_FLASH_INT].page);
+    sim_env_u32("SIM_EXT_FLASH_ERASE_US", &sim_cost[SIM_FLASH_EXT].erase_us);
+    sim_env_u32("SIM_EXT_FLASH_PROG_US", &sim_cost[SIM_FLASH_EXT].prog_us);
+    sim_env_u32("SIM_EXT_FLASH_PAGE", &sim_cost[SIM_FLASH_EXT].page);
+    sim_env_u32("SIM_FLASH_SWAP_US", &sim_swap_us);
+    if (sim_cost[SIM_FLASH_INT].page == 0)
+        sim_cost[SIM_FLASH_INT].page = 1;
+    if (sim_cost[SIM_FLASH_EXT].page == 0)
+        sim_cost[SIM_FLASH_EXT].page = 1;
+    sim_flash_cost_alloc(&sim_cost[SIM_FLASH_INT], INTERNAL_FLASH_FILE);
+#ifdef EXT_FLASH
+    sim_flash_cost_alloc(&sim_cost[SIM_FLASH_EXT], EXTERNAL_FLASH_FILE);
+#endif
+    atexit(sim_flash_cost_report);
+}
+
 /* global used to store command line arguments to forward to the test
  * application */
 char **main_argv;
@@ -417,6 +616,9 @@ void hal_flash_dualbank_swap(void)
 
     free(buffer);
 
+    /* The copy above only emulates the bank remap: account for the swap
+     * itself, not for the bytes moved */
+    sim_swaps++;
     sim_flash_optr ^= SIM_FLASH_OPTR_SWAP_BANK;
     sim_dualbank_register_store();
     wolfBoot_printf("Simulator dualbank swap complete, register=%u\n",
@@ -427,11 +629,171 @@ void hal_flash_dualbank_swap(void)
 }
 #endif
 
+#if defined(WOLFBOOT_IMG_CHUNKS_PARALLEL) && !defined(WOLFBOOT_MP_DISPATCH)
+/* Worker pool for chunked images: each thread picks the next chunk to verify
+ * until all the chunks have been checked. */
+#ifndef SIM_CHUNK_THREADS
+#define SIM_CHUNK_THREADS 4
+#endif
+
+struct sim_chunk_job {
+    struct wolfBoot_image *img;
+    uint32_t n;
+    uint32_t next;
+    int failed;
+    pthread_mutex_t lock;
+};
+
+static void *sim_chunk_worker(void *arg)
+{
+    struct sim_chunk_job *job = (struct sim_chunk_job *)arg;
+    uint32_t idx;
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        idx = job->next;
+        if (idx < job->n)
+            job->next++;
+        pthread_mutex_unlock(&job->lock);
+        if (idx >= job->n)
+            break;
+        if (wolfBoot_verify_image_chunk(job->img, idx) != 0) {
+            pthread_mutex_lock(&job->lock);
+            job->failed = 1;
+            pthread_mutex_unlock(&job->lock);
+        }
+    }
+    return NULL;
+}
+
+int hal_verify_image_chunks(struct wolfBoot_image *img, uint32_t n)
+{
+    pthread_t th[SIM_CHUNK_THREADS];
+    struct sim_chunk_job job;
+    int i, started = 0;
+
+    memset(&job, 0, sizeof(job));
+    job.img = img;
+    job.n = n;
+    pthread_mutex_init(&job.lock, NULL);
+    for (i = 0; i < SIM_CHUNK_THREADS; i++) {
+        if (pthread_create(&th[started], NULL, sim_chunk_worker, &job) == 0)
+            started++;
+    }
+    /* The boot thread takes part too, and completes the job alone if no
+     * worker could be started. */
+    sim_chunk_worker(&job);
+    for (i = 0; i < started; i++)
+        pthread_join(th[i], NULL);
+    pthread_mutex_destroy(&job.lock);
+    wolfBoot_printf("Verified %u chunks with %d threads: %s\n",
+        (unsigned int)n, started + 1, job.failed ? "FAIL" : "OK");
+    return job.failed ? -1 : 0;
+}
+#endif /* WOLFBOOT_IMG_CHUNKS_PARALLEL && !WOLFBOOT_MP_DISPATCH */
+
+#ifdef WOLFBOOT_IMG_CHUNKS_LAZY
+/* No MPU in the simulator: the range is only reported, and left to the
+ * application (test-app "lazy_verify" command). */
+uintptr_t hal_lazy_xip_protect(uintptr_t start, uintptr_t end)
+{
+    wolfBoot_printf("Lazy XIP: %lu bytes at %p left to the application\n",
+        (unsigned long)(end - start), (void *)start);
+    return start;
+}
+#endif
+
+#ifdef WOLFBOOT_VERIFY_CACHE
+/* Fixed secret for the simulator: a real target uses an OTP or PUF value
+ * that the application cannot read. */
+int hal_verify_cache_secret(uint8_t *out, size_t out_len)
+{
+    size_t i;
+
+    for (i = 0; i < out_len; i++)
+        out[i] = (uint8_t)(0x5A ^ (i * 7));
+    return 0;
+}
+#endif
+
+#ifdef WOLFBOOT_MP_DISPATCH
+/* Emulated secondary cores for src/mp_dispatch.c: each worker is a thread
+ * parked on a condition variable, woken by hal_mp_kick() like an IPI. */
+#ifndef SIM_MP_WORKERS
+#define SIM_MP_WORKERS 3
+#endif
+
+static struct wolfBoot_mp_shared sim_mp_shared;
+static pthread_mutex_t sim_mp_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sim_mp_cond = PTHREAD_COND_INITIALIZER;
+static unsigned int sim_mp_pending[SIM_MP_WORKERS + 1];
+static unsigned int sim_mp_started;
+
+static void *sim_mp_worker(void *arg)
+{
+    unsigned int w = (unsigned int)(uintptr_t)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&sim_mp_lock);
+        while (sim_mp_pending[w] == 0)
+            pthread_cond_wait(&sim_mp_cond, &sim_mp_lock);
+        sim_mp_pending[w] = 0;
+        pthread_mutex_unlock(&sim_mp_lock);
+        wolfBoot_mp_worker_poll(w);
+    }
+    return NULL;
+}
+
+struct wolfBoot_mp_shared *hal_mp_shared(void)
+{
+    return &sim_mp_shared;
+}
+
+unsigned int hal_mp_workers(void)
+{
+    pthread_t th;
+
+    /* Bring the "cores" up on first use */
+    while (sim_mp_started < SIM_MP_WORKERS) {
+        if (pthread_create(&th, NULL, sim_mp_worker,
+                (void *)(uintptr_t)(sim_mp_started + 1)) != 0)
+            break;
+        pthread_detach(th);
+        sim_mp_started++;
+    }
+    return sim_mp_started;
+}
+
+void hal_mp_kick(unsigned int w)
+{
+    pthread_mutex_lock(&sim_mp_lock);
+    sim_mp_pending[w] = 1;
+    pthread_cond_broadcast(&sim_mp_cond);
+    pthread_mutex_unlock(&sim_mp_lock);
+}
+#endif /* WOLFBOOT_MP_DISPATCH */
+
 void hal_prepare_boot(void)
 {
     /* no op */
 }
 
+#if defined(BOOT_BENCHMARK) || defined(WOLFBOOT_BOOT_TIMING)
+/* Microseconds since the first call, i.e. roughly since power-on */
+uint64_t hal_get_timer_us(void)
+{
+    static uint64_t sim_t0;
+    struct timespec ts;
+    uint64_t now;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+    if (sim_t0 == 0)
+        sim_t0 = now;
+    return now - sim_t0;
+}
+#endif
+
 int hal_flash_write(uintptr_t address, const uint8_t *data, int len)
 {
     int i;
@@ -439,6 +801,7 @@ int hal_flash_write(uintptr_t address, const uint8_t *data, int len)
         wolfBoot_printf("FLASH IS BEING WRITTEN TO WHILE LOCKED\n");
         return -1;
     }
+    sim_flash_cost_prog(SIM_FLASH_INT, address - (uintptr_t)sim_ram_base, len);
     if (forceEmergency == 1 && address == WOLFBOOT_PARTITION_BOOT_ADDRESS) {
         /* implicit cast abide compiler warning */
         memset((void*)address, 0, len);
@@ -472,6 +835,7 @@ int hal_flash_erase(uintptr_t address, int len)
         wolfBoot_printf("FLASH IS BEING ERASED WHILE LOCKED\n");
         return -1;
     }
+    sim_flash_cost_erase(SIM_FLASH_INT, address - (uintptr_t)sim_ram_base, len);
     /* implicit cast abide compiler warning */
     wolfBoot_printf( "hal_flash_erase addr %p len %d\n", (void*)address, len);
     if (address == erasefail_address + WOLFBOOT_PARTITION_BOOT_ADDRESS) {
@@ -508,6 +872,7 @@ void hal_init(void)
 #ifdef DUALBANK_SWAP
     sim_dualbank_register_load();
 #endif
+    sim_flash_cost_init();
 
     for (i = 1; i < main_argc; i++) {
         if (strcmp(main_argv[i], "powerfail") == 0) {
@@ -556,6 +921,7 @@ int ext_flash_write(uintptr_t address, const uint8_t *data, int len)
         wolfBoot_printf("EXT FLASH IS BEING WRITTEN TO WHILE LOCKED\n");
         return -1;
     }
+    sim_flash_cost_prog(SIM_FLASH_EXT, address, len);
     memcpy(flash_base + address, data, len);
     return 0;
 }
@@ -572,6 +938,7 @@ int ext_flash_erase(uintptr_t address, int len)
         wolfBoot_printf("EXT FLASH IS BEING ERASED WHILE LOCKED\n");
         return -1;
     }
+    sim_flash_cost_erase(SIM_FLASH_EXT, address, len);
     memset(flash_base + address, FLASH_BYTE_ERASED, len);
     return 0;
 }
@@ -618,6 +985,8 @@ void do_boot(const uint32_t *app_offset)
     if (extFlashLocked == 0) {
         wolfBoot_printf("WARNING EXT FLASH IS UNLOCKED AT BOOT");
     }
+    /* the application replaces this process: atexit() would not run */
+    sim_flash_cost_report();
 
 #ifdef __APPLE__
     typedef int (*main_entry)(int, char**, char**, char**);
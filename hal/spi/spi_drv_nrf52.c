@@ -25,6 +25,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
  */
 #include <stdint.h>
+#include <stddef.h>
 #include "spi_drv.h"
 
 #ifdef TARGET_nrf52
@@ -49,6 +50,55 @@ void RAMFUNCTION spi_cs_on(uint32_t base, int pin)
     (void)base;
 }
 
+#ifdef SPI_FLASH_DMA
+/* SPIM: every transfer, byte-level ones included, goes through EasyDMA */
+static int RAMFUNCTION spim_xfer(const uint8_t *tx, uint8_t *rx, uint32_t sz)
+{
+    /* EasyDMA only accesses data RAM: flash contents are bounced */
+    static uint8_t bounce[SPIM_MAXCNT];
+    uint32_t chunk, i;
+
+    while (sz > 0) {
+        chunk = (sz > SPIM_MAXCNT) ? SPIM_MAXCNT : sz;
+        if (tx != NULL && ((uintptr_t)tx < NRF52_RAM_BASE ||
+                (uintptr_t)tx + chunk > NRF52_RAM_END)) {
+            for (i = 0; i < chunk; i++)
+                bounce[i] = tx[i];
+            SPIM_TXD_PTR = (uint32_t)bounce;
+        }
+        else {
+            SPIM_TXD_PTR = (uint32_t)tx;
+        }
+        SPIM_TXD_MAXCNT = (tx != NULL) ? chunk : 0; /* ORC (0xFF) otherwise */
+        SPIM_RXD_PTR = (rx != NULL) ? (uint32_t)rx : (uint32_t)bounce;
+        SPIM_RXD_MAXCNT = (rx != NULL || tx == NULL) ? chunk : 0;
+        SPI_EVENTS_END = 0;
+        SPI_TASKS_START = 1;
+        while (SPI_EVENTS_END == 0)
+            ;
+        SPI_EVENTS_END = 0;
+        if (tx != NULL)
+            tx += chunk;
+        if (rx != NULL)
+            rx += chunk;
+        sz -= chunk;
+    }
+    return 0;
+}
+
+static uint8_t spim_rx_byte;
+
+uint8_t RAMFUNCTION spi_read(void)
+{
+    return spim_rx_byte;
+}
+
+void RAMFUNCTION spi_write(const char byte)
+{
+    uint8_t b = (uint8_t)byte;
+    spim_xfer(&b, &spim_rx_byte, 1);
+}
+#else
 uint8_t RAMFUNCTION spi_read(void)
 {
     volatile uint32_t reg = SPI_EV_RDY;
@@ -68,6 +118,46 @@ void RAMFUNCTION spi_write(const char byte)
     while (!reg)
         reg = SPI_EV_RDY;
 }
+#endif /* SPI_FLASH_DMA */
+
+#ifdef SPI_FLASH
+int RAMFUNCTION spi_xfer_buf(uint32_t base, int pin, const uint8_t *tx,
+    uint8_t *rx, uint32_t sz, int flags)
+{
+    int ret = 0;
+#ifndef SPI_FLASH_DMA
+    uint32_t i;
+    uint32_t reg;
+#endif
+
+    spi_cs_on(base, pin);
+#ifdef SPI_FLASH_DMA
+    ret = spim_xfer(tx, rx, sz);
+#else
+    /* TXD is double buffered: keep the next byte queued while the current
+     * one is shifted */
+    if (sz > 0) {
+        SPI_EV_RDY = 0;
+        SPI_TXDATA = (tx != NULL) ? tx[0] : 0xFF;
+        for (i = 0; i < sz; i++) {
+            if (i + 1 < sz)
+                SPI_TXDATA = (tx != NULL) ? tx[i + 1] : 0xFF;
+            reg = SPI_EV_RDY;
+            while (!reg)
+                reg = SPI_EV_RDY;
+            SPI_EV_RDY = 0;
+            reg = SPI_RXDATA;
+            if (rx != NULL)
+                rx[i] = (uint8_t)reg;
+        }
+    }
+#endif
+    if (!(flags & SPI_XFER_FLAG_CONTINUE)) {
+        spi_cs_off(base, pin);
+    }
+    return ret;
+}
+#endif /* SPI_FLASH */
 
 
 void spi_init(int polarity, int phase)
@@ -89,7 +179,12 @@ void spi_init(int polarity, int phase)
 
         SPI_FREQUENCY = M1;
         SPI_CONFIG = 0; /* mode 0,0 default */
-        SPI_ENABLE = 1;
+#ifdef SPI_FLASH_DMA
+        SPIM_ORC = 0xFF;
+        SPI_ENABLE = SPI_ENABLE_SPIM;
+#else
+        SPI_ENABLE = SPI_ENABLE_SPI;
+#endif
     }
 }
 
@@ -386,6 +386,107 @@ void RAMFUNCTION spi_write(const char byte)
 }
 #endif /* SPI_FLASH || WOLFBOOT_TPM */
 
+#ifdef SPI_FLASH
+#ifdef SPI_FLASH_DMA
+#ifndef TARGET_stm32f4
+    #error SPI_FLASH_DMA is only supported on STM32F4 (DMA2 streams 0/3)
+#endif
+#ifndef SPI_FLASH_DMA_MIN
+#define SPI_FLASH_DMA_MIN 16 /* shorter transfers (commands) are polled */
+#endif
+
+static int RAMFUNCTION stm_spi_dma_xfer(const uint8_t *tx, uint8_t *rx,
+    uint32_t sz)
+{
+    static uint8_t dummy_tx = 0xFF;
+    static uint8_t dummy_rx;
+    uint32_t chunk;
+    int ret = 0;
+
+    while (sz > 0 && ret == 0) {
+        chunk = (sz > DMA_MAX_XFER) ? DMA_MAX_XFER : sz;
+        DMA2_SxCR(SPI1_DMA_RX_STREAM) = 0;
+        DMA2_SxCR(SPI1_DMA_TX_STREAM) = 0;
+        while ((DMA2_SxCR(SPI1_DMA_RX_STREAM) & DMA_SxCR_EN) ||
+               (DMA2_SxCR(SPI1_DMA_TX_STREAM) & DMA_SxCR_EN));
+        DMA2_LIFCR = DMA_LIFCR_CS0 | DMA_LIFCR_CS3;
+
+        /* peripheral to memory, discard into a single byte if rx is NULL */
+        DMA2_SxPAR(SPI1_DMA_RX_STREAM) = (uint32_t)&SPI1_RXDR;
+        DMA2_SxM0AR(SPI1_DMA_RX_STREAM) =
+            (rx != NULL) ? (uint32_t)rx : (uint32_t)&dummy_rx;
+        DMA2_SxNDTR(SPI1_DMA_RX_STREAM) = chunk;
+        DMA2_SxFCR(SPI1_DMA_RX_STREAM) = 0; /* direct mode */
+        DMA2_SxCR(SPI1_DMA_RX_STREAM) = DMA_SxCR_CHSEL(SPI1_DMA_CHANNEL) |
+            ((rx != NULL) ? DMA_SxCR_MINC : 0);
+
+        /* memory to peripheral, 0xFF if tx is NULL */
+        DMA2_SxPAR(SPI1_DMA_TX_STREAM) = (uint32_t)&SPI1_TXDR;
+        DMA2_SxM0AR(SPI1_DMA_TX_STREAM) =
+            (tx != NULL) ? (uint32_t)tx : (uint32_t)&dummy_tx;
+        DMA2_SxNDTR(SPI1_DMA_TX_STREAM) = chunk;
+        DMA2_SxFCR(SPI1_DMA_TX_STREAM) = 0;
+        DMA2_SxCR(SPI1_DMA_TX_STREAM) = DMA_SxCR_CHSEL(SPI1_DMA_CHANNEL) |
+            DMA_SxCR_DIR_M2P | ((tx != NULL) ? DMA_SxCR_MINC : 0);
+
+        DMA2_SxCR(SPI1_DMA_RX_STREAM) |= DMA_SxCR_EN;
+        DMA2_SxCR(SPI1_DMA_TX_STREAM) |= DMA_SxCR_EN;
+        /* RX requests enabled first (RM0090, 28.3.9) */
+        SPI1_CR2 |= SPI_CR2_RXDMAEN;
+        SPI1_CR2 |= SPI_CR2_TXDMAEN;
+
+        /* the last byte is received after the last one is sent */
+        while ((DMA2_LISR & (DMA_LISR_TCIF0 | DMA_LISR_TEIF0 |
+                DMA_LISR_TEIF3)) == 0);
+        if (DMA2_LISR & (DMA_LISR_TEIF0 | DMA_LISR_TEIF3))
+            ret = -1;
+        SPI1_CR2 &= ~(SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+        DMA2_SxCR(SPI1_DMA_RX_STREAM) = 0;
+        DMA2_SxCR(SPI1_DMA_TX_STREAM) = 0;
+
+        if (tx != NULL)
+            tx += chunk;
+        if (rx != NULL)
+            rx += chunk;
+        sz -= chunk;
+    }
+    return ret;
+}
+#endif /* SPI_FLASH_DMA */
+
+/* Polled transfer: the next byte is loaded in the transmit buffer while the
+ * current one is shifted out, so that the bus is never idle between bytes */
+int RAMFUNCTION spi_xfer_buf(uint32_t base, int pin, const uint8_t *tx,
+    uint8_t *rx, uint32_t sz, int flags)
+{
+    uint32_t i;
+    uint8_t b;
+    int ret = 0;
+
+    spi_cs_on(base, pin);
+#ifdef SPI_FLASH_DMA
+    if (sz >= SPI_FLASH_DMA_MIN) {
+        ret = stm_spi_dma_xfer(tx, rx, sz);
+        sz = 0;
+    }
+#endif
+    if (sz > 0) {
+        spi_write((tx != NULL) ? (const char)tx[0] : (const char)0xFF);
+        for (i = 0; i < sz; i++) {
+            if (i + 1 < sz)
+                spi_write((tx != NULL) ? (const char)tx[i + 1] : (const char)0xFF);
+            b = spi_read();
+            if (rx != NULL)
+                rx[i] = b;
+        }
+    }
+    if (!(flags & SPI_XFER_FLAG_CONTINUE)) {
+        spi_cs_off(base, pin);
+    }
+    return ret;
+}
+#endif /* SPI_FLASH */
+
 static int initialized = 0;
 void RAMFUNCTION spi_init(int polarity, int phase)
 {
@@ -408,6 +509,9 @@ void RAMFUNCTION spi_init(int polarity, int phase)
 
 #if defined(SPI_FLASH) || defined(WOLFBOOT_TPM)
         APB2_CLOCK_ER |= SPI1_APB2_CLOCK_ER_VAL;
+        #if defined(SPI_FLASH) && defined(SPI_FLASH_DMA)
+        AHB1_CLOCK_ER |= RCC_AHB1ENR_DMA2EN;
+        #endif
         #ifdef TARGET_stm32h5
         RCC_CCIPR3 &= ~ (RCC_CCIPR3_SPI1SEL_MASK << RCC_CCIPR3_SPI1SEL_SHIFT);
         RCC_CCIPR3 |= (0 << RCC_CCIPR3_SPI1SEL_SHIFT); /* PLL1_Q */
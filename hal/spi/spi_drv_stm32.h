@@ -37,6 +37,31 @@
 #define SPI_CLOCK_PIN 3 /* SPI_SCK: PB3  */
 #define SPI_MISO_PIN  4 /* SPI_MISO PB4  */
 #define SPI_MOSI_PIN  5 /* SPI_MOSI PB5  */
+
+/* DMA2: SPI1_RX on stream 0, SPI1_TX on stream 3, both channel 3 */
+#define AHB1_CLOCK_ER     (*(volatile uint32_t *)(0x40023830))
+#define RCC_AHB1ENR_DMA2EN (1 << 22)
+#define DMA2_BASE         (0x40026400)
+#define DMA2_LISR         (*(volatile uint32_t *)(DMA2_BASE + 0x00))
+#define DMA2_LIFCR        (*(volatile uint32_t *)(DMA2_BASE + 0x08))
+#define DMA2_SxCR(n)      (*(volatile uint32_t *)(DMA2_BASE + 0x10 + 0x18 * (n)))
+#define DMA2_SxNDTR(n)    (*(volatile uint32_t *)(DMA2_BASE + 0x14 + 0x18 * (n)))
+#define DMA2_SxPAR(n)     (*(volatile uint32_t *)(DMA2_BASE + 0x18 + 0x18 * (n)))
+#define DMA2_SxM0AR(n)    (*(volatile uint32_t *)(DMA2_BASE + 0x1C + 0x18 * (n)))
+#define DMA2_SxFCR(n)     (*(volatile uint32_t *)(DMA2_BASE + 0x24 + 0x18 * (n)))
+#define SPI1_DMA_RX_STREAM 0
+#define SPI1_DMA_TX_STREAM 3
+#define SPI1_DMA_CHANNEL   3
+#define DMA_SxCR_EN        (1 << 0)
+#define DMA_SxCR_DIR_M2P   (1 << 6)
+#define DMA_SxCR_MINC      (1 << 10)
+#define DMA_SxCR_CHSEL(c)  ((uint32_t)(c) << 25)
+#define DMA_LISR_TEIF0     (1 << 3)
+#define DMA_LISR_TCIF0     (1 << 5)
+#define DMA_LISR_TEIF3     (1 << 25)
+#define DMA_LIFCR_CS0      (0x3DUL)       /* FEIF0, DMEIF0, TEIF0, HTIF0, TCIF0 */
+#define DMA_LIFCR_CS3      (0x3DUL << 22) /* FEIF3, DMEIF3, TEIF3, HTIF3, TCIF3 */
+#define DMA_MAX_XFER       0xFFFF
 #endif /* TARGET_stm32f4 */
 
 
@@ -495,6 +520,8 @@
 #define SPI_CR1_TX_CRC_NEXT         (1 << 12)
 #define SPI_CR1_HW_CRC_EN           (1 << 13)
 #define SPI_CR1_BIDIOE              (1 << 14)
+#define SPI_CR2_RXDMAEN             (1 << 0)
+#define SPI_CR2_TXDMAEN             (1 << 1)
 #define SPI_CR2_SSOE                (1 << 2)
 
 #define SPI_SR_RX_NOTEMPTY          (1 << 0)
@@ -56,10 +56,18 @@ struct wb_patch_ctx {
 #endif
 };
 
+/* Host-side match index, see wb_diff_index_build() */
+struct wb_diff_index;
+
 struct wb_diff_ctx {
     uint8_t *src_a;
     uint8_t *src_b;
     uint32_t size_a, size_b, off_b;
+    struct wb_diff_index *idx_a;
+    struct wb_diff_index *idx_b;
+    uint32_t window;   /* windowed mode, see wb_diff_set_window() */
+    uint32_t win_seg;  /* segment covered by the indexes, plus one */
+    int win_index;
 };
 
 
@@ -68,6 +76,9 @@ typedef struct wb_diff_ctx WB_DIFF_CTX;
 
 int wb_diff_init(WB_DIFF_CTX *ctx, uint8_t *src_a, uint32_t len_a, uint8_t *src_b, uint32_t len_b);
 int wb_diff(WB_DIFF_CTX *ctx, uint8_t *patch, uint32_t len);
+int wb_diff_index_build(WB_DIFF_CTX *ctx);
+void wb_diff_index_free(WB_DIFF_CTX *ctx);
+int wb_diff_set_window(WB_DIFF_CTX *ctx, uint32_t window);
 int wb_patch_init(WB_PATCH_CTX *bm, uint8_t *src, uint32_t ssz, uint8_t *patch, uint32_t psz);
 int wb_patch(WB_PATCH_CTX *ctx, uint8_t *dst, uint32_t len);
 int wolfBoot_get_delta_info(uint8_t part, int inverse, uint32_t **img_offset,
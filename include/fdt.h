@@ -157,14 +157,48 @@ int fdt_find_prop_offset(void* fdt, int startoff, const char* propname, const ch
 int fdt_find_devtype(void* fdt, int startoff, const char* node);
 int fdt_node_check_compatible(const void *fdt, int nodeoffset, const char *compatible);
 int fdt_node_offset_by_compatible(const void *fdt, int startoffset, const char *compatible);
+int fdt_node_offset_by_phandle(const void *fdt, uint32_t phandle);
 int fdt_add_subnode(void* fdt, int parentoff, const char* name);
 int fdt_del_node(void *fdt, int nodeoffset);
 
+/* Node index (WOLFBOOT_FDT_INDEX): one pass over the structure block records
+ * the offset, name hash and phandle of every node, so that the lookups above
+ * no longer walk the blob. The index covers one blob at a time and is kept
+ * valid by the edits made through this API. */
+#ifdef WOLFBOOT_FDT_INDEX
+#ifndef FDT_INDEX_MAX_NODES
+#define FDT_INDEX_MAX_NODES 1024
+#endif
+/* Returns the number of nodes, or a negative FDT_ERR_* (no index) */
+int fdt_index_build(void *fdt);
+void fdt_index_release(void);
+#else
+#define fdt_index_build(fdt) do { (void)(fdt); } while (0)
+#define fdt_index_release() do {} while (0)
+#endif
+
 /* helpers to fix/append a property to a node */
 int fdt_fixup_str(void* fdt, int off, const char* node, const char* name, const char* str);
 int fdt_fixup_val(void* fdt, int off, const char* node, const char* name, uint32_t val);
 int fdt_fixup_val64(void* fdt, int off, const char* node, const char* name, uint64_t val);
 
+/* Batched fixups: the properties are set with a single move of the structure
+ * and strings blocks, instead of one per property. The node is looked up by
+ * name when node is not NULL, else off is used. A (node, name) pair may
+ * appear only once per batch. Returns 0 or a negative FDT_ERR_*, in which case
+ * the blob is not modified. */
+#ifndef FDT_FIXUP_BATCH_MAX
+#define FDT_FIXUP_BATCH_MAX 32
+#endif
+struct fdt_fixup {
+    const char* node;
+    int off;
+    const char* name;
+    const void* val;
+    int len;
+};
+int fdt_fixup_batch(void* fdt, const struct fdt_fixup* fixups, int count);
+
 int fdt_shrink(void* fdt);
 int fdt_add_mem_rsv(void* fdt, uint64_t address, uint64_t size);
 
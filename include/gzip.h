@@ -72,4 +72,84 @@ int wolfBoot_gunzip(const uint8_t *in, uint32_t in_len,
                     uint8_t *out, uint32_t out_max,
                     uint32_t *out_len);
 
+/* Streaming (resumable) decompression
+ *
+ * The compressed stream is fed in arbitrary chunks (e.g. one disk block at
+ * a time) and inflated straight into the destination buffer, so the whole
+ * gzip stream never needs to be staged in RAM.
+ *
+ * As with wolfBoot_gunzip(), the destination doubles as the LZ77 window:
+ * back-references read at most WOLFBOOT_GZIP_WINDOW_SIZE bytes behind the
+ * write position, so no separate window copy is kept. Input that cannot be
+ * decoded yet (a Huffman code or block header split across two chunks) is
+ * carried over in WOLFBOOT_GZIP_STREAM_BUF_SIZE bytes of staging space
+ * inside the context.
+ *
+ * The context is large (~2.3 KB, ~4.3 KB with WOLFBOOT_GZIP_FAST); place it in
+ * static storage on targets with small stacks. Fields are private.
+ */
+#define WOLFBOOT_GZIP_WINDOW_SIZE     32768U /* RFC 1951 max distance */
+#ifndef WOLFBOOT_GZIP_STREAM_BUF_SIZE
+#define WOLFBOOT_GZIP_STREAM_BUF_SIZE 1024U
+#endif
+#ifndef WOLFBOOT_GZIP_FAST_BITS
+#define WOLFBOOT_GZIP_FAST_BITS       9
+#endif
+
+struct wolfBoot_gzip_huff {
+    int16_t  counts[16];              /* codes per length, 0..15 */
+    int16_t  symbols[288];            /* symbols in canonical order */
+#ifdef WOLFBOOT_GZIP_FAST
+    uint16_t fast[1U << WOLFBOOT_GZIP_FAST_BITS];
+#endif
+};
+
+struct wolfBoot_gzip_state {
+    const uint8_t *in;
+    uint32_t       in_len;
+    uint32_t       in_pos;
+#ifdef WOLFBOOT_GZIP_FAST
+    uint64_t       bit_buf;
+#else
+    uint32_t       bit_buf;
+#endif
+    int            bit_count;
+    uint8_t       *out;
+    uint32_t       out_max;
+    uint32_t       out_pos;
+    uint32_t       crc32;
+#ifdef WOLFBOOT_GZIP_FAST
+    uint32_t       crc_pos;
+#endif
+};
+
+typedef struct wolfBoot_gunzip_ctx {
+    struct wolfBoot_gzip_state s;
+    struct wolfBoot_gzip_huff  litlen;
+    struct wolfBoot_gzip_huff  dist;
+    uint8_t  in_buf[WOLFBOOT_GZIP_STREAM_BUF_SIZE];
+    uint32_t stored_left;
+    uint8_t  phase;
+    uint8_t  bfinal;
+    int      error;
+} WOLFBOOT_GUNZIP_CTX;
+
+/* Start a streaming decompression into out[0..out_max).
+ * Returns 0 or WOLFBOOT_GZIP_E_PARAM. */
+int wolfBoot_gunzip_init(WOLFBOOT_GUNZIP_CTX *ctx, uint8_t *out,
+                         uint32_t out_max);
+
+/* Feed the next chunk of the gzip stream. Any chunk size is accepted,
+ * including bytes past the end of the stream (ignored).
+ * Returns 1 once the trailer has been verified, 0 if more input is needed,
+ * or a negative WOLFBOOT_GZIP_E_* error (sticky for the rest of the stream).
+ */
+int wolfBoot_gunzip_feed(WOLFBOOT_GUNZIP_CTX *ctx, const uint8_t *in,
+                         uint32_t in_len);
+
+/* Complete the stream. Returns 0 and sets *out_len if the whole stream,
+ * trailer included, has been decoded; WOLFBOOT_GZIP_E_TRUNCATED if input
+ * is missing, or the error reported by the last feed. */
+int wolfBoot_gunzip_finish(WOLFBOOT_GUNZIP_CTX *ctx, uint32_t *out_len);
+
 #endif /* WOLFBOOT_GZIP_H */
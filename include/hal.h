@@ -60,13 +60,20 @@ void hal_deinit();
 void hal_init(void);
 
 /* Timer functions (platform-specific, used for benchmarking) */
-#if defined(WOLFBOOT_UPDATE_DISK) || defined(BOOT_BENCHMARK)
+#if defined(WOLFBOOT_UPDATE_DISK) || defined(BOOT_BENCHMARK) || \
+    defined(WOLFBOOT_BOOT_TIMING)
 uint64_t hal_get_timer_us(void);
 #endif
 
 /* Boot benchmarking macros
  * Usage: Declare BENCHMARK_DECLARE() at function scope,
  *        then use BENCHMARK_START() and BENCHMARK_END(msg) to measure time.
+ *
+ * Interleaved stages (e.g. read/decrypt/hash of each chunk in a loop) are
+ * timed with per-stage accumulators: BENCHMARK_LAP_DECLARE(stage) at
+ * function scope, BENCHMARK_START() before the loop, BENCHMARK_LAP(stage)
+ * after each stage (charges the time since the previous lap to it) and
+ * BENCHMARK_LAP_REPORT(msg, stage) to print the total.
  */
 #ifdef BOOT_BENCHMARK
     #define BENCHMARK_DECLARE() uint64_t _boot_bench_start
@@ -75,10 +82,42 @@ uint64_t hal_get_timer_us(void);
         uint64_t _elapsed_ms = (hal_get_timer_us() - _boot_bench_start) / 1000; \
         wolfBoot_printf(msg " (%lu ms)\r\n", (unsigned long)_elapsed_ms); \
     } while(0)
+    #define BENCHMARK_LAP_DECLARE(stage) uint64_t _boot_bench_##stage = 0
+    #define BENCHMARK_LAP(stage) do { \
+        uint64_t _now = hal_get_timer_us(); \
+        _boot_bench_##stage += _now - _boot_bench_start; \
+        _boot_bench_start = _now; \
+    } while(0)
+    #define BENCHMARK_LAP_REPORT(msg, stage) \
+        wolfBoot_printf(msg " (%lu ms)\r\n", \
+            (unsigned long)(_boot_bench_##stage / 1000))
 #else
     #define BENCHMARK_DECLARE() do {} while(0)
     #define BENCHMARK_START() do {} while(0)
     #define BENCHMARK_END(msg) wolfBoot_printf(msg "\r\n")
+    #define BENCHMARK_LAP_DECLARE(stage) do {} while(0)
+    #define BENCHMARK_LAP(stage) do {} while(0)
+    #define BENCHMARK_LAP_REPORT(msg, stage) do {} while(0)
+#endif
+
+/* Persistent boot timing (WOLFBOOT_BOOT_TIMING)
+ * BOOT_TIMING_BEGIN(phase)/BOOT_TIMING_END(phase) accumulate the time spent
+ * in a boot phase (WOLFBOOT_TIMING_*). The totals are stored in the
+ * diagnostics log by wolfBoot_timing_commit() before starting the
+ * application. BOOT_TIMING_FLAG(flags) sets WOLFBOOT_TIMING_F_* flags of the
+ * record, e.g. WOLFBOOT_TIMING_F_UPDATE when an update is being installed.
+ */
+#ifdef WOLFBOOT_BOOT_TIMING
+    void wolfBoot_timing_begin(int phase);
+    void wolfBoot_timing_end(int phase);
+    #define BOOT_TIMING_BEGIN(phase) wolfBoot_timing_begin(phase)
+    #define BOOT_TIMING_END(phase) wolfBoot_timing_end(phase)
+    void wolfBoot_timing_flag(uint8_t flags);
+    #define BOOT_TIMING_FLAG(flags) wolfBoot_timing_flag(flags)
+#else
+    #define BOOT_TIMING_BEGIN(phase) do {} while(0)
+    #define BOOT_TIMING_END(phase) do {} while(0)
+    #define BOOT_TIMING_FLAG(flags) do {} while(0)
 #endif
 
 #ifdef ARCH_64BIT
@@ -124,6 +163,50 @@ void hal_prepare_boot(void);
     const char* hal_fit_config_name(void);
 #endif
 
+#ifdef WOLFBOOT_IMG_CHUNKS_PARALLEL
+    /*
+     * Verify all the n chunks of a chunked image, calling
+     * wolfBoot_verify_image_chunk() for each index, possibly on several
+     * cores/threads at the same time. Return 0 only if all the chunks match.
+     */
+    struct wolfBoot_image;
+    int hal_verify_image_chunks(struct wolfBoot_image *img, uint32_t n);
+#endif
+
+#ifdef WOLFBOOT_IMG_CHUNKS_LAZY
+    /*
+     * Lazy verification of XIP images: [start, end) is the part of the boot
+     * image left unverified at boot. Plan to make it non-executable from
+     * do_boot() on, until the application has verified it. Return the start
+     * of the range that will actually be protected (start, or the next
+     * address the protection unit can be aligned to), or 0 if it cannot be
+     * protected: wolfBoot then verifies everything below that address before
+     * boot. The weak default returns 0.
+     */
+    uintptr_t hal_lazy_xip_protect(uintptr_t start, uintptr_t end);
+    /*
+     * Drop the protection planned by hal_lazy_xip_protect(). Called at the
+     * start of each integrity check, and when a lazy check fails, so that
+     * do_boot() only applies the plan of the image verified last. The weak
+     * default does nothing.
+     */
+    void hal_lazy_xip_reset(void);
+#endif
+
+#ifdef WOLFBOOT_MP_DISPATCH
+    /*
+     * Secondary core work dispatch (src/mp_dispatch.c).
+     * hal_mp_shared() returns the zeroed dispatch block, in memory coherent
+     * for all the cores; hal_mp_workers() the number of secondary cores that
+     * may run wolfBoot_mp_worker_poll(); hal_mp_kick(w) wakes worker w
+     * (1..hal_mp_workers()) so that it polls its mailbox.
+     */
+    struct wolfBoot_mp_shared;
+    struct wolfBoot_mp_shared *hal_mp_shared(void);
+    unsigned int hal_mp_workers(void);
+    void hal_mp_kick(unsigned int w);
+#endif
+
 /* Optional watchdog kick. With -DWATCHDOG, wolfBoot calls this from its long
  * hash and flash copy/erase loops; a port overrides the weak no-op default
  * (see libwolfboot.c, hal/renesas-rx.c). Compiles out when WATCHDOG is unset. */
@@ -151,6 +234,10 @@ void wolfBoot_watchdog_feed(void);
     #define ext_flash_unlock() do{}while(0)
     #define ext_flash_read spi_flash_read
     #define ext_flash_write spi_flash_write
+#ifdef SPI_FLASH_SFDP
+    #define ext_flash_erase(address, len) \
+        spi_flash_erase((uint32_t)(address), (len))
+#else
     static inline int ext_flash_erase(uintptr_t address, int len)
     {
         int ret = 0;
@@ -164,6 +251,7 @@ void wolfBoot_watchdog_feed(void);
         }
         return ret;
     }
+#endif /* SPI_FLASH_SFDP */
 #endif /* !SPI_FLASH */
 
 #ifdef TZEN
@@ -197,6 +285,13 @@ int hal_attestation_get_implementation_id(uint8_t *buf, size_t *len);
 int hal_attestation_get_ueid(uint8_t *buf, size_t *len);
 int hal_attestation_get_iak_private_key(uint8_t *buf, size_t *len);
 
+#ifdef WOLFBOOT_VERIFY_CACHE
+/* Device secret keying the verification cache (OTP, PUF, TPM...). It must
+ * not be readable by the application. The weak default uses
+ * hal_uds_derive_key(); without a secret the cache is never used. */
+int hal_verify_cache_secret(uint8_t *out, size_t out_len);
+#endif
+
 #ifdef WOLFBOOT_DICE_HW
 /* Hardware DICE hooks — implement these to delegate CDI derivation and
  * attestation signing to a platform security boundary. */
@@ -670,6 +670,9 @@ static void NOINLINEFUNCTION wolfBoot_image_set_fw_base(
 /* Redundant, canary-wrapped test for a confirmed integrity (digest) check. */
 #define SHA_OK(imgp) (((imgp)->sha_ok == 1) && \
                       ((imgp)->not_sha_ok == ~(uint32_t)1))
+/* Same, for a confirmed signature check */
+#define SIG_OK(imgp) (((imgp)->signature_ok == 1) && \
+                      ((imgp)->not_signature_ok == ~(uint32_t)1))
 
 /**
  * Digest comparison with no call and no return register, run inline as an
@@ -795,6 +798,43 @@ static void NOINLINEFUNCTION wolfBoot_image_set_fw_base(
         asm volatile("nop"); \
     }
 
+/**
+ * Chunk verification (WOLFBOOT_IMG_CHUNKS).
+ *
+ * The root digest computed by image_chunks_root() is kept complemented until
+ * hal_verify_image_chunks() has returned 0, checked redundantly as in
+ * VERIFY_FN(). image_chunks_seal() then restores it from the result itself,
+ * so a skipped branch or call leaves a root that VERIFY_INTEGRITY_FN()
+ * rejects.
+ *
+ * Uses GAS local numeric labels (6f/6:) for safe expansion.
+ */
+#define VERIFY_CHUNKS_FN(img, n, computed_digest) \
+    { \
+        volatile int chunks_res = -1; \
+        /* Redundant set of r0=50 */ \
+        asm volatile("mov r0, #50":::"r0"); \
+        asm volatile("mov r0, #50":::"r0"); \
+        asm volatile("mov r0, #50":::"r0"); \
+        chunks_res = hal_verify_image_chunks((img), (n)); \
+        /* Redundant checks that ensure the function actually returned 0 */ \
+        asm volatile("cmp r0, #0":::"cc"); \
+        asm volatile("cmp r0, #0":::"cc"); \
+        asm volatile("cmp r0, #0":::"cc"); \
+        asm volatile("bne 6f"); \
+        asm volatile("cmp r0, #0":::"cc"); \
+        asm volatile("cmp r0, #0":::"cc"); \
+        asm volatile("cmp r0, #0":::"cc"); \
+        asm volatile("bne 6f"); \
+        asm volatile("cmp r0, #0":::"cc"); \
+        asm volatile("cmp r0, #0":::"cc"); \
+        asm volatile("cmp r0, #0":::"cc"); \
+        asm volatile("bne 6f"); \
+        image_chunks_seal((computed_digest), (uint32_t)chunks_res); \
+        asm volatile("6:"); \
+        asm volatile("nop"); \
+    }
+
 /**
  * Hardened assertion that the integrity (digest) check has actually been
  * performed and passed. Mirrors the sha portion of PART_SANITY_CHECK and is
@@ -1681,6 +1721,7 @@ static void UNUSEDFUNCTION wolfBoot_image_set_fw_base(
         wolfBoot_image_confirm_signature_ok(img);
 
 #define SHA_OK(imgp) ((imgp)->sha_ok == 1)
+#define SIG_OK(imgp) ((imgp)->signature_ok == 1)
 
 #define VERIFY_INTEGRITY_FN(img, computed_digest, stored) \
     if (image_CT_compare((computed_digest), (stored), \
@@ -1689,6 +1730,10 @@ static void UNUSEDFUNCTION wolfBoot_image_set_fw_base(
         wolfBoot_image_confirm_sha_ok(img); \
     }
 
+#define VERIFY_CHUNKS_FN(img, n, computed_digest) \
+    image_chunks_seal((computed_digest), \
+        (uint32_t)hal_verify_image_chunks((img), (n)));
+
 #define PART_SANITY_CHECK(p) \
     if (((p)->hdr_ok != 1) || ((p)->sha_ok != 1) || ((p)->signature_ok != 1)) \
         wolfBoot_panic()
@@ -1722,12 +1767,24 @@ int wolfBoot_open_image(struct wolfBoot_image *img, uint8_t part);
 int wolfBoot_open_image_external(struct wolfBoot_image* img, uint8_t part, uint8_t* addr);
 #endif
 int wolfBoot_open_image_address(struct wolfBoot_image* img, uint8_t* image);
+uint32_t wolfBoot_image_total_size(struct wolfBoot_image *img);
 #ifdef WOLFBOOT_SELF_HEADER
 int wolfBoot_open_self(struct wolfBoot_image *img);
 int wolfBoot_open_self_address(struct wolfBoot_image *img, uint8_t *hdr,
     uint8_t *image);
 #endif
 int wolfBoot_verify_integrity(struct wolfBoot_image *img);
+int wolfBoot_image_hash_start(struct wolfBoot_image *img);
+int wolfBoot_image_hash_update(struct wolfBoot_image *img, uint32_t len);
+int wolfBoot_image_hash_verify(struct wolfBoot_image *img);
+#ifdef WOLFBOOT_IMG_CHUNKS
+uint32_t wolfBoot_image_chunks(struct wolfBoot_image *img);
+int wolfBoot_verify_image_chunk(struct wolfBoot_image *img, uint32_t idx);
+#ifdef WOLFBOOT_IMG_CHUNKS_LAZY
+int wolfBoot_verify_integrity_lazy(struct wolfBoot_image *img,
+    uint32_t prefix);
+#endif
+#endif
 int wolfBoot_verify_authenticity(struct wolfBoot_image *img);
 int wolfBoot_set_partition_state(uint8_t part, uint8_t newst);
 int wolfBoot_get_update_sector_flag(uint16_t sector, uint8_t *flag);
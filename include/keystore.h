@@ -57,6 +57,9 @@ uint8_t *keystore_get_buffer(int id);
 int keystore_get_size(int id);
 uint32_t keystore_get_key_type(int id);
 uint32_t keystore_get_mask(int id);
+#ifdef WOLFBOOT_KEYSTORE_HINTS
+const uint8_t *keystore_get_key_hint(int id);
+#endif
 
 
 #ifdef __cplusplus
@@ -0,0 +1,88 @@
+/* keyvault_log.h
+ *
+ * Log-structured backend for the secure vault of the PKCS11 and PSA stores.
+ *
+ * Compile with KEYVAULT_LOG=1
+ *
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#ifndef KEYVAULT_LOG_H
+#define KEYVAULT_LOG_H
+
+#include <stdint.h>
+
+#ifndef KEYVAULT_OBJ_SIZE
+    #define KEYVAULT_OBJ_SIZE 0x1000 /* 4KB per object */
+#endif
+
+#ifndef KEYVAULT_MAX_ITEMS
+    #define KEYVAULT_MAX_ITEMS 20
+#endif
+
+/* Vault area, same size as the one of the sector based stores */
+#ifndef KEYVAULT_LOG_SIZE
+    #define KEYVAULT_LOG_SIZE \
+        ((((KEYVAULT_MAX_ITEMS * KEYVAULT_OBJ_SIZE) + WOLFBOOT_SECTOR_SIZE - 1) / \
+          WOLFBOOT_SECTOR_SIZE + 2) * WOLFBOOT_SECTOR_SIZE)
+#endif
+
+/* Flash programming unit: every record field is written once between two
+ * erases, in units of this size (16: quad-word ECC flash, e.g. STM32H5) */
+#ifndef KEYVAULT_LOG_ALIGN
+    #define KEYVAULT_LOG_ALIGN 16
+#endif
+
+/* Same payload limit as the sector based stores (the 8 bytes of token and
+ * object id prefix of their slots) */
+#define KEYVAULT_LOG_MAX_PAYLOAD (KEYVAULT_OBJ_SIZE - 8)
+
+/* Same values as the internal errors of wolfPKCS11 (NOT_AVAILABLE_E,
+ * FIND_FULL_E, SESSION_COUNT_E), returned as-is by both stores */
+#define KEYVAULT_LOG_NOT_AVAILABLE  (-4)
+#define KEYVAULT_LOG_FULL           (-5)
+#define KEYVAULT_LOG_SESSION_COUNT  (-8)
+
+struct keyvault_log_stats {
+    uint32_t blocks;          /* erase blocks in the vault */
+    uint32_t block_size;      /* bytes */
+    uint32_t records;         /* records appended since boot */
+    uint32_t sector_erases;   /* flash sectors erased since boot */
+    uint32_t gc_runs;         /* blocks collected since boot */
+    uint32_t gc_bytes;        /* live bytes moved by the collection */
+    uint32_t live_bytes;      /* current objects, with record overhead */
+    uint32_t capacity;        /* max live_bytes */
+    uint32_t min_erase_count; /* wear of the blocks, stored in flash */
+    uint32_t max_erase_count;
+};
+
+/* Same semantic as wolfPKCS11_Store_Open/_Close/_Read/_Write/_Remove. An
+ * object opened for writing is replaced when the store is closed; only one
+ * object can be open for writing at a time. */
+int keyvault_log_open(int32_t type, uint32_t id1, uint32_t id2, int read,
+    void **store);
+void keyvault_log_close(void *store);
+int keyvault_log_read(void *store, unsigned char *buffer, int len);
+int keyvault_log_write(void *store, const unsigned char *buffer, int len);
+int keyvault_log_remove(int32_t type, uint32_t id1, uint32_t id2);
+
+int keyvault_log_get_stats(struct keyvault_log_stats *stats);
+
+#endif /* !KEYVAULT_LOG_H */
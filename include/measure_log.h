@@ -0,0 +1,105 @@
+/* measure_log.h
+ *
+ * Boot-time measurement log: digests of the boot regions, computed once and
+ * shared by measured boot (TPM), DICE and the attestation token.
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#ifndef MEASURE_LOG_H
+#define MEASURE_LOG_H
+
+#include <stdint.h>
+#include "wolfboot/wolfboot.h"
+
+#ifdef WOLFBOOT_MEASURE_LOG
+
+#ifndef WOLFBOOT_MLOG_MAX_ENTRIES
+#define WOLFBOOT_MLOG_MAX_ENTRIES 8
+#endif
+
+/* PCR of an entry not extended into the TPM */
+#define WOLFBOOT_MLOG_NO_PCR 0xFFFFFFFFUL
+
+/* Measured regions */
+#define WOLFBOOT_MLOG_WOLFBOOT      1  /* the bootloader itself */
+#define WOLFBOOT_MLOG_BOOT_IMAGE    2  /* verified image in PART_BOOT */
+#define WOLFBOOT_MLOG_UPDATE_IMAGE  3  /* verified image in PART_UPDATE */
+#define WOLFBOOT_MLOG_BOOT_PARTITION 4 /* whole PART_BOOT (measured boot) */
+
+/* TCG algorithm identifier of WOLFBOOT_HASH_* */
+#if defined(WOLFBOOT_HASH_SHA256)
+#define WOLFBOOT_MLOG_ALG 0x000B
+#elif defined(WOLFBOOT_HASH_SHA384)
+#define WOLFBOOT_MLOG_ALG 0x000C
+#elif defined(WOLFBOOT_HASH_SHA3_384)
+#define WOLFBOOT_MLOG_ALG 0x0028
+#endif
+
+struct wolfBoot_mlog_entry {
+    uint32_t region;     /* WOLFBOOT_MLOG_*, 0 if the entry is free */
+    uint32_t pcr;        /* PCR extended with the digest, or NO_PCR */
+    uintptr_t addr;      /* measured range */
+    uint32_t size;
+    uint16_t alg;        /* WOLFBOOT_MLOG_ALG */
+    uint16_t digest_len;
+    uint8_t digest[WOLFBOOT_SHA_DIGEST_SIZE];
+};
+
+/* Record the digest of a region, replacing the previous entry of the same
+ * region. Returns 0, or -1 if the log is full. */
+int wolfBoot_mlog_record(uint32_t region, uintptr_t addr, uint32_t size,
+    const uint8_t *digest);
+
+/* Drop the entry of a region, e.g. before the region is verified again */
+void wolfBoot_mlog_forget(uint32_t region);
+
+/* Entry of a region, or NULL */
+const struct wolfBoot_mlog_entry *wolfBoot_mlog_get(uint32_t region);
+
+/* Digest of [addr, addr + size): taken from the log if this range has been
+ * measured already for the region, hashed and recorded otherwise. */
+int wolfBoot_mlog_measure(uint32_t region, uintptr_t addr, uint32_t size,
+    uint8_t *digest);
+
+/* Note that the digest of a region has been extended into a PCR */
+int wolfBoot_mlog_set_pcr(uint32_t region, uint32_t pcr);
+
+/* Serialize the log as a TCG PC Client crypto-agile event log (Spec ID
+ * header event, then one TCG_PCR_EVENT2 per entry extended into a PCR).
+ * Entries not extended into a PCR are not exported. With buf == NULL only
+ * the size is returned in *len. */
+int wolfBoot_mlog_export(uint8_t *buf, uint32_t *len);
+
+void wolfBoot_mlog_reset(void);
+
+#ifdef WOLFBOOT_MEASURE_LOG_ADDRESS
+/* Copy the exported log to WOLFBOOT_MEASURE_LOG_ADDRESS for the
+ * application, preceded by its 32-bit length */
+void wolfBoot_mlog_handoff(void);
+#else
+#define wolfBoot_mlog_handoff() do {} while (0)
+#endif
+
+#else
+
+#define wolfBoot_mlog_handoff() do {} while (0)
+
+#endif /* WOLFBOOT_MEASURE_LOG */
+#endif /* MEASURE_LOG_H */
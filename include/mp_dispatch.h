@@ -0,0 +1,74 @@
+/* mp_dispatch.h
+ *
+ * Work dispatch to the secondary cores parked during boot.
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#ifndef MP_DISPATCH_H
+#define MP_DISPATCH_H
+
+#include <stdint.h>
+
+#ifdef WOLFBOOT_MP_DISPATCH
+
+#ifndef WOLFBOOT_MP_MAX_WORKERS
+#define WOLFBOOT_MP_MAX_WORKERS 4
+#endif
+
+/* Work item callback: process item idx of the job, return 0 on success */
+typedef int (*wolfBoot_mp_work_fn)(void *arg, uint32_t idx);
+
+/* Per-worker mailbox. start is written by the boot core, ack, done and
+ * status by the worker. */
+struct wolfBoot_mp_mailbox {
+    volatile uint32_t start;   /* sequence number of the job to run */
+    volatile uint32_t lane;    /* first item of the worker (stride: lanes) */
+    volatile uint32_t ack;     /* sequence number accepted by the worker */
+    volatile uint32_t done;    /* sequence number completed by the worker */
+    volatile int32_t  status;  /* result of the job, 0 or -1 */
+    uint32_t reserved;
+};
+
+/* State shared between the boot core and the workers. It must be placed
+ * in memory that all the cores see coherently (uncached on some SoCs, see
+ * hal_mp_shared()), and be zeroed before the first wolfBoot_mp_run(). */
+struct wolfBoot_mp_shared {
+    volatile uint32_t active;  /* sequence number of the running job, or 0 */
+    volatile uint32_t seq;     /* last sequence number used */
+    volatile uint32_t n;       /* number of items of the job */
+    volatile uint32_t lanes;   /* boot core + workers taking part */
+    volatile uint32_t offline; /* bit w set: worker w stopped answering */
+    uint32_t reserved;
+    void * volatile arg;
+    volatile wolfBoot_mp_work_fn fn;
+    struct wolfBoot_mp_mailbox mb[WOLFBOOT_MP_MAX_WORKERS];
+};
+
+/* Boot core: run fn(arg, idx) for idx in [0, n), split across the boot core
+ * and the available workers. Returns 0 if all the items succeeded. */
+int wolfBoot_mp_run(wolfBoot_mp_work_fn fn, void *arg, uint32_t n);
+
+/* Worker w (1..hal_mp_workers()): run the pending job, if any. Called from
+ * the park loop of the secondary core after every wake-up. Returns 1 if a
+ * job was run, 0 otherwise. */
+int wolfBoot_mp_worker_poll(unsigned int w);
+
+#endif /* WOLFBOOT_MP_DISPATCH */
+#endif /* MP_DISPATCH_H */
@@ -107,6 +107,24 @@
 #endif
 #endif /* !SDHCI_DMA_BUFF_BOUNDARY */
 
+/* ADMA2 scatter/gather DMA (opt-in with SDHCI_ADMA2).
+ * Multi-block transfers of at least SDHCI_DMA_THRESHOLD bytes are described
+ * by a table of 32-bit ADMA2 descriptors, each covering up to 64KB, so a
+ * single CMD18 moves up to SDHCI_ADMA2_MAX_DESC * 64KB without the SDMA
+ * boundary interrupts or the PIO BRR polling loop. Used only when the
+ * controller reports ADMA2 support (SRS16.A2S); the transfer falls back to
+ * SDMA/PIO when the buffer is not DMA addressable (to CMD17 reads with
+ * SDHCI_FORCE_SINGLE_BLOCK_READ), and ADMA2 is disabled for the rest of the
+ * boot after an ADMA error or timeout. */
+#ifdef SDHCI_ADMA2
+#ifndef SDHCI_ADMA2_MAX_DESC
+#define SDHCI_ADMA2_MAX_DESC    32
+#endif
+#define SDHCI_ADMA2_DESC_MAX_LEN    (64U * 1024U)
+#define SDHCI_ADMA2_MAX_BLOCKS  \
+    ((SDHCI_ADMA2_MAX_DESC * SDHCI_ADMA2_DESC_MAX_LEN) / SDHCI_BLOCK_SIZE)
+#endif /* SDHCI_ADMA2 */
+
 /* Timeouts */
 #ifndef SDHCI_INIT_TIMEOUT_US
 #define SDHCI_INIT_TIMEOUT_US   500000      /* 500ms for initialization */
@@ -234,7 +252,9 @@
 #define SDHCI_SRS10_BVS_1_8V    (0x5U << 9)
 #define SDHCI_SRS10_BVS_3_0V    (0x6U << 9)
 #define SDHCI_SRS10_BVS_3_3V    (0x7U << 9)
+#define SDHCI_SRS10_DMA_MASK    (0x3U << 3)
 #define SDHCI_SRS10_DMA_SDMA    (0x0U << 3)
+#define SDHCI_SRS10_DMA_ADMA2   (0x2U << 3)
 
 /* SRS11 - Clock Control / Timeout / Software Reset */
 #define SDHCI_SRS11_ICE         (1U << 0)   /* Internal clock enable */
@@ -327,6 +347,7 @@
 #define SDHCI_SRS16_TCU         (1U << 7)   /* Timeout clock unit (1=MHz) */
 #define SDHCI_SRS16_BCSDCLK_SHIFT   8
 #define SDHCI_SRS16_BCSDCLK_MASK    (0xFFU << 8)
+#define SDHCI_SRS16_A2S         (1U << 19)  /* ADMA2 support */
 #define SDHCI_SRS16_VS33        (1U << 24)  /* 3.3V supported */
 #define SDHCI_SRS16_VS30        (1U << 25)  /* 3.0V supported */
 #define SDHCI_SRS16_VS18        (1U << 26)  /* 1.8V supported */
@@ -415,8 +436,15 @@
 #define SDHCI_IRQ_FLAG_CC       0x01
 #define SDHCI_IRQ_FLAG_TC       0x02
 #define SDHCI_IRQ_FLAG_DMAINT   0x04
+#define SDHCI_IRQ_FLAG_ADMA_ERR 0x08
 #define SDHCI_IRQ_FLAG_ERROR    0x80
 
+/* ADMA2 descriptor attributes (32-bit addressing, 16-bit length) */
+#define SDHCI_ADMA2_ATTR_VALID  (1U << 0)
+#define SDHCI_ADMA2_ATTR_END    (1U << 1)
+#define SDHCI_ADMA2_ATTR_INT    (1U << 2)
+#define SDHCI_ADMA2_ATTR_ACT_TRAN   (0x2U << 4)
+
 /* Response types */
 typedef enum {
     SDHCI_RESP_NONE,
@@ -0,0 +1,89 @@
+/* sfdp.h
+ *
+ * JEDEC Serial Flash Discoverable Parameters (JESD216): discovery of the
+ * geometry, erase types and read modes of SPI NOR flash memories.
+ *
+ * Compile with SPI_FLASH_SFDP=1
+ *
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#ifndef SFDP_H
+#define SFDP_H
+
+#include <stdint.h>
+
+#define SFDP_READ_CMD        0x5AU /* 3-byte address, 8 dummy clocks */
+#define SFDP_READ_DUMMY      8
+#define SFDP_SIGNATURE       0x50444653UL /* "SFDP" */
+#define SFDP_MAX_ERASE_TYPES 4
+
+/* Read modes of the Basic Flash Parameter Table */
+#define SFDP_READ_1_1_2      0
+#define SFDP_READ_1_2_2      1
+#define SFDP_READ_1_1_4      2
+#define SFDP_READ_1_4_4      3
+#define SFDP_READ_MODES      4
+
+struct sfdp_erase_type {
+    uint32_t size;     /* bytes, 0 if not supported */
+    uint8_t opcode;
+};
+
+struct sfdp_read_mode {
+    uint8_t opcode;    /* 0 if not supported */
+    uint8_t dummy;     /* wait states (dummy clocks) */
+    uint8_t mode;      /* mode bit clocks, sent before the wait states */
+};
+
+struct sfdp_info {
+    uint32_t size;              /* device size, bytes */
+    uint32_t page_size;         /* program page, bytes */
+    uint8_t addr_bytes;         /* 3, or 4 for 4-byte only devices */
+    uint8_t addr4_supported;    /* 4-byte addressing available */
+    uint8_t quad_enable;        /* Quad Enable Requirements (BFPT DWORD 15) */
+    uint8_t n_erase;
+    /* sorted by increasing size */
+    struct sfdp_erase_type erase[SFDP_MAX_ERASE_TYPES];
+    struct sfdp_read_mode read[SFDP_READ_MODES];
+};
+
+/* Read len bytes of the SFDP space at addr (SFDP_READ_CMD). Returns 0. */
+typedef int (*sfdp_read_cb)(uint32_t addr, uint8_t *buf, uint32_t len);
+
+/* Read and parse the SFDP header and the Basic Flash Parameter Table.
+ * Returns 0, or -1 if the device does not implement SFDP. */
+int sfdp_probe(sfdp_read_cb read, struct sfdp_info *info);
+
+/* Largest erase type that erases [addr, addr + size) with size <= len and
+ * addr aligned, or NULL if addr is not aligned to the smallest type. */
+const struct sfdp_erase_type *sfdp_erase_type_for(const struct sfdp_info *info,
+    uint32_t addr, uint32_t len);
+
+/* Erase command of the driver: opcode, address. Returns 0 when done. */
+typedef int (*sfdp_erase_cb)(uint8_t opcode, uint32_t addr);
+
+/* Erase all the smallest erase units touched by [addr, addr + len), with the
+ * largest erase type that fits each aligned step (e.g. 64 KB blocks inside
+ * the range, 4 KB sectors at its ends). */
+int sfdp_erase_range(const struct sfdp_info *info, uint32_t addr,
+    uint32_t len, sfdp_erase_cb erase);
+
+#endif /* !SFDP_H */
@@ -81,6 +81,13 @@ void spi_cs_on(uint32_t base, int pin);
 void spi_cs_off(uint32_t base, int pin);
 void spi_write(const char byte);
 uint8_t spi_read(void);
+/* Bulk transfer on the chip select (base, pin): sz bytes are clocked out
+ * from tx (0xFF when tx is NULL) and received into rx (discarded when rx is
+ * NULL). Set flags == SPI_XFER_FLAG_CONTINUE to keep CS asserted for the next
+ * call. A weak version built on spi_write()/spi_read() is provided by
+ * spi_flash.c; drivers may override it with FIFO or DMA transfers. */
+int spi_xfer_buf(uint32_t base, int pin, const uint8_t *tx, uint8_t *rx,
+    uint32_t sz, int flags);
 #endif
 
 #ifdef WOLFBOOT_TPM
@@ -665,9 +665,10 @@ extern int tolower(int c);
     #define NO_AES
 #endif
 
+/* HMAC is also used by the verification cache (WOLFBOOT_VERIFY_CACHE) */
 #if !defined(WOLFBOOT_TPM) && !defined(WOLFCRYPT_SECURE_MODE) && \
     !defined(WOLFCRYPT_TEST) && !defined(WOLFCRYPT_BENCHMARK) && \
-    !defined(WOLFCRYPT_MAX32666_TEST)
+    !defined(WOLFCRYPT_MAX32666_TEST) && !defined(WOLFBOOT_VERIFY_CACHE)
 #   define NO_HMAC
 #endif
 
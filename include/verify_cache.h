@@ -0,0 +1,67 @@
+/* verify_cache.h
+ *
+ * Verification cache: skip the signature verification of a boot image that
+ * has already been authenticated on this device, when its digest, version
+ * and key are unchanged.
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#ifndef VERIFY_CACHE_H
+#define VERIFY_CACHE_H
+
+#include <stdint.h>
+#include "image.h"
+
+#ifdef WOLFBOOT_VERIFY_CACHE
+
+/* "WBVC" */
+#define WOLFBOOT_VERIFY_CACHE_MAGIC 0x43564257UL
+
+/* Size of the device secret returned by hal_verify_cache_secret() */
+#ifndef WOLFBOOT_VERIFY_CACHE_SECRET_SIZE
+#define WOLFBOOT_VERIFY_CACHE_SECRET_SIZE 32
+#endif
+
+/* Record stored at WOLFBOOT_VERIFY_CACHE_ADDRESS. The MAC covers the image
+ * digest, the version, the key slot and the public key(s) in the keystore,
+ * keyed with a key derived from the device secret. */
+struct wolfBoot_verify_cache_record {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t key_slot;
+    uint32_t reserved;
+    uint8_t mac[WOLFBOOT_SHA_DIGEST_SIZE];
+};
+
+/* Check the image against the cache record. Returns 0 and confirms the
+ * signature of the image if the record matches, -1 otherwise. The integrity
+ * of the image must have been verified. */
+int wolfBoot_verify_cache_check(struct wolfBoot_image *img);
+
+/* Store the record of an image whose signature has just been verified.
+ * Returns 0 (also when the record is already up to date), or -1. */
+int wolfBoot_verify_cache_store(struct wolfBoot_image *img);
+
+/* wolfBoot_verify_authenticity(), served from the cache when possible. The
+ * cache is refreshed after a full verification. */
+int wolfBoot_verify_authenticity_cached(struct wolfBoot_image *img);
+
+#endif /* WOLFBOOT_VERIFY_CACHE */
+#endif /* VERIFY_CACHE_H */
@@ -242,6 +242,10 @@ extern "C" {
 /* Signature-covered digest of a raw (non-FIT) device tree, binding it to this
  * image. Length = image hash size (WOLFBOOT_SHA_DIGEST_SIZE). */
 #define HDR_DEVICE_TREE_DIGEST      0x35
+/* Chunked image digest: size of the chunks (4 bytes). The table of the
+ * digests of all the chunks follows the firmware, and the image digest covers
+ * the header and the table instead of the firmware. */
+#define HDR_IMG_CHUNKS              0x36
 #define HDR_PADDING                 0xFF
 
 /* Auth Key types */
@@ -345,7 +349,9 @@ extern "C" {
     #define WOLFBOOT_DEVID_CRYPT  (-2) /* INVALID_DEVID */
 #endif
 
-#if defined(__WOLFBOOT) || defined(UNIT_TEST_AUTH)
+/* The application also hashes the boot image with IMG_CHUNKS_LAZY */
+#if defined(__WOLFBOOT) || defined(UNIT_TEST_AUTH) || \
+    defined(WOLFBOOT_IMG_CHUNKS_LAZY)
 
 #include "wolfssl/wolfcrypt/settings.h"
 #include "wolfssl/wolfcrypt/visibility.h"
@@ -383,6 +389,11 @@ extern "C" {
 #   define self_hash self_sha256
 #   define final_hash wc_Sha256Final
     typedef wc_Sha256 wolfBoot_hash_t;
+#   define wolfBoot_hash_init(c) \
+        wc_InitSha256_ex(c, NULL, WOLFBOOT_DEVID_HASH)
+#   define wolfBoot_hash_update(c, p, l) wc_Sha256Update(c, p, l)
+#   define wolfBoot_hash_final(c, d)     wc_Sha256Final(c, d)
+#   define wolfBoot_hash_free(c)         wc_Sha256Free(c)
 #   define HDR_HASH HDR_SHA256
 #elif defined(WOLFBOOT_HASH_SHA384)
 #   ifdef WOLFBOOT_HASH_SHA256
@@ -405,6 +416,11 @@ extern "C" {
 #   define self_hash self_sha384
 #   define final_hash wc_Sha384Final
     typedef wc_Sha384 wolfBoot_hash_t;
+#   define wolfBoot_hash_init(c) \
+        wc_InitSha384_ex(c, NULL, WOLFBOOT_DEVID_HASH)
+#   define wolfBoot_hash_update(c, p, l) wc_Sha384Update(c, p, l)
+#   define wolfBoot_hash_final(c, d)     wc_Sha384Final(c, d)
+#   define wolfBoot_hash_free(c)         wc_Sha384Free(c)
 #   define HDR_HASH HDR_SHA384
 #elif defined(WOLFBOOT_HASH_SHA3_384)
 #   ifdef WOLFBOOT_HASH_SHA256
@@ -426,6 +442,11 @@ extern "C" {
 #   define final_hash wc_Sha3Final
 #   define key_hash key_sha3_384
     typedef wc_Sha3 wolfBoot_hash_t;
+#   define wolfBoot_hash_init(c) \
+        wc_InitSha3_384(c, NULL, WOLFBOOT_DEVID_HASH)
+#   define wolfBoot_hash_update(c, p, l) wc_Sha3_384_Update(c, p, l)
+#   define wolfBoot_hash_final(c, d)     wc_Sha3_384_Final(c, d)
+#   define wolfBoot_hash_free(c)         wc_Sha3_384_Free(c)
 #   define HDR_HASH HDR_SHA3_384
 #else
 #   error "No valid hash algorithm defined!"
@@ -671,18 +692,68 @@ struct wolfBoot_failure_record {
     uint32_t crc;        /* CRC32 over the preceding 12 bytes */
 };
 
+/* Boot-timing records share the diagnostics log with the failure records.
+ * They are told apart by their phase, and are skipped by
+ * wolfBoot_get_failure_count() / wolfBoot_get_failure(). */
+#define WOLFBOOT_FAILURE_PHASE_TIMING 0x80
+/* Boot counter used to sample the boot-timing records (never returned) */
+#define WOLFBOOT_FAILURE_PHASE_BOOT_COUNT 0x81
+
+/* Boot phases timed in a boot-timing record */
+#define WOLFBOOT_TIMING_HASH      0 /* image integrity checks */
+#define WOLFBOOT_TIMING_SIGNATURE 1 /* image signature checks */
+#define WOLFBOOT_TIMING_DECRYPT   2 /* decryption of encrypted images */
+#define WOLFBOOT_TIMING_COPY      3 /* update swap/copy, or load to RAM */
+#define WOLFBOOT_TIMING_DELTA     4 /* delta patching */
+#define WOLFBOOT_TIMING_TOTAL     5 /* timer value when the app is started */
+#define WOLFBOOT_TIMING_PHASES    6
+
+/* Boot-timing record flags */
+#define WOLFBOOT_TIMING_F_UPDATE  0x01 /* an update was installed */
+
+/* Persisted boot-timing record (one per sampled boot). The first 16 bytes
+ * have the layout of struct wolfBoot_failure_record. */
+struct wolfBoot_timing_record {
+    uint32_t seq;        /* monotonic sequence number (higher = newer) */
+    uint8_t  phase;      /* WOLFBOOT_FAILURE_PHASE_TIMING */
+    uint8_t  flags;      /* WOLFBOOT_TIMING_F_* */
+    uint8_t  partition;  /* partition booted */
+    uint8_t  reserved;
+    uint32_t fw_version; /* version of the image booted */
+    uint32_t crc;        /* CRC32 over the preceding 12 bytes */
+    uint16_t duration[WOLFBOOT_TIMING_PHASES]; /* see wolfBoot_timing_us() */
+    uint32_t crc_duration; /* CRC32 over duration[] */
+};
+
 /* Public API */
 int wolfBoot_get_failure_count(void);
 int wolfBoot_get_failure(int index, struct wolfBoot_failure_record *out);
 int wolfBoot_clear_failures(void);
+int wolfBoot_get_timing_count(void);
+int wolfBoot_get_timing(int index, struct wolfBoot_timing_record *out);
+uint32_t wolfBoot_timing_us(const struct wolfBoot_timing_record *rec,
+        int phase);
 
 #if defined(__WOLFBOOT) || defined(UNIT_TEST)
 /* Internal API */
 int wolfBoot_record_failure(uint8_t phase, uint8_t cause, uint8_t partition,
         uint32_t fw_version);
+#ifdef WOLFBOOT_BOOT_TIMING
+int wolfBoot_timing_commit(uint8_t partition, uint32_t fw_version);
+#endif
 #endif
 #endif /* WOLFBOOT_PERSIST_FAILURE_STATUS */
 
+#if defined(WOLFBOOT_IMG_CHUNKS_LAZY) && defined(WOLFBOOT_FIXED_PARTITIONS)
+/* Lazy verification of the running XIP image (IMG_CHUNKS_LAZY=1): only the
+ * first chunks are verified before boot, the application verifies the
+ * others before executing them. */
+int wolfBoot_lazy_verify_next(void);
+int wolfBoot_lazy_verify_range(uintptr_t addr, uint32_t len);
+/* Weak hook, called as the verified part [start, end) of the image grows */
+void wolfBoot_lazy_xip_verified(uintptr_t start, uintptr_t end);
+#endif
+
 
 /* Encryption algorithm constants - always available for tools */
 #define ENCRYPT_BLOCK_SIZE_CHACHA  64
@@ -88,12 +88,32 @@ enum ata_security_state ata_security_get_state(int);
 
 #define ATA_CMD_READ_DMA_EX 0x25
 #define ATA_CMD_WRITE_DMA_EX 0x35
+#define ATA_CMD_READ_FPDMA_QUEUED 0x60
 #define ATA_CMD_DEVICE_CONFIGURATION_IDENTIFY 0xB1
 #define ATA_CMD_WRITE_DMA 0xCA
 #define ATA_CMD_IDENTIFY_DEVICE 0xEC
 
 #define ATA_IDENTIFY_DEVICE_COMMAND_LEN          (256 * 2)
 
+/* Command tables: PRDT entries per command, bytes per PRDT entry */
+#define ATA_PRDT_ENTRIES        8
+#define ATA_PRDT_MAX_BYTES      (4 * 1024 * 1024)
+#define ATA_CMD_TABLE_SIZE      (128 + ATA_PRDT_ENTRIES * 16)
+
+#ifdef WOLFBOOT_AHCI_NCQ
+/* READ FPDMA QUEUED: tags (and command tables) in use per port, and the
+ * number of sectors of each queued command */
+#ifndef ATA_NCQ_MAX_SLOTS
+#define ATA_NCQ_MAX_SLOTS       8
+#endif
+#ifndef ATA_NCQ_XFER_SECTORS
+#define ATA_NCQ_XFER_SECTORS    128
+#endif
+#define ATA_CMD_SLOTS           ATA_NCQ_MAX_SLOTS
+#else
+#define ATA_CMD_SLOTS           1
+#endif
+
 
 /* Security feature set */
 #define ATA_CMD_SECURITY_SET_PASSWORD       0xF1
@@ -75,6 +75,14 @@ ifeq ($(FLASH_OTP_KEYSTORE),1)
     CFLAGS+=-D"FLASH_OTP_KEYSTORE"
 endif
 
+# Look up the key slot using the key digests precomputed in keystore.c
+ifeq ($(KEYSTORE_HINTS),1)
+    CFLAGS+=-D"WOLFBOOT_KEYSTORE_HINTS"
+endif
+ifeq ($(KEYSTORE_HINTS_VERIFY),1)
+    CFLAGS+=-D"WOLFBOOT_KEYSTORE_HINTS" -D"WOLFBOOT_KEYSTORE_HINTS_VERIFY"
+endif
+
 ifeq ($(WOLFBOOT_TEST_FILLER),1)
     CFLAGS+=-D"WOLFBOOT_TEST_FILLER"
 endif
@@ -98,6 +106,13 @@ ifeq ($(WOLFBOOT_PERSIST_FAILURE_STATUS),1)
     ifeq ($(WOLFBOOT_DIAGNOSTICS_EXT),1)
         CFLAGS+=-D"WOLFBOOT_DIAGNOSTICS_EXT"
     endif
+    # Boot phase timings stored in the same log (needs hal_get_timer_us)
+    ifeq ($(WOLFBOOT_BOOT_TIMING),1)
+        CFLAGS+=-D"WOLFBOOT_BOOT_TIMING"
+        ifneq ($(WOLFBOOT_BOOT_TIMING_SAMPLE),)
+            CFLAGS+=-D"WOLFBOOT_BOOT_TIMING_SAMPLE=$(WOLFBOOT_BOOT_TIMING_SAMPLE)"
+        endif
+    endif
 endif
 
 # Support for TPM signature verification
@@ -126,6 +141,35 @@ ifeq ($(MEASURED_BOOT_TCG2),1)
   CFLAGS+=-D"WOLFBOOT_MEASURED_PCR_A=$(MEASURED_PCR_A)"
 endif
 
+## Measurement log: each boot region is hashed once, and the digest shared
+## by measured boot, DICE and the attestation token. With
+## MEASURE_LOG_ADDRESS, the log is handed to the application as a TCG event
+## log at that address (32-bit length first, MEASURE_LOG_SIZE bytes at most).
+ifeq ($(MEASURE_LOG),1)
+  CFLAGS+=-D"WOLFBOOT_MEASURE_LOG"
+  OBJS+=src/measure_log.o
+  ifneq ($(MEASURE_LOG_ADDRESS),)
+    CFLAGS+=-D"WOLFBOOT_MEASURE_LOG_ADDRESS=$(MEASURE_LOG_ADDRESS)"
+  endif
+  ifneq ($(MEASURE_LOG_SIZE),)
+    CFLAGS+=-D"WOLFBOOT_MEASURE_LOG_SIZE=$(MEASURE_LOG_SIZE)"
+  endif
+endif
+
+## Verification cache: after a full signature check of the boot image, a MAC
+## keyed by a device secret (hal_verify_cache_secret) is stored in the flash
+## sector at VERIFY_CACHE_ADDRESS. Later boots of the same image check the
+## MAC instead of the signature. HMAC is linked via AUX_WOLFCRYPT_OBJS.
+ifeq ($(VERIFY_CACHE),1)
+  ifeq ($(VERIFY_CACHE_ADDRESS),)
+    $(error VERIFY_CACHE=1 requires VERIFY_CACHE_ADDRESS)
+  endif
+  CFLAGS+=-D"WOLFBOOT_VERIFY_CACHE"
+  CFLAGS+=-D"WOLFBOOT_VERIFY_CACHE_ADDRESS=$(VERIFY_CACHE_ADDRESS)"
+  OBJS+=src/verify_cache.o
+  AUX_WOLFCRYPT_OBJS+=$(WOLFBOOT_LIB_WOLFSSL)/wolfcrypt/src/hmac.o
+endif
+
 ## TPM keystore
 ifeq ($(WOLFBOOT_TPM_KEYSTORE),1)
   WOLFTPM:=1
@@ -789,6 +833,19 @@ ifeq ($(QSPI_FLASH),1)
   endif
 endif
 
+ifeq ($(SPI_FLASH_DMA),1)
+  ifeq ($(SPI_FLASH),1)
+    CFLAGS+=-D"SPI_FLASH_DMA"
+  endif
+endif
+
+ifeq ($(SPI_FLASH_SFDP),1)
+  ifneq ($(filter 1,$(SPI_FLASH) $(QSPI_FLASH)),)
+    CFLAGS+=-D"SPI_FLASH_SFDP"
+    OBJS+= src/sfdp.o
+  endif
+endif
+
 # SD Card support (Cadence SDHCI controller)
 ifeq ($(DISK_SDCARD),1)
   CFLAGS+=-D"DISK_SDCARD=1"
@@ -860,6 +917,18 @@ ifeq ($(EXT_FLASH),1)
     CFLAGS+=-D"UART_FLASH=1"
     OBJS+=src/uart_flash.o
     WOLFCRYPT_OBJS+=hal/uart/uart_drv_$(UART_TARGET).o
+    ifeq ($(UART_FLASH_V2),1)
+      CFLAGS+=-D"UART_FLASH_V2"
+    endif
+    ifneq ($(UART_FLASH_V2_WINDOW),)
+      CFLAGS+=-D"UART_FLASH_V2_WINDOW=$(UART_FLASH_V2_WINDOW)"
+    endif
+    ifneq ($(UART_FLASH_V2_FRAME_SIZE),)
+      CFLAGS+=-D"UART_FLASH_V2_FRAME_SIZE=$(UART_FLASH_V2_FRAME_SIZE)"
+    endif
+    ifneq ($(UART_FLASH_V2_BITRATE),)
+      CFLAGS+=-D"UART_FLASH_V2_BITRATE=$(UART_FLASH_V2_BITRATE)"
+    endif
   endif
 endif
 
@@ -942,6 +1011,9 @@ endif
 
 ifeq ($(NVM_FLASH_WRITEONCE),1)
   CFLAGS+= -D"NVM_FLASH_WRITEONCE"
+  ifeq ($(NVM_FLASH_LOG),1)
+    CFLAGS+= -D"NVM_FLASH_LOG"
+  endif
 endif
 
 ifeq ($(DISABLE_BACKUP),1)
@@ -950,6 +1022,10 @@ ifeq ($(DISABLE_BACKUP),1)
   WOLFBOOT_PARTITION_SWAP_ADDRESS?=0
 endif
 
+ifeq ($(SWAP_SKIP_UNCHANGED),1)
+  CFLAGS+= -D"WOLFBOOT_SWAP_SKIP_UNCHANGED"
+endif
+
 DEBUG_SYMBOLS?=0
 ifeq ($(DEBUG),1)
   CFLAGS+=-O0 -D"DEBUG"
@@ -1011,10 +1087,20 @@ endif
 
 # GZIP=1 enables native gzip decompression of FIT subimages
 # (RFC 1951 + RFC 1952). Enabled by default in FIT-using example configs.
+# GZIP_FAST=1 selects the table-driven inflater (~5 KB more stack, faster).
+# GZIP_CRC32_TABLE=1/4/8 selects a 1/4/8 KB table-driven CRC32 (0: bitwise).
 GZIP ?= 0
+GZIP_FAST ?= 0
+GZIP_CRC32_TABLE ?= 0
 ifeq ($(GZIP),1)
   OBJS += src/gzip.o
   CFLAGS+=-DWOLFBOOT_GZIP
+  ifeq ($(GZIP_FAST),1)
+    CFLAGS+=-DWOLFBOOT_GZIP_FAST
+  endif
+  ifneq ($(GZIP_CRC32_TABLE),0)
+    CFLAGS+=-DWOLFBOOT_GZIP_CRC32_TABLE=$(GZIP_CRC32_TABLE)
+  endif
 endif
 
 # FIT_RAMDISK=1 enables FIT ramdisk (initramfs) extraction and DTB
@@ -1025,6 +1111,14 @@ ifeq ($(FIT_RAMDISK),1)
   CFLAGS+=-DWOLFBOOT_FIT_RAMDISK
 endif
 
+# FDT_INDEX=1 indexes the nodes of the DTB once before hal_dts_fixup, so that
+# the node/compatible/phandle lookups of the fixups do not walk the blob. The
+# index takes 12 bytes per node (FDT_INDEX_MAX_NODES, default 1024).
+FDT_INDEX ?= 0
+ifeq ($(FDT_INDEX),1)
+  CFLAGS+=-DWOLFBOOT_FDT_INDEX
+endif
+
 # FPGA_BITSTREAM=1 enables loading an "fpga" sub-image from a FIT and
 # programming the PL before booting (Xilinx ZynqMP/Zynq-7000; Versal is
 # stubbed pending a PLM Load-PDI path). Off by default.
@@ -1062,6 +1156,34 @@ ifeq ($(WOLFBOOT_IMG_HASH_ONESHOT),1)
   CFLAGS+=-DWOLFBOOT_IMG_HASH_ONESHOT
 endif
 
+# Chunked image digest: images are signed with a table of per-chunk digests,
+# and the chunks can be verified independently (in parallel with
+# IMG_CHUNKS_PARALLEL, see hal_verify_image_chunks())
+ifeq ($(IMG_CHUNKS),1)
+  IMG_CHUNK_SIZE?=0x10000
+  CFLAGS+=-DWOLFBOOT_IMG_CHUNKS
+  SIGN_OPTIONS+=--chunk-size $(IMG_CHUNK_SIZE)
+  ifeq ($(IMG_CHUNKS_PARALLEL),1)
+    CFLAGS+=-DWOLFBOOT_IMG_CHUNKS_PARALLEL
+  endif
+  # XIP boot image verified lazily: only the first IMG_CHUNKS_LAZY_PREFIX
+  # bytes before boot, the rest by the application, see
+  # wolfBoot_lazy_verify_next() and hal_lazy_xip_protect()
+  ifeq ($(IMG_CHUNKS_LAZY),1)
+    IMG_CHUNKS_LAZY_PREFIX?=0x4000
+    CFLAGS+=-DWOLFBOOT_IMG_CHUNKS_LAZY \
+      -DWOLFBOOT_IMG_CHUNKS_LAZY_PREFIX=$(IMG_CHUNKS_LAZY_PREFIX)
+  endif
+endif
+
+# Work dispatch to the parked secondary cores (src/mp_dispatch.c). The HAL
+# provides hal_mp_shared/hal_mp_workers/hal_mp_kick (hal/mpfs250.c), and
+# with IMG_CHUNKS_PARALLEL=1 the chunks are verified on all the cores.
+ifeq ($(MP_DISPATCH),1)
+  CFLAGS+=-DWOLFBOOT_MP_DISPATCH
+  OBJS+=src/mp_dispatch.o
+endif
+
 ifeq ($(WOLFBOOT_HUGE_STACK),1)
   CFLAGS+=-DWOLFBOOT_HUGE_STACK
 endif
@@ -1115,6 +1237,9 @@ ifeq ($(WOLFCRYPT_TZ_PKCS11),1)
   endif
   WOLFCRYPT_OBJS+=src/store_sbrk.o
   WOLFCRYPT_OBJS+=src/pkcs11_store.o
+  ifeq ($(KEYVAULT_LOG),1)
+    WOLFCRYPT_OBJS+=src/keyvault_log.o
+  endif
   WOLFCRYPT_OBJS+=src/pkcs11_callable.o
   WOLFCRYPT_OBJS+=$(WOLFBOOT_LIB_WOLFSSL)/wolfcrypt/src/pwdbased.o
   WOLFCRYPT_OBJS+=$(WOLFBOOT_LIB_WOLFSSL)/wolfcrypt/src/hmac.o
@@ -1173,6 +1298,9 @@ ifeq ($(WOLFCRYPT_TZ_PSA),1)
   endif
   WOLFCRYPT_OBJS+=src/store_sbrk.o
   WOLFCRYPT_OBJS+=src/psa_store.o
+  ifeq ($(KEYVAULT_LOG),1)
+    WOLFCRYPT_OBJS+=src/keyvault_log.o
+  endif
   WOLFCRYPT_OBJS+=src/arm_tee_psa_veneer.o
   WOLFCRYPT_OBJS+=src/arm_tee_psa_ipc.o
   WOLFCRYPT_OBJS+=$(WOLFBOOT_LIB_WOLFCOSE)/src/wolfcose.o
@@ -1440,6 +1568,10 @@ ifeq ($(DISK_LOCK),1)
   endif
 endif
 
+ifeq ($(AHCI_NCQ),1)
+  CFLAGS+=-DWOLFBOOT_AHCI_NCQ
+endif
+
 ifeq ($(FSP), 1)
   X86_FSP_OPTIONS := \
     X86_UART_BASE \
@@ -1498,6 +1630,13 @@ ifneq ($(KEYVAULT_MAX_ITEMS),)
   CFLAGS+=-DKEYVAULT_MAX_ITEMS=$(KEYVAULT_MAX_ITEMS)
 endif
 
+# KEYVAULT_LOG=1 stores the PKCS11/PSA vault as an append-only log with a RAM
+# index (src/keyvault_log.c) instead of one slot per object. The two layouts
+# are not compatible: the vault is formatted on the first access.
+ifeq ($(KEYVAULT_LOG),1)
+  CFLAGS+=-DWOLFBOOT_KEYVAULT_LOG
+endif
+
 # Support for using a custom partition ID
 ifneq ($(WOLFBOOT_PART_ID),)
   CFLAGS+=-DHDR_IMG_TYPE_APP=$(WOLFBOOT_PART_ID)
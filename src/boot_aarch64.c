@@ -24,6 +24,7 @@
 #include "image.h"
 #include "loader.h"
 #include "printf.h"
+#include "fdt.h"
 #include "wolfboot/wolfboot.h"
 
 /* Include platform-specific header for EL configuration defines
@@ -158,7 +159,9 @@ void RAMFUNCTION do_boot(const uint32_t *app_offset)
         (uint32_t)(uintptr_t)app_offset, current_el());
 #ifdef MMU
     wolfBoot_printf("do_boot: dts=0x%08x\n", (uint32_t)(uintptr_t)dts_offset);
+    fdt_index_build((void*)dts_offset);
     hal_dts_fixup((uint32_t*)dts_offset);
+    fdt_index_release();
 #endif
 
 #ifndef SKIP_GIC_INIT
@@ -185,6 +185,88 @@ static void RAMFUNCTION mpu_off(void)
     mpu_is_on = 0;
     MPU_CTRL = 0;
 }
+
+#if defined(WOLFBOOT_IMG_CHUNKS_LAZY) && !defined(CORTEX_M33) && \
+    !defined(CORTEX_M55) && !defined(CORTEX_R5)
+/* Lazy verification of the boot image (IMG_CHUNKS_LAZY=1): the part that is
+ * not verified before boot is covered by execute-never regions, which
+ * do_boot() sets up in place of turning the MPU off. PMSAv7 regions are
+ * naturally aligned powers of two, of at least 32 bytes. */
+#define MPU_LAZY_XIP
+#define MPU_LAZY_MIN_REGION 32U
+#ifndef MPU_LAZY_MAX_REGIONS
+#define MPU_LAZY_MAX_REGIONS 16
+#endif
+
+static uint32_t mpu_lazy_base[MPU_LAZY_MAX_REGIONS];
+static uint32_t mpu_lazy_rasr[MPU_LAZY_MAX_REGIONS];
+static int mpu_lazy_count = 0;
+
+/* RASR SIZE field of a power-of-two region of sz bytes */
+static uint32_t mpu_lazy_size(uint32_t sz)
+{
+    uint32_t field = 0;
+
+    while ((sz >> (field + 1)) > 1U)
+        field++;
+    return field << 1;
+}
+
+/* Cover [start, end) with at most max regions, from the lowest address
+ * above start for which it is possible: the more aligned the start, the
+ * fewer regions are needed. Returns the start of the covered range, or 0
+ * if there is none. */
+static uint32_t mpu_lazy_plan(uint32_t start, uint32_t end, int max)
+{
+    uint32_t align, first, addr, sz;
+    int n;
+
+    mpu_lazy_count = 0;
+    if (max > MPU_LAZY_MAX_REGIONS)
+        max = MPU_LAZY_MAX_REGIONS;
+    if ((max <= 0) || (end <= start))
+        return 0;
+    /* The tail of the last region may cover what follows the image */
+    if (end > 0xFFFFFFFFUL - MPU_LAZY_MIN_REGION)
+        return 0;
+    end = (end + MPU_LAZY_MIN_REGION - 1) & ~(MPU_LAZY_MIN_REGION - 1);
+    for (align = MPU_LAZY_MIN_REGION; align != 0; align <<= 1) {
+        first = (start + align - 1) & ~(align - 1);
+        if ((first < start) || (first >= end))
+            break;
+        n = 0;
+        addr = first;
+        while ((addr < end) && (n < max)) {
+            /* Largest region aligned on addr that fits in the range */
+            sz = (addr == 0) ? 0x80000000UL : (addr & (~addr + 1));
+            while (sz > end - addr)
+                sz >>= 1;
+            mpu_lazy_base[n] = addr;
+            mpu_lazy_rasr[n] = mpu_lazy_size(sz);
+            n++;
+            addr += sz;
+        }
+        if (addr >= end) {
+            mpu_lazy_count = n;
+            return first;
+        }
+    }
+    return 0;
+}
+
+uintptr_t hal_lazy_xip_protect(uintptr_t start, uintptr_t end)
+{
+    if (MPU_TYPE == 0)
+        return 0;
+    return mpu_lazy_plan((uint32_t)start, (uint32_t)end,
+        (int)((MPU_TYPE >> 8) & 0xFF));
+}
+
+void hal_lazy_xip_reset(void)
+{
+    mpu_lazy_count = 0;
+}
+#endif /* WOLFBOOT_IMG_CHUNKS_LAZY */
 #else
 #define mpu_init() do{}while(0)
 #define mpu_off() do{}while(0)
@@ -494,6 +576,34 @@ void isr_empty(void)
 static void  *app_entry;
 static uint32_t app_end_stack;
 
+#ifdef MPU_LAZY_XIP
+/* Replace the wolfBoot regions with the execute-never regions planned by
+ * hal_lazy_xip_protect(). The default memory map stays in place for
+ * privileged accesses. The application removes the regions as it
+ * verifies the image (wolfBoot_lazy_xip_verified()). */
+static void RAMFUNCTION mpu_lazy_apply(void)
+{
+    uint32_t n = (MPU_TYPE >> 8) & 0xFF;
+    uint32_t i;
+
+    MPU_CTRL = 0;
+    for (i = 0; i < n; i++) {
+        MPU_RNR = i;
+        MPU_RASR = 0;
+    }
+    for (i = 0; i < (uint32_t)mpu_lazy_count; i++) {
+        MPU_RNR = i;
+        MPU_RBAR = mpu_lazy_base[i];
+        MPU_RASR = mpu_lazy_rasr[i] | MPU_RASR_ENABLE | MPU_RASR_ATTR_C |
+            MPU_RASR_ATTR_AP_PRW_URW | MPU_RASR_ATTR_XN;
+    }
+    MPU_CTRL = 1 | (1 << 2); /* ENABLE | PRIVDEFENA */
+    mpu_is_on = 1;
+    asm volatile("dsb");
+    asm volatile("isb");
+}
+#endif
+
 
 void RAMFUNCTION do_boot(const uint32_t *app_offset)
 {
@@ -566,6 +676,11 @@ void RAMFUNCTION do_boot(const uint32_t *app_offset)
 
 #else /* Armv6/v7 boot procedure */
 
+#ifdef MPU_LAZY_XIP
+    if (mpu_lazy_count > 0)
+        mpu_lazy_apply();
+    else
+#endif
     mpu_off();
 #   ifndef NO_VTOR
     /* Disable interrupts */
@@ -430,7 +430,9 @@ void do_boot(const uint32_t *app_offset)
     boot_entry entry = (boot_entry)app_offset;
 
 #ifdef MMU
+    fdt_index_build((void*)dts_offset);
     hal_dts_fixup((uint32_t*)dts_offset);
+    fdt_index_release();
 #endif
 
 #if defined(DEBUG_UART) && defined(WOLFBOOT_ARCH_PPC)
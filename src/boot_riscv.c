@@ -26,6 +26,7 @@
 #include "image.h"
 #include "loader.h"
 #include "printf.h"
+#include "fdt.h"
 
 /* Include platform-specific headers (may define PLIC_BASE) */
 #ifdef TARGET_mpfs250
@@ -468,7 +469,9 @@ void do_boot(const uint32_t *app_offset)
     /* dts_offset is NULL when the loaded image was not a FIT (or had no
      * flat_dt): skip the fixup and hand off with dtb=0 rather than deref. */
     if (dts_offset != NULL) {
+        fdt_index_build((void*)dts_offset);
         hal_dts_fixup((uint32_t*)dts_offset);
+        fdt_index_release();
     }
     dts_addr = (unsigned long)dts_offset;
 #elif defined(WOLFBOOT_RISCV_MMODE) || __riscv_xlen == 64
@@ -255,6 +255,252 @@ int wb_diff_init(WB_DIFF_CTX *ctx, uint8_t *src_a, uint32_t len_a, uint8_t *src_
     return 0;
 }
 
+/* Match index
+ *
+ * Every BLOCK_HDR_SIZE window of an image is hashed with a rolling
+ * (Rabin-Karp) hash and the window offsets are stored in a bucket table.
+ * Within a bucket the offsets are sorted in ascending order, so the lowest
+ * candidate at or after a given offset is found with a binary search.
+ *
+ * The lookup returns exactly the same offset the linear memcmp scan in
+ * wb_diff() would stop at, so indexed and non-indexed runs produce
+ * byte-identical patches.
+ */
+#define WB_DIFF_HASH_MUL    0x01000193U
+#define WB_DIFF_HASH_MIX    0x9E3779B1U
+#define WB_DIFF_BITS_MIN    10
+#define WB_DIFF_BITS_MAX    24
+
+struct wb_diff_index {
+    uint32_t bits;
+    uint32_t n_pos;
+    uint32_t *bucket; /* (1 << bits) + 1 start offsets into pos[] */
+    uint32_t *pos;
+};
+
+static uint32_t wb_diff_hash(const uint8_t *p)
+{
+    uint32_t h = 0;
+    uint32_t i;
+    for (i = 0; i < BLOCK_HDR_SIZE; i++)
+        h = (h * WB_DIFF_HASH_MUL) + p[i];
+    return h;
+}
+
+static uint32_t wb_diff_bucket(const struct wb_diff_index *idx, uint32_t h)
+{
+    return (h * WB_DIFF_HASH_MIX) >> (32 - idx->bits);
+}
+
+static void wb_diff_index_destroy(struct wb_diff_index *idx)
+{
+    if (idx != NULL) {
+        free(idx->bucket);
+        free(idx->pos);
+        free(idx);
+    }
+}
+
+/* Index the windows of src[start, start + size). The stored offsets are
+ * relative to src. */
+static struct wb_diff_index *wb_diff_index_create(const uint8_t *src,
+        uint32_t start, uint32_t size)
+{
+    struct wb_diff_index *idx;
+    uint32_t n_buckets;
+    uint32_t out_mul = 1;
+    uint32_t h;
+    uint32_t i;
+    int pass;
+
+    if (size < BLOCK_HDR_SIZE)
+        return NULL;
+    idx = calloc(1, sizeof(*idx));
+    if (idx == NULL)
+        return NULL;
+    idx->n_pos = size - BLOCK_HDR_SIZE + 1;
+    idx->bits = WB_DIFF_BITS_MIN;
+    while ((idx->bits < WB_DIFF_BITS_MAX) && ((1U << idx->bits) < idx->n_pos))
+        idx->bits++;
+    n_buckets = 1U << idx->bits;
+    idx->bucket = calloc(n_buckets + 1, sizeof(uint32_t));
+    idx->pos = malloc(idx->n_pos * sizeof(uint32_t));
+    if ((idx->bucket == NULL) || (idx->pos == NULL)) {
+        wb_diff_index_destroy(idx);
+        return NULL;
+    }
+    for (i = 1; i < BLOCK_HDR_SIZE; i++)
+        out_mul *= WB_DIFF_HASH_MUL;
+    src += start;
+
+    /* Pass 0 counts the windows per bucket, pass 1 places the offsets.
+     * Offsets are visited in ascending order, so every bucket ends up
+     * sorted without an explicit sort.
+     */
+    for (pass = 0; pass < 2; pass++) {
+        h = wb_diff_hash(src);
+        for (i = 0; i < idx->n_pos; i++) {
+            uint32_t b = wb_diff_bucket(idx, h);
+            if (pass == 0)
+                idx->bucket[b + 1]++;
+            else
+                idx->pos[idx->bucket[b]++] = start + i;
+            if (i + BLOCK_HDR_SIZE < size) {
+                h = ((h - (src[i] * out_mul)) * WB_DIFF_HASH_MUL) +
+                    src[i + BLOCK_HDR_SIZE];
+            }
+        }
+        if (pass == 0) {
+            for (i = 0; i < n_buckets; i++)
+                idx->bucket[i + 1] += idx->bucket[i];
+        } else {
+            /* Placement advanced each start to the next bucket's start:
+             * shift back by one to restore the start offsets.
+             */
+            for (i = n_buckets; i > 0; i--)
+                idx->bucket[i] = idx->bucket[i - 1];
+            idx->bucket[0] = 0;
+        }
+    }
+    return idx;
+}
+
+/* First index in pos[start..end) whose value is >= off */
+static uint32_t wb_diff_lower_bound(const uint32_t *pos, uint32_t start,
+        uint32_t end, uint32_t off)
+{
+    while (start < end) {
+        uint32_t mid = start + ((end - start) / 2);
+        if (pos[mid] < off)
+            start = mid + 1;
+        else
+            end = mid;
+    }
+    return start;
+}
+
+/* Find the lowest offset in [lo, hi] where src holds the same
+ * BLOCK_HDR_SIZE bytes as 'needle', skipping offsets that would encode an
+ * ESC as the most significant offset byte. Returns 0 and sets *found on
+ * success, -1 if there is no such offset.
+ */
+static int wb_diff_index_find(const struct wb_diff_index *idx,
+        const uint8_t *src, uint32_t lo, uint32_t hi, const uint8_t *needle,
+        uint32_t *found)
+{
+    uint32_t b = wb_diff_bucket(idx, wb_diff_hash(needle));
+    uint32_t end = idx->bucket[b + 1];
+    uint32_t k = wb_diff_lower_bound(idx->pos, idx->bucket[b], end, lo);
+
+    while ((k < end) && (idx->pos[k] <= hi)) {
+        uint32_t p = idx->pos[k];
+        if ((p <= BLOCK_OFF_MAX) && (((p >> 16) & 0xFF) == ESC)) {
+            k = wb_diff_lower_bound(idx->pos, k, end, (p | 0xFFFFU) + 1);
+            continue;
+        }
+        if (memcmp(src + p, needle, BLOCK_HDR_SIZE) == 0) {
+            *found = p;
+            return 0;
+        }
+        k++;
+    }
+    return -1;
+}
+
+int wb_diff_index_build(WB_DIFF_CTX *ctx)
+{
+    if (!ctx)
+        return -1;
+    wb_diff_index_free(ctx);
+    if (ctx->window != 0) {
+        /* Built one segment at a time by wb_diff() */
+        ctx->win_index = 1;
+        ctx->win_seg = 0;
+        return 0;
+    }
+    ctx->idx_a = wb_diff_index_create(ctx->src_a, 0, ctx->size_a);
+    ctx->idx_b = wb_diff_index_create(ctx->src_b, 0, ctx->size_b);
+    if (((ctx->idx_a == NULL) && (ctx->size_a >= BLOCK_HDR_SIZE)) ||
+        ((ctx->idx_b == NULL) && (ctx->size_b >= BLOCK_HDR_SIZE))) {
+        /* Out of memory: fall back to the linear scan */
+        wb_diff_index_free(ctx);
+        return -1;
+    }
+    return 0;
+}
+
+void wb_diff_index_free(WB_DIFF_CTX *ctx)
+{
+    if (!ctx)
+        return;
+    wb_diff_index_destroy(ctx->idx_a);
+    wb_diff_index_destroy(ctx->idx_b);
+    ctx->idx_a = NULL;
+    ctx->idx_b = NULL;
+}
+
+/* Windowed mode
+ *
+ * By default every match candidate of the whole images is considered, and
+ * the index covers both images entirely. In windowed mode the search for the
+ * sector being encoded is restricted to:
+ *  - 'A' offsets in [sector start, sector start + window)
+ *  - 'B' offsets in [sector start - window, sector start - one sector)
+ * and to the offsets that fit the 24-bit block header, so images larger than
+ * 16 MB can be diffed: data beyond the reach of a header is sent as
+ * literals. The images are walked front to back, only touching the window
+ * around the current sector, and the indexes only cover the current segment
+ * of 'window' bytes (two windows of each image), so the memory used does not
+ * depend on the image size.
+ *
+ * The patch format is unchanged.
+ */
+int wb_diff_set_window(WB_DIFF_CTX *ctx, uint32_t window)
+{
+    if (!ctx || (window < 2 * wolfboot_sector_size) ||
+            ((window % wolfboot_sector_size) != 0))
+        return -1;
+    wb_diff_index_free(ctx);
+    ctx->window = window;
+    ctx->win_seg = 0;
+    ctx->win_index = 0;
+    return 0;
+}
+
+/* Index the segment of 'A' and 'B' that the window of off_b can reach */
+static void wb_diff_window_index(WB_DIFF_CTX *ctx)
+{
+    uint32_t seg = ctx->off_b / ctx->window;
+    uint32_t lo, hi;
+    uint32_t len_a = 0, len_b = 0;
+
+    if (seg + 1 == ctx->win_seg)
+        return;
+    wb_diff_index_free(ctx);
+    ctx->win_seg = seg + 1;
+    lo = seg * ctx->window;
+    hi = lo + 2 * ctx->window + BLOCK_HDR_SIZE;
+    if ((hi < lo) || (hi > ctx->size_a))
+        hi = ctx->size_a;
+    if (lo < hi) {
+        len_a = hi - lo;
+        ctx->idx_a = wb_diff_index_create(ctx->src_a, lo, len_a);
+    }
+    hi = lo + ctx->window;
+    if ((hi < lo) || (hi > ctx->size_b))
+        hi = ctx->size_b;
+    lo = (lo > ctx->window) ? (lo - ctx->window) : 0;
+    if (lo < hi) {
+        len_b = hi - lo;
+        ctx->idx_b = wb_diff_index_create(ctx->src_b, lo, len_b);
+    }
+    if (((ctx->idx_a == NULL) && (len_a >= BLOCK_HDR_SIZE)) ||
+        ((ctx->idx_b == NULL) && (len_b >= BLOCK_HDR_SIZE))) {
+        /* Out of memory: use the linear scan, it finds the same matches */
+        wb_diff_index_free(ctx);
+    }
+}
+
 int wb_diff(WB_DIFF_CTX *ctx, uint8_t *patch, uint32_t len)
 {
     struct block_hdr hdr;
@@ -271,9 +517,12 @@ int wb_diff(WB_DIFF_CTX *ctx, uint8_t *patch, uint32_t len)
     while ((ctx->off_b + BLOCK_HDR_SIZE < ctx->size_b) && (len > p_off + BLOCK_HDR_SIZE)) {
         uintptr_t page_start = ctx->off_b / wolfboot_sector_size;
         uintptr_t pa_start;
+        uint32_t win_a_hi = BLOCK_OFF_MAX;
         found = 0;
         if (p_off + BLOCK_HDR_SIZE >  len)
             return (int)p_off;
+        if ((ctx->window != 0) && ctx->win_index)
+            wb_diff_window_index(ctx);
 
         /* 'A' Patch base is valid for addresses in blocks ahead.
          * For matching previous blocks, 'B' is used as base instead.
@@ -285,13 +534,30 @@ int wb_diff(WB_DIFF_CTX *ctx, uint8_t *patch, uint32_t len)
 
         pa_start = wolfboot_sector_size  * page_start;
         pa = ctx->src_a + pa_start;
+        if ((ctx->window != 0) && (pa_start + ctx->window - 1 < win_a_hi))
+            win_a_hi = (uint32_t)(pa_start + ctx->window - 1);
         while (((uintptr_t)(pa - ctx->src_a) < (uintptr_t)ctx->size_a) && (p_off < len)) {
             if ((uintptr_t)(ctx->size_a - (pa - ctx->src_a)) < BLOCK_HDR_SIZE)
                 break;
+            if ((ctx->window != 0) &&
+                    ((uintptr_t)(pa - ctx->src_a) > win_a_hi))
+                break;
             if ((ctx->size_b - ctx->off_b) < BLOCK_HDR_SIZE)
                 break;
             if ((wolfboot_sector_size - (ctx->off_b % wolfboot_sector_size)) < BLOCK_HDR_SIZE)
                 break;
+            if (ctx->idx_a != NULL) {
+                /* Jump straight to the next candidate in the index */
+                uint32_t cand;
+                uint32_t a_hi = ctx->size_a - BLOCK_HDR_SIZE;
+                if ((ctx->window != 0) && (a_hi > win_a_hi))
+                    a_hi = win_a_hi;
+                if (wb_diff_index_find(ctx->idx_a, ctx->src_a,
+                            (uint32_t)(pa - ctx->src_a), a_hi,
+                            ctx->src_b + ctx->off_b, &cand) != 0)
+                    break;
+                pa = ctx->src_a + cand;
+            }
             if ((memcmp(pa, (ctx->src_b + ctx->off_b), BLOCK_HDR_SIZE) == 0)) {
                 uintptr_t b_start;
                 uint8_t *pa_limit = ctx->src_a + ctx->size_a;
@@ -352,6 +618,8 @@ int wb_diff(WB_DIFF_CTX *ctx, uint8_t *patch, uint32_t len)
             uintptr_t pb_end = page_start * wolfboot_sector_size;
             uint8_t *pb_limit = ctx->src_b + pb_end;
             pb = ctx->src_b;
+            if ((ctx->window != 0) && (pb_end > ctx->window))
+                pb += pb_end - ctx->window;
             while (((uintptr_t)(pb - ctx->src_b) < pb_end) && (p_off < len)) {
                 /* Check image boundary */
                 if ((ctx->size_b - ctx->off_b) < BLOCK_HDR_SIZE)
@@ -365,6 +633,21 @@ int wb_diff(WB_DIFF_CTX *ctx, uint8_t *patch, uint32_t len)
                 if (wolfboot_sector_size > (page_start * wolfboot_sector_size)
                         - (pb - ctx->src_b))
                     break;
+                if ((ctx->window != 0) &&
+                        ((uintptr_t)(pb - ctx->src_b) > BLOCK_OFF_MAX))
+                    break;
+
+                if (ctx->idx_b != NULL) {
+                    uint32_t cand;
+                    uint32_t b_hi = (uint32_t)(pb_end - wolfboot_sector_size);
+                    if ((ctx->window != 0) && (b_hi > BLOCK_OFF_MAX))
+                        b_hi = BLOCK_OFF_MAX;
+                    if (wb_diff_index_find(ctx->idx_b, ctx->src_b,
+                                (uint32_t)(pb - ctx->src_b), b_hi,
+                                ctx->src_b + ctx->off_b, &cand) != 0)
+                        break;
+                    pb = ctx->src_b + cand;
+                }
 
                 if ((memcmp(pb, (ctx->src_b + ctx->off_b), BLOCK_HDR_SIZE) == 0)) {
                     /* A match was found between the current pointer and a
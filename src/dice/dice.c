@@ -28,6 +28,7 @@
 #include "image.h"
 #include "wolfboot/wolfboot.h"
 #include "wolfboot/dice.h"
+#include "measure_log.h"
 
 #include <wolfssl/wolfcrypt/types.h>
 #include <wolfssl/wolfcrypt/hmac.h>
@@ -131,6 +132,7 @@ struct wolfboot_dice_claims {
     size_t component_count;
 };
 
+#ifndef WOLFBOOT_MEASURE_LOG
 static int wolfboot_hash_region(uintptr_t address, uint32_t size, uint8_t *out)
 {
 #if defined(WOLFBOOT_HASH_SHA256)
@@ -197,6 +199,7 @@ static int wolfboot_hash_region(uintptr_t address, uint32_t size, uint8_t *out)
 
     return ret;
 }
+#endif /* !WOLFBOOT_MEASURE_LOG */
 
 static int wolfboot_get_boot_image_claims(uint8_t *measurement,
                                           size_t *measurement_len,
@@ -265,9 +268,16 @@ static int wolfboot_get_wolfboot_hash(uint8_t *out, size_t *out_len)
     }
 
     size = (uint32_t)(end - start);
+#ifdef WOLFBOOT_MEASURE_LOG
+    /* Hashed once per boot, shared with measured boot */
+    if (wolfBoot_mlog_measure(WOLFBOOT_MLOG_WOLFBOOT, start, size, out) != 0) {
+        return -1;
+    }
+#else
     if (wolfboot_hash_region(start, size, out) != 0) {
         return -1;
     }
+#endif
 
     *out_len = WOLFBOOT_SHA_DIGEST_SIZE;
     return 0;
@@ -410,6 +420,7 @@ static int wolfboot_dice_collect_claims(struct wolfboot_dice_claims *claims)
 #endif
     uint8_t wb_hash[WOLFBOOT_SHA_DIGEST_SIZE];
     size_t wb_hash_len = sizeof(wb_hash);
+    int wb_hash_ok = 0;
     uint8_t boot_hash[WOLFBOOT_SHA_DIGEST_SIZE];
     size_t boot_hash_len = sizeof(boot_hash);
     uint8_t boot_signer_id[WOLFBOOT_SHA_DIGEST_SIZE];
@@ -447,6 +458,7 @@ static int wolfboot_dice_collect_claims(struct wolfboot_dice_claims *claims)
 
     if (claims->implementation_id_len == 0) {
         if (wolfboot_get_wolfboot_hash(wb_hash, &wb_hash_len) == 0) {
+            wb_hash_ok = 1;
             XMEMCPY(claims->implementation_id, wb_hash, wb_hash_len);
             claims->implementation_id_len = wb_hash_len;
         }
@@ -458,7 +470,8 @@ static int wolfboot_dice_collect_claims(struct wolfboot_dice_claims *claims)
 
     /* A measurement that silently vanishes leaves a token a verifier cannot
      * tell from one for a device with nothing to measure. */
-    if (wolfboot_get_wolfboot_hash(wb_hash, &wb_hash_len) != 0) {
+    if (!wb_hash_ok &&
+        wolfboot_get_wolfboot_hash(wb_hash, &wb_hash_len) != 0) {
 #ifndef WOLFBOOT_DICE_HW
         wc_ForceZero(uds, sizeof(uds));
 #endif
@@ -103,6 +103,118 @@ static inline int fdt_data_size_(void *fdt)
     return (int)(off + sz);
 }
 
+#ifdef WOLFBOOT_FDT_INDEX
+/* Node index of one blob: offsets of all the nodes in structure order, with
+ * the hash of their name and their phandle. Built by fdt_index_build() and
+ * kept in sync by the structure splices, so that lookups do not walk the
+ * whole structure block. */
+struct fdt_index_node {
+    int offset;
+    uint32_t name_hash;
+    uint32_t phandle;
+};
+static struct {
+    const void *fdt;
+    int count;
+    struct fdt_index_node node[FDT_INDEX_MAX_NODES];
+} fdt_idx;
+
+static uint32_t fdt_name_hash_(const char *s, int len)
+{
+    uint32_t h = 0x811C9DC5UL; /* FNV-1a */
+    int i;
+    for (i = 0; i < len; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 0x01000193UL;
+    }
+    return h;
+}
+
+static int fdt_index_active_(const void *fdt)
+{
+    return (fdt != NULL) && (fdt_idx.fdt == fdt);
+}
+
+/* first entry with an offset greater than startoff */
+static int fdt_index_after_(int startoff)
+{
+    int lo = 0, hi = fdt_idx.count, mid;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (fdt_idx.node[mid].offset <= startoff)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static struct fdt_index_node* fdt_index_find_(int offset)
+{
+    int i = fdt_index_after_(offset - 1);
+    if (i < fdt_idx.count && fdt_idx.node[i].offset == offset)
+        return &fdt_idx.node[i];
+    return NULL;
+}
+
+/* [off, off + oldlen) of the structure block replaced by newlen bytes */
+static void fdt_index_splice_(const void *fdt, int off, int oldlen, int newlen)
+{
+    int i, j;
+    if (!fdt_index_active_(fdt))
+        return;
+    for (i = 0, j = 0; i < fdt_idx.count; i++) {
+        struct fdt_index_node n = fdt_idx.node[i];
+        if ((oldlen > 0) && (n.offset >= off) && (n.offset < off + oldlen))
+            continue; /* removed */
+        if (n.offset >= off + oldlen)
+            n.offset += newlen - oldlen;
+        fdt_idx.node[j++] = n;
+    }
+    fdt_idx.count = j;
+}
+
+static void fdt_index_add_(const void *fdt, int offset, const char *name,
+    int namelen)
+{
+    int i;
+    if (!fdt_index_active_(fdt))
+        return;
+    if (fdt_idx.count >= FDT_INDEX_MAX_NODES) {
+        fdt_idx.fdt = NULL; /* full: back to structure walks */
+        return;
+    }
+    i = fdt_index_after_(offset - 1);
+    memmove(&fdt_idx.node[i + 1], &fdt_idx.node[i],
+        (fdt_idx.count - i) * sizeof(fdt_idx.node[0]));
+    fdt_idx.node[i].offset = offset;
+    fdt_idx.node[i].name_hash = fdt_name_hash_(name, namelen);
+    fdt_idx.node[i].phandle = 0;
+    fdt_idx.count++;
+}
+
+static int fdt_is_phandle_(const char *name)
+{
+    return (strcmp(name, "phandle") == 0) ||
+        (strcmp(name, "linux,phandle") == 0);
+}
+
+static void fdt_index_set_phandle_(const void *fdt, int offset,
+    const char *name, const void *val, int len)
+{
+    struct fdt_index_node *n;
+    if (!fdt_index_active_(fdt) || (len != 4) || !fdt_is_phandle_(name))
+        return;
+    n = fdt_index_find_(offset);
+    if (n != NULL)
+        n->phandle = fdt32_to_cpu(*(const uint32_t*)val);
+}
+#else
+#define fdt_index_splice_(fdt, off, oldlen, newlen) do {} while (0)
+#define fdt_index_add_(fdt, offset, name, namelen) do {} while (0)
+#define fdt_index_set_phandle_(fdt, offset, name, val, len) do {} while (0)
+#endif /* WOLFBOOT_FDT_INDEX */
+
 static const void *fdt_offset_ptr(const void *fdt, int offset, unsigned int len)
 {
     unsigned int uoffset = offset;
@@ -312,6 +424,8 @@ static int fdt_splice_struct_(void *fdt, void *p, int oldlen, int newlen)
     if (err == 0) {
         fdt_set_size_dt_struct(fdt, fdt_size_dt_struct(fdt) + delta);
         fdt_set_off_dt_strings(fdt, fdt_off_dt_strings(fdt) + delta);
+        fdt_index_splice_(fdt, (int)((char*)p - (char*)fdt_offset_ptr_(fdt, 0)),
+            oldlen, newlen);
     }
     return err;
 }
@@ -623,6 +737,7 @@ int fdt_setprop(void *fdt, int nodeoffset, const char *name, const void *val,
         if (len > 0) {
             memcpy(prop_data, val, len);
         }
+        fdt_index_set_phandle_(fdt, nodeoffset, name, val, len);
     }
     if (err != 0) {
         wolfBoot_printf("FDT: Set prop failed! %d (name %s, off %d)\n",
@@ -675,6 +790,21 @@ int fdt_find_node_offset(void* fdt, int startoff, const char* nodename)
         return -1;
 
     fnlen = (int)strlen(nodename);
+#ifdef WOLFBOOT_FDT_INDEX
+    if (fdt_index_active_(fdt)) {
+        uint32_t h = fdt_name_hash_(nodename, fnlen);
+        int i;
+        for (i = fdt_index_after_(startoff); i < fdt_idx.count; i++) {
+            if (fdt_idx.node[i].name_hash != h)
+                continue;
+            off = fdt_idx.node[i].offset;
+            nstr = fdt_get_name(fdt, off, &nlen);
+            if ((nlen == fnlen) && (memcmp(nstr, nodename, fnlen) == 0))
+                return off;
+        }
+        return -FDT_ERR_NOTFOUND;
+    }
+#endif
     for (off = fdt_next_node(fdt, startoff, NULL);
          off >= 0;
          off = fdt_next_node(fdt, off, NULL))
@@ -697,6 +827,18 @@ int fdt_find_prop_offset(void* fdt, int startoff, const char* propname,
         return -1;
 
     pvallen = (int)strlen(propval)+1;
+#ifdef WOLFBOOT_FDT_INDEX
+    if (fdt_index_active_(fdt)) {
+        int i;
+        for (i = fdt_index_after_(startoff); i < fdt_idx.count; i++) {
+            off = fdt_idx.node[i].offset;
+            val = fdt_getprop(fdt, off, propname, &len);
+            if (val && (len == pvallen) && (memcmp(val, propval, len) == 0))
+                return off;
+        }
+        return -FDT_ERR_NOTFOUND;
+    }
+#endif
     for (off = fdt_next_node(fdt, startoff, NULL);
          off >= 0;
          off = fdt_next_node(fdt, off, NULL))
@@ -719,9 +861,23 @@ int fdt_node_offset_by_compatible(const void *fdt, int startoffset,
 {
     int offset;
     int complen = (int)strlen(compatible);
+#ifdef WOLFBOOT_FDT_INDEX
+    int i = 0;
+    int indexed = fdt_index_active_(fdt);
+    if (indexed)
+        i = fdt_index_after_(startoffset);
+    for (offset = indexed ?
+            ((i < fdt_idx.count) ? fdt_idx.node[i].offset : -FDT_ERR_NOTFOUND) :
+            fdt_next_node(fdt, startoffset, NULL);
+         offset >= 0;
+         offset = indexed ?
+            ((++i < fdt_idx.count) ? fdt_idx.node[i].offset : -FDT_ERR_NOTFOUND) :
+            fdt_next_node(fdt, offset, NULL))
+#else
     for (offset = fdt_next_node(fdt, startoffset, NULL);
          offset >= 0;
          offset = fdt_next_node(fdt, offset, NULL))
+#endif
     {
         int len;
         const char *prop = (const char*)fdt_getprop(fdt, offset, "compatible",
@@ -746,6 +902,36 @@ int fdt_node_offset_by_compatible(const void *fdt, int startoffset,
     return offset;
 }
 
+int fdt_node_offset_by_phandle(const void *fdt, uint32_t phandle)
+{
+    int offset, len;
+    const uint32_t *val;
+
+    if ((phandle == 0) || (phandle == 0xFFFFFFFFUL))
+        return -FDT_ERR_BADOFFSET;
+#ifdef WOLFBOOT_FDT_INDEX
+    if (fdt_index_active_(fdt)) {
+        int i;
+        for (i = 0; i < fdt_idx.count; i++) {
+            if (fdt_idx.node[i].phandle == phandle)
+                return fdt_idx.node[i].offset;
+        }
+        return -FDT_ERR_NOTFOUND;
+    }
+#endif
+    for (offset = fdt_next_node(fdt, -1, NULL);
+         offset >= 0;
+         offset = fdt_next_node(fdt, offset, NULL))
+    {
+        val = fdt_getprop(fdt, offset, "phandle", &len);
+        if (val == NULL)
+            val = fdt_getprop(fdt, offset, "linux,phandle", &len);
+        if ((val != NULL) && (len == 4) && (fdt32_to_cpu(*val) == phandle))
+            break;
+    }
+    return offset;
+}
+
 int fdt_add_subnode(void* fdt, int parentoff, const char *name)
 {
     int err;
@@ -783,6 +969,7 @@ int fdt_add_subnode(void* fdt, int parentoff, const char *name)
         memcpy(nh->name, name, namelen);
         endtag = (uint32_t*)((char *)nh + nodelen - FDT_TAGSIZE);
         *endtag = cpu_to_fdt32(FDT_END_NODE);
+        fdt_index_add_(fdt, offset, name, namelen);
         err = offset;
     }
     return err;
@@ -811,6 +998,61 @@ int fdt_del_node(void *fdt, int nodeoffset)
 }
 
 
+#ifdef WOLFBOOT_FDT_INDEX
+int fdt_index_build(void *fdt)
+{
+    int err, len, offset = 0, nextoffset = 0, count = 0;
+    uint32_t tag;
+    const char *name;
+    const struct fdt_property *prop;
+
+    fdt_index_release();
+    if (fdt == NULL)
+        return -FDT_ERR_BADSTATE;
+    err = fdt_check_header(fdt);
+    if (err != 0)
+        return err;
+    do {
+        tag = fdt_next_tag(fdt, offset, &nextoffset);
+        if (tag == FDT_BEGIN_NODE) {
+            if (count >= FDT_INDEX_MAX_NODES)
+                return -FDT_ERR_NOSPACE;
+            name = fdt_get_name(fdt, offset, &len);
+            if (name == NULL)
+                return len;
+            fdt_idx.node[count].offset = offset;
+            fdt_idx.node[count].name_hash = fdt_name_hash_(name, len);
+            fdt_idx.node[count].phandle = 0;
+            count++;
+        }
+        else if ((tag == FDT_PROP) && (count > 0)) {
+            /* properties come before the subnodes: owned by the last node */
+            prop = fdt_get_property_by_offset(fdt, offset, &len);
+            if ((prop != NULL) && (len == 4)) {
+                name = fdt_get_string(fdt, fdt32_to_cpu(prop->nameoff), NULL);
+                if ((name != NULL) && fdt_is_phandle_(name)) {
+                    fdt_idx.node[count - 1].phandle =
+                        fdt32_to_cpu(*(const uint32_t*)prop->data);
+                }
+            }
+        }
+        offset = nextoffset;
+    } while ((tag != FDT_END) && (offset >= 0));
+    if (nextoffset < 0)
+        return nextoffset;
+
+    fdt_idx.count = count;
+    fdt_idx.fdt = fdt;
+    return count;
+}
+
+void fdt_index_release(void)
+{
+    fdt_idx.fdt = NULL;
+    fdt_idx.count = 0;
+}
+#endif /* WOLFBOOT_FDT_INDEX */
+
 /* adjust the actual total size in the FDT header */
 int fdt_shrink(void* fdt)
 {
@@ -906,6 +1148,178 @@ int fdt_fixup_val64(void* fdt, int off, const char* node, const char* name,
     return fdt_setprop(fdt, off, name, &val, sizeof(val));
 }
 
+/* One property edit of a batch: [pos, pos + oldlen) of the structure block
+ * becomes newlen bytes. pos is the property value for a resize, or the first
+ * tag after the node name for a new property (as fdt_add_property_). */
+struct fdt_batch_edit_ {
+    const struct fdt_fixup* fix;
+    int node;
+    int hdr;     /* property header offset, -1 for a new property */
+    int pos;
+    int oldlen;
+    int newlen;
+    int nameoff;
+};
+
+int fdt_fixup_batch(void* fdt, const struct fdt_fixup* fixups, int count)
+{
+    struct fdt_batch_edit_ edit[FDT_FIXUP_BATCH_MAX];
+    struct fdt_batch_edit_ tmp;
+    const struct fdt_property* prop;
+    uint32_t size_str, data_end;
+    char *base, *strtab;
+    const char *p;
+    int i, j, err, len, shift, delta = 0, seg_start, seg_end;
+
+    if ((fdt == NULL) || (fixups == NULL) || (count < 0))
+        return -FDT_ERR_BADSTATE;
+    if (count > FDT_FIXUP_BATCH_MAX)
+        return -FDT_ERR_NOSPACE;
+    err = fdt_check_header(fdt);
+    if (err != 0)
+        return err;
+    if (count == 0)
+        return 0;
+    size_str = fdt_size_dt_strings(fdt);
+
+    /* Resolve all the nodes and properties before changing the blob */
+    for (i = 0; i < count; i++) {
+        const struct fdt_fixup* f = &fixups[i];
+        struct fdt_batch_edit_* e = &edit[i];
+
+        if ((f->name == NULL) || (f->len < 0) ||
+                ((f->len > 0) && (f->val == NULL))) {
+            err = -FDT_ERR_BADSTATE;
+            break;
+        }
+        e->fix = f;
+        e->node = f->off;
+        if (f->node != NULL)
+            e->node = fdt_find_node_offset(fdt, -1, f->node);
+        err = (e->node < 0) ? e->node : fdt_check_node_offset_(fdt, e->node);
+        if (err < 0)
+            break;
+        for (j = 0; j < i; j++) {
+            if ((edit[j].node == e->node) &&
+                    (strcmp(edit[j].fix->name, f->name) == 0)) {
+                err = -FDT_ERR_EXISTS;
+                break;
+            }
+        }
+        if (err < 0)
+            break;
+        prop = fdt_get_property(fdt, e->node, f->name, &len, &e->hdr);
+        if (prop != NULL) {
+            e->pos = e->hdr + (int)sizeof(*prop);
+            e->oldlen = FDT_TAGALIGN(len);
+            e->newlen = FDT_TAGALIGN(f->len);
+            e->nameoff = (int)fdt32_to_cpu(prop->nameoff);
+        }
+        else if (len == -FDT_ERR_NOTFOUND) {
+            /* new property, name string appended if missing */
+            e->hdr = -1;
+            e->pos = err;
+            e->oldlen = 0;
+            e->newlen = (int)sizeof(*prop) + FDT_TAGALIGN(f->len);
+            strtab = (char*)fdt + fdt_off_dt_strings(fdt);
+            p = fdt_find_string_(strtab, fdt_size_dt_strings(fdt), f->name);
+            if (p == NULL) {
+                len = (int)strlen(f->name) + 1;
+                data_end = (uint32_t)fdt_data_size_(fdt);
+                if (data_end + len > fdt_totalsize(fdt)) {
+                    err = -FDT_ERR_NOSPACE;
+                    break;
+                }
+                p = strtab + fdt_size_dt_strings(fdt);
+                memcpy((char*)p, f->name, len);
+                fdt_set_size_dt_strings(fdt, fdt_size_dt_strings(fdt) + len);
+            }
+            e->nameoff = (int)(p - strtab);
+        }
+        else {
+            err = len;
+            break;
+        }
+        delta += e->newlen - e->oldlen;
+    }
+    if ((err >= 0) &&
+            ((uint32_t)fdt_data_size_(fdt) + delta > fdt_totalsize(fdt))) {
+        err = -FDT_ERR_NOSPACE;
+    }
+    if (err < 0) {
+        fdt_set_size_dt_strings(fdt, size_str);
+        wolfBoot_printf("FDT: Batch fixup failed! %d (%d of %d)\n",
+            err, i, count);
+        return err;
+    }
+
+    /* Sort by position: the edits cut the data into count + 1 segments, the
+     * one after edit i moves by the sum of the size changes up to i. New
+     * properties of a node are laid out in reverse order, as a sequence of
+     * fdt_setprop() calls would. */
+    for (i = 1; i < count; i++) {
+        tmp = edit[i];
+        for (j = i; (j > 0) && ((edit[j - 1].pos > tmp.pos) ||
+                ((edit[j - 1].pos == tmp.pos) && (edit[j - 1].fix < tmp.fix)));
+                j--)
+            edit[j] = edit[j - 1];
+        edit[j] = tmp;
+    }
+    base = (char*)fdt_offset_ptr_w_(fdt, 0);
+    data_end = (uint32_t)fdt_data_size_(fdt) - fdt_off_dt_struct(fdt);
+
+    /* Every byte is moved once: segments moving down in increasing order,
+     * then segments moving up in decreasing order */
+    for (i = 0, shift = 0; i < count; i++) {
+        shift += edit[i].newlen - edit[i].oldlen;
+        seg_start = edit[i].pos + edit[i].oldlen;
+        seg_end = (i + 1 < count) ? edit[i + 1].pos : (int)data_end;
+        if (shift < 0)
+            memmove(base + seg_start + shift, base + seg_start,
+                seg_end - seg_start);
+    }
+    for (i = count - 1, shift = delta; i >= 0; i--) {
+        seg_start = edit[i].pos + edit[i].oldlen;
+        seg_end = (i + 1 < count) ? edit[i + 1].pos : (int)data_end;
+        if (shift > 0)
+            memmove(base + seg_start + shift, base + seg_start,
+                seg_end - seg_start);
+        shift -= edit[i].newlen - edit[i].oldlen;
+    }
+
+    /* Properties, at their final position */
+    for (i = 0, shift = 0; i < count; i++) {
+        const struct fdt_fixup* f = edit[i].fix;
+        struct fdt_property* np;
+        char* data = base + edit[i].pos + shift;
+
+        if (edit[i].hdr >= 0) {
+            /* the header is in the segment before the value */
+            np = (struct fdt_property*)(base + edit[i].hdr + shift);
+        }
+        else {
+            np = (struct fdt_property*)data;
+            np->tag = cpu_to_fdt32(FDT_PROP);
+            np->nameoff = cpu_to_fdt32(edit[i].nameoff);
+            data = np->data;
+        }
+        np->len = cpu_to_fdt32(f->len);
+        if (f->len > 0)
+            memcpy(data, f->val, f->len);
+        memset(data + f->len, 0, FDT_TAGALIGN(f->len) - f->len);
+        fdt_index_set_phandle_(fdt, edit[i].node, f->name, f->val, f->len);
+        shift += edit[i].newlen - edit[i].oldlen;
+    }
+    fdt_set_size_dt_struct(fdt, fdt_size_dt_struct(fdt) + delta);
+    fdt_set_off_dt_strings(fdt, fdt_off_dt_strings(fdt) + delta);
+    for (i = count - 1; i >= 0; i--)
+        fdt_index_splice_(fdt, edit[i].pos, edit[i].oldlen, edit[i].newlen);
+
+    wolfBoot_printf("FDT: Batch fixup, %d properties (%d bytes)\n",
+        count, delta);
+    return 0;
+}
+
 
 /* FIT Specific */
 const char* fit_find_images(void* fdt, const char** pkernel, const char** pflat_dt,
@@ -109,5 +109,14 @@ uint32_t keystore_get_key_type(int id)
     return slot->key_type;
 }
 
+#ifdef WOLFBOOT_KEYSTORE_HINTS
+/* No precomputed digests in OTP: keys are hashed at runtime */
+const uint8_t *keystore_get_key_hint(int id)
+{
+    (void)id;
+    return (const uint8_t *)0;
+}
+#endif
+
 
 #endif /* FLASH_OTP_KEYSTORE && !WOLFBOOT_NO_SIGN */
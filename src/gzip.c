@@ -12,6 +12,23 @@
  *    matters for the bootloader.
  *  - No dynamic allocation; state lives on the caller's stack (~6 KB peak).
  *  - CRC32 IEEE 802.3 polynomial computed on-the-fly during output.
+ *  - Streaming variant (wolfBoot_gunzip_init/feed/finish): same decoder,
+ *    driven one step at a time (header, block header, Huffman symbol,
+ *    stored run, trailer) from a small staging buffer in the caller's
+ *    context. A step that runs out of input is rolled back and retried on
+ *    the next feed, so no step has to be re-entrant.
+ *
+ * Optional speed/size trade-offs, selected at build time:
+ *  - WOLFBOOT_GZIP_FAST: first-level Huffman lookup tables
+ *    (WOLFBOOT_GZIP_FAST_BITS wide, codes longer than that fall back to the canonical
+ *    decoder), a 64-bit bit buffer refilled a byte at a time only when it
+ *    runs low, bulk copies for stored blocks and back-references, and CRC32
+ *    computed over the output in bulk instead of per byte. Adds ~1 KB of
+ *    stack per Huffman tree (~5 KB peak).
+ *  - WOLFBOOT_GZIP_CRC32_TABLE=N: table-driven CRC32. N=1 uses a single
+ *    256-entry table (1 KB), N=4 / N=8 use slice-by-4 / slice-by-8
+ *    (4 KB / 8 KB). Tables live in .bss and are generated on first use.
+ *    N=0 (default) keeps the bit-serial implementation.
  *
  *
  * Copyright (C) 2026 wolfSSL Inc.
@@ -37,6 +54,15 @@
 #include "gzip.h"
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
+
+#ifndef WOLFBOOT_GZIP_CRC32_TABLE
+#define WOLFBOOT_GZIP_CRC32_TABLE 0
+#endif
+#if (WOLFBOOT_GZIP_CRC32_TABLE != 0) && (WOLFBOOT_GZIP_CRC32_TABLE != 1) && \
+    (WOLFBOOT_GZIP_CRC32_TABLE != 4) && (WOLFBOOT_GZIP_CRC32_TABLE != 8)
+#error "WOLFBOOT_GZIP_CRC32_TABLE must be 0, 1, 4 or 8"
+#endif
 
 /* RFC 1951/1952 implementation-detail constants. These were previously
  * in include/gzip.h but are not part of the public API of this module
@@ -87,6 +113,20 @@
 #define GZIP_REPEAT_Z7_EXTRA      7
 #define GZIP_REPEAT_Z7_BASE       11
 
+#ifdef WOLFBOOT_GZIP_FAST
+/* First-level lookup table: entry = (code length << GZIP_FAST_SYM_BITS) |
+ * symbol. A zero entry means the code is longer than WOLFBOOT_GZIP_FAST_BITS.
+ */
+#define GZIP_FAST_BITS            WOLFBOOT_GZIP_FAST_BITS
+#define GZIP_FAST_SIZE            (1U << GZIP_FAST_BITS)
+#define GZIP_FAST_SYM_BITS        9
+#define GZIP_FAST_SYM_MASK        ((1U << GZIP_FAST_SYM_BITS) - 1U)
+#define GZIP_BITBUF_REFILL        56    /* refill while <= this many bits */
+typedef uint64_t gz_bitbuf_t;
+#else
+typedef uint32_t gz_bitbuf_t;
+#endif
+
 /* RFC 1951 Sec. 3.2.5: length codes 257..285 base values and extra bits */
 static const uint16_t gz_len_base[29] = {
     3,   4,   5,   6,   7,   8,   9,  10,
@@ -120,32 +160,49 @@ static const uint8_t gz_cl_order[GZIP_CL_CODES] = {
     16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
 };
 
-typedef struct gz_state {
-    /* input bit stream */
-    const uint8_t *in;
-    uint32_t       in_len;
-    uint32_t       in_pos;
-    uint32_t       bit_buf;
-    int            bit_count;
-
-    /* output buffer (doubles as sliding window) */
-    uint8_t       *out;
-    uint32_t       out_max;
-    uint32_t       out_pos;
-
-    /* running CRC32 of decompressed bytes */
-    uint32_t       crc32;
-} gz_state_t;
-
-typedef struct gz_huff {
-    int16_t counts[GZIP_MAX_HUFF_BITS + 1];
-    int16_t symbols[GZIP_LITLEN_CODES];
-} gz_huff_t;
+/* Decoder state and Huffman tables are declared in gzip.h so that callers
+ * can allocate a streaming context; they are private to this file. */
+typedef struct wolfBoot_gzip_state gz_state_t;
+typedef struct wolfBoot_gzip_huff gz_huff_t;
 
 /* ------------------------------------------------------------------------- */
 /* CRC32                                                                     */
 /* ------------------------------------------------------------------------- */
 
+#if WOLFBOOT_GZIP_CRC32_TABLE > 0
+static uint32_t gz_crc_table[WOLFBOOT_GZIP_CRC32_TABLE][256];
+static int gz_crc_table_ready = 0;
+
+static void gz_crc32_init_table(void)
+{
+    uint32_t i, c;
+    int k;
+
+    if (gz_crc_table_ready) {
+        return;
+    }
+    for (i = 0; i < 256; i++) {
+        c = i;
+        for (k = 0; k < 8; k++) {
+            c = (c & 1U) ? ((c >> 1) ^ GZIP_CRC32_POLY) : (c >> 1);
+        }
+        gz_crc_table[0][i] = c;
+    }
+    /* Slice-by-N: table[k][i] is the CRC of byte i followed by k zeros */
+    for (k = 1; k < WOLFBOOT_GZIP_CRC32_TABLE; k++) {
+        for (i = 0; i < 256; i++) {
+            c = gz_crc_table[k - 1][i];
+            gz_crc_table[k][i] = (c >> 8) ^ gz_crc_table[0][c & 0xFFU];
+        }
+    }
+    gz_crc_table_ready = 1;
+}
+
+static uint32_t gz_crc32_byte(uint32_t crc, uint8_t b)
+{
+    return (crc >> 8) ^ gz_crc_table[0][(crc ^ b) & 0xFFU];
+}
+#else
 static uint32_t gz_crc32_byte(uint32_t crc, uint8_t b)
 {
     int k;
@@ -159,6 +216,54 @@ static uint32_t gz_crc32_byte(uint32_t crc, uint8_t b)
     }
     return crc;
 }
+#endif
+
+#ifdef WOLFBOOT_GZIP_FAST
+static uint32_t gz_crc32_buf(uint32_t crc, const uint8_t *p, uint32_t len)
+{
+#if WOLFBOOT_GZIP_CRC32_TABLE >= 4
+    while (len >= 4) {
+        crc ^= (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+               ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    #if WOLFBOOT_GZIP_CRC32_TABLE == 8
+        if (len >= 8) {
+            crc = gz_crc_table[7][crc & 0xFFU] ^
+                  gz_crc_table[6][(crc >> 8) & 0xFFU] ^
+                  gz_crc_table[5][(crc >> 16) & 0xFFU] ^
+                  gz_crc_table[4][crc >> 24] ^
+                  gz_crc_table[3][p[4]] ^
+                  gz_crc_table[2][p[5]] ^
+                  gz_crc_table[1][p[6]] ^
+                  gz_crc_table[0][p[7]];
+            p += 8;
+            len -= 8;
+            continue;
+        }
+    #endif
+        crc = gz_crc_table[3][crc & 0xFFU] ^
+              gz_crc_table[2][(crc >> 8) & 0xFFU] ^
+              gz_crc_table[1][(crc >> 16) & 0xFFU] ^
+              gz_crc_table[0][crc >> 24];
+        p += 4;
+        len -= 4;
+    }
+#endif
+    while (len > 0) {
+        crc = gz_crc32_byte(crc, *p);
+        p++;
+        len--;
+    }
+    return crc;
+}
+
+/* Fold the output produced since the last flush into the running CRC32 */
+static void gz_crc_flush(gz_state_t *s)
+{
+    s->crc32 = gz_crc32_buf(s->crc32, s->out + s->crc_pos,
+                            s->out_pos - s->crc_pos);
+    s->crc_pos = s->out_pos;
+}
+#endif
 
 /* ------------------------------------------------------------------------- */
 /* Bit stream reader (LSB-first within bytes per RFC 1951 Sec. 3.1.1)        */
@@ -173,7 +278,7 @@ static int gz_need_bits(gz_state_t *s, int n)
             ret = WOLFBOOT_GZIP_E_TRUNCATED;
         }
         else {
-            s->bit_buf |= ((uint32_t)s->in[s->in_pos]) << s->bit_count;
+            s->bit_buf |= ((gz_bitbuf_t)s->in[s->in_pos]) << s->bit_count;
             s->in_pos++;
             s->bit_count += 8;
         }
@@ -181,22 +286,41 @@ static int gz_need_bits(gz_state_t *s, int n)
     return ret;
 }
 
+#ifdef WOLFBOOT_GZIP_FAST
+/* Top up the bit buffer as far as the input allows. Never fails: running
+ * out of input is detected by the consumer via gz_need_bits(). */
+static void gz_refill(gz_state_t *s)
+{
+    while ((s->bit_count <= GZIP_BITBUF_REFILL) && (s->in_pos < s->in_len)) {
+        s->bit_buf |= ((gz_bitbuf_t)s->in[s->in_pos]) << s->bit_count;
+        s->in_pos++;
+        s->bit_count += 8;
+    }
+}
+#endif
+
 static int gz_get_bits(gz_state_t *s, int n, uint32_t *val)
 {
     int ret = gz_need_bits(s, n);
     if (ret == 0) {
-        *val = s->bit_buf & (((uint32_t)1 << n) - 1);
+        *val = (uint32_t)(s->bit_buf & (((gz_bitbuf_t)1 << n) - 1));
         s->bit_buf >>= n;
         s->bit_count -= n;
     }
     return ret;
 }
 
+/* Drop the bits of the current partial byte. Whole bytes still held in the
+ * bit buffer are handed back to the input, so in_pos points at the next
+ * unread byte afterwards. */
 static void gz_align_byte(gz_state_t *s)
 {
     int drop = s->bit_count & 7;
     s->bit_buf >>= drop;
     s->bit_count -= drop;
+    s->in_pos -= (uint32_t)(s->bit_count >> 3);
+    s->bit_buf = 0;
+    s->bit_count = 0;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -213,7 +337,9 @@ static int gz_emit_byte(gz_state_t *s, uint8_t b)
     else {
         s->out[s->out_pos] = b;
         s->out_pos++;
+#ifndef WOLFBOOT_GZIP_FAST
         s->crc32 = gz_crc32_byte(s->crc32, b);
+#endif
     }
     return ret;
 }
@@ -222,6 +348,46 @@ static int gz_emit_byte(gz_state_t *s, uint8_t b)
 /* Canonical Huffman build / decode                                          */
 /* ------------------------------------------------------------------------- */
 
+#ifdef WOLFBOOT_GZIP_FAST
+/* Fill the first-level lookup table for all codes of at most GZIP_FAST_BITS
+ * bits. DEFLATE packs Huffman codes MSB-first into an LSB-first stream, so
+ * each code is bit-reversed and replicated over every combination of the
+ * following (unused) bits. */
+static void gz_huff_build_fast(gz_huff_t *h, const uint8_t *lengths, int n,
+                               int all_zero)
+{
+    uint16_t next_code[GZIP_MAX_HUFF_BITS + 1];
+    uint32_t code = 0;
+    uint32_t rev, i;
+    int sym, len, b;
+
+    memset(h->fast, 0, sizeof(h->fast));
+    if (all_zero) {
+        return;
+    }
+    next_code[0] = 0;
+    for (len = 1; len <= GZIP_MAX_HUFF_BITS; len++) {
+        code = (code + (uint32_t)(len > 1 ? h->counts[len - 1] : 0)) << 1;
+        next_code[len] = (uint16_t)code;
+    }
+    for (sym = 0; sym < n; sym++) {
+        len = lengths[sym];
+        if ((len == 0) || (len > GZIP_FAST_BITS)) {
+            continue;
+        }
+        code = next_code[len]++;
+        rev = 0;
+        for (b = 0; b < len; b++) {
+            rev = (rev << 1) | ((code >> b) & 1U);
+        }
+        for (i = rev; i < GZIP_FAST_SIZE; i += (1U << len)) {
+            h->fast[i] = (uint16_t)(((uint32_t)len << GZIP_FAST_SYM_BITS) |
+                                    (uint32_t)sym);
+        }
+    }
+}
+#endif
+
 /* Build canonical Huffman decode tables from per-symbol code lengths.
  * lengths[i] is the bit length of symbol i (0 = absent).
  * Returns 0 on success, WOLFBOOT_GZIP_E_HUFFMAN on malformed (over-subscribed)
@@ -279,6 +445,11 @@ static int gz_huff_build(gz_huff_t *h, const uint8_t *lengths, int n)
             }
         }
     }
+#ifdef WOLFBOOT_GZIP_FAST
+    if (ret == 0) {
+        gz_huff_build_fast(h, lengths, n, all_zero);
+    }
+#endif
     return ret;
 }
 
@@ -293,6 +464,20 @@ static int gz_huff_decode(gz_state_t *s, const gz_huff_t *h)
     int len, count, br_ret;
     uint32_t bit;
 
+#ifdef WOLFBOOT_GZIP_FAST
+    uint16_t e;
+
+    gz_refill(s);
+    e = h->fast[s->bit_buf & (GZIP_FAST_SIZE - 1U)];
+    len = (int)(e >> GZIP_FAST_SYM_BITS);
+    if ((len != 0) && (len <= s->bit_count)) {
+        s->bit_buf >>= len;
+        s->bit_count -= len;
+        return (int)(e & GZIP_FAST_SYM_MASK);
+    }
+    /* Long code or end of input: fall back to the canonical decoder */
+#endif
+
     for (len = 1; (len <= GZIP_MAX_HUFF_BITS) &&
                   (ret == WOLFBOOT_GZIP_E_HUFFMAN); len++) {
         br_ret = gz_get_bits(s, 1, &bit);
@@ -318,11 +503,12 @@ static int gz_huff_decode(gz_state_t *s, const gz_huff_t *h)
 /* Block decoders                                                            */
 /* ------------------------------------------------------------------------- */
 
-/* RFC 1951 Sec. 3.2.4: stored (uncompressed) block */
-static int gz_inflate_stored(gz_state_t *s)
+/* RFC 1951 Sec. 3.2.4: stored (uncompressed) block header. On success
+ * *len holds the number of literal bytes that follow in the input. */
+static int gz_stored_begin(gz_state_t *s, uint32_t *len)
 {
     int ret = 0;
-    uint32_t len = 0, nlen;
+    uint32_t nlen;
 
     /* Discard remaining bits in current partial byte */
     gz_align_byte(s);
@@ -332,32 +518,66 @@ static int gz_inflate_stored(gz_state_t *s)
         ret = WOLFBOOT_GZIP_E_TRUNCATED;
     }
     if (ret == 0) {
-        len  = (uint32_t)s->in[s->in_pos] |
+        *len = (uint32_t)s->in[s->in_pos] |
                ((uint32_t)s->in[s->in_pos + 1] << 8);
         nlen = (uint32_t)s->in[s->in_pos + 2] |
                ((uint32_t)s->in[s->in_pos + 3] << 8);
         s->in_pos += 4;
 
-        if ((len ^ 0xFFFFU) != nlen) {
+        if ((*len ^ 0xFFFFU) != nlen) {
             ret = WOLFBOOT_GZIP_E_FORMAT;
         }
-        else if (s->in_pos + len > s->in_len) {
-            ret = WOLFBOOT_GZIP_E_TRUNCATED;
-        }
-        else {
-            /* No buffered bits remain after align_byte; clear defensively */
-            s->bit_buf = 0;
-            s->bit_count = 0;
-        }
     }
+    return ret;
+}
+
+/* Copy up to *left stored bytes from the input that is available now;
+ * *left is decremented by the amount copied. */
+static int gz_stored_copy(gz_state_t *s, uint32_t *left)
+{
+    int ret = 0;
+    uint32_t len = s->in_len - s->in_pos;
 
+    if (len > *left) {
+        len = *left;
+    }
+#ifdef WOLFBOOT_GZIP_FAST
+    {
+        uint32_t room = s->out_max - s->out_pos;
+        uint32_t n = (len > room) ? room : len;
+        memcpy(s->out + s->out_pos, s->in + s->in_pos, n);
+        s->out_pos += n;
+        s->in_pos += n;
+        *left -= n;
+        if (n < len) {
+            ret = WOLFBOOT_GZIP_E_OUTPUT;
+        }
+    }
+#else
     while ((ret == 0) && (len > 0)) {
         ret = gz_emit_byte(s, s->in[s->in_pos]);
         if (ret == 0) {
             s->in_pos++;
             len--;
+            (*left)--;
         }
     }
+#endif
+    return ret;
+}
+
+/* RFC 1951 Sec. 3.2.4: stored (uncompressed) block, fully in memory */
+static int gz_inflate_stored(gz_state_t *s)
+{
+    uint32_t len = 0;
+    int ret = gz_stored_begin(s, &len);
+
+    if ((ret == 0) && (s->in_pos + len > s->in_len)) {
+        ret = WOLFBOOT_GZIP_E_TRUNCATED;
+    }
+    if (ret == 0) {
+        ret = gz_stored_copy(s, &len);
+    }
     return ret;
 }
 
@@ -380,101 +600,135 @@ static int gz_build_fixed(gz_huff_t *litlen, gz_huff_t *dist)
     return ret;
 }
 
-/* Inflate the body of a Huffman-coded block (fixed or dynamic) until the
- * end-of-block symbol (256) is decoded. */
-static int gz_inflate_huffman(gz_state_t *s,
-                              const gz_huff_t *litlen, const gz_huff_t *dist)
+/* Decode one literal/length symbol and, for a length, its distance, then
+ * produce the output. All input is consumed before any output is written,
+ * so a truncated symbol leaves the output untouched (the streaming decoder
+ * relies on this to retry it once more input arrives).
+ * Returns 0, 1 at end-of-block, or negative WOLFBOOT_GZIP_E_* on error. */
+static int gz_inflate_symbol(gz_state_t *s,
+                             const gz_huff_t *litlen, const gz_huff_t *dist)
 {
     int ret = 0;
     int done = 0;
     int sym, li;
     uint32_t length, distance, extra, copy_pos;
 
-    while ((ret == 0) && !done) {
-        sym = gz_huff_decode(s, litlen);
-        if (sym < 0) {
-            ret = sym;
-        }
-        else if (sym < GZIP_EOB_SYMBOL) {
-            ret = gz_emit_byte(s, (uint8_t)sym);
+    sym = gz_huff_decode(s, litlen);
+    if (sym < 0) {
+        ret = sym;
+    }
+    else if (sym < GZIP_EOB_SYMBOL) {
+        ret = gz_emit_byte(s, (uint8_t)sym);
+    }
+    else if (sym == GZIP_EOB_SYMBOL) {
+        done = 1;
+    }
+    else {
+        /* length code 257..285 -> length 3..258 */
+        li = sym - GZIP_LENGTH_CODE_BASE;
+        if (li >= GZIP_LENGTH_CODE_COUNT) {
+            ret = WOLFBOOT_GZIP_E_HUFFMAN;
         }
-        else if (sym == GZIP_EOB_SYMBOL) {
-            done = 1;
+        length = 0;
+        if (ret == 0) {
+            length = gz_len_base[li];
+            if (gz_len_extra[li] > 0) {
+                ret = gz_get_bits(s, gz_len_extra[li], &extra);
+                if (ret == 0) {
+                    length += extra;
+                }
+            }
         }
-        else {
-            /* length code 257..285 -> length 3..258 */
-            li = sym - GZIP_LENGTH_CODE_BASE;
-            if (li >= GZIP_LENGTH_CODE_COUNT) {
+
+        distance = 0;
+        if (ret == 0) {
+            sym = gz_huff_decode(s, dist);
+            if (sym < 0) {
+                ret = sym;
+            }
+            else if (sym >= GZIP_DIST_CODE_COUNT) {
                 ret = WOLFBOOT_GZIP_E_HUFFMAN;
             }
-            length = 0;
-            if (ret == 0) {
-                length = gz_len_base[li];
-                if (gz_len_extra[li] > 0) {
-                    ret = gz_get_bits(s, gz_len_extra[li], &extra);
+            else {
+                distance = gz_dist_base[sym];
+                if (gz_dist_extra[sym] > 0) {
+                    ret = gz_get_bits(s, gz_dist_extra[sym], &extra);
                     if (ret == 0) {
-                        length += extra;
+                        distance += extra;
                     }
                 }
             }
+        }
 
-            distance = 0;
-            if (ret == 0) {
-                sym = gz_huff_decode(s, dist);
-                if (sym < 0) {
-                    ret = sym;
-                }
-                else if (sym >= GZIP_DIST_CODE_COUNT) {
-                    ret = WOLFBOOT_GZIP_E_HUFFMAN;
-                }
-                else {
-                    distance = gz_dist_base[sym];
-                    if (gz_dist_extra[sym] > 0) {
-                        ret = gz_get_bits(s, gz_dist_extra[sym], &extra);
-                        if (ret == 0) {
-                            distance += extra;
-                        }
-                    }
-                }
+        if (ret == 0) {
+            if ((distance == 0) || (distance > s->out_pos)) {
+                ret = WOLFBOOT_GZIP_E_DISTANCE;
             }
-
-            if (ret == 0) {
-                if ((distance == 0) || (distance > s->out_pos)) {
-                    ret = WOLFBOOT_GZIP_E_DISTANCE;
-                }
-                else if (s->out_pos + length > s->out_max) {
-                    ret = WOLFBOOT_GZIP_E_OUTPUT;
-                }
+            else if (s->out_pos + length > s->out_max) {
+                ret = WOLFBOOT_GZIP_E_OUTPUT;
             }
+        }
 
-            /* LZ77 copy. Output buffer doubles as the window. Copy must be
-             * byte-by-byte to support overlapping runs (length > distance). */
-            if (ret == 0) {
-                copy_pos = s->out_pos - distance;
-                while ((ret == 0) && (length > 0)) {
-                    ret = gz_emit_byte(s, s->out[copy_pos]);
-                    if (ret == 0) {
-                        copy_pos++;
-                        length--;
-                    }
+#ifdef WOLFBOOT_GZIP_FAST
+        /* LZ77 copy in chunks of at most 'distance' bytes: every chunk
+         * reads only bytes written before it starts, so overlapping runs
+         * (length > distance) still replicate correctly. */
+        if (ret == 0) {
+            uint8_t *dst = s->out + s->out_pos;
+            uint32_t n;
+            s->out_pos += length;
+            while (length > 0) {
+                n = (length > distance) ? distance : length;
+                memcpy(dst, dst - distance, n);
+                dst += n;
+                length -= n;
+            }
+        }
+        (void)copy_pos;
+#else
+        /* LZ77 copy. Output buffer doubles as the window. Copy must be
+         * byte-by-byte to support overlapping runs (length > distance). */
+        if (ret == 0) {
+            copy_pos = s->out_pos - distance;
+            while ((ret == 0) && (length > 0)) {
+                ret = gz_emit_byte(s, s->out[copy_pos]);
+                if (ret == 0) {
+                    copy_pos++;
+                    length--;
                 }
             }
         }
+#endif
+    }
+    if ((ret == 0) && done) {
+        ret = 1;
     }
     return ret;
 }
 
-/* RFC 1951 Sec. 3.2.7: dynamic Huffman block.
- * Decodes the code-length code, expands it into the literal/length and
- * distance trees, then runs gz_inflate_huffman() on the block body. */
-static int gz_inflate_dynamic(gz_state_t *s)
+/* Inflate the body of a Huffman-coded block (fixed or dynamic) until the
+ * end-of-block symbol (256) is decoded. */
+static int gz_inflate_huffman(gz_state_t *s,
+                              const gz_huff_t *litlen, const gz_huff_t *dist)
+{
+    int ret = 0;
+
+    while (ret == 0) {
+        ret = gz_inflate_symbol(s, litlen, dist);
+    }
+    return (ret == 1) ? 0 : ret;
+}
+
+/* RFC 1951 Sec. 3.2.7: dynamic Huffman block header.
+ * Decodes the code-length code and expands it into the literal/length and
+ * distance trees. */
+static int gz_read_dynamic(gz_state_t *s, gz_huff_t *litlen_huff,
+                           gz_huff_t *dist_huff)
 {
     int ret;
     uint8_t cl_lens[GZIP_CL_CODES];
     uint8_t code_lens[GZIP_LITLEN_CODES + GZIP_DIST_CODES];
     gz_huff_t cl_huff;
-    gz_huff_t litlen_huff;
-    gz_huff_t dist_huff;
     uint32_t hlit = 0, hdist = 0, hclen = 0, val;
     int i, total, idx, sym;
     uint8_t prev = 0;
@@ -587,11 +841,21 @@ static int gz_inflate_dynamic(gz_state_t *s)
     }
 
     if (ret == 0) {
-        ret = gz_huff_build(&litlen_huff, code_lens, (int)hlit);
+        ret = gz_huff_build(litlen_huff, code_lens, (int)hlit);
     }
     if (ret == 0) {
-        ret = gz_huff_build(&dist_huff, code_lens + hlit, (int)hdist);
+        ret = gz_huff_build(dist_huff, code_lens + hlit, (int)hdist);
     }
+    return ret;
+}
+
+/* RFC 1951 Sec. 3.2.7: dynamic Huffman block */
+static int gz_inflate_dynamic(gz_state_t *s)
+{
+    gz_huff_t litlen_huff;
+    gz_huff_t dist_huff;
+    int ret = gz_read_dynamic(s, &litlen_huff, &dist_huff);
+
     if (ret == 0) {
         ret = gz_inflate_huffman(s, &litlen_huff, &dist_huff);
     }
@@ -761,6 +1025,26 @@ static int gz_parse_trailer(gz_state_t *s, uint32_t computed_crc,
 /* Public entry point                                                        */
 /* ------------------------------------------------------------------------- */
 
+static void gz_state_init(gz_state_t *s, const uint8_t *in, uint32_t in_len,
+                          uint8_t *out, uint32_t out_max)
+{
+    s->in = in;
+    s->in_len = in_len;
+    s->in_pos = 0;
+    s->bit_buf = 0;
+    s->bit_count = 0;
+    s->out = out;
+    s->out_max = out_max;
+    s->out_pos = 0;
+    s->crc32 = GZIP_CRC32_INIT;
+#ifdef WOLFBOOT_GZIP_FAST
+    s->crc_pos = 0;
+#endif
+#if WOLFBOOT_GZIP_CRC32_TABLE > 0
+    gz_crc32_init_table();
+#endif
+}
+
 int wolfBoot_gunzip(const uint8_t *in, uint32_t in_len,
                     uint8_t *out, uint32_t out_max,
                     uint32_t *out_len)
@@ -772,28 +1056,219 @@ int wolfBoot_gunzip(const uint8_t *in, uint32_t in_len,
         ret = WOLFBOOT_GZIP_E_PARAM;
     }
     else {
-        s.in = in;
-        s.in_len = in_len;
-        s.in_pos = 0;
-        s.bit_buf = 0;
-        s.bit_count = 0;
-        s.out = out;
-        s.out_max = out_max;
-        s.out_pos = 0;
-        s.crc32 = GZIP_CRC32_INIT;
+        gz_state_init(&s, in, in_len, out, out_max);
 
         ret = gz_parse_header(&s);
         if (ret == 0) {
             ret = gz_inflate(&s);
         }
+#ifdef WOLFBOOT_GZIP_FAST
+        if (ret == 0) {
+            gz_crc_flush(&s);
+        }
+#endif
         if (ret == 0) {
             /* Final CRC32 is the running register XOR'd with the final mask */
-            s.crc32 ^= GZIP_CRC32_FINAL_XOR;
-            ret = gz_parse_trailer(&s, s.crc32, s.out_pos);
+            ret = gz_parse_trailer(&s, s.crc32 ^ GZIP_CRC32_FINAL_XOR,
+                                   s.out_pos);
         }
         *out_len = s.out_pos;
     }
     return ret;
 }
 
+/* ------------------------------------------------------------------------- */
+/* Streaming entry points                                                    */
+/* ------------------------------------------------------------------------- */
+
+/* Streaming decoder phases (WOLFBOOT_GUNZIP_CTX.phase) */
+#define GZ_PHASE_HEADER           0
+#define GZ_PHASE_BLOCK            1
+#define GZ_PHASE_STORED           2
+#define GZ_PHASE_HUFFMAN          3
+#define GZ_PHASE_TRAILER          4
+#define GZ_PHASE_DONE             5
+
+/* Decode as much as the staged input allows. Each step (gzip header, block
+ * header, stored run, Huffman symbol, trailer) either completes or, if the
+ * input runs out half-way, is rolled back to where it started so it can be
+ * retried after the next feed. Steps never write output before all of
+ * their input has been read. */
+static int gz_stream_run(WOLFBOOT_GUNZIP_CTX *ctx)
+{
+    gz_state_t *s = &ctx->s;
+    uint32_t saved_pos = 0;
+    gz_bitbuf_t saved_buf = 0;
+    int saved_count = 0;
+    uint32_t bfinal, btype;
+    int ret = 0;
+
+    while ((ret == 0) && (ctx->phase != GZ_PHASE_DONE)) {
+        saved_pos = s->in_pos;
+        saved_buf = s->bit_buf;
+        saved_count = s->bit_count;
+
+        switch (ctx->phase) {
+            case GZ_PHASE_HEADER:
+                ret = gz_parse_header(s);
+                if (ret == 0) {
+                    ctx->phase = GZ_PHASE_BLOCK;
+                }
+                break;
+            case GZ_PHASE_BLOCK:
+                ret = gz_get_bits(s, 1, &bfinal);
+                if (ret == 0) {
+                    ret = gz_get_bits(s, 2, &btype);
+                }
+                if (ret == 0) {
+                    ctx->bfinal = (uint8_t)bfinal;
+                    if (btype == 0) {
+                        ret = gz_stored_begin(s, &ctx->stored_left);
+                        if (ret == 0) {
+                            ctx->phase = GZ_PHASE_STORED;
+                        }
+                    }
+                    else if ((btype == 1) || (btype == 2)) {
+                        if (btype == 1) {
+                            ret = gz_build_fixed(&ctx->litlen, &ctx->dist);
+                        }
+                        else {
+                            ret = gz_read_dynamic(s, &ctx->litlen, &ctx->dist);
+                        }
+                        if (ret == 0) {
+                            ctx->phase = GZ_PHASE_HUFFMAN;
+                        }
+                    }
+                    else {
+                        ret = WOLFBOOT_GZIP_E_FORMAT;
+                    }
+                }
+                break;
+            case GZ_PHASE_STORED:
+                if (ctx->stored_left == 0) {
+                    ctx->phase = ctx->bfinal ? GZ_PHASE_TRAILER :
+                                               GZ_PHASE_BLOCK;
+                }
+                else if (s->in_pos >= s->in_len) {
+                    ret = WOLFBOOT_GZIP_E_TRUNCATED;
+                }
+                else {
+                    ret = gz_stored_copy(s, &ctx->stored_left);
+                }
+                break;
+            case GZ_PHASE_HUFFMAN:
+                ret = gz_inflate_symbol(s, &ctx->litlen, &ctx->dist);
+                if (ret == 1) {
+                    ret = 0;
+                    ctx->phase = ctx->bfinal ? GZ_PHASE_TRAILER :
+                                               GZ_PHASE_BLOCK;
+                }
+                break;
+            case GZ_PHASE_TRAILER:
+#ifdef WOLFBOOT_GZIP_FAST
+                gz_crc_flush(s);
+#endif
+                ret = gz_parse_trailer(s, s->crc32 ^ GZIP_CRC32_FINAL_XOR,
+                                       s->out_pos);
+                if (ret == 0) {
+                    ctx->phase = GZ_PHASE_DONE;
+                }
+                break;
+            default:
+                ret = WOLFBOOT_GZIP_E_PARAM;
+                break;
+        }
+    }
+    if (ret == WOLFBOOT_GZIP_E_TRUNCATED) {
+        /* Not an error yet: wait for more input */
+        s->in_pos = saved_pos;
+        s->bit_buf = saved_buf;
+        s->bit_count = saved_count;
+        ret = 0;
+    }
+    return ret;
+}
+
+int wolfBoot_gunzip_init(WOLFBOOT_GUNZIP_CTX *ctx, uint8_t *out,
+                         uint32_t out_max)
+{
+    if ((ctx == NULL) || (out == NULL)) {
+        return WOLFBOOT_GZIP_E_PARAM;
+    }
+    memset(ctx, 0, sizeof(*ctx));
+    gz_state_init(&ctx->s, ctx->in_buf, 0, out, out_max);
+    ctx->phase = GZ_PHASE_HEADER;
+    return 0;
+}
+
+int wolfBoot_gunzip_feed(WOLFBOOT_GUNZIP_CTX *ctx, const uint8_t *in,
+                         uint32_t in_len)
+{
+    gz_state_t *s;
+    uint32_t held, drop, keep, n;
+    int ret = 0;
+
+    if ((ctx == NULL) || ((in == NULL) && (in_len > 0))) {
+        return WOLFBOOT_GZIP_E_PARAM;
+    }
+    if (ctx->error != 0) {
+        return ctx->error;
+    }
+    s = &ctx->s;
+    while ((ret == 0) && (ctx->phase != GZ_PHASE_DONE) && (in_len > 0)) {
+        /* Drop consumed input, then stage as much of the chunk as fits.
+         * Whole bytes still sitting in bit_buf are kept too: the byte
+         * alignment of stored blocks and the trailer hands them back. */
+        held = (uint32_t)(s->bit_count >> 3);
+        drop = s->in_pos - held;
+        keep = s->in_len - drop;
+        if ((keep > 0) && (drop > 0)) {
+            memmove(ctx->in_buf, ctx->in_buf + drop, keep);
+        }
+        n = (uint32_t)sizeof(ctx->in_buf) - keep;
+        if (n > in_len) {
+            n = in_len;
+        }
+        memcpy(ctx->in_buf + keep, in, n);
+        in += n;
+        in_len -= n;
+        s->in_pos = held;
+        s->in_len = keep + n;
+
+        ret = gz_stream_run(ctx);
+        if ((ret == 0) && (ctx->phase != GZ_PHASE_DONE) &&
+            (s->in_pos == (uint32_t)(s->bit_count >> 3)) &&
+            (s->in_len == sizeof(ctx->in_buf))) {
+            /* A single step needs more than the staging buffer holds
+             * (e.g. an oversized FEXTRA field). */
+            ret = WOLFBOOT_GZIP_E_FORMAT;
+        }
+    }
+    if (ret < 0) {
+        ctx->error = ret;
+        return ret;
+    }
+    return (ctx->phase == GZ_PHASE_DONE) ? 1 : 0;
+}
+
+int wolfBoot_gunzip_finish(WOLFBOOT_GUNZIP_CTX *ctx, uint32_t *out_len)
+{
+    int ret;
+
+    if ((ctx == NULL) || (out_len == NULL)) {
+        return WOLFBOOT_GZIP_E_PARAM;
+    }
+    *out_len = ctx->s.out_pos;
+    if (ctx->error != 0) {
+        ret = ctx->error;
+    }
+    else if (ctx->phase != GZ_PHASE_DONE) {
+        ret = WOLFBOOT_GZIP_E_TRUNCATED;
+    }
+    else {
+        ret = 0;
+    }
+    return ret;
+}
+
 #endif /* WOLFBOOT_GZIP */
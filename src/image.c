@@ -42,6 +42,7 @@
 #include "hal.h"
 #include "spi_drv.h"
 #include "printf.h"
+#include "measure_log.h"
 #ifdef WOLFBOOT_TPM
 #include "tpm.h"
 #endif
@@ -999,6 +1000,28 @@ uint16_t wolfBoot_get_header(struct wolfBoot_image *img, uint16_t type,
 #ifdef EXT_FLASH
 static uint8_t ext_hash_block[WOLFBOOT_SHA_BLOCK_SIZE] XALIGNED(4);
 #endif
+
+/* Address the hashers read the memory mapped image at, offset bytes after
+ * fw_base: the image body, or what follows it (chunk table). */
+static uint8_t *image_body_addr(struct wolfBoot_image *img, uint32_t offset)
+{
+    uint8_t *p = (uint8_t *)(img->fw_base + offset);
+#if defined(MPFS_DDR_INIT)
+    /* PolarFire SoC DDR build: route in-DDR image-body reads through the
+     * non-cached DDR SEG window (0xC0000000 base) so cache fills don't evict
+     * L2 Scratch lines (where wolfBoot's own code/stack live).  PDMA already
+     * L2-flushed the cached writes at disk-load, so the non-cached side reads
+     * the correct DDR contents.  0x8xxxxxxx -> 0xCxxxxxxx.  Applied at this
+     * single point so every image-body hasher (SHA256/384/3-384) and the
+     * chunk table reads behave identically; inert for the L2-Scratch QSPI
+     * M-mode build (fw_base is not in the 0x8xxxxxxx window). */
+    if (((uintptr_t)p & 0xF0000000UL) == 0x80000000UL) {
+        p = (uint8_t *)((uintptr_t)p | 0x40000000UL);
+    }
+#endif
+    return p;
+}
+
 /**
  * @brief Get a block of data to be hashed.
  *
@@ -1008,7 +1031,6 @@ static uint8_t ext_hash_block[WOLFBOOT_SHA_BLOCK_SIZE] XALIGNED(4);
  */
 static uint8_t *get_sha_block(struct wolfBoot_image *img, uint32_t offset)
 {
-    uint8_t *p;
     if (offset > img->fw_size)
         return NULL;
 #ifdef EXT_FLASH
@@ -1018,21 +1040,7 @@ static uint8_t *get_sha_block(struct wolfBoot_image *img, uint32_t offset)
         return ext_hash_block;
     }
 #endif
-    p = (uint8_t *)(img->fw_base + offset);
-#if defined(MPFS_DDR_INIT)
-    /* PolarFire SoC DDR build: route in-DDR image-body reads through the
-     * non-cached DDR SEG window (0xC0000000 base) so cache fills don't evict
-     * L2 Scratch lines (where wolfBoot's own code/stack live).  PDMA already
-     * L2-flushed the cached writes at disk-load, so the non-cached side reads
-     * the correct DDR contents.  0x8xxxxxxx -> 0xCxxxxxxx.  Applied at this
-     * single point so every image-body hasher (SHA256/384/3-384) behaves
-     * identically; inert for the L2-Scratch QSPI M-mode build (fw_base is not
-     * in the 0x8xxxxxxx window). */
-    if (((uintptr_t)p & 0xF0000000UL) == 0x80000000UL) {
-        p = (uint8_t *)((uintptr_t)p | 0x40000000UL);
-    }
-#endif
-    return p;
+    return image_body_addr(img, offset);
 }
 
 #ifdef EXT_FLASH
@@ -1466,6 +1474,23 @@ uint32_t wolfBoot_image_size(uint8_t *image)
     return im2n(*size);
 }
 
+/**
+ * @brief Get the size of an image as stored in its partition: the header, the
+ * firmware and, for chunked images (WOLFBOOT_IMG_CHUNKS), the chunk table that
+ * follows the firmware. This is the area to copy when an image is moved.
+ *
+ * @param img The image, with hdr, part and fw_size set.
+ * @return The stored size in bytes.
+ */
+uint32_t wolfBoot_image_total_size(struct wolfBoot_image *img)
+{
+    uint32_t size = img->fw_size + IMAGE_HEADER_SIZE;
+#ifdef WOLFBOOT_IMG_CHUNKS
+    size += wolfBoot_image_chunks(img) * WOLFBOOT_SHA_DIGEST_SIZE;
+#endif
+    return size;
+}
+
 /**
  * @brief Open an image using the provided image address.
  *
@@ -1825,30 +1850,309 @@ int wolfBoot_open_self_address(struct wolfBoot_image* img, uint8_t* hdr,
 }
 #endif
 
+#ifdef WOLFBOOT_IMG_CHUNKS
+/* Chunked images (sign --chunk-size) carry the chunk size in HDR_IMG_CHUNKS
+ * and the digests of all the chunks in a table stored right after the
+ * firmware. The image digest in the header covers the header and the table,
+ * and each chunk is then checked on its own against its entry in the table,
+ * so the chunks can be hashed in any order, or concurrently. */
+
+static uint32_t image_chunk_geometry(struct wolfBoot_image *img,
+    uint32_t *chunk_sz)
+{
+    uint8_t *p;
+    uint32_t sz, n;
+    uint32_t max_sz = 0xFFFFFFFFUL;
+
+    if ((img == NULL) || (!img->hdr_ok) ||
+            (get_header(img, HDR_IMG_CHUNKS, &p) != sizeof(uint32_t)))
+        return 0;
+    sz = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+        ((uint32_t)p[3] << 24);
+    if ((sz == 0) || (img->fw_size == 0))
+        return 0;
+    n = ((img->fw_size - 1) / sz) + 1;
+#if defined(WOLFBOOT_FIXED_PARTITIONS)
+    max_sz = ((img->part == PART_UPDATE) ? WOLFBOOT_PARTITION_UPDATE_SIZE :
+        WOLFBOOT_PARTITION_SIZE) - IMAGE_HEADER_SIZE;
+#elif defined(WOLFBOOT_RAMBOOT_MAX_SIZE)
+    max_sz = WOLFBOOT_RAMBOOT_MAX_SIZE;
+#endif
+    /* The table must fit after the firmware */
+    if ((img->fw_size > max_sz) ||
+            (n > (max_sz - img->fw_size) / WOLFBOOT_SHA_DIGEST_SIZE))
+        return 0;
+    if (chunk_sz != NULL)
+        *chunk_sz = sz;
+    return n;
+}
+
+/**
+ * @brief Get the number of chunks of a chunked image.
+ *
+ * @param img The image.
+ * @return The number of chunks, 0 if the image is not chunked or its chunk
+ * table does not fit in the partition.
+ */
+uint32_t wolfBoot_image_chunks(struct wolfBoot_image *img)
+{
+    return image_chunk_geometry(img, NULL);
+}
+
+/* Entry idx of the chunk table. External images are read into buf. */
+static const uint8_t *image_chunk_digest(struct wolfBoot_image *img,
+    uint32_t idx, uint8_t *buf)
+{
+    uint32_t off = img->fw_size + (idx * WOLFBOOT_SHA_DIGEST_SIZE);
+#ifdef EXT_FLASH
+    if (PART_IS_EXT(img)) {
+        if (ext_flash_check_read((uintptr_t)img->fw_base + off, buf,
+                WOLFBOOT_SHA_DIGEST_SIZE) != WOLFBOOT_SHA_DIGEST_SIZE)
+            return NULL;
+        return buf;
+    }
+#endif
+    (void)buf;
+    return image_body_addr(img, off);
+}
+
+/* Root digest of a chunked image: header, then the chunk table. It is
+ * stored complemented, and only restored by image_chunks_seal() once all
+ * the chunks are known to match the table (VERIFY_CHUNKS_FN()). */
+static int image_chunks_root(struct wolfBoot_image *img, uint32_t n,
+    uint8_t *hash)
+{
+    wolfBoot_hash_t ctx;
+    uint8_t buf[WOLFBOOT_SHA_DIGEST_SIZE];
+    const uint8_t *d;
+    uint32_t i;
+    int ret = 0;
+
+    if (header_hash(&ctx, img) != 0)
+        return -1;
+    for (i = 0; i < n; i++) {
+        d = image_chunk_digest(img, i, buf);
+        if (d == NULL) {
+            ret = -1;
+            break;
+        }
+        wolfBoot_hash_update(&ctx, d, WOLFBOOT_SHA_DIGEST_SIZE);
+    }
+    wolfBoot_hash_final(&ctx, hash);
+    wolfBoot_hash_free(&ctx);
+    for (i = 0; i < WOLFBOOT_SHA_DIGEST_SIZE; i++)
+        hash[i] = (uint8_t)~hash[i];
+    return ret;
+}
+
+/* Restore the root digest computed by image_chunks_root() if res, the
+ * result of hal_verify_image_chunks(), is 0. The flip mask is derived from
+ * res without branching, so that reaching this call with a failed result
+ * still leaves a root that VERIFY_INTEGRITY_FN() rejects. */
+static void NOINLINEFUNCTION image_chunks_seal(uint8_t *hash, uint32_t res)
+{
+    volatile uint32_t z1 = 0U, z2 = 0U, ok = 0U;
+    uint8_t mask;
+    uint32_t i;
+
+    z1 = 1U ^ ((res | (0U - res)) >> 31);   /* 1 iff res == 0 */
+    z2 = (res == 0U) ? 1U : 0U;             /* 1 iff res == 0 */
+    ok = z1 & z2;
+    ok &= z1;
+    mask = (uint8_t)(0U - ok);
+    for (i = 0; i < WOLFBOOT_SHA_DIGEST_SIZE; i++)
+        hash[i] ^= mask;
+}
+
+/**
+ * @brief Verify one chunk of a chunked image against the chunk table.
+ *
+ * Only uses local state, so different chunks of the same image can be
+ * verified concurrently (e.g. from hal_verify_image_chunks()), as long as
+ * the image is memory mapped: external flash reads are not serialized.
+ * The table itself is only trusted after wolfBoot_verify_integrity().
+ *
+ * @param img The image.
+ * @param idx Index of the chunk, from 0 to wolfBoot_image_chunks() - 1.
+ * @return 0 if the chunk matches its digest, non-zero otherwise.
+ */
+int wolfBoot_verify_image_chunk(struct wolfBoot_image *img, uint32_t idx)
+{
+    wolfBoot_hash_t ctx;
+    uint8_t hash[WOLFBOOT_SHA_DIGEST_SIZE];
+    uint8_t buf[WOLFBOOT_SHA_DIGEST_SIZE];
+#ifdef EXT_FLASH
+    uint8_t blk[WOLFBOOT_SHA_BLOCK_SIZE];
+#endif
+    const uint8_t *expected;
+    const uint8_t *p;
+    uint32_t chunk_sz, n, pos, end, len;
+
+    n = image_chunk_geometry(img, &chunk_sz);
+    if (idx >= n)
+        return -1;
+    pos = idx * chunk_sz;
+    end = pos + chunk_sz;
+    if ((end < pos) || (end > img->fw_size))
+        end = img->fw_size;
+    if (wolfBoot_hash_init(&ctx) != 0)
+        return -1;
+    while (pos < end) {
+        len = WOLFBOOT_SHA_BLOCK_SIZE;
+        if (len > end - pos)
+            len = end - pos;
+#ifdef EXT_FLASH
+        if (PART_IS_EXT(img)) {
+            if (ext_flash_check_read((uintptr_t)img->fw_base + pos, blk,
+                    (int)len) != (int)len) {
+                wolfBoot_hash_free(&ctx);
+                return -1;
+            }
+            p = blk;
+        } else
+#endif
+        {
+            p = get_sha_block(img, pos);
+        }
+        wolfBoot_hash_update(&ctx, p, len);
+        pos += len;
+    }
+    wolfBoot_hash_final(&ctx, hash);
+    wolfBoot_hash_free(&ctx);
+    expected = image_chunk_digest(img, idx, buf);
+    if (expected == NULL)
+        return -1;
+    /* Returned as is, so that the callers accumulate it without branching */
+    return wolfBoot_hardened_CT_compare(expected, hash,
+        WOLFBOOT_SHA_DIGEST_SIZE);
+}
+
+#ifndef WOLFBOOT_IMG_CHUNKS_PARALLEL
+/* Without a parallel implementation in the HAL, chunks are checked in
+ * order by the boot core. */
+static int hal_verify_image_chunks(struct wolfBoot_image *img, uint32_t n)
+{
+    uint32_t i;
+    int ret = 0;
+
+    for (i = 0; i < n; i++) {
+        ret |= wolfBoot_verify_image_chunk(img, i);
+        wolfBoot_watchdog_feed();
+    }
+    return ret;
+}
+#endif
+
+#ifdef WOLFBOOT_IMG_CHUNKS_LAZY
+/* Number of chunks to verify before booting an image lazily: the ones in
+ * the first prefix bytes of the firmware, and any other chunk that the HAL
+ * cannot keep from being executed until the application verifies it. */
+static uint32_t image_lazy_chunks(struct wolfBoot_image *img, uint32_t prefix,
+    uint32_t n)
+{
+    uint32_t chunk_sz = 0;
+    uint32_t first;
+    uintptr_t fw_start, start, end, prot;
+
+    if ((prefix == 0) || (image_chunk_geometry(img, &chunk_sz) != n) ||
+            (chunk_sz == 0))
+        return n;
+    first = ((prefix - 1) / chunk_sz) + 1;
+    if (first >= n)
+        return n;
+    fw_start = (uintptr_t)img->fw_base;
+    start = fw_start + ((uintptr_t)first * chunk_sz);
+    end = fw_start + img->fw_size;
+    prot = hal_lazy_xip_protect(start, end);
+    if ((prot < start) || (prot >= end))
+        return n;
+    return (uint32_t)(((prot - fw_start) - 1) / chunk_sz) + 1;
+}
+#endif
+#endif /* WOLFBOOT_IMG_CHUNKS */
+
 /**
  * @brief Verify the integrity of the image using the stored SHA hash.
  *
  * This function verifies the integrity of the image by calculating its SHA hash
  * and comparing it with the stored hash.
+ * For chunked images (WOLFBOOT_IMG_CHUNKS), the stored hash covers the header
+ * and the chunk table, and all the chunks are verified against the table via
+ * hal_verify_image_chunks().
  *
  * @param img The pointer to the wolfBoot_image structure representing the image.
  * @return 0 on success, -1 on error.
  */
-int wolfBoot_verify_integrity(struct wolfBoot_image *img)
+#ifdef WOLFBOOT_MEASURE_LOG
+/* The digest of a verified image goes to the measurement log, so that
+ * measured boot and attestation do not hash the image again. */
+static uint32_t image_mlog_region(struct wolfBoot_image *img)
+{
+    if (img->part == PART_BOOT)
+        return WOLFBOOT_MLOG_BOOT_IMAGE;
+    if (img->part == PART_UPDATE)
+        return WOLFBOOT_MLOG_UPDATE_IMAGE;
+    return 0;
+}
+
+static void image_mlog_record(struct wolfBoot_image *img)
+{
+    uint32_t region = image_mlog_region(img);
+
+    if (region != 0) {
+        (void)wolfBoot_mlog_record(region, (uintptr_t)img->hdr,
+            IMAGE_HEADER_SIZE + img->fw_size, img->sha_hash);
+    }
+}
+#define image_mlog_forget(img) wolfBoot_mlog_forget(image_mlog_region(img))
+#else
+#define image_mlog_record(img) do {} while (0)
+#define image_mlog_forget(img) do {} while (0)
+#endif
+
+static int image_verify_integrity(struct wolfBoot_image *img, uint32_t prefix)
 {
     uint8_t *stored_sha;
     uint16_t stored_sha_len;
+#ifdef WOLFBOOT_IMG_CHUNKS
+    uint32_t n_chunks, n_verify;
+#endif
     /* Reset any cached integrity state up-front, so that a stale sha_ok (and
      * its complement/canary) left over from a previous verification of a
      * re-used image cannot survive a failed comparison and produce a
      * false-positive SHA_OK() result below. */
     img->sha_hash = NULL;
     wolfBoot_image_clear_sha_ok(img);
+    image_mlog_forget(img);
+#ifdef WOLFBOOT_IMG_CHUNKS_LAZY
+    /* Same for the execute-never plan of the image verified before this
+     * one (fallback, emergency update): it must not be applied to this
+     * image at boot. */
+    hal_lazy_xip_reset();
+#endif
     stored_sha_len = get_header(img, WOLFBOOT_SHA_HDR, &stored_sha);
     if (stored_sha_len != WOLFBOOT_SHA_DIGEST_SIZE)
         return -1;
+#ifdef WOLFBOOT_IMG_CHUNKS
+    n_chunks = image_chunk_geometry(img, NULL);
+    if (n_chunks > 0) {
+        /* The stored digest covers the header and the chunk table, and
+         * each chunk must match its digest in the table. */
+        n_verify = n_chunks;
+#ifdef WOLFBOOT_IMG_CHUNKS_LAZY
+        n_verify = image_lazy_chunks(img, prefix, n_chunks);
+#endif
+        if (image_chunks_root(img, n_chunks, digest) != 0)
+            return -1;
+        /* Fault-hardened check of the chunks: the root only matches the
+         * stored digest below if all of them matched the table. */
+        VERIFY_CHUNKS_FN(img, n_verify, digest);
+    }
+    else
+#endif
     if (image_hash(img, digest) != 0)
         return -1;
+    (void)prefix;
     /* Redundant, fault-hardened digest comparison. On a match this records the
      * verified digest and sets sha_ok (plus its complement/canary under
      * ARMORED) through an unskippable callback; otherwise the flags stay
@@ -1856,6 +2160,166 @@ int wolfBoot_verify_integrity(struct wolfBoot_image *img)
     VERIFY_INTEGRITY_FN(img, digest, stored_sha);
     if (!SHA_OK(img))
         return -1;
+    image_mlog_record(img);
+    return 0;
+}
+
+int wolfBoot_verify_integrity(struct wolfBoot_image *img)
+{
+    int ret;
+
+    BOOT_TIMING_BEGIN(WOLFBOOT_TIMING_HASH);
+    ret = image_verify_integrity(img, 0);
+    BOOT_TIMING_END(WOLFBOOT_TIMING_HASH);
+    return ret;
+}
+
+#ifdef WOLFBOOT_IMG_CHUNKS_LAZY
+/**
+ * @brief Verify the integrity of an XIP image, leaving most of its chunks
+ * to the application.
+ *
+ * Like wolfBoot_verify_integrity(), but for chunked images only the chunks
+ * in the first prefix bytes of the firmware are hashed. The chunk table is
+ * still authenticated as a whole. The rest of the firmware is passed to
+ * hal_lazy_xip_protect(), which keeps it from being executed after boot;
+ * whatever the HAL cannot protect is verified here as well. The
+ * application then verifies the remaining chunks with
+ * wolfBoot_lazy_verify_next() or wolfBoot_lazy_verify_range().
+ * Images without a chunk table are verified entirely.
+ *
+ * @param img The image.
+ * @param prefix Number of bytes at the start of the firmware that must be
+ * verified before boot (vector table and early code).
+ * @return 0 on success, -1 on error.
+ */
+int wolfBoot_verify_integrity_lazy(struct wolfBoot_image *img, uint32_t prefix)
+{
+    int ret;
+
+    BOOT_TIMING_BEGIN(WOLFBOOT_TIMING_HASH);
+    ret = image_verify_integrity(img, prefix);
+    /* The plan made for an image that failed is dropped as well */
+    if (ret != 0)
+        hal_lazy_xip_reset();
+    BOOT_TIMING_END(WOLFBOOT_TIMING_HASH);
+    return ret;
+}
+#endif
+
+/* State of the incremental integrity check. Only one image can be hashed
+ * this way at a time, which is all the RAM loaders need. */
+static wolfBoot_hash_t stream_hash_ctx;
+static uint32_t stream_hash_pos;
+static int stream_hash_active;
+
+/**
+ * @brief Start an incremental integrity check of an image.
+ *
+ * Hashes the image header. The firmware is then hashed piece by piece with
+ * wolfBoot_image_hash_update() as it becomes available at img->fw_base,
+ * typically right after each chunk is loaded (and decrypted) into RAM, so
+ * it is still in the data cache. wolfBoot_image_hash_verify() completes
+ * the check in place of wolfBoot_verify_integrity(). Chunked images are not
+ * supported.
+ *
+ * @param img The image, with fw_base pointing to where the firmware will be.
+ * @return 0 on success, -1 on error.
+ */
+int wolfBoot_image_hash_start(struct wolfBoot_image *img)
+{
+    if (stream_hash_active) {
+        wolfBoot_hash_free(&stream_hash_ctx);
+        stream_hash_active = 0;
+    }
+    stream_hash_pos = 0;
+    if (img == NULL)
+        return -1;
+#ifdef WOLFBOOT_IMG_CHUNKS
+    /* The digest of a chunked image does not cover the firmware stream */
+    if (image_chunk_geometry(img, NULL) > 0)
+        return -1;
+#endif
+    if (header_hash(&stream_hash_ctx, img) != 0)
+        return -1;
+    stream_hash_active = 1;
+    return 0;
+}
+
+/**
+ * @brief Hash the next len bytes of the firmware.
+ *
+ * The firmware must be hashed in order, from offset 0 up to fw_size.
+ *
+ * @param img The image passed to wolfBoot_image_hash_start().
+ * @param len Number of bytes, following the ones already hashed, to add.
+ * @return 0 on success, -1 on error.
+ */
+int wolfBoot_image_hash_update(struct wolfBoot_image *img, uint32_t len)
+{
+    if ((img == NULL) || (!stream_hash_active) ||
+            (len > img->fw_size - stream_hash_pos))
+        return -1;
+#ifdef WOLFBOOT_IMG_HASH_ONESHOT
+    if (img->fw_base == NULL)
+        return -1;
+    wolfBoot_hash_update(&stream_hash_ctx, img->fw_base + stream_hash_pos, len);
+    stream_hash_pos += len;
+#else
+    {
+        uint8_t *p;
+        uint32_t blksz;
+        while (len > 0) {
+            p = get_sha_block(img, stream_hash_pos);
+            if (p == NULL)
+                return -1;
+            blksz = WOLFBOOT_SHA_BLOCK_SIZE;
+            if (blksz > len)
+                blksz = len;
+            wolfBoot_hash_update(&stream_hash_ctx, p, blksz);
+            stream_hash_pos += blksz;
+            len -= blksz;
+        }
+    }
+#endif
+    wolfBoot_watchdog_feed();
+    return 0;
+}
+
+/**
+ * @brief Complete an incremental integrity check.
+ *
+ * Fails unless exactly fw_size bytes of firmware were hashed. On success
+ * the image is marked as sha_ok, exactly as wolfBoot_verify_integrity()
+ * would, so wolfBoot_verify_authenticity() does not hash it again.
+ *
+ * @param img The image passed to wolfBoot_image_hash_start().
+ * @return 0 on success, -1 on error.
+ */
+int wolfBoot_image_hash_verify(struct wolfBoot_image *img)
+{
+    uint8_t *stored_sha;
+    uint16_t stored_sha_len;
+    int complete;
+
+    img->sha_hash = NULL;
+    wolfBoot_image_clear_sha_ok(img);
+    image_mlog_forget(img);
+    if (!stream_hash_active)
+        return -1;
+    complete = (stream_hash_pos == img->fw_size);
+    wolfBoot_hash_final(&stream_hash_ctx, digest);
+    wolfBoot_hash_free(&stream_hash_ctx);
+    stream_hash_active = 0;
+    if (!complete)
+        return -1;
+    stored_sha_len = get_header(img, WOLFBOOT_SHA_HDR, &stored_sha);
+    if (stored_sha_len != WOLFBOOT_SHA_DIGEST_SIZE)
+        return -1;
+    VERIFY_INTEGRITY_FN(img, digest, stored_sha);
+    if (!SHA_OK(img))
+        return -1;
+    image_mlog_record(img);
     return 0;
 }
 
@@ -2433,13 +2897,13 @@ int wolfBoot_load_flash_image_elf(int part, unsigned long* entry_out, int ext_fl
  * @param img The pointer to the wolfBoot_image structure representing the image.
  * @return 0 on success, -1 on error, -2 if the signature verification fails.
  */
-int wolfBoot_verify_authenticity(struct wolfBoot_image *img)
+static int image_verify_authenticity(struct wolfBoot_image *img)
 {
     wolfBoot_image_confirm_signature_ok(img);
     return 0;
 }
 #else
-int wolfBoot_verify_authenticity(struct wolfBoot_image *img)
+static int image_verify_authenticity(struct wolfBoot_image *img)
 {
     uint8_t *stored_signature;
     uint16_t stored_signature_size;
@@ -2645,13 +3109,6 @@ int wolfBoot_verify_authenticity(struct wolfBoot_image *img)
      */
     wolfBoot_verify_signature_primary(key_slot, img, stored_signature);
 
-#ifdef WOLFBOOT_ARMORED
-#define SIG_OK(imgp) (((imgp)->signature_ok == 1) && \
-                      ((imgp)->not_signature_ok == ~(uint32_t)1))
-#else
-#define SIG_OK(imgp) ((imgp)->signature_ok == 1)
-#endif
-
 #ifdef SIGN_HYBRID
     if (SIG_OK(img)) {
         uint8_t *stored_secondary_signature;
@@ -2718,10 +3175,19 @@ int wolfBoot_verify_authenticity(struct wolfBoot_image *img)
         return 0;
     }
     return -2;
-#undef SIG_OK
 }
 #endif
 
+int wolfBoot_verify_authenticity(struct wolfBoot_image *img)
+{
+    int ret;
+
+    BOOT_TIMING_BEGIN(WOLFBOOT_TIMING_SIGNATURE);
+    ret = image_verify_authenticity(img);
+    BOOT_TIMING_END(WOLFBOOT_TIMING_SIGNATURE);
+    return ret;
+}
+
 /**
  * @brief Peek at the content of the image at a specific offset.
  *
@@ -2765,6 +3231,11 @@ static int keyslot_CT_hint_matches(const uint8_t *expected,
  *
  * This function retrieves the key slot ID from the keystore that matches the
  * provided SHA hash.
+ * With WOLFBOOT_KEYSTORE_HINTS the digests precomputed in the keystore
+ * (keystore_get_key_hint()) are compared instead of hashing each key, and
+ * keys without a precomputed digest are hashed. All the slots are compared
+ * in both cases. With WOLFBOOT_KEYSTORE_HINTS_VERIFY the matching key is
+ * hashed to check that its precomputed digest is correct.
  *
  * @param hint The SHA hash of the public key to search for.
  * @return The key slot ID if found, -1 if the key was not found.
@@ -2776,11 +3247,27 @@ int keyslot_id_by_sha(const uint8_t *hint)
 
     for (id = 0; id < keystore_num_pubkeys(); id++) {
         int match;
+        const uint8_t *key_digest = digest;
+#ifdef WOLFBOOT_KEYSTORE_HINTS
+        key_digest = keystore_get_key_hint(id);
+        if (key_digest == NULL) {
+            key_hash(id, digest);
+            key_digest = digest;
+        }
+#else
         key_hash(id, digest);
-        match = keyslot_CT_hint_matches(digest, hint);
+#endif
+        match = keyslot_CT_hint_matches(key_digest, hint);
         if (match && (match_id < 0))
             match_id = id;
     }
+#ifdef WOLFBOOT_KEYSTORE_HINTS_VERIFY
+    if (match_id >= 0) {
+        key_hash(match_id, digest);
+        if (!keyslot_CT_hint_matches(digest, hint))
+            match_id = -1;
+    }
+#endif
     return match_id;
 }
 #endif /* !WOLFBOOT_NO_SIGN && !WOLFBOOT_RENESAS_SCEPROTECT */
@@ -0,0 +1,924 @@
+/* keyvault_log.c
+ *
+ * Log-structured backend for the secure vault of the PKCS11 and PSA stores.
+ *
+ * Compile with KEYVAULT_LOG=1
+ *
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+/* The vault is a ring of erase blocks, each made of one or more flash
+ * sectors:
+ *
+ *   - block header: two slots. Slot 0 (erase count) is written right after
+ *     the erase, slot 1 (generation) when the block starts receiving records.
+ *   - records, appended one after the other:
+ *       header (type, ids, sequence number, length, flags)
+ *       payload, padded to KEYVAULT_LOG_ALIGN
+ *       commit slot (sequence number, payload CRC)
+ *
+ * Every field is programmed once after the erase, in its own
+ * KEYVAULT_LOG_ALIGN units, so the layout is also valid for flash with
+ * write-once ECC words. A record is valid only once its commit slot is
+ * written: an interrupted update leaves the previous version in place.
+ *
+ * The index of the objects is built in RAM when the vault is first accessed;
+ * the newest sequence number of each object wins, a record with the
+ * KV_REC_DELETED flag (tombstone) removes it. Blocks are erased by the
+ * garbage collector only, after moving the records that are still current.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hal.h"
+#include "keyvault_log.h"
+
+#ifdef WOLFBOOT_KEYVAULT_LOG
+
+#ifndef UNIT_TEST
+/* From linker script: origin and size of vault flash */
+extern uint32_t _flash_keyvault;
+extern uint32_t _flash_keyvault_size;
+
+#define vault_base ((uint8_t*)&_flash_keyvault)
+#define vault_size ((uint32_t)&_flash_keyvault_size)
+#endif
+
+#if (KEYVAULT_LOG_ALIGN < 4) || \
+    ((KEYVAULT_LOG_ALIGN & (KEYVAULT_LOG_ALIGN - 1)) != 0)
+    #error KEYVAULT_LOG_ALIGN must be a power of two, 4 or more
+#endif
+
+#define KV_ALIGN_UP(x) \
+    (((x) + KEYVAULT_LOG_ALIGN - 1) & ~(KEYVAULT_LOG_ALIGN - 1))
+
+#define KV_SLOT_SIZE     KV_ALIGN_UP(16)  /* struct kv_slot, kv_commit */
+#define KV_REC_SIZE      KV_ALIGN_UP(32)  /* struct kv_rec */
+#define KV_BLOCK_HDR     (2 * KV_SLOT_SIZE)
+#define KV_SPAN(len)     (KV_REC_SIZE + KV_ALIGN_UP(len) + KV_SLOT_SIZE)
+#define KV_MAX_SPAN      KV_SPAN(KEYVAULT_LOG_MAX_PAYLOAD)
+
+/* Smallest group of sectors holding two objects of maximum size */
+#ifndef KEYVAULT_LOG_BLOCK_SIZE
+    #define KEYVAULT_LOG_BLOCK_SIZE \
+        (((KV_BLOCK_HDR + 2 * KV_MAX_SPAN + WOLFBOOT_SECTOR_SIZE - 1) / \
+          WOLFBOOT_SECTOR_SIZE) * WOLFBOOT_SECTOR_SIZE)
+#endif
+
+#define KV_BLOCK_SIZE    KEYVAULT_LOG_BLOCK_SIZE
+#define KV_BLOCKS        (KEYVAULT_LOG_SIZE / KV_BLOCK_SIZE)
+
+#if (KV_BLOCK_SIZE < KV_BLOCK_HDR + 2 * KV_MAX_SPAN)
+    #error KEYVAULT_LOG_BLOCK_SIZE must hold two objects of maximum size
+#endif
+
+#if (KV_BLOCKS < 3)
+    #error KEYVAULT_LOG_SIZE too small: at least three blocks are needed
+#endif
+
+/* One block is always kept free for the garbage collector, and the tail of
+ * a block may be too short for the next record. */
+#define KV_CAPACITY \
+    ((KV_BLOCKS - 2) * (KV_BLOCK_SIZE - KV_BLOCK_HDR - KV_MAX_SPAN))
+
+/* Static wear leveling: when the erase counts drift further apart than
+ * this, the least worn block is collected even if its records are current */
+#ifndef KEYVAULT_LOG_WEAR_DELTA
+    #define KEYVAULT_LOG_WEAR_DELTA 8
+#endif
+
+/* Live objects, plus the tombstones still needed to hide their older
+ * versions until the garbage collector erases them */
+#define KV_INDEX_SLOTS   (2 * KEYVAULT_MAX_ITEMS)
+
+#define MAX_OPEN_STORES  16
+
+#define KV_BLOCK_MAGIC   0x4B4C4256UL /* "VBLK" */
+#define KV_OPEN_MAGIC    0x4E45504FUL /* "OPEN" */
+#define KV_REC_MAGIC     0x4345524BUL /* "KREC" */
+#define KV_COMMIT_MAGIC  0x544D4F43UL /* "COMT" */
+
+#define KV_REC_DELETED   (1 << 0)
+
+struct kv_slot {
+    uint32_t magic;
+    uint32_t val;       /* erase count (slot 0), generation (slot 1) */
+    uint32_t crc;
+    uint32_t pad;
+};
+
+struct kv_rec {
+    uint32_t magic;
+    uint32_t seq;
+    int32_t  type;
+    uint32_t id1;
+    uint32_t id2;
+    uint32_t len;
+    uint32_t flags;
+    uint32_t crc;
+};
+
+struct kv_commit {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t data_crc;
+    uint32_t crc;
+};
+
+#define KV_BLOCK_FREE    0
+#define KV_BLOCK_USED    1
+#define KV_BLOCK_DIRTY   2
+
+struct kv_block {
+    uint32_t state;
+    uint32_t gen;
+    uint32_t erase_count;
+    uint32_t wr;        /* append offset in the block */
+    uint32_t live;      /* bytes of the records referenced by the index */
+};
+
+struct kv_entry {
+    int32_t  type;
+    uint32_t id1;
+    uint32_t id2;
+    uint32_t seq;       /* 0: unused */
+    uint32_t off;       /* record offset in the vault */
+    uint32_t len;
+    uint32_t flags;
+};
+
+struct kv_handle {
+    uint32_t flags;
+    int32_t  type;
+    uint32_t id1;
+    uint32_t id2;
+    uint32_t seq;       /* version being read */
+    uint32_t pos;
+};
+
+#define KV_HANDLE_OPEN   (1 << 0)
+#define KV_HANDLE_WRITE  (1 << 1)
+
+static struct kv_block kv_blocks[KV_BLOCKS];
+static struct kv_entry kv_index[KV_INDEX_SLOTS];
+static struct kv_handle kv_handles[MAX_OPEN_STORES];
+static struct keyvault_log_stats kv_stats;
+static int kv_mounted;
+static int kv_head = -1;
+static uint32_t kv_seq;
+static uint32_t kv_gen;
+
+/* Payload of the object open for writing, committed on close */
+static uint8_t kv_stage[KEYVAULT_LOG_MAX_PAYLOAD];
+static uint32_t kv_stage_len;
+static struct kv_handle *kv_writer;
+
+static uint32_t kv_crc32(uint32_t crc, const uint8_t *p, uint32_t len)
+{
+    int k;
+    crc = ~crc;
+    while (len-- > 0) {
+        crc ^= *p++;
+        for (k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (0xEDB88320UL & (0U - (crc & 1U)));
+    }
+    return ~crc;
+}
+
+static uint32_t kv_block_addr(int b)
+{
+    return (uint32_t)b * KV_BLOCK_SIZE;
+}
+
+static int kv_block_of(uint32_t off)
+{
+    return (int)(off / KV_BLOCK_SIZE);
+}
+
+static int kv_is_erased(uint32_t off, uint32_t len)
+{
+    const uint8_t *p = vault_base + off;
+    while (len-- > 0) {
+        if (*p++ != 0xFF)
+            return 0;
+    }
+    return 1;
+}
+
+/* Program len bytes at off, padding the last KEYVAULT_LOG_ALIGN unit with
+ * 0xFF so that it is written with a single operation. */
+static int kv_program(uint32_t off, const uint8_t *data, uint32_t len)
+{
+    uint8_t unit[KEYVAULT_LOG_ALIGN];
+    uint32_t body = len & ~(KEYVAULT_LOG_ALIGN - 1);
+    int ret = 0;
+
+    hal_flash_unlock();
+    if (body > 0)
+        ret = hal_flash_write((uintptr_t)vault_base + off, data, body);
+    if ((ret == 0) && (body < len)) {
+        memset(unit, 0xFF, sizeof(unit));
+        memcpy(unit, data + body, len - body);
+        ret = hal_flash_write((uintptr_t)vault_base + off + body, unit,
+            KEYVAULT_LOG_ALIGN);
+    }
+    hal_flash_lock();
+    return ret;
+}
+
+static int kv_slot_valid(uint32_t off, uint32_t magic, uint32_t *val)
+{
+    struct kv_slot slot;
+    memcpy(&slot, vault_base + off, sizeof(slot));
+    if ((slot.magic != magic) ||
+            (slot.crc != kv_crc32(0, (uint8_t *)&slot,
+                offsetof(struct kv_slot, crc))))
+        return 0;
+    *val = slot.val;
+    return 1;
+}
+
+static int kv_slot_write(uint32_t off, uint32_t magic, uint32_t val)
+{
+    struct kv_slot slot;
+    slot.magic = magic;
+    slot.val = val;
+    slot.crc = kv_crc32(0, (uint8_t *)&slot, offsetof(struct kv_slot, crc));
+    slot.pad = 0xFFFFFFFFUL;
+    return kv_program(off, (uint8_t *)&slot, sizeof(slot));
+}
+
+static int kv_block_erase(int b)
+{
+    struct kv_block *blk = &kv_blocks[b];
+    int ret;
+
+    hal_flash_unlock();
+    ret = hal_flash_erase((uintptr_t)vault_base + kv_block_addr(b),
+        KV_BLOCK_SIZE);
+    hal_flash_lock();
+    kv_stats.sector_erases += KV_BLOCK_SIZE / WOLFBOOT_SECTOR_SIZE;
+    blk->erase_count++;
+    if (ret == 0)
+        ret = kv_slot_write(kv_block_addr(b), KV_BLOCK_MAGIC, blk->erase_count);
+    blk->gen = 0;
+    blk->live = 0;
+    blk->wr = KV_BLOCK_HDR;
+    blk->state = (ret == 0) ? KV_BLOCK_FREE : KV_BLOCK_DIRTY;
+    return ret;
+}
+
+static int kv_free_blocks(void)
+{
+    int b, n = 0;
+    for (b = 0; b < KV_BLOCKS; b++) {
+        if (kv_blocks[b].state == KV_BLOCK_FREE)
+            n++;
+    }
+    return n;
+}
+
+/* Start appending to the free block with the lowest erase count */
+static int kv_open_head(void)
+{
+    int b, sel = -1;
+    for (b = 0; b < KV_BLOCKS; b++) {
+        if ((kv_blocks[b].state == KV_BLOCK_FREE) && ((sel < 0) ||
+                (kv_blocks[b].erase_count < kv_blocks[sel].erase_count)))
+            sel = b;
+    }
+    kv_head = -1;
+    if (sel < 0)
+        return -1;
+    kv_blocks[sel].state = KV_BLOCK_USED;
+    kv_blocks[sel].gen = ++kv_gen;
+    kv_blocks[sel].wr = KV_BLOCK_HDR;
+    if (kv_slot_write(kv_block_addr(sel) + KV_SLOT_SIZE, KV_OPEN_MAGIC,
+            kv_gen) != 0) {
+        kv_blocks[sel].wr = KV_BLOCK_SIZE;
+        return -1;
+    }
+    kv_head = sel;
+    return 0;
+}
+
+static uint32_t kv_rec_crc(const struct kv_rec *rec)
+{
+    return kv_crc32(0, (const uint8_t *)rec, offsetof(struct kv_rec, crc));
+}
+
+static int kv_rec_committed(uint32_t off, const struct kv_rec *rec)
+{
+    struct kv_commit c;
+    memcpy(&c, vault_base + off + KV_REC_SIZE + KV_ALIGN_UP(rec->len),
+        sizeof(c));
+    return (c.magic == KV_COMMIT_MAGIC) && (c.seq == rec->seq) &&
+        (c.crc == kv_crc32(0, (uint8_t *)&c,
+            offsetof(struct kv_commit, crc))) &&
+        (c.data_crc == kv_crc32(0, vault_base + off + KV_REC_SIZE, rec->len));
+}
+
+/* Walk the records of block b, starting at *off. Returns 1 with the next
+ * committed record, 0 at the end of the block. Records without a commit
+ * slot (interrupted append) are skipped; a damaged header ends the block. */
+static int kv_next_record(int b, uint32_t *off, uint32_t *at,
+    struct kv_rec *rec)
+{
+    uint32_t end = kv_block_addr(b) + KV_BLOCK_SIZE;
+
+    while (*off + KV_SPAN(0) <= end) {
+        if (kv_is_erased(*off, KV_REC_SIZE))
+            return 0;
+        memcpy(rec, vault_base + *off, sizeof(*rec));
+        if ((rec->magic != KV_REC_MAGIC) || (rec->crc != kv_rec_crc(rec)) ||
+                (rec->len > KEYVAULT_LOG_MAX_PAYLOAD) ||
+                (*off + KV_SPAN(rec->len) > end)) {
+            *off = end;
+            return 0;
+        }
+        if (rec->seq > kv_seq)
+            kv_seq = rec->seq;
+        *at = *off;
+        *off += KV_SPAN(rec->len);
+        if (kv_rec_committed(*at, rec))
+            return 1;
+    }
+    return 0;
+}
+
+static struct kv_entry *kv_index_find(int32_t type, uint32_t id1,
+    uint32_t id2)
+{
+    int i;
+    for (i = 0; i < KV_INDEX_SLOTS; i++) {
+        struct kv_entry *e = &kv_index[i];
+        if ((e->seq != 0) && (e->type == type) && (e->id1 == id1) &&
+                (e->id2 == id2))
+            return e;
+    }
+    return NULL;
+}
+
+static struct kv_entry *kv_index_alloc(void)
+{
+    int i;
+    for (i = 0; i < KV_INDEX_SLOTS; i++) {
+        if (kv_index[i].seq == 0)
+            return &kv_index[i];
+    }
+    return NULL;
+}
+
+static int kv_index_objects(void)
+{
+    int i, n = 0;
+    for (i = 0; i < KV_INDEX_SLOTS; i++) {
+        if ((kv_index[i].seq != 0) &&
+                ((kv_index[i].flags & KV_REC_DELETED) == 0))
+            n++;
+    }
+    return n;
+}
+
+static uint32_t kv_live_bytes(void)
+{
+    int b;
+    uint32_t live = 0;
+    for (b = 0; b < KV_BLOCKS; b++)
+        live += kv_blocks[b].live;
+    return live;
+}
+
+#ifdef KEYVAULT_LOG_SCRUB
+/* Overwrite the payload of a superseded record with zeros. Programming a
+ * zero over a programmed bit is fine on NOR flash, but not on flash with
+ * write-once ECC words. The payload CRC no longer matches, so the record
+ * is ignored from now on. */
+static void kv_scrub(const struct kv_entry *e)
+{
+    static const uint8_t zero[KEYVAULT_LOG_ALIGN * 4];
+    uint32_t off = e->off + KV_REC_SIZE;
+    uint32_t left = KV_ALIGN_UP(e->len);
+
+    hal_flash_unlock();
+    while (left > 0) {
+        uint32_t sz = (left > sizeof(zero)) ? sizeof(zero) : left;
+        hal_flash_write((uintptr_t)vault_base + off, zero, sz);
+        off += sz;
+        left -= sz;
+    }
+    hal_flash_lock();
+}
+#else
+#define kv_scrub(e) do { (void)(e); } while (0)
+#endif
+
+/* Point the index entry to the record just appended at off */
+static void kv_index_set(struct kv_entry *e, const struct kv_rec *rec,
+    uint32_t off)
+{
+    if (e->seq != 0) {
+        kv_blocks[kv_block_of(e->off)].live -= KV_SPAN(e->len);
+        if (e->len > 0)
+            kv_scrub(e);
+    }
+    e->type = rec->type;
+    e->id1 = rec->id1;
+    e->id2 = rec->id2;
+    e->seq = rec->seq;
+    e->off = off;
+    e->len = rec->len;
+    e->flags = rec->flags;
+    kv_blocks[kv_block_of(off)].live += KV_SPAN(rec->len);
+}
+
+/* Append a record to the head block, opening a new one if it does not fit.
+ * The payload is read from data, which can also be a record in flash. */
+static int kv_append(struct kv_rec *rec, const uint8_t *data, uint32_t *at)
+{
+    struct kv_commit c;
+    uint32_t span = KV_SPAN(rec->len);
+    uint32_t off;
+    int ret;
+
+    if ((kv_head < 0) || (kv_blocks[kv_head].wr + span > KV_BLOCK_SIZE)) {
+        if (kv_open_head() != 0)
+            return KEYVAULT_LOG_FULL;
+    }
+    off = kv_block_addr(kv_head) + kv_blocks[kv_head].wr;
+    rec->magic = KV_REC_MAGIC;
+    rec->crc = kv_rec_crc(rec);
+    c.magic = KV_COMMIT_MAGIC;
+    c.seq = rec->seq;
+    c.data_crc = kv_crc32(0, data, rec->len);
+    c.crc = kv_crc32(0, (uint8_t *)&c, offsetof(struct kv_commit, crc));
+
+    kv_blocks[kv_head].wr += span;
+    ret = kv_program(off, (uint8_t *)rec, sizeof(*rec));
+    if ((ret == 0) && (rec->len > 0))
+        ret = kv_program(off + KV_REC_SIZE, data, rec->len);
+    if (ret == 0)
+        ret = kv_program(off + span - KV_SLOT_SIZE, (uint8_t *)&c, sizeof(c));
+    if (ret != 0) {
+        /* The scan at boot may stop at this record: nothing else is
+         * appended to the block. */
+        kv_blocks[kv_head].wr = KV_BLOCK_SIZE;
+        kv_head = -1;
+        return -1;
+    }
+    kv_stats.records++;
+    *at = off;
+    return 0;
+}
+
+/* Does a block other than skip still hold a version of the object older
+ * than seq? A tombstone is needed as long as it does. */
+static int kv_older_version(const struct kv_entry *e, int skip)
+{
+    struct kv_rec rec;
+    uint32_t off, at;
+    int b;
+
+    for (b = 0; b < KV_BLOCKS; b++) {
+        if ((b == skip) || (kv_blocks[b].state != KV_BLOCK_USED))
+            continue;
+        off = kv_block_addr(b) + KV_BLOCK_HDR;
+        while (kv_next_record(b, &off, &at, &rec)) {
+            if ((rec.type == e->type) && (rec.id1 == e->id1) &&
+                    (rec.id2 == e->id2) && (rec.seq < e->seq))
+                return 1;
+        }
+    }
+    return 0;
+}
+
+/* Collect the used block with the fewest live bytes (or the least worn
+ * one, see KEYVAULT_LOG_WEAR_DELTA): move its current records to the head,
+ * then erase it. */
+static int kv_gc_one(void)
+{
+    struct kv_rec rec;
+    struct kv_entry *e;
+    uint32_t off, at, to;
+    uint32_t max_erase = 0;
+    int b, victim = -1, cold = -1;
+
+    for (b = 0; b < KV_BLOCKS; b++) {
+        if (kv_blocks[b].erase_count > max_erase)
+            max_erase = kv_blocks[b].erase_count;
+        if ((b == kv_head) || (kv_blocks[b].state != KV_BLOCK_USED))
+            continue;
+        if ((victim < 0) || (kv_blocks[b].live < kv_blocks[victim].live) ||
+                ((kv_blocks[b].live == kv_blocks[victim].live) &&
+                 (kv_blocks[b].gen < kv_blocks[victim].gen)))
+            victim = b;
+        if ((cold < 0) ||
+                (kv_blocks[b].erase_count < kv_blocks[cold].erase_count))
+            cold = b;
+    }
+    if (victim < 0)
+        return -1;
+    /* Moving a full block needs a free one */
+    if ((max_erase - kv_blocks[cold].erase_count > KEYVAULT_LOG_WEAR_DELTA) &&
+            (kv_free_blocks() > 0))
+        victim = cold;
+
+    off = kv_block_addr(victim) + KV_BLOCK_HDR;
+    while (kv_next_record(victim, &off, &at, &rec)) {
+        e = kv_index_find(rec.type, rec.id1, rec.id2);
+        if ((e == NULL) || (e->off != at))
+            continue; /* superseded */
+        if (((e->flags & KV_REC_DELETED) != 0) &&
+                !kv_older_version(e, victim)) {
+            kv_blocks[victim].live -= KV_SPAN(0);
+            memset(e, 0, sizeof(*e));
+            continue;
+        }
+        /* Same sequence number: if the erase below is interrupted, both
+         * copies are found at boot and either one is current. */
+        if (kv_append(&rec, vault_base + at + KV_REC_SIZE, &to) != 0)
+            return -1;
+        kv_blocks[victim].live -= KV_SPAN(e->len);
+        e->off = to;
+        kv_blocks[kv_block_of(to)].live += KV_SPAN(e->len);
+        kv_stats.gc_bytes += KV_SPAN(e->len);
+    }
+    if (kv_block_erase(victim) != 0)
+        return -1;
+    kv_stats.gc_runs++;
+    return 0;
+}
+
+/* Make sure that a record of span bytes can be appended while keeping one
+ * free block for the garbage collector. */
+static int kv_make_room(uint32_t span)
+{
+    int i;
+
+    /* Retry the blocks whose erase failed */
+    for (i = 0; i < KV_BLOCKS; i++) {
+        if (kv_blocks[i].state == KV_BLOCK_DIRTY)
+            (void)kv_block_erase(i);
+    }
+    for (i = 0; i < 2 * KV_BLOCKS; i++) {
+        if ((kv_head >= 0) && (kv_blocks[kv_head].wr + span <= KV_BLOCK_SIZE))
+            return 0;
+        if (kv_free_blocks() > 1)
+            return 0;
+        if (kv_gc_one() != 0)
+            break;
+    }
+    return KEYVAULT_LOG_FULL;
+}
+
+static void kv_mount_record(int b, const struct kv_rec *rec, uint32_t at)
+{
+    struct kv_entry *e = kv_index_find(rec->type, rec->id1, rec->id2);
+    if (e == NULL) {
+        e = kv_index_alloc();
+        if (e == NULL)
+            return;
+    } else if ((e->seq > rec->seq) || ((e->seq == rec->seq) &&
+            (kv_blocks[kv_block_of(e->off)].gen > kv_blocks[b].gen))) {
+        return;
+    }
+    e->type = rec->type;
+    e->id1 = rec->id1;
+    e->id2 = rec->id2;
+    e->seq = rec->seq;
+    e->off = at;
+    e->len = rec->len;
+    e->flags = rec->flags;
+}
+
+static int kv_mount(void)
+{
+    struct kv_rec rec;
+    uint32_t off, at, val;
+    uint32_t max_erase = 0;
+    int b, i;
+
+    if (kv_mounted)
+        return 0;
+#ifndef UNIT_TEST
+    if (vault_size < KEYVAULT_LOG_SIZE)
+        return KEYVAULT_LOG_NOT_AVAILABLE;
+#endif
+    memset(kv_blocks, 0, sizeof(kv_blocks));
+    memset(kv_index, 0, sizeof(kv_index));
+    memset(&kv_stats, 0, sizeof(kv_stats));
+    kv_head = -1;
+    kv_seq = 0;
+    kv_gen = 0;
+
+    for (b = 0; b < KV_BLOCKS; b++) {
+        struct kv_block *blk = &kv_blocks[b];
+        off = kv_block_addr(b);
+        blk->state = KV_BLOCK_DIRTY;
+        if (!kv_slot_valid(off, KV_BLOCK_MAGIC, &val))
+            continue;
+        blk->erase_count = val;
+        if (val > max_erase)
+            max_erase = val;
+        if (kv_slot_valid(off + KV_SLOT_SIZE, KV_OPEN_MAGIC, &val)) {
+            blk->state = KV_BLOCK_USED;
+            blk->gen = val;
+            if (val > kv_gen)
+                kv_gen = val;
+        } else if (kv_is_erased(off + KV_SLOT_SIZE, KV_SLOT_SIZE)) {
+            blk->state = KV_BLOCK_FREE;
+            blk->wr = KV_BLOCK_HDR;
+        }
+    }
+
+    for (b = 0; b < KV_BLOCKS; b++) {
+        if (kv_blocks[b].state != KV_BLOCK_USED)
+            continue;
+        off = kv_block_addr(b) + KV_BLOCK_HDR;
+        while (kv_next_record(b, &off, &at, &rec))
+            kv_mount_record(b, &rec, at);
+        kv_blocks[b].wr = off - kv_block_addr(b);
+        if ((kv_head < 0) || (kv_blocks[b].gen > kv_blocks[kv_head].gen))
+            kv_head = b;
+    }
+    for (i = 0; i < KV_INDEX_SLOTS; i++) {
+        if (kv_index[i].seq != 0)
+            kv_blocks[kv_block_of(kv_index[i].off)].live +=
+                KV_SPAN(kv_index[i].len);
+    }
+
+    for (b = 0; b < KV_BLOCKS; b++) {
+        if (kv_blocks[b].state == KV_BLOCK_DIRTY) {
+            /* Blank, foreign or interrupted erase: the erase count is lost,
+             * assume the highest one. */
+            if (!kv_slot_valid(kv_block_addr(b), KV_BLOCK_MAGIC, &val))
+                kv_blocks[b].erase_count = max_erase;
+            if (kv_block_erase(b) != 0)
+                return KEYVAULT_LOG_NOT_AVAILABLE;
+        }
+    }
+    kv_mounted = 1;
+    return 0;
+}
+
+#ifdef UNIT_TEST
+/* Forget the RAM state, as after a reboot */
+static void kv_log_unmount(void)
+{
+    kv_mounted = 0;
+    kv_writer = NULL;
+    memset(kv_stage, 0, sizeof(kv_stage));
+    kv_stage_len = 0;
+    memset(kv_handles, 0, sizeof(kv_handles));
+}
+#endif
+
+static struct kv_handle *kv_handle_alloc(void)
+{
+    int i;
+    for (i = 0; i < MAX_OPEN_STORES; i++) {
+        if ((kv_handles[i].flags & KV_HANDLE_OPEN) == 0)
+            return &kv_handles[i];
+    }
+    return NULL;
+}
+
+static int kv_handle_valid(const struct kv_handle *h)
+{
+    return (h != NULL) && (h >= kv_handles) &&
+        (h < kv_handles + MAX_OPEN_STORES) &&
+        ((h->flags & KV_HANDLE_OPEN) != 0);
+}
+
+/* Live bytes after replacing the object with a version of len bytes */
+static uint32_t kv_live_after(const struct kv_handle *h, uint32_t len)
+{
+    const struct kv_entry *e = kv_index_find(h->type, h->id1, h->id2);
+    uint32_t live = kv_live_bytes() + KV_SPAN(len);
+    if (e != NULL)
+        live -= KV_SPAN(e->len);
+    return live;
+}
+
+/* Wipe the payload of the last writer */
+static void kv_stage_clear(void)
+{
+    volatile uint8_t *p = kv_stage;
+    uint32_t i;
+    for (i = 0; i < kv_stage_len; i++)
+        p[i] = 0;
+    kv_stage_len = 0;
+}
+
+int keyvault_log_open(int32_t type, uint32_t id1, uint32_t id2, int read,
+    void **store)
+{
+    struct kv_handle *h;
+    struct kv_entry *e;
+    int ret;
+
+    *store = NULL;
+    ret = kv_mount();
+    if (ret != 0)
+        return ret;
+    h = kv_handle_alloc();
+    if ((h == NULL) || (!read && (kv_writer != NULL)))
+        return KEYVAULT_LOG_SESSION_COUNT;
+
+    e = kv_index_find(type, id1, id2);
+    if ((e != NULL) && ((e->flags & KV_REC_DELETED) != 0) && read)
+        e = NULL;
+    if ((e == NULL) && read)
+        return KEYVAULT_LOG_NOT_AVAILABLE;
+
+    h->type = type;
+    h->id1 = id1;
+    h->id2 = id2;
+    h->pos = 0;
+    if (!read) {
+        if ((e == NULL) || ((e->flags & KV_REC_DELETED) != 0)) {
+            int i;
+            if (kv_index_objects() >= KEYVAULT_MAX_ITEMS)
+                return KEYVAULT_LOG_FULL;
+            /* Tombstones are released when the older versions are erased */
+            for (i = 0; (e == NULL) && (kv_index_alloc() == NULL) &&
+                    (i < KV_BLOCKS); i++) {
+                if (kv_gc_one() != 0)
+                    break;
+            }
+            if ((e == NULL) && (kv_index_alloc() == NULL))
+                return KEYVAULT_LOG_FULL;
+        }
+        /* Opening for writing truncates the object */
+        if (kv_live_after(h, 0) > KV_CAPACITY)
+            return KEYVAULT_LOG_FULL;
+        kv_stage_clear();
+        kv_writer = h;
+        h->flags = KV_HANDLE_OPEN | KV_HANDLE_WRITE;
+    } else {
+        h->seq = e->seq;
+        h->flags = KV_HANDLE_OPEN;
+    }
+    *store = h;
+    return 0;
+}
+
+/* Append the staged payload as the new version of the object */
+static int kv_commit(const struct kv_handle *h)
+{
+    struct kv_entry *e;
+    struct kv_rec rec;
+    uint32_t at;
+    int ret;
+
+    ret = kv_make_room(KV_SPAN(kv_stage_len));
+    if (ret != 0)
+        return ret;
+    e = kv_index_find(h->type, h->id1, h->id2);
+    if (e == NULL)
+        e = kv_index_alloc();
+    if (e == NULL)
+        return KEYVAULT_LOG_FULL;
+    memset(&rec, 0, sizeof(rec));
+    rec.seq = ++kv_seq;
+    rec.type = h->type;
+    rec.id1 = h->id1;
+    rec.id2 = h->id2;
+    rec.len = kv_stage_len;
+    ret = kv_append(&rec, kv_stage, &at);
+    if (ret == 0)
+        kv_index_set(e, &rec, at);
+    return ret;
+}
+
+void keyvault_log_close(void *store)
+{
+    struct kv_handle *h = store;
+    if (!kv_handle_valid(h))
+        return;
+    if ((h->flags & KV_HANDLE_WRITE) != 0) {
+        (void)kv_commit(h);
+        kv_stage_clear();
+        kv_writer = NULL;
+    }
+    memset(h, 0, sizeof(*h));
+}
+
+int keyvault_log_read(void *store, unsigned char *buffer, int len)
+{
+    struct kv_handle *h = store;
+    const uint8_t *src;
+    uint32_t size;
+
+    if (!kv_handle_valid(h) || (len < 0))
+        return -1;
+    if ((h->flags & KV_HANDLE_WRITE) != 0) {
+        src = kv_stage;
+        size = kv_stage_len;
+    } else {
+        const struct kv_entry *e = kv_index_find(h->type, h->id1, h->id2);
+        /* Removed or replaced since it was opened */
+        if ((e == NULL) || (e->seq != h->seq))
+            return -1;
+        src = vault_base + e->off + KV_REC_SIZE;
+        size = e->len;
+    }
+    if (h->pos >= size)
+        return 0; /* "EOF" */
+    if ((uint32_t)len > size - h->pos)
+        len = (int)(size - h->pos);
+    memcpy(buffer, src + h->pos, len);
+    h->pos += len;
+    return len;
+}
+
+int keyvault_log_write(void *store, const unsigned char *buffer, int len)
+{
+    struct kv_handle *h = store;
+
+    if (!kv_handle_valid(h) || ((h->flags & KV_HANDLE_WRITE) == 0) ||
+            (len < 0))
+        return -1;
+    if ((uint32_t)len > KEYVAULT_LOG_MAX_PAYLOAD - h->pos)
+        len = (int)(KEYVAULT_LOG_MAX_PAYLOAD - h->pos);
+    /* Collect now, so that the close does not fail */
+    if ((kv_live_after(h, h->pos + len) > KV_CAPACITY) ||
+            (kv_make_room(KV_SPAN(h->pos + len)) != 0))
+        return -1;
+    memcpy(kv_stage + h->pos, buffer, len);
+    h->pos += len;
+    kv_stage_len = h->pos;
+    return len;
+}
+
+int keyvault_log_remove(int32_t type, uint32_t id1, uint32_t id2)
+{
+    struct kv_entry *e;
+    struct kv_rec rec;
+    uint32_t at;
+    int ret;
+
+    ret = kv_mount();
+    if (ret != 0)
+        return ret;
+    e = kv_index_find(type, id1, id2);
+    if ((e == NULL) || ((e->flags & KV_REC_DELETED) != 0))
+        return KEYVAULT_LOG_NOT_AVAILABLE;
+    ret = kv_make_room(KV_SPAN(0));
+    if (ret != 0)
+        return ret;
+    memset(&rec, 0, sizeof(rec));
+    rec.seq = ++kv_seq;
+    rec.type = type;
+    rec.id1 = id1;
+    rec.id2 = id2;
+    rec.flags = KV_REC_DELETED;
+    ret = kv_append(&rec, NULL, &at);
+    if (ret == 0)
+        kv_index_set(e, &rec, at);
+    return ret;
+}
+
+int keyvault_log_get_stats(struct keyvault_log_stats *stats)
+{
+    int b, ret;
+
+    ret = kv_mount();
+    if (ret != 0)
+        return ret;
+    memcpy(stats, &kv_stats, sizeof(*stats));
+    stats->blocks = KV_BLOCKS;
+    stats->block_size = KV_BLOCK_SIZE;
+    stats->live_bytes = kv_live_bytes();
+    stats->capacity = KV_CAPACITY;
+    stats->min_erase_count = 0xFFFFFFFFUL;
+    stats->max_erase_count = 0;
+    for (b = 0; b < KV_BLOCKS; b++) {
+        if (kv_blocks[b].erase_count < stats->min_erase_count)
+            stats->min_erase_count = kv_blocks[b].erase_count;
+        if (kv_blocks[b].erase_count > stats->max_erase_count)
+            stats->max_erase_count = kv_blocks[b].erase_count;
+    }
+    return 0;
+}
+
+#endif /* WOLFBOOT_KEYVAULT_LOG */
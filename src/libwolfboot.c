@@ -261,6 +261,7 @@ static const uint32_t wolfboot_magic_trail = WOLFBOOT_MAGIC_TRAIL;
 
 #include <stddef.h>
 #include <string.h>
+#ifndef NVM_FLASH_LOG
 static uint8_t NVM_CACHE[NVM_CACHE_SIZE] XALIGNED(16);
 static int nvm_cached_sector = 0;
 
@@ -281,6 +282,7 @@ static uint8_t get_base_offset(uint8_t *base, uintptr_t off)
 {
     return *(uint8_t*)((uintptr_t)base - off); /* ignore array bounds error */
 }
+#endif /* !NVM_FLASH_LOG */
 
 void WEAKFUNCTION hal_cache_invalidate(void)
 {
@@ -289,6 +291,7 @@ void WEAKFUNCTION hal_cache_invalidate(void)
 #ifdef __CCRX__
 #pragma section FRAM
 #endif
+#ifndef NVM_FLASH_LOG
 static int RAMFUNCTION nvm_select_fresh_sector(int part)
 {
     int sel;
@@ -463,6 +466,323 @@ static int RAMFUNCTION partition_magic_write(uint8_t part, uintptr_t addr)
     nvm_cache_scrub();
     return ret;
 }
+#else /* NVM_FLASH_LOG */
+/* Log-structured trailer (NVM_FLASH_LOG).
+ *
+ * The two trailer sectors at the end of the partition are used as
+ * append-only logs of fixed-size records, instead of two copies of the
+ * trailer. Slot 0 of a sector holds a header with a generation counter:
+ * the sector with the highest valid generation is the active one.
+ *
+ *  | hdr: magic, gen | rec | rec | ... | rec | erased ... |
+ *
+ *  rec: | offset (LE16) | len | chk | value[4] | (padded to the record size)
+ *
+ * Changing a flag appends a record to the active sector: one program
+ * operation, no erase. When the active sector is full, the current trailer
+ * is written in compact form (one record per non-erased word) to the other
+ * sector, which becomes active when its header, programmed last, is valid.
+ * A compaction interrupted by a power failure leaves the previous
+ * generation active.
+ *
+ * The current trailer is kept in RAM and returned by get_trailer_at().
+ * Before each access the active header and the next free slot are checked,
+ * so a lookup costs two small reads; the end of the log is located with a
+ * binary search when the mirror has to be rebuilt (first access, or after
+ * the trailer sectors were erased).
+ */
+#if defined(EXT_ENCRYPTED) || (TRAILER_SKIP != 0)
+#error "NVM_FLASH_LOG needs the whole trailer sectors: not compatible with EXT_ENCRYPTED or TRAILER_SKIP"
+#endif
+
+#ifndef NVM_LOG_RECORD_SIZE
+#define NVM_LOG_RECORD_SIZE 8
+#endif
+#if (NVM_LOG_RECORD_SIZE < 8) || \
+    ((NVM_LOG_RECORD_SIZE & (NVM_LOG_RECORD_SIZE - 1)) != 0)
+#error "NVM_LOG_RECORD_SIZE must be a power of two, 8 or larger"
+#endif
+
+#ifndef NVM_LOG_TRAILER_SIZE
+/* Magic (4B) + state (1B) + sector flags, plus 8 bytes for the BOOT
+ * trailer that precedes the UPDATE one with FLAGS_HOME. */
+#define NVM_LOG_TRAILER_SIZE ((4 + 1 + 8 + 1 + \
+    (WOLFBOOT_PARTITION_UPDATE_SIZE / (2 * WOLFBOOT_SECTOR_SIZE)) + 3) & ~3)
+#endif
+
+#define NVM_LOG_SLOTS  (WOLFBOOT_SECTOR_SIZE / NVM_LOG_RECORD_SIZE)
+#define NVM_LOG_MAGIC  0x474C564EUL /* "NVLG" */
+
+#if ((NVM_LOG_TRAILER_SIZE / 4) + 2) > NVM_LOG_SLOTS
+#error "NVM_FLASH_LOG: the compacted trailer does not fit in one sector"
+#endif
+
+#ifdef FLAGS_HOME
+#define NVM_LOG_AREAS 1
+#else
+#define NVM_LOG_AREAS 2
+#endif
+
+struct nvm_log {
+    uint8_t trailer[NVM_LOG_TRAILER_SIZE]; /* mirror, ends at ENDFLAGS */
+    uint32_t gen;
+    uint16_t next;   /* first free slot in the active sector */
+    uint8_t sel;     /* active sector: 0 = last, 1 = the one before */
+    uint8_t active;  /* 0: no valid log, or the mirror must be reloaded */
+};
+
+static struct nvm_log nvm_logs[NVM_LOG_AREAS];
+
+static int RAMFUNCTION nvm_log_area(int part)
+{
+#ifdef FLAGS_HOME
+    (void)part;
+    return 0;
+#else
+    return (part == PART_BOOT) ? 0 : 1;
+#endif
+}
+
+static uintptr_t RAMFUNCTION nvm_log_endflags(int area)
+{
+    if (area == 0)
+        return PART_BOOT_ENDFLAGS;
+    return PART_UPDATE_ENDFLAGS;
+}
+
+static uintptr_t RAMFUNCTION nvm_log_sector(int area, int sel)
+{
+    uintptr_t top;
+    if (area == 0)
+        top = WOLFBOOT_PARTITION_BOOT_ADDRESS + WOLFBOOT_PARTITION_SIZE;
+    else
+        top = WOLFBOOT_PARTITION_UPDATE_ADDRESS +
+            WOLFBOOT_PARTITION_UPDATE_SIZE;
+    return top - (WOLFBOOT_SECTOR_SIZE * (uintptr_t)(sel + 1));
+}
+
+static const uint8_t* RAMFUNCTION nvm_log_slot(uintptr_t sector, int slot)
+{
+    return (const uint8_t *)(sector + (uintptr_t)slot * NVM_LOG_RECORD_SIZE);
+}
+
+static int RAMFUNCTION nvm_log_slot_erased(const uint8_t *p)
+{
+    int i;
+    for (i = 0; i < NVM_LOG_RECORD_SIZE; i++) {
+        if (p[i] != FLASH_BYTE_ERASED)
+            return 0;
+    }
+    return 1;
+}
+
+static uint8_t RAMFUNCTION nvm_log_chk(const uint8_t *rec)
+{
+    return (uint8_t)(0x5A ^ rec[0] ^ rec[1] ^ rec[2] ^ rec[4] ^ rec[5] ^
+        rec[6] ^ rec[7]);
+}
+
+static int RAMFUNCTION nvm_log_header(uintptr_t sector, uint32_t *gen)
+{
+    uint32_t hdr[2];
+    XMEMCPY(hdr, (void *)sector, sizeof(hdr));
+    if (hdr[0] != NVM_LOG_MAGIC)
+        return -1;
+    *gen = hdr[1];
+    return 0;
+}
+
+static void RAMFUNCTION nvm_log_apply(struct nvm_log *log, const uint8_t *rec)
+{
+    uint32_t off = rec[0] | ((uint32_t)rec[1] << 8);
+    uint8_t len = rec[2];
+
+    /* Records torn by a power failure are skipped */
+    if ((len == 0) || (len > 4) || (off + len > NVM_LOG_TRAILER_SIZE) ||
+            (rec[3] != nvm_log_chk(rec)))
+        return;
+    XMEMCPY(log->trailer + off, rec + 4, len);
+}
+
+/* Return the mirror of the trailer for 'part', up to date with the flash */
+static struct nvm_log* RAMFUNCTION nvm_log_sync(int part)
+{
+    int area = nvm_log_area(part);
+    struct nvm_log *log = &nvm_logs[area];
+    uintptr_t sector;
+    uint32_t gen[2];
+    int valid[2];
+    int lo, hi, mid, i;
+
+    hal_cache_invalidate();
+
+    if (log->active) {
+        sector = nvm_log_sector(area, log->sel);
+        if ((nvm_log_header(sector, &gen[0]) == 0) && (gen[0] == log->gen)) {
+            /* Pick up records appended since the last access */
+            while ((log->next < NVM_LOG_SLOTS) &&
+                    !nvm_log_slot_erased(nvm_log_slot(sector, log->next))) {
+                nvm_log_apply(log, nvm_log_slot(sector, log->next));
+                log->next++;
+            }
+            return log;
+        }
+    }
+
+    /* Rebuild the mirror from the newest valid sector */
+    XMEMSET(log->trailer, FLASH_BYTE_ERASED, sizeof(log->trailer));
+    log->active = 0;
+    log->gen = 0;
+    for (i = 0; i < 2; i++)
+        valid[i] = (nvm_log_header(nvm_log_sector(area, i), &gen[i]) == 0);
+    if (!valid[0] && !valid[1])
+        return log;
+    log->sel = (!valid[0] || (valid[1] && (gen[1] > gen[0]))) ? 1 : 0;
+    log->gen = gen[log->sel];
+    sector = nvm_log_sector(area, log->sel);
+
+    /* Records are appended in order: find the first erased slot */
+    lo = 1;
+    hi = NVM_LOG_SLOTS;
+    while (lo < hi) {
+        mid = lo + ((hi - lo) / 2);
+        if (nvm_log_slot_erased(nvm_log_slot(sector, mid)))
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    for (i = 1; i < lo; i++)
+        nvm_log_apply(log, nvm_log_slot(sector, i));
+    log->next = (uint16_t)lo;
+    log->active = 1;
+    return log;
+}
+
+static int RAMFUNCTION nvm_log_write_slot(uintptr_t sector, int slot,
+    uint32_t off, const uint8_t *val, uint8_t len)
+{
+    uint8_t rec[NVM_LOG_RECORD_SIZE];
+
+    XMEMSET(rec, FLASH_BYTE_ERASED, sizeof(rec));
+    rec[0] = (uint8_t)(off & 0xFF);
+    rec[1] = (uint8_t)(off >> 8);
+    rec[2] = len;
+    XMEMCPY(rec + 4, val, len);
+    rec[3] = nvm_log_chk(rec);
+    return hal_flash_write(sector + (uintptr_t)slot * NVM_LOG_RECORD_SIZE,
+        rec, NVM_LOG_RECORD_SIZE);
+}
+
+/* Write the whole mirror to the inactive sector and switch to it */
+static int RAMFUNCTION nvm_log_compact(int area, struct nvm_log *log)
+{
+    int sel = log->active ? !log->sel : 0;
+    uintptr_t sector = nvm_log_sector(area, sel);
+    uint8_t hdr[NVM_LOG_RECORD_SIZE];
+    uint32_t word;
+    uint32_t off;
+    int slot = 1;
+    int ret;
+
+    ret = hal_flash_erase(sector, WOLFBOOT_SECTOR_SIZE);
+    for (off = 0; (ret == 0) && (off < NVM_LOG_TRAILER_SIZE); off += 4) {
+        XMEMCPY(&word, log->trailer + off, sizeof(word));
+        if (word == FLASH_WORD_ERASED)
+            continue;
+        ret = nvm_log_write_slot(sector, slot++, off, log->trailer + off, 4);
+    }
+    if (ret == 0) {
+        /* Header last: the new generation is valid only when complete */
+        XMEMSET(hdr, FLASH_BYTE_ERASED, sizeof(hdr));
+        word = NVM_LOG_MAGIC;
+        XMEMCPY(hdr, &word, sizeof(word));
+        word = log->gen + 1;
+        XMEMCPY(hdr + 4, &word, sizeof(word));
+        ret = hal_flash_write(sector, hdr, NVM_LOG_RECORD_SIZE);
+    }
+    if (ret != 0) {
+        log->active = 0; /* reload from the flash at the next access */
+        return ret;
+    }
+    log->sel = (uint8_t)sel;
+    log->gen++;
+    log->next = (uint16_t)slot;
+    log->active = 1;
+    return 0;
+}
+
+static int RAMFUNCTION nvm_log_set(uint8_t part, uintptr_t addr,
+    const uint8_t *val, uint8_t len)
+{
+    int area = nvm_log_area(part);
+    struct nvm_log *log = nvm_log_sync(part);
+    uintptr_t base = nvm_log_endflags(area) - NVM_LOG_TRAILER_SIZE;
+    uint32_t off;
+    int ret;
+
+    if ((addr < base) || (addr + len > base + NVM_LOG_TRAILER_SIZE))
+        return -1;
+    off = (uint32_t)(addr - base);
+    if (XMEMCMP(log->trailer + off, val, len) == 0)
+        return 0;
+    XMEMCPY(log->trailer + off, val, len);
+    if (log->active && (log->next < NVM_LOG_SLOTS)) {
+        ret = nvm_log_write_slot(nvm_log_sector(area, log->sel), log->next,
+            off, val, len);
+        if (ret != 0) {
+            log->active = 0;
+            return ret;
+        }
+        log->next++;
+        return 0;
+    }
+    /* No log yet, or the active sector is full */
+    return nvm_log_compact(area, log);
+}
+
+static uint8_t* RAMFUNCTION nvm_log_get(uint8_t part, uintptr_t addr)
+{
+    static uint32_t erased_word;
+    int area = nvm_log_area(part);
+    struct nvm_log *log = nvm_log_sync(part);
+    uintptr_t base = nvm_log_endflags(area) - NVM_LOG_TRAILER_SIZE;
+
+    if ((addr < base) || (addr >= base + NVM_LOG_TRAILER_SIZE)) {
+        /* Outside of the trailer: reads as erased */
+        erased_word = FLASH_WORD_ERASED;
+        return (uint8_t *)&erased_word;
+    }
+    return log->trailer + (addr - base);
+}
+
+static int RAMFUNCTION trailer_write(uint8_t part, uintptr_t addr, uint8_t val)
+{
+    return nvm_log_set(part, addr, &val, 1);
+}
+
+static int RAMFUNCTION partition_magic_write(uint8_t part, uintptr_t addr)
+{
+    return nvm_log_set(part, addr, (const uint8_t *)&wolfboot_magic_trail,
+        sizeof(uint32_t));
+}
+
+/* Reset the UPDATE trailer (sector flags included) to IMG_STATE_UPDATING,
+ * with a single compaction. With FLAGS_HOME the BOOT trailer, above
+ * PART_UPDATE_ENDFLAGS, is preserved. */
+static int RAMFUNCTION nvm_log_update_trigger(void)
+{
+    int area = nvm_log_area(PART_UPDATE);
+    struct nvm_log *log = nvm_log_sync(PART_UPDATE);
+    uint32_t end = (uint32_t)(PART_UPDATE_ENDFLAGS -
+        (nvm_log_endflags(area) - NVM_LOG_TRAILER_SIZE));
+
+    XMEMSET(log->trailer, FLASH_BYTE_ERASED, end - sizeof(uint32_t) - 1);
+    log->trailer[end - sizeof(uint32_t) - 1] = IMG_STATE_UPDATING;
+    XMEMCPY(log->trailer + end - sizeof(uint32_t), &wolfboot_magic_trail,
+        sizeof(uint32_t));
+    return nvm_log_compact(area, log);
+}
+#endif /* NVM_FLASH_LOG */
 #ifdef __CCRX__
 #pragma section
 #endif
@@ -524,7 +844,9 @@ static void RAMFUNCTION set_partition_magic(uint8_t part)
 static uint8_t* RAMFUNCTION get_trailer_at(uint8_t part, uint32_t at)
 {
     uint8_t *ret = NULL;
+#ifndef NVM_FLASH_LOG
     uint32_t sel_sec = 0;
+#endif
 
     if (part == PART_BOOT) {
     #ifdef EXT_FLASH
@@ -537,11 +859,16 @@ static uint8_t* RAMFUNCTION get_trailer_at(uint8_t part, uint32_t at)
     #endif
         {
             /* only internal flash should be writeonce */
+        #if defined(NVM_FLASH_LOG)
+            ret = nvm_log_get(part,
+                    PART_BOOT_ENDFLAGS - (sizeof(uint32_t) + at));
+        #else
         #ifdef NVM_FLASH_WRITEONCE
             sel_sec = nvm_select_fresh_sector(part);
         #endif
             ret = (void *)(PART_BOOT_ENDFLAGS -
                     (WOLFBOOT_SECTOR_SIZE * sel_sec + (sizeof(uint32_t) + at)));
+        #endif
         }
     }
     else if (part == PART_UPDATE) {
@@ -555,11 +882,16 @@ static uint8_t* RAMFUNCTION get_trailer_at(uint8_t part, uint32_t at)
     #endif
         {
             /* only internal flash should be writeonce */
+        #if defined(NVM_FLASH_LOG)
+            ret = nvm_log_get(part,
+                    PART_UPDATE_ENDFLAGS - (sizeof(uint32_t) + at));
+        #else
         #ifdef NVM_FLASH_WRITEONCE
             sel_sec = nvm_select_fresh_sector(part);
         #endif
             ret = (void *)(PART_UPDATE_ENDFLAGS -
                     (WOLFBOOT_SECTOR_SIZE * sel_sec + (sizeof(uint32_t) + at)));
+        #endif
         }
     }
     return ret;
@@ -872,7 +1204,7 @@ void RAMFUNCTION wolfBoot_update_trigger(void)
 {
     uint8_t st = IMG_STATE_UPDATING;
     uintptr_t lastSector = ((PART_UPDATE_ENDFLAGS - 1) / WOLFBOOT_SECTOR_SIZE) * WOLFBOOT_SECTOR_SIZE;
-#ifdef NVM_FLASH_WRITEONCE
+#if defined(NVM_FLASH_WRITEONCE) && !defined(NVM_FLASH_LOG)
     uint8_t selSec = 0;
 #endif
 
@@ -894,6 +1226,9 @@ void RAMFUNCTION wolfBoot_update_trigger(void)
 #ifndef NVM_FLASH_WRITEONCE
         hal_flash_erase(lastSector, WOLFBOOT_SECTOR_SIZE);
         wolfBoot_set_partition_state(PART_UPDATE, st);
+#elif defined(NVM_FLASH_LOG)
+        (void)lastSector;
+        nvm_log_update_trigger();
 #else
         uint32_t magic = WOLFBOOT_MAGIC_TRAIL;
         uint32_t offset = SECTOR_FLAGS_SIZE;
@@ -953,6 +1288,10 @@ void RAMFUNCTION wolfBoot_success(void)
 #endif
 #endif /* WOLFBOOT_FIXED_PARTITIONS */
 
+#if defined(WOLFBOOT_BOOT_TIMING) && !defined(WOLFBOOT_PERSIST_FAILURE_STATUS)
+#error "WOLFBOOT_BOOT_TIMING requires WOLFBOOT_PERSIST_FAILURE_STATUS"
+#endif
+
 #ifdef WOLFBOOT_PERSIST_FAILURE_STATUS
 /* Persistent failure diagnostics.
  *
@@ -996,8 +1335,12 @@ void RAMFUNCTION wolfBoot_success(void)
                              (haladdr_t)(i) * DIAG_SECTOR_SIZE)
 
 #ifndef WOLFBOOT_DIAGNOSTICS_RECORD_SIZE
+#ifdef WOLFBOOT_BOOT_TIMING
+#define WOLFBOOT_DIAGNOSTICS_RECORD_SIZE 32U
+#else
 #define WOLFBOOT_DIAGNOSTICS_RECORD_SIZE 16U
 #endif
+#endif
 #define DIAG_HDR_SIZE       WOLFBOOT_DIAGNOSTICS_RECORD_SIZE
 #define DIAG_RECORD_SIZE    WOLFBOOT_DIAGNOSTICS_RECORD_SIZE
 #define DIAG_SLOTS_PER_SECTOR ((DIAG_SECTOR_SIZE - DIAG_HDR_SIZE) / DIAG_RECORD_SIZE)
@@ -1015,6 +1358,10 @@ typedef char diag_header_size_check[
     (sizeof(struct wolfBoot_diag_header) <= DIAG_HDR_SIZE) ? 1 : -1];
 typedef char diag_record_min_check[(DIAG_RECORD_SIZE >= 16U) ? 1 : -1];
 typedef char diag_slots_check[(DIAG_SLOTS_PER_SECTOR >= 1) ? 1 : -1];
+#ifdef WOLFBOOT_BOOT_TIMING
+typedef char diag_timing_size_check[
+    (sizeof(struct wolfBoot_timing_record) <= DIAG_RECORD_SIZE) ? 1 : -1];
+#endif
 
 static uint32_t RAMFUNCTION diag_crc32(const void *data, uint32_t len)
 {
@@ -1204,14 +1551,13 @@ static int RAMFUNCTION diag_slot_is_erased(haladdr_t sector_addr, int slot)
     return 1;
 }
 
-int RAMFUNCTION wolfBoot_record_failure(uint8_t phase, uint8_t cause,
-        uint8_t partition, uint32_t fw_version)
+/* Append a record to the active sector. slot holds the record padded with
+ * 0xFF to DIAG_RECORD_SIZE; its sequence number and CRC are filled in here. */
+static int RAMFUNCTION diag_append(uint8_t *slot)
 {
     uint32_t gen[DIAG_N_SECTORS];
     int count[DIAG_N_SECTORS];
-    struct wolfBoot_failure_record rec;
-    uint8_t slot[DIAG_RECORD_SIZE] XALIGNED_STACK(4);
-    uint32_t seq, active_gen;
+    uint32_t seq, crc, active_gen;
     int active, active_count, ret;
 
     diag_unlock();
@@ -1246,60 +1592,299 @@ int RAMFUNCTION wolfBoot_record_failure(uint8_t phase, uint8_t cause,
         active_count = 0;
     }
 
+    XMEMCPY(slot, &seq, sizeof(seq));
+    crc = diag_crc32(slot, 12);
+    XMEMCPY(slot + 12, &crc, sizeof(crc));
+    ret = diag_write(DIAG_SECTOR_ADDR(active) + DIAG_HDR_SIZE +
+            (uint32_t)active_count * DIAG_RECORD_SIZE, slot, DIAG_RECORD_SIZE);
+
+    diag_lock();
+    return ret;
+}
+
+int RAMFUNCTION wolfBoot_record_failure(uint8_t phase, uint8_t cause,
+        uint8_t partition, uint32_t fw_version)
+{
+    struct wolfBoot_failure_record rec;
+    uint8_t slot[DIAG_RECORD_SIZE] XALIGNED_STACK(4);
+
     XMEMSET(&rec, 0, sizeof(rec));
-    rec.seq = seq;
     rec.phase = phase;
     rec.cause = cause;
     rec.partition = partition;
     rec.fw_version = fw_version;
-    rec.crc = diag_crc32(&rec, 12);
 
     XMEMSET(slot, 0xFF, sizeof(slot));
     XMEMCPY(slot, &rec, sizeof(rec));
-    ret = diag_write(DIAG_SECTOR_ADDR(active) + DIAG_HDR_SIZE +
-            (uint32_t)active_count * DIAG_RECORD_SIZE, slot, DIAG_RECORD_SIZE);
+    return diag_append(slot);
+}
+
+#ifdef WOLFBOOT_BOOT_TIMING
+/* Boot timing.
+ *
+ * The time spent in each boot phase is accumulated in RAM during the boot
+ * and stored as a single record right before starting the application.
+ * Boots that installed an update are always recorded; other boots are
+ * sampled, one in WOLFBOOT_BOOT_TIMING_SAMPLE (0: never), to limit the wear
+ * of the diagnostics sectors.
+ *
+ * The timer value at the end of the boot is nearly the same on every cold
+ * boot, so the sampled boots are counted in flash instead: a boot-counter
+ * record (WOLFBOOT_FAILURE_PHASE_BOOT_COUNT) holds one bit per boot after its
+ * 16-byte header, cleared by reprogramming the byte, and a new counter record
+ * is appended when all its bits are used. Flash that cannot be reprogrammed
+ * without an erase (NVM_FLASH_WRITEONCE) cannot hold the counter: there, only
+ * the boots that installed an update are recorded, unless every boot is
+ * (WOLFBOOT_BOOT_TIMING_SAMPLE=1).
+ */
+#ifndef WOLFBOOT_BOOT_TIMING_SAMPLE
+#define WOLFBOOT_BOOT_TIMING_SAMPLE 16
+#endif
 
-    diag_lock();
-    return ret;
+#define DIAG_COUNT_BITS ((DIAG_RECORD_SIZE - 16U) * 8U)
+#if WOLFBOOT_BOOT_TIMING_SAMPLE > 1 && \
+    (!defined(NVM_FLASH_WRITEONCE) || DIAG_IS_EXT)
+#define DIAG_BOOT_COUNT
+#if WOLFBOOT_BOOT_TIMING_SAMPLE > DIAG_COUNT_BITS
+#error "WOLFBOOT_BOOT_TIMING_SAMPLE too large, raise WOLFBOOT_DIAGNOSTICS_RECORD_SIZE"
+#endif
+#endif
+
+static uint64_t timing_start[WOLFBOOT_TIMING_PHASES];
+static uint32_t timing_total[WOLFBOOT_TIMING_PHASES];
+static uint32_t timing_running;
+static uint8_t timing_flags;
+
+void RAMFUNCTION wolfBoot_timing_begin(int phase)
+{
+    if (phase < 0 || phase >= WOLFBOOT_TIMING_PHASES)
+        return;
+    timing_start[phase] = hal_get_timer_us();
+    timing_running |= (1U << phase);
+}
+
+void RAMFUNCTION wolfBoot_timing_end(int phase)
+{
+    uint64_t elapsed;
+
+    if (phase < 0 || phase >= WOLFBOOT_TIMING_PHASES ||
+            (timing_running & (1U << phase)) == 0)
+        return;
+    timing_running &= ~(1U << phase);
+    elapsed = hal_get_timer_us() - timing_start[phase];
+    if (elapsed > 0xFFFFFFFFUL - timing_total[phase])
+        timing_total[phase] = 0xFFFFFFFFUL;
+    else
+        timing_total[phase] += (uint32_t)elapsed;
+}
+
+void RAMFUNCTION wolfBoot_timing_flag(uint8_t flags)
+{
+    timing_flags |= flags;
+}
+
+#ifdef DIAG_BOOT_COUNT
+static int diag_find(int index, int kind,
+        struct wolfBoot_failure_record *rec, haladdr_t *addr);
+
+/* Count one more boot in the newest boot-counter record, appending a new
+ * record when there is none or when it is full. Returns the number of boots
+ * counted by that record, or -1 on error. */
+static int RAMFUNCTION diag_count_boot(void)
+{
+    struct wolfBoot_failure_record rec;
+    uint8_t slot[DIAG_RECORD_SIZE] XALIGNED_STACK(4);
+    uint8_t *bits = slot + sizeof(rec);
+    haladdr_t addr;
+    uint32_t n = 0, i;
+    int ret;
+
+    if (diag_find(0, -1, &rec, &addr) == 0 &&
+            diag_read(addr, slot, DIAG_RECORD_SIZE) == (int)DIAG_RECORD_SIZE) {
+        for (i = 0; i < DIAG_COUNT_BITS; i++) {
+            if ((bits[i / 8] & (1U << (i % 8))) == 0)
+                n++;
+        }
+        if (n < DIAG_COUNT_BITS) {
+            i = n / 8;
+            bits[i] &= (uint8_t)~(1U << (n % 8));
+            diag_unlock();
+            ret = diag_write(addr + sizeof(rec) + i, &bits[i], 1);
+            diag_lock();
+            return (ret == 0) ? (int)(n + 1) : -1;
+        }
+    }
+
+    XMEMSET(&rec, 0, sizeof(rec));
+    rec.phase = WOLFBOOT_FAILURE_PHASE_BOOT_COUNT;
+    XMEMSET(slot, 0xFF, sizeof(slot));
+    XMEMCPY(slot, &rec, sizeof(rec));
+    bits[0] = 0xFE;
+    return (diag_append(slot) == 0) ? 1 : -1;
+}
+#endif /* DIAG_BOOT_COUNT */
+
+/* Durations are stored on 16 bits: exact below 32768 us, otherwise a
+ * 4-bit exponent and the 12 most significant bits of the value (relative
+ * error below 0.05%, saturating after about 35 minutes). */
+static uint16_t timing_encode(uint32_t us)
+{
+    uint32_t e = 0;
+
+    if (us < 0x8000U)
+        return (uint16_t)us;
+    us >>= 4;
+    while (us >= 0x1000U) {
+        us >>= 1;
+        e++;
+    }
+    if (e > 15U)
+        return 0xFFFFU;
+    return (uint16_t)(0x8000U | (e << 11) | (us & 0x7FFU));
+}
+
+int RAMFUNCTION wolfBoot_timing_commit(uint8_t partition, uint32_t fw_version)
+{
+    struct wolfBoot_timing_record rec;
+    uint8_t slot[DIAG_RECORD_SIZE] XALIGNED_STACK(4);
+    uint64_t now = hal_get_timer_us();
+    int i;
+
+    if ((timing_flags & WOLFBOOT_TIMING_F_UPDATE) == 0) {
+#if defined(DIAG_BOOT_COUNT)
+        i = diag_count_boot();
+        if (i < 0 || (i % WOLFBOOT_BOOT_TIMING_SAMPLE) != 0)
+            return 0;
+#elif WOLFBOOT_BOOT_TIMING_SAMPLE != 1
+        return 0;
+#endif
+    }
+    timing_total[WOLFBOOT_TIMING_TOTAL] =
+        (now > 0xFFFFFFFFUL) ? 0xFFFFFFFFUL : (uint32_t)now;
+
+    XMEMSET(&rec, 0, sizeof(rec));
+    rec.phase = WOLFBOOT_FAILURE_PHASE_TIMING;
+    rec.flags = timing_flags;
+    rec.partition = partition;
+    rec.fw_version = fw_version;
+    for (i = 0; i < WOLFBOOT_TIMING_PHASES; i++)
+        rec.duration[i] = timing_encode(timing_total[i]);
+    rec.crc_duration = diag_crc32(rec.duration, sizeof(rec.duration));
+
+    XMEMSET(slot, 0xFF, sizeof(slot));
+    XMEMCPY(slot, &rec, sizeof(rec));
+    return diag_append(slot);
 }
+#endif /* WOLFBOOT_BOOT_TIMING */
 #endif /* __WOLFBOOT || UNIT_TEST */
 
-int wolfBoot_get_failure_count(void)
+/* Kind of a record: 1 for boot timing, 0 for failures, -1 for the boot
+ * counter, which is never returned. */
+static int diag_record_kind(uint8_t phase)
+{
+    if (phase == WOLFBOOT_FAILURE_PHASE_TIMING)
+        return 1;
+    if (phase == WOLFBOOT_FAILURE_PHASE_BOOT_COUNT)
+        return -1;
+    return 0;
+}
+
+/* Find the index-th newest record of one kind (see diag_record_kind()).
+ * On success the first 16 bytes of the record are in rec and its address in
+ * *addr. */
+static int diag_find(int index, int kind,
+        struct wolfBoot_failure_record *rec, haladdr_t *addr)
 {
     uint32_t gen[DIAG_N_SECTORS];
     int count[DIAG_N_SECTORS];
-    int active, i, total = 0;
-    diag_scan(gen, count, &active);
-    for (i = 0; i < DIAG_N_SECTORS; i++)
-        if (count[i] >= 0)
-            total += count[i];
-    return total;
+    int order[DIAG_N_SECTORS];
+    int k, i, slot;
+
+    if (index < 0)
+        return -1;
+    k = diag_ordered(order, gen, count);
+    for (i = k - 1; i >= 0; i--) {
+        haladdr_t sector_addr = DIAG_SECTOR_ADDR(order[i]);
+        for (slot = count[order[i]] - 1; slot >= 0; slot--) {
+            if (diag_read_record(sector_addr, slot, rec) != 0)
+                continue;
+            if (diag_record_kind(rec->phase) != kind)
+                continue;
+            if (index-- == 0) {
+                if (addr != NULL)
+                    *addr = sector_addr + DIAG_HDR_SIZE +
+                        (haladdr_t)slot * DIAG_RECORD_SIZE;
+                return 0;
+            }
+        }
+    }
+    return -1;
 }
 
-int wolfBoot_get_failure(int index, struct wolfBoot_failure_record *out)
+static int diag_count_records(int kind)
 {
     uint32_t gen[DIAG_N_SECTORS];
     int count[DIAG_N_SECTORS];
     int order[DIAG_N_SECTORS];
-    int k, i, total = 0, fwd;
+    struct wolfBoot_failure_record rec;
+    int k, i, slot, n = 0;
 
+    k = diag_ordered(order, gen, count);
+    for (i = 0; i < k; i++) {
+        for (slot = 0; slot < count[order[i]]; slot++) {
+            if (diag_read_record(DIAG_SECTOR_ADDR(order[i]), slot, &rec) == 0 &&
+                    diag_record_kind(rec.phase) == kind)
+                n++;
+        }
+    }
+    return n;
+}
+
+int wolfBoot_get_failure_count(void)
+{
+    return diag_count_records(0);
+}
+
+int wolfBoot_get_failure(int index, struct wolfBoot_failure_record *out)
+{
     if (out == NULL)
         return -1;
+    return diag_find(index, 0, out, NULL);
+}
 
-    k = diag_ordered(order, gen, count);
-    for (i = 0; i < k; i++)
-        total += count[order[i]];
-    if (index < 0 || index >= total)
+int wolfBoot_get_timing_count(void)
+{
+    return diag_count_records(1);
+}
+
+int wolfBoot_get_timing(int index, struct wolfBoot_timing_record *out)
+{
+    struct wolfBoot_failure_record rec;
+    haladdr_t addr;
+
+    if (out == NULL || sizeof(*out) > DIAG_RECORD_SIZE)
+        return -1;
+    if (diag_find(index, 1, &rec, &addr) != 0)
+        return -1;
+    if (diag_read(addr, out, sizeof(*out)) != (int)sizeof(*out))
         return -1;
+    /* The durations are not covered by the record CRC */
+    if (diag_crc32(out->duration, sizeof(out->duration)) != out->crc_duration)
+        return -1;
+    return 0;
+}
 
-    fwd = total - 1 - index;
-    for (i = 0; i < k; i++) {
-        int c = count[order[i]];
-        if (fwd < c)
-            return diag_read_record(DIAG_SECTOR_ADDR(order[i]), fwd, out);
-        fwd -= c;
-    }
-    return -1;
+uint32_t wolfBoot_timing_us(const struct wolfBoot_timing_record *rec,
+        int phase)
+{
+    uint32_t v;
+
+    if (rec == NULL || phase < 0 || phase >= WOLFBOOT_TIMING_PHASES)
+        return 0;
+    v = rec->duration[phase];
+    if ((v & 0x8000U) == 0)
+        return v;
+    return (0x800U | (v & 0x7FFU)) << (((v >> 11) & 0xFU) + 4U);
 }
 
 int wolfBoot_clear_failures(void)
@@ -1400,6 +1985,191 @@ uint16_t wolfBoot_find_header(uint8_t *haystack, uint16_t type, uint8_t **ptr)
     return 0;
 }
 
+#if defined(WOLFBOOT_IMG_CHUNKS_LAZY) && defined(WOLFBOOT_FIXED_PARTITIONS)
+#ifdef __WOLFBOOT
+/* Without an MPU driver in the HAL, unverified chunks cannot be kept from
+ * executing: wolfBoot then verifies the whole image before boot. */
+uintptr_t WEAKFUNCTION hal_lazy_xip_protect(uintptr_t start, uintptr_t end)
+{
+    (void)start;
+    (void)end;
+    return 0;
+}
+
+void WEAKFUNCTION hal_lazy_xip_reset(void)
+{
+}
+#endif
+
+#ifndef WOLFBOOT_IMG_CHUNKS_LAZY_PREFIX
+#define WOLFBOOT_IMG_CHUNKS_LAZY_PREFIX 0x4000
+#endif
+
+/* Lazy verification of the running image. Before boot, wolfBoot has
+ * authenticated the chunk table and verified the chunks in the first
+ * WOLFBOOT_IMG_CHUNKS_LAZY_PREFIX bytes of the firmware (all of them if the
+ * prefix is 0). The application verifies the others here, in order, so the
+ * verified part of the firmware is always a prefix. */
+static uint32_t lazy_next_chunk;
+static int lazy_started;
+static int lazy_failed;
+
+/* Called each time the verified prefix grows to [start, end). The default
+ * does nothing; override it to lift the execute-never protection set up by
+ * wolfBoot (see hal_lazy_xip_protect()) over the verified part. */
+void WEAKFUNCTION wolfBoot_lazy_xip_verified(uintptr_t start, uintptr_t end)
+{
+    (void)start;
+    (void)end;
+}
+
+/* Number of chunks of the image in PART_BOOT, 0 if it is not chunked */
+static uint32_t lazy_geometry(uint8_t **fw, uint32_t *fw_size,
+    uint32_t *chunk_sz)
+{
+    uint8_t *image = (uint8_t *)WOLFBOOT_PARTITION_BOOT_ADDRESS;
+    uint8_t *p = NULL;
+    uint32_t sz, csz, n;
+    const uint32_t max_sz = WOLFBOOT_PARTITION_SIZE - IMAGE_HEADER_SIZE;
+
+    if (*((uint32_t *)image) != WOLFBOOT_MAGIC)
+        return 0;
+    if (wolfBoot_find_header(image + IMAGE_HEADER_OFFSET, HDR_IMG_CHUNKS,
+            &p) != sizeof(uint32_t))
+        return 0;
+    sz = *((uint32_t *)(image + sizeof(uint32_t)));
+    csz = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+        ((uint32_t)p[3] << 24);
+    if ((sz == 0) || (csz == 0) || (sz > max_sz))
+        return 0;
+    n = ((sz - 1) / csz) + 1;
+    if (n > (max_sz - sz) / WOLFBOOT_SHA_DIGEST_SIZE)
+        return 0;
+    *fw = image + IMAGE_HEADER_SIZE;
+    *fw_size = sz;
+    *chunk_sz = csz;
+    return n;
+}
+
+static int lazy_verify_chunk(const uint8_t *fw, uint32_t fw_size,
+    uint32_t chunk_sz, uint32_t idx)
+{
+    wolfBoot_hash_t ctx;
+    uint8_t hash[WOLFBOOT_SHA_DIGEST_SIZE];
+    const uint8_t *expected = fw + fw_size + (idx * WOLFBOOT_SHA_DIGEST_SIZE);
+    uint32_t pos = idx * chunk_sz;
+    uint32_t len = fw_size - pos;
+    uint8_t diff = 0;
+    int i, ret;
+
+    if (len > chunk_sz)
+        len = chunk_sz;
+    ret = wolfBoot_hash_init(&ctx);
+    if (ret == 0)
+        ret = wolfBoot_hash_update(&ctx, fw + pos, len);
+    if (ret == 0)
+        ret = wolfBoot_hash_final(&ctx, hash);
+    wolfBoot_hash_free(&ctx);
+    if (ret != 0)
+        return -1;
+    for (i = 0; i < WOLFBOOT_SHA_DIGEST_SIZE; i++)
+        diff |= hash[i] ^ expected[i];
+    return (diff == 0) ? 0 : -1;
+}
+
+/* Skip the chunks that wolfBoot verified before boot */
+static void lazy_start(uint32_t n, uint32_t chunk_sz)
+{
+    uint32_t first = n;
+
+    if (lazy_started)
+        return;
+    lazy_started = 1;
+#if WOLFBOOT_IMG_CHUNKS_LAZY_PREFIX > 0
+    first = ((WOLFBOOT_IMG_CHUNKS_LAZY_PREFIX - 1) / chunk_sz) + 1;
+    if (first > n)
+        first = n;
+#else
+    (void)chunk_sz;
+#endif
+    lazy_next_chunk = first;
+}
+
+/**
+ * @brief Verify the next chunk of the running image.
+ *
+ * With IMG_CHUNKS_LAZY=1, wolfBoot only verifies the beginning of the boot
+ * image. The application calls this function, e.g. from its idle loop,
+ * until it returns 0. wolfBoot_lazy_xip_verified() is called after each
+ * chunk. Once a chunk has failed, all the following calls fail too.
+ *
+ * @return 1 if more chunks remain to be verified, 0 if the whole image has
+ * been verified, -1 if a chunk does not match its digest.
+ */
+int wolfBoot_lazy_verify_next(void)
+{
+    uint8_t *fw = NULL;
+    uint32_t fw_size = 0, chunk_sz = 0, n, end;
+
+    if (lazy_failed)
+        return -1;
+    n = lazy_geometry(&fw, &fw_size, &chunk_sz);
+    /* Not chunked: verified by wolfBoot as a whole */
+    if (n == 0)
+        return 0;
+    lazy_start(n, chunk_sz);
+    if (lazy_next_chunk >= n)
+        return 0;
+    if (lazy_verify_chunk(fw, fw_size, chunk_sz, lazy_next_chunk) != 0) {
+        lazy_failed = 1;
+        return -1;
+    }
+    lazy_next_chunk++;
+    end = fw_size;
+    if (lazy_next_chunk < n)
+        end = lazy_next_chunk * chunk_sz;
+    wolfBoot_lazy_xip_verified((uintptr_t)fw, (uintptr_t)fw + end);
+    return (lazy_next_chunk < n) ? 1 : 0;
+}
+
+/**
+ * @brief Verify the running image up to the end of a range.
+ *
+ * To be called before the first use of code or constant data in
+ * [addr, addr + len). Since the image is verified in order, all the chunks
+ * before the range are verified too, if they have not been yet.
+ *
+ * @param addr Start of the range, in the firmware of PART_BOOT.
+ * @param len Length of the range.
+ * @return 0 if the range has been verified, -1 if a chunk does not match or
+ * the range is not in the firmware.
+ */
+int wolfBoot_lazy_verify_range(uintptr_t addr, uint32_t len)
+{
+    uint8_t *fw = NULL;
+    uint32_t fw_size = 0, chunk_sz = 0, n, last;
+    int ret;
+
+    if (lazy_failed)
+        return -1;
+    n = lazy_geometry(&fw, &fw_size, &chunk_sz);
+    if (n == 0)
+        return 0;
+    if ((len == 0) || (addr < (uintptr_t)fw) ||
+            (addr - (uintptr_t)fw >= fw_size) ||
+            (len > fw_size - (uint32_t)(addr - (uintptr_t)fw)))
+        return -1;
+    last = (uint32_t)(addr - (uintptr_t)fw + len - 1) / chunk_sz;
+    lazy_start(n, chunk_sz);
+    while (lazy_next_chunk <= last) {
+        ret = wolfBoot_lazy_verify_next();
+        if (ret < 0)
+            return -1;
+    }
+    return 0;
+}
+#endif /* WOLFBOOT_IMG_CHUNKS_LAZY && WOLFBOOT_FIXED_PARTITIONS */
+
 #ifdef EXT_FLASH
 uint8_t hdr_cpy[IMAGE_HEADER_SIZE] XALIGNED(4);
 uint32_t hdr_cpy_done = 0;
@@ -2637,7 +3407,7 @@ int RAMFUNCTION ext_flash_encrypt_write(uintptr_t address, const uint8_t *data,
     uint8_t block[ENCRYPT_BLOCK_SIZE];
     uint8_t enc_block[ENCRYPT_BLOCK_SIZE];
     uint32_t row_address = address, row_offset;
-    int sz = len, i, step, ret;
+    int sz = len, step, ret;
     uint8_t part;
     uint32_t iv_counter = 0;
 #if defined(EXT_ENCRYPTED) && !defined(WOLFBOOT_SMALL_STACK) && \
@@ -2704,18 +3474,18 @@ int RAMFUNCTION ext_flash_encrypt_write(uintptr_t address, const uint8_t *data,
         sz = len - step;
     }
 
-    /* encrypt remainder, staging at most one cache worth at a time */
+    /* encrypt remainder, staging at most one cache worth at a time. Both
+     * ciphers are stream modes, so one call over the whole stage produces
+     * the same keystream as a call per block, without the per-block copy
+     * and call overhead. */
     ret = 0;
     step = sz & ~(ENCRYPT_BLOCK_SIZE - 1);
     while (step > 0) {
         int chunk = step;
         if (chunk > (int)ENCRYPT_STAGE_SIZE)
             chunk = (int)ENCRYPT_STAGE_SIZE;
-        for (i = 0; i < chunk / ENCRYPT_BLOCK_SIZE; i++) {
-            XMEMCPY(block, data + (ENCRYPT_BLOCK_SIZE * i), ENCRYPT_BLOCK_SIZE);
-            crypto_encrypt(ENCRYPT_CACHE + (ENCRYPT_BLOCK_SIZE * i), block,
-                ENCRYPT_BLOCK_SIZE);
-        }
+        if (crypto_encrypt(ENCRYPT_CACHE, (uint8_t *)data, chunk) != 0)
+            return -1;
         ret = ext_flash_write(address, ENCRYPT_CACHE, chunk);
         if (ret < 0)
             return ret;
@@ -2760,7 +3530,6 @@ int RAMFUNCTION ext_flash_decrypt_read(uintptr_t address, uint8_t *data, int len
     uint8_t  block[ENCRYPT_BLOCK_SIZE] XALIGNED_STACK(4);
     uint8_t  dec_block[ENCRYPT_BLOCK_SIZE] XALIGNED_STACK(4);
     uint32_t row_address = address, row_offset, iv_counter = 0;
-    int i;
     int flash_read_size;
     int read_remaining = len;
     int unaligned_head_size, unaligned_trailer_size;
@@ -2825,13 +3594,16 @@ int RAMFUNCTION ext_flash_decrypt_read(uintptr_t address, uint8_t *data, int len
     flash_read_size = read_remaining & ~(ENCRYPT_BLOCK_SIZE - 1);
     if (ext_flash_read(address, data, flash_read_size) != flash_read_size)
         return -1;
-    for (i = 0; i < flash_read_size / ENCRYPT_BLOCK_SIZE; i++)
-    {
-        XMEMCPY(block, data + (ENCRYPT_BLOCK_SIZE * i), ENCRYPT_BLOCK_SIZE);
-        crypto_decrypt(data + (ENCRYPT_BLOCK_SIZE * i), block,
-                ENCRYPT_BLOCK_SIZE);
-        iv_counter++;
+    /* Decrypt the aligned body in place with a single call: AES-CTR, ChaCha
+     * and PKCS#11 C_DecryptUpdate all accept in == out */
+    BOOT_TIMING_BEGIN(WOLFBOOT_TIMING_DECRYPT);
+    if ((flash_read_size > 0) &&
+            (crypto_decrypt(data, data, flash_read_size) != 0)) {
+        BOOT_TIMING_END(WOLFBOOT_TIMING_DECRYPT);
+        return -1;
     }
+    BOOT_TIMING_END(WOLFBOOT_TIMING_DECRYPT);
+    iv_counter += flash_read_size / ENCRYPT_BLOCK_SIZE;
 
     address += flash_read_size;
     data += flash_read_size;
@@ -2924,6 +3696,7 @@ int wolfBoot_ram_decrypt(uint8_t *src, uint8_t *dst)
 #endif
 
     /* decrypt content */
+    BOOT_TIMING_BEGIN(WOLFBOOT_TIMING_DECRYPT);
     while (dst_offset < (len + IMAGE_HEADER_SIZE)) {
         wolfBoot_crypto_set_iv(encrypt_iv_nonce, iv_counter);
         crypto_decrypt(dec_block, row_address, ENCRYPT_BLOCK_SIZE);
@@ -2932,6 +3705,7 @@ int wolfBoot_ram_decrypt(uint8_t *src, uint8_t *dst)
         dst_offset += ENCRYPT_BLOCK_SIZE;
         iv_counter++;
     }
+    BOOT_TIMING_END(WOLFBOOT_TIMING_DECRYPT);
     return 0;
 }
 #endif /* MMU */
@@ -0,0 +1,292 @@
+/* measure_log.c
+ *
+ * Boot-time measurement log.
+ *
+ * Each boot region (wolfBoot itself, the verified images) is hashed at most
+ * once per boot: the first consumer computes the digest and records it, the
+ * others (TPM measured boot, DICE claims and CDI, attestation token) read it
+ * back from the log. Image digests are recorded by the integrity check, so
+ * they never need to be computed again.
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "hal.h"
+#include "measure_log.h"
+
+#ifdef WOLFBOOT_MEASURE_LOG
+
+/* TCG PC Client event log */
+#define TCG_EV_NO_ACTION      0x00000003UL
+#define TCG_EV_POST_CODE      0x00000001UL
+#define TCG_EV_IPL            0x0000000DUL
+#define TCG_SPEC_ID_EVENT_SZ  33
+#define TCG_SPEC_ID_HDR_SZ    (4 + 4 + 20 + 4)
+
+static struct wolfBoot_mlog_entry mlog[WOLFBOOT_MLOG_MAX_ENTRIES];
+
+static struct wolfBoot_mlog_entry *mlog_find(uint32_t region)
+{
+    int i;
+
+    if (region == 0)
+        return NULL;
+    for (i = 0; i < WOLFBOOT_MLOG_MAX_ENTRIES; i++) {
+        if (mlog[i].region == region)
+            return &mlog[i];
+    }
+    return NULL;
+}
+
+static struct wolfBoot_mlog_entry *mlog_find_free(void)
+{
+    int i;
+
+    for (i = 0; i < WOLFBOOT_MLOG_MAX_ENTRIES; i++) {
+        if (mlog[i].region == 0)
+            return &mlog[i];
+    }
+    return NULL;
+}
+
+static int mlog_hash_region(uintptr_t addr, uint32_t size, uint8_t *digest)
+{
+    wolfBoot_hash_t ctx;
+    uint32_t pos = 0;
+    uint32_t chunk;
+    int ret;
+
+    ret = wolfBoot_hash_init(&ctx);
+    if (ret != 0)
+        return -1;
+    while ((ret == 0) && (pos < size)) {
+        chunk = WOLFBOOT_SHA_BLOCK_SIZE;
+        if (pos + chunk > size)
+            chunk = size - pos;
+#if defined(EXT_FLASH) && defined(NO_XIP)
+        {
+            uint8_t tmp[WOLFBOOT_SHA_BLOCK_SIZE];
+            if (ext_flash_read(addr + pos, tmp, chunk) != (int)chunk)
+                ret = -1;
+            else
+                ret = wolfBoot_hash_update(&ctx, tmp, chunk);
+        }
+#else
+        ret = wolfBoot_hash_update(&ctx, (const uint8_t *)(addr + pos), chunk);
+#endif
+        pos += chunk;
+    }
+    if (ret == 0)
+        ret = wolfBoot_hash_final(&ctx, digest);
+    wolfBoot_hash_free(&ctx);
+    return (ret == 0) ? 0 : -1;
+}
+
+int wolfBoot_mlog_record(uint32_t region, uintptr_t addr, uint32_t size,
+    const uint8_t *digest)
+{
+    struct wolfBoot_mlog_entry *e;
+
+    if (region == 0 || digest == NULL)
+        return -1;
+    e = mlog_find(region);
+    if (e == NULL)
+        e = mlog_find_free();
+    if (e == NULL)
+        return -1;
+    e->region = region;
+    e->pcr = WOLFBOOT_MLOG_NO_PCR;
+    e->addr = addr;
+    e->size = size;
+    e->alg = WOLFBOOT_MLOG_ALG;
+    e->digest_len = WOLFBOOT_SHA_DIGEST_SIZE;
+    memcpy(e->digest, digest, WOLFBOOT_SHA_DIGEST_SIZE);
+    return 0;
+}
+
+void wolfBoot_mlog_forget(uint32_t region)
+{
+    struct wolfBoot_mlog_entry *e = mlog_find(region);
+
+    if (e != NULL)
+        memset(e, 0, sizeof(*e));
+}
+
+const struct wolfBoot_mlog_entry *wolfBoot_mlog_get(uint32_t region)
+{
+    return mlog_find(region);
+}
+
+int wolfBoot_mlog_measure(uint32_t region, uintptr_t addr, uint32_t size,
+    uint8_t *digest)
+{
+    struct wolfBoot_mlog_entry *e;
+    uint8_t d[WOLFBOOT_SHA_DIGEST_SIZE];
+
+    if (digest == NULL)
+        return -1;
+    e = mlog_find(region);
+    if (e != NULL && e->addr == addr && e->size == size) {
+        memcpy(digest, e->digest, WOLFBOOT_SHA_DIGEST_SIZE);
+        return 0;
+    }
+    if (mlog_hash_region(addr, size, d) != 0)
+        return -1;
+    memcpy(digest, d, WOLFBOOT_SHA_DIGEST_SIZE);
+    /* A full log only costs a second hash later on */
+    (void)wolfBoot_mlog_record(region, addr, size, d);
+    return 0;
+}
+
+int wolfBoot_mlog_set_pcr(uint32_t region, uint32_t pcr)
+{
+    struct wolfBoot_mlog_entry *e = mlog_find(region);
+
+    if (e == NULL)
+        return -1;
+    e->pcr = pcr;
+    return 0;
+}
+
+void wolfBoot_mlog_reset(void)
+{
+    memset(mlog, 0, sizeof(mlog));
+}
+
+static uint8_t *put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+    return p + 4;
+}
+
+static uint8_t *put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static const char *mlog_region_name(uint32_t region)
+{
+    switch (region) {
+        case WOLFBOOT_MLOG_WOLFBOOT:
+            return "wolfBoot";
+        case WOLFBOOT_MLOG_BOOT_IMAGE:
+            return "boot-image";
+        case WOLFBOOT_MLOG_UPDATE_IMAGE:
+            return "update-image";
+        case WOLFBOOT_MLOG_BOOT_PARTITION:
+            return "boot-partition";
+        default:
+            return "region";
+    }
+}
+
+/* Only the digests extended into a PCR are events: replaying the log must
+ * give the PCR values */
+static int mlog_exported(const struct wolfBoot_mlog_entry *e)
+{
+    return (e->region != 0) && (e->pcr != WOLFBOOT_MLOG_NO_PCR);
+}
+
+int wolfBoot_mlog_export(uint8_t *buf, uint32_t *len)
+{
+    static const char spec_id[16] = "Spec ID Event03";
+    uint32_t need = TCG_SPEC_ID_HDR_SZ + TCG_SPEC_ID_EVENT_SZ;
+    uint32_t name_len;
+    uint8_t *p = buf;
+    int i;
+
+    if (len == NULL)
+        return -1;
+    for (i = 0; i < WOLFBOOT_MLOG_MAX_ENTRIES; i++) {
+        if (!mlog_exported(&mlog[i]))
+            continue;
+        name_len = (uint32_t)strlen(mlog_region_name(mlog[i].region)) + 1;
+        need += 4 + 4 + 4 + 2 + WOLFBOOT_SHA_DIGEST_SIZE + 4 + name_len;
+    }
+    if (buf == NULL) {
+        *len = need;
+        return 0;
+    }
+    if (*len < need)
+        return -1;
+
+    /* Header: TCG_PCR_EVENT carrying the TCG_EfiSpecIDEvent */
+    p = put_le32(p, 0);
+    p = put_le32(p, TCG_EV_NO_ACTION);
+    memset(p, 0, 20);
+    p += 20;
+    p = put_le32(p, TCG_SPEC_ID_EVENT_SZ);
+    memcpy(p, spec_id, sizeof(spec_id));
+    p += sizeof(spec_id);
+    p = put_le32(p, 0);                 /* platformClass */
+    *p++ = 0;                           /* specVersionMinor */
+    *p++ = 2;                           /* specVersionMajor */
+    *p++ = 0;                           /* specErrata */
+    *p++ = (sizeof(uintptr_t) == 8) ? 2 : 1; /* uintnSize */
+    p = put_le32(p, 1);                 /* numberOfAlgorithms */
+    p = put_le16(p, WOLFBOOT_MLOG_ALG);
+    p = put_le16(p, WOLFBOOT_SHA_DIGEST_SIZE);
+    *p++ = 0;                           /* vendorInfoSize */
+
+    /* One TCG_PCR_EVENT2 per entry, the region name as event data */
+    for (i = 0; i < WOLFBOOT_MLOG_MAX_ENTRIES; i++) {
+        const char *name;
+        if (!mlog_exported(&mlog[i]))
+            continue;
+        name = mlog_region_name(mlog[i].region);
+        name_len = (uint32_t)strlen(name) + 1;
+        p = put_le32(p, mlog[i].pcr);
+        p = put_le32(p, (mlog[i].region == WOLFBOOT_MLOG_WOLFBOOT) ?
+            TCG_EV_POST_CODE : TCG_EV_IPL);
+        p = put_le32(p, 1);
+        p = put_le16(p, mlog[i].alg);
+        memcpy(p, mlog[i].digest, WOLFBOOT_SHA_DIGEST_SIZE);
+        p += WOLFBOOT_SHA_DIGEST_SIZE;
+        p = put_le32(p, name_len);
+        memcpy(p, name, name_len);
+        p += name_len;
+    }
+    *len = need;
+    return 0;
+}
+
+#ifdef WOLFBOOT_MEASURE_LOG_ADDRESS
+#ifndef WOLFBOOT_MEASURE_LOG_SIZE
+#define WOLFBOOT_MEASURE_LOG_SIZE 1024
+#endif
+
+void wolfBoot_mlog_handoff(void)
+{
+    uint8_t *dst = (uint8_t *)(uintptr_t)(WOLFBOOT_MEASURE_LOG_ADDRESS);
+    uint32_t len = WOLFBOOT_MEASURE_LOG_SIZE - 4;
+
+    if (wolfBoot_mlog_export(dst + 4, &len) != 0)
+        len = 0;
+    put_le32(dst, len);
+}
+#endif
+
+#endif /* WOLFBOOT_MEASURE_LOG */
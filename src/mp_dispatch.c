@@ -0,0 +1,201 @@
+/* mp_dispatch.c
+ *
+ * Work dispatch to the secondary cores parked during boot.
+ *
+ * The boot core publishes a job (callback, argument, number of items) in a
+ * shared block, then rings each worker through its mailbox. The items are
+ * striped across lanes: lane 0 is the boot core, and each worker gets the
+ * lane stored in its mailbox, running items lane, lane + lanes, ...
+ * Workers acknowledge the job, then report completion and status. A worker
+ * that does not acknowledge (or complete) in time is marked offline and not
+ * used again; its lane is run by the boot core, so the job always completes,
+ * single-core in the worst case. The callbacks must be safe to run twice on
+ * the same item for that reason (e.g. hashing or verifying, not decrypting
+ * in place).
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#include <stdint.h>
+#include "hal.h"
+#include "mp_dispatch.h"
+#include "printf.h"
+
+#ifdef WOLFBOOT_MP_DISPATCH
+
+/* Polls of the mailbox before giving up on a worker */
+#ifndef WOLFBOOT_MP_ACK_TIMEOUT
+#define WOLFBOOT_MP_ACK_TIMEOUT  1000000U
+#endif
+#ifndef WOLFBOOT_MP_DONE_TIMEOUT
+#define WOLFBOOT_MP_DONE_TIMEOUT 0x40000000U
+#endif
+
+/* Pause between two polls of a mailbox */
+#ifndef WOLFBOOT_MP_RELAX
+#define WOLFBOOT_MP_RELAX() do {} while (0)
+#endif
+
+#define mp_fence() __sync_synchronize()
+
+static int mp_run_lane(wolfBoot_mp_work_fn fn, void *arg, uint32_t n,
+    uint32_t lane, uint32_t lanes, volatile uint32_t *active, uint32_t seq)
+{
+    uint32_t idx;
+    int ret = 0;
+
+    for (idx = lane; idx < n; idx += lanes) {
+        /* Stop if the job has been taken over by the boot core */
+        if ((active != NULL) && (*active != seq))
+            return -1;
+        if (fn(arg, idx) != 0)
+            ret = -1;
+    }
+    return ret;
+}
+
+static int mp_wait(volatile uint32_t *p, uint32_t seq, uint32_t timeout)
+{
+    uint32_t i;
+
+    for (i = 0; i < timeout; i++) {
+        if (*p == seq) {
+            mp_fence();
+            return 0;
+        }
+        WOLFBOOT_MP_RELAX();
+    }
+    return -1;
+}
+
+int wolfBoot_mp_run(wolfBoot_mp_work_fn fn, void *arg, uint32_t n)
+{
+    struct wolfBoot_mp_shared *sh = hal_mp_shared();
+    uint8_t lane_of[WOLFBOOT_MP_MAX_WORKERS + 1];
+    unsigned int workers, w;
+    uint32_t lanes = 1, lane, seq;
+    int ret = 0;
+
+    if (fn == NULL)
+        return -1;
+    workers = hal_mp_workers();
+    if (workers > WOLFBOOT_MP_MAX_WORKERS)
+        workers = WOLFBOOT_MP_MAX_WORKERS;
+    if (sh == NULL || n < 2)
+        workers = 0;
+
+    /* Assign a lane to each worker still answering */
+    for (w = 1; w <= workers; w++) {
+        lane_of[w] = 0;
+        if ((sh->offline & (1U << w)) == 0 && lanes < n)
+            lane_of[w] = (uint8_t)lanes++;
+    }
+    if (lanes == 1)
+        return mp_run_lane(fn, arg, n, 0, 1, NULL, 0);
+
+    seq = sh->seq + 1;
+    if (seq == 0)
+        seq = 1;
+    sh->seq = seq;
+    sh->fn = fn;
+    sh->arg = arg;
+    sh->n = n;
+    sh->lanes = lanes;
+    mp_fence();
+    sh->active = seq;
+    for (w = 1; w <= workers; w++) {
+        if (lane_of[w] == 0)
+            continue;
+        sh->mb[w - 1].lane = lane_of[w];
+        mp_fence();
+        sh->mb[w - 1].start = seq;
+        mp_fence();
+        hal_mp_kick(w);
+    }
+
+    /* Lane 0 on the boot core, then the barrier */
+    ret = mp_run_lane(fn, arg, n, 0, lanes, NULL, 0);
+    for (w = 1; w <= workers; w++) {
+        lane = lane_of[w];
+        if (lane == 0)
+            continue;
+        if ((mp_wait(&sh->mb[w - 1].ack, seq, WOLFBOOT_MP_ACK_TIMEOUT) != 0) ||
+            (mp_wait(&sh->mb[w - 1].done, seq,
+                WOLFBOOT_MP_DONE_TIMEOUT) != 0)) {
+            wolfBoot_printf("MP: worker %u not responding, running its "
+                "share locally\n", w);
+            sh->offline |= (1U << w);
+            if (mp_run_lane(fn, arg, n, lane, lanes, NULL, 0) != 0)
+                ret = -1;
+        }
+        else if (sh->mb[w - 1].status != 0) {
+            ret = -1;
+        }
+    }
+    /* Workers late on this job stop at their next item */
+    sh->active = 0;
+    mp_fence();
+    return ret;
+}
+
+int wolfBoot_mp_worker_poll(unsigned int w)
+{
+    struct wolfBoot_mp_shared *sh = hal_mp_shared();
+    struct wolfBoot_mp_mailbox *mb;
+    uint32_t seq;
+    int status;
+
+    if ((sh == NULL) || (w == 0) || (w > WOLFBOOT_MP_MAX_WORKERS))
+        return 0;
+    mb = &sh->mb[w - 1];
+    seq = mb->start;
+    if ((seq == 0) || (seq == mb->ack))
+        return 0;
+    mp_fence();
+    mb->ack = seq;
+    mp_fence();
+    if (sh->active != seq) {
+        status = -1;
+    }
+    else {
+        status = mp_run_lane(sh->fn, sh->arg, sh->n, mb->lane, sh->lanes,
+            &sh->active, seq);
+    }
+    mb->status = status;
+    mp_fence();
+    mb->done = seq;
+    mp_fence();
+    return 1;
+}
+
+#if defined(WOLFBOOT_IMG_CHUNKS) && defined(WOLFBOOT_IMG_CHUNKS_PARALLEL)
+#include "image.h"
+
+static int mp_verify_chunk(void *arg, uint32_t idx)
+{
+    return wolfBoot_verify_image_chunk((struct wolfBoot_image *)arg, idx);
+}
+
+int hal_verify_image_chunks(struct wolfBoot_image *img, uint32_t n)
+{
+    return wolfBoot_mp_run(mp_verify_chunk, img, n);
+}
+#endif
+
+#endif /* WOLFBOOT_MP_DISPATCH */
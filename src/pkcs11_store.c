@@ -77,6 +77,40 @@ void * _sbrk(unsigned int incr)
 }
 #endif
 
+#ifdef WOLFBOOT_KEYVAULT_LOG
+
+/* Log-structured vault, see keyvault_log.c */
+#include "keyvault_log.h"
+
+int wolfPKCS11_Store_Open(int type, CK_ULONG id1, CK_ULONG id2, int read,
+    void** store)
+{
+    return keyvault_log_open((int32_t)type, (uint32_t)id1, (uint32_t)id2,
+        read, store);
+}
+
+void wolfPKCS11_Store_Close(void* store)
+{
+    keyvault_log_close(store);
+}
+
+int wolfPKCS11_Store_Read(void* store, unsigned char* buffer, int len)
+{
+    return keyvault_log_read(store, buffer, len);
+}
+
+int wolfPKCS11_Store_Write(void* store, unsigned char* buffer, int len)
+{
+    return keyvault_log_write(store, buffer, len);
+}
+
+int wolfPKCS11_Store_Remove(int type, CK_ULONG id1, CK_ULONG id2)
+{
+    return keyvault_log_remove((int32_t)type, (uint32_t)id1, (uint32_t)id2);
+}
+
+#else
+
 struct obj_hdr
 {
     uint32_t token_id;
@@ -569,4 +603,6 @@ int wolfPKCS11_Store_Remove(int type, CK_ULONG id1, CK_ULONG id2)
     return 0;
 }
 
+#endif /* WOLFBOOT_KEYVAULT_LOG */
+
 #endif /* SECURE_PKCS11 */
@@ -76,6 +76,47 @@ void * _sbrk(unsigned int incr)
 }
 #endif
 
+#ifdef WOLFBOOT_KEYVAULT_LOG
+
+/* Log-structured vault, see keyvault_log.c */
+#include "keyvault_log.h"
+
+int wolfPSA_Store_Open(int type, unsigned long id1, unsigned long id2, int read,
+    void** store)
+{
+    return keyvault_log_open((int32_t)type, (uint32_t)id1, (uint32_t)id2,
+        read, store);
+}
+
+int wolfPSA_Store_OpenSz(int type, unsigned long id1, unsigned long id2, int read,
+    int variableSz, void** store)
+{
+    (void)variableSz;
+    return wolfPSA_Store_Open(type, id1, id2, read, store);
+}
+
+void wolfPSA_Store_Close(void* store)
+{
+    keyvault_log_close(store);
+}
+
+int wolfPSA_Store_Read(void* store, unsigned char* buffer, int len)
+{
+    return keyvault_log_read(store, buffer, len);
+}
+
+int wolfPSA_Store_Write(void* store, unsigned char* buffer, int len)
+{
+    return keyvault_log_write(store, buffer, len);
+}
+
+int wolfPSA_Store_Remove(int type, unsigned long id1, unsigned long id2)
+{
+    return keyvault_log_remove((int32_t)type, (uint32_t)id1, (uint32_t)id2);
+}
+
+#else
+
 struct obj_hdr
 {
     uint32_t token_id;
@@ -579,4 +620,6 @@ int wolfPSA_Store_Remove(int type, unsigned long id1, unsigned long id2)
     return 0;
 }
 
+#endif /* WOLFBOOT_KEYVAULT_LOG */
+
 #endif /* WOLFCRYPT_TZ_PSA */
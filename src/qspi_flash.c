@@ -25,6 +25,9 @@
 
 #include "spi_drv.h"
 #include "spi_flash.h"
+#ifdef SPI_FLASH_SFDP
+#include "sfdp.h"
+#endif
 
 #if defined(QSPI_FLASH) || defined(OCTOSPI_FLASH)
 
@@ -122,6 +125,25 @@
 #endif
 
 
+#ifdef SPI_FLASH_SFDP
+/* Parameters discovered at probe (JESD216), hardcoded values otherwise */
+static struct sfdp_info sfdp;
+static int sfdp_found;
+static uint32_t flash_size = FLASH_DEVICE_SIZE;
+static uint32_t page_size = FLASH_PAGE_SIZE;
+static uint8_t read_cmd = FLASH_READ_CMD;
+static uint8_t read_dummy = QSPI_DUMMY_READ;
+#if QSPI_DATA_MODE == QSPI_DATA_MODE_QSPI
+static uint8_t read_alt = 1;
+#endif
+#else
+#define flash_size FLASH_DEVICE_SIZE
+#define page_size  FLASH_PAGE_SIZE
+#define read_cmd   FLASH_READ_CMD
+#define read_dummy QSPI_DUMMY_READ
+#define read_alt   1
+#endif
+
 /* forward declarations */
 static int qspi_wait_ready(void);
 static int qspi_status(uint8_t* status);
@@ -256,11 +278,6 @@ static int qspi_wait_ready(void)
 }
 
 #if QSPI_DATA_MODE == QSPI_DATA_MODE_QSPI
-static int qspi_quad_enable(void)
-{
-    int ret;
-    uint8_t data[4]; /* size multiple of uint32_t */
-
 #ifndef QSPI_NO_SR2
     #define QE_SR_READ  READ_SR2_CMD
     #define QE_SR_BIT   FLASH_SR2_QE
@@ -271,18 +288,78 @@ static int qspi_quad_enable(void)
     #define QE_SR_WRITE WRITE_SR_CMD
 #endif
 
+#ifdef SPI_FLASH_SFDP
+/* Quad Enable Requirements 1, 4 and 5: QE is bit 1 of status register 2,
+ * written along with status register 1 by a two bytes WRSR */
+static int qspi_quad_enable_sr12(void)
+{
+    int ret;
+    uint8_t data[4]; /* size multiple of uint32_t */
+    uint8_t sr1 = 0;
+
+    memset(data, 0, sizeof(data));
+    ret = qspi_command_simple(QSPI_MODE_READ, READ_SR2_CMD, data, 1);
+    if (ret != 0 || (data[0] & FLASH_SR2_QE) != 0)
+        return ret;
+    ret = qspi_status(&sr1);
+    if (ret == 0)
+        ret = qspi_write_enable();
+    if (ret == 0) {
+        data[1] = data[0] | FLASH_SR2_QE;
+        data[0] = sr1;
+        ret = qspi_command_simple(QSPI_MODE_WRITE, WRITE_SR_CMD, data, 2);
+        qspi_wait_ready();
+        qspi_write_disable();
+    }
+    return ret;
+}
+#endif
+
+static int qspi_quad_enable(void)
+{
+    int ret;
+    uint8_t data[4]; /* size multiple of uint32_t */
+    uint8_t qe_sr_read = QE_SR_READ;
+    uint8_t qe_sr_bit = QE_SR_BIT;
+    uint8_t qe_sr_write = QE_SR_WRITE;
+
+#ifdef SPI_FLASH_SFDP
+    if (sfdp_found) {
+        switch (sfdp.quad_enable) {
+            case 0: /* no QE bit */
+                return 0;
+            case 1:
+            case 4:
+            case 5:
+                return qspi_quad_enable_sr12();
+            case 2: /* bit 6 of status register 1 */
+                qe_sr_read = READ_SR_CMD;
+                qe_sr_bit = FLASH_SR_QE;
+                qe_sr_write = WRITE_SR_CMD;
+                break;
+            case 6: /* bit 1 of status register 2, own read/write commands */
+                qe_sr_read = READ_SR2_CMD;
+                qe_sr_bit = FLASH_SR2_QE;
+                qe_sr_write = WRITE_SR2_CMD;
+                break;
+            default: /* not described: build configuration */
+                break;
+        }
+    }
+#endif
+
     memset(data, 0, sizeof(data));
-    ret = qspi_command_simple(QSPI_MODE_READ, QE_SR_READ, data, 1);
+    ret = qspi_command_simple(QSPI_MODE_READ, qe_sr_read, data, 1);
 #ifdef DEBUG_QSPI
     wolfBoot_printf("Status Reg: Ret %d, 0x%x (Quad Enabled: %s)\n",
-        ret, data[0], (data[0] & QE_SR_BIT) ? "Yes" : "No");
+        ret, data[0], (data[0] & qe_sr_bit) ? "Yes" : "No");
 #endif
-    if (ret == 0 && (data[0] & QE_SR_BIT) == 0) {
+    if (ret == 0 && (data[0] & qe_sr_bit) == 0) {
         ret = qspi_write_enable();
         if (ret == 0) {
             memset(data, 0, sizeof(data));
-            data[0] |= QE_SR_BIT;
-            ret = qspi_command_simple(QSPI_MODE_WRITE, QE_SR_WRITE, data, 1);
+            data[0] |= qe_sr_bit;
+            ret = qspi_command_simple(QSPI_MODE_WRITE, qe_sr_write, data, 1);
 #ifdef DEBUG_QSPI
             wolfBoot_printf("Setting Quad Enable: Ret %d, SR 0x%x\n",
                 ret, data[0]);
@@ -329,12 +406,73 @@ static int qspi_exit_4byte_addr(void)
 }
 #endif
 
+#ifdef SPI_FLASH_SFDP
+static int qspi_sfdp_read(uint32_t address, uint8_t *buf, uint32_t len)
+{
+    return qspi_transfer(QSPI_MODE_READ, SFDP_READ_CMD,
+        address, 3, QSPI_DATA_MODE_SPI,                    /* Address */
+        0, 0, QSPI_DATA_MODE_NONE,                         /* Alternate Bytes */
+        SFDP_READ_DUMMY,                                   /* Dummy */
+        buf, len, QSPI_DATA_MODE_SPI                       /* Data */
+    );
+}
+
+static void qspi_sfdp_probe(void)
+{
+#if QSPI_ADDR_SZ == 3 && QSPI_DATA_MODE != QSPI_DATA_MODE_SPI
+    const struct sfdp_read_mode *m;
+#endif
+
+    sfdp_found = (sfdp_probe(qspi_sfdp_read, &sfdp) == 0);
+    /* erase units must not exceed the sector size of the partitions */
+    if (sfdp_found && (sfdp.erase[0].size > FLASH_SECTOR_SIZE ||
+            (QSPI_ADDR_SZ == 3 && sfdp.addr_bytes != 3) ||
+            (QSPI_ADDR_SZ == 4 && !sfdp.addr4_supported)))
+        sfdp_found = 0;
+    if (!sfdp_found) {
+        wolfBoot_printf("QSPI SFDP: not found, using defaults\n");
+        return;
+    }
+    flash_size = sfdp.size;
+    page_size = sfdp.page_size;
+
+#if QSPI_ADDR_SZ == 3 && QSPI_DATA_MODE != QSPI_DATA_MODE_SPI
+    /* Opcode and cycles of the configured multi-line read */
+#if QSPI_DATA_MODE == QSPI_DATA_MODE_QSPI
+    m = &sfdp.read[(QSPI_ADDR_MODE == QSPI_DATA_MODE_QSPI) ?
+        SFDP_READ_1_4_4 : SFDP_READ_1_1_4];
+#else
+    m = &sfdp.read[(QSPI_ADDR_MODE == QSPI_DATA_MODE_DSPI) ?
+        SFDP_READ_1_2_2 : SFDP_READ_1_1_2];
+#endif
+    if (m->opcode != 0) {
+        read_cmd = m->opcode;
+        read_dummy = m->dummy + m->mode;
+#if QSPI_DATA_MODE == QSPI_DATA_MODE_QSPI
+        /* mode bits are sent as the alternate byte when they make one,
+         * otherwise clocked as dummy cycles */
+        read_alt = (m->mode *
+            ((QSPI_ADDR_MODE == QSPI_DATA_MODE_QSPI) ? 4 : 1) == 8);
+        if (read_alt)
+            read_dummy = m->dummy;
+#endif
+    }
+#endif
+    wolfBoot_printf("QSPI SFDP: %d KB, page %d, largest erase %d KB, "
+        "read 0x%x\n", (int)(flash_size >> 10), (int)page_size,
+        (int)(sfdp.erase[sfdp.n_erase - 1].size >> 10), read_cmd);
+}
+#endif
 
 uint16_t spi_flash_probe(void)
 {
     spi_init(0,0);
     qspi_flash_read_id(NULL, 0);
 
+#ifdef SPI_FLASH_SFDP
+    qspi_sfdp_probe();
+#endif
+
 #if QSPI_DATA_MODE == QSPI_DATA_MODE_QSPI
     qspi_quad_enable();
 #endif
@@ -350,23 +488,22 @@ uint16_t spi_flash_probe(void)
     return 0;
 }
 
-/* Called for each sector from hal.h inline ext_flash_erase function
- * Use SPI_FLASH_SECTOR_SIZE to adjust for QSPI sector size */
-int spi_flash_sector_erase(uint32_t address)
+static int qspi_erase_cmd(uint8_t cmd, uint32_t address)
 {
     int ret;
 
     ret = qspi_write_enable();
     if (ret == 0) {
         /* ------ Erase Flash ------ */
-        ret = qspi_transfer(QSPI_MODE_WRITE, SEC_ERASE_CMD,
+        ret = qspi_transfer(QSPI_MODE_WRITE, cmd,
             address, QSPI_ADDR_SZ, QSPI_DATA_MODE_SPI,     /* Address */
             0, 0, QSPI_DATA_MODE_NONE,                     /* Alternate Bytes */
             0,                                             /* Dummy */
             NULL, 0, QSPI_DATA_MODE_NONE                   /* Data */
         );
 #ifdef DEBUG_QSPI
-        wolfBoot_printf("QSPI Flash Erase: Ret %d, Address 0x%x\n", ret, address);
+        wolfBoot_printf("QSPI Flash Erase: Ret %d, Cmd 0x%x, Address 0x%x\n",
+            ret, cmd, address);
 #endif
         if (ret == 0) {
             ret = qspi_wait_ready(); /* Wait for not busy */
@@ -376,39 +513,64 @@ int spi_flash_sector_erase(uint32_t address)
     return ret;
 }
 
+/* Called for each sector from hal.h inline ext_flash_erase function
+ * Use SPI_FLASH_SECTOR_SIZE to adjust for QSPI sector size */
+int spi_flash_sector_erase(uint32_t address)
+{
+    return qspi_erase_cmd(SEC_ERASE_CMD, address);
+}
+
+#ifdef SPI_FLASH_SFDP
+int spi_flash_erase(uint32_t address, int len)
+{
+    uint32_t end = address + len;
+    int ret = 0;
+
+    if (len <= 0)
+        return 0;
+    if (sfdp_found)
+        return sfdp_erase_range(&sfdp, address, (uint32_t)len, qspi_erase_cmd);
+    for (address &= ~(FLASH_SECTOR_SIZE - 1); address < end && ret == 0;
+            address += FLASH_SECTOR_SIZE) {
+        ret = spi_flash_sector_erase(address);
+    }
+    return ret;
+}
+#endif
+
 int spi_flash_read(uint32_t address, void *data, int len)
 {
     int ret;
 #if QSPI_DATA_MODE == QSPI_DATA_MODE_QSPI
     const uint32_t altByte = 0xF0; /* enable continuous read */
-    uint32_t altSz = 1;
-    uint32_t altMode = QSPI_ADDR_MODE;
+    uint32_t altSz = read_alt ? 1 : 0;
+    uint32_t altMode = read_alt ? QSPI_ADDR_MODE : QSPI_DATA_MODE_NONE;
 #else
     const uint32_t altByte = 0x00;
     uint32_t altSz = 0;
     uint32_t altMode = QSPI_DATA_MODE_NONE;
 #endif
 
-    if ((len < 0) || (address >= FLASH_DEVICE_SIZE) ||
-            ((uint64_t)address + (uint32_t)len > FLASH_DEVICE_SIZE)) {
+    if ((len < 0) || (address >= flash_size) ||
+            ((uint64_t)address + (uint32_t)len > flash_size)) {
 #ifdef DEBUG_QSPI
         wolfBoot_printf("QSPI Flash Read: Invalid address (0x%x, len %d, max 0x%x)\n",
-            address, len, FLASH_DEVICE_SIZE);
+            address, len, flash_size);
 #endif
         return -1;
     }
 
     /* ------ Read Flash ------ */
-    ret = qspi_transfer(QSPI_MODE_READ, FLASH_READ_CMD,
+    ret = qspi_transfer(QSPI_MODE_READ, read_cmd,
         address, QSPI_ADDR_SZ, QSPI_ADDR_MODE,             /* Address */
         altByte, altSz, altMode,                           /* Alternate Bytes */
-        QSPI_DUMMY_READ,                                   /* Dummy */
+        read_dummy,                                        /* Dummy */
         data, len, QSPI_DATA_MODE                          /* Data */
     );
 
 #ifdef DEBUG_QSPI
     wolfBoot_printf("QSPI Flash Read: Ret %d, Cmd 0x%x, Len %d, 0x%x -> %p\n",
-        ret, FLASH_READ_CMD, len, address, data);
+        ret, read_cmd, len, address, data);
 #endif
 
     /* external flash read expects length returned */
@@ -428,11 +590,11 @@ int spi_flash_write(uint32_t address, const void *data, int len)
         len, data, address);
 #endif
 
-    if ((len < 0) || (address >= FLASH_DEVICE_SIZE) ||
-            ((uint64_t)address + (uint32_t)len > FLASH_DEVICE_SIZE)) {
+    if ((len < 0) || (address >= flash_size) ||
+            ((uint64_t)address + (uint32_t)len > flash_size)) {
 #ifdef DEBUG_QSPI
         wolfBoot_printf("QSPI Flash Write: Invalid address (0x%x, len %d, max 0x%x)\n",
-            address, len, FLASH_DEVICE_SIZE);
+            address, len, flash_size);
 #endif
         return -1;
     }
@@ -445,7 +607,7 @@ int spi_flash_write(uint32_t address, const void *data, int len)
             break;
         }
 
-        xferSz = FLASH_PAGE_SIZE - ((uint32_t)addr % FLASH_PAGE_SIZE);
+        xferSz = page_size - ((uint32_t)addr % page_size);
         if (xferSz > (uint32_t)remaining) {
             xferSz = (uint32_t)remaining;
         }
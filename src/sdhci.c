@@ -37,7 +37,7 @@
 /* ============================================================================
  * Platform DMA cache maintenance (weak defaults - override in HAL)
  * ============================================================================ */
-#ifndef SDHCI_SDMA_DISABLED
+#if !defined(SDHCI_SDMA_DISABLED) || defined(SDHCI_ADMA2)
 void __attribute__((weak)) sdhci_platform_dma_prepare(
     void *buf, uint32_t sz, int is_write)
 {
@@ -89,6 +89,26 @@ static int g_uhs_recovered = 0;
 static volatile uint32_t g_mmc_irq_status = 0;
 static volatile int g_mmc_irq_pending = 0;
 
+#ifdef SDHCI_ADMA2
+/* ADMA2 descriptor (32-bit address mode): attributes, 16-bit length
+ * (0 encodes 64KB) and the data address. The table is read by the
+ * controller, so it must be 4-byte aligned and below 4GB. */
+struct sdhci_adma2_desc {
+    uint16_t attr;
+    uint16_t len;
+    uint32_t addr;
+};
+static struct sdhci_adma2_desc g_adma2_desc[SDHCI_ADMA2_MAX_DESC]
+    __attribute__((aligned(8)));
+/* Set by sdhci_init() when the controller supports ADMA2, cleared after
+ * an ADMA2 failure so the rest of the boot uses SDMA/PIO */
+static int g_adma2_enabled = 0;
+/* Returned by sdhci_transfer() for a multi-block read that cannot be
+ * described by the descriptor table: the caller reads the blocks with
+ * sdhci_read_blocks() instead */
+#define SDHCI_ERR_ADMA2_NO_DESC (-2)
+#endif /* SDHCI_ADMA2 */
+
 /* Microsecond delay using hardware timer */
 static void udelay(uint32_t us)
 {
@@ -202,6 +222,9 @@ void sdhci_irq_handler(void)
     /* Check for any other errors */
     if (status & SDHCI_SRS12_EINT) {
         g_mmc_irq_status |= SDHCI_IRQ_FLAG_ERROR;
+        if (status & SDHCI_SRS12_EADMA) {
+            g_mmc_irq_status |= SDHCI_IRQ_FLAG_ADMA_ERR;
+        }
         /* Clear all error status bits */
         SDHCI_REG_SET(SDHCI_SRS12, (status & SDHCI_SRS12_ERR_STAT));
     }
@@ -1338,6 +1361,39 @@ static int emmc_card_full_init(void)
  * Data Transfer
  * ============================================================================ */
 
+#ifdef SDHCI_ADMA2
+/* Describe buf/sz with ADMA2 descriptors of up to 64KB each.
+ * Returns the number of descriptors used, or 0 if the buffer cannot be
+ * described (not 4-byte aligned, above 4GB, or too large for the table),
+ * in which case the caller uses SDMA/PIO instead. */
+static uint32_t sdhci_adma2_build(const uint32_t *buf, uint32_t sz)
+{
+    uint64_t addr = (uint64_t)(uintptr_t)buf;
+    uint32_t n = 0;
+
+    if ((addr % 4) != 0 || sz == 0 ||
+        (addr + sz - 1) > 0xFFFFFFFFULL ||
+        (((uint64_t)(uintptr_t)g_adma2_desc) +
+            sizeof(g_adma2_desc) - 1) > 0xFFFFFFFFULL ||
+        sz > (SDHCI_ADMA2_MAX_DESC * SDHCI_ADMA2_DESC_MAX_LEN)) {
+        return 0;
+    }
+    while (sz > 0) {
+        uint32_t len = (sz > SDHCI_ADMA2_DESC_MAX_LEN) ?
+            SDHCI_ADMA2_DESC_MAX_LEN : sz;
+        g_adma2_desc[n].attr = SDHCI_ADMA2_ATTR_VALID |
+            SDHCI_ADMA2_ATTR_ACT_TRAN;
+        g_adma2_desc[n].len = (uint16_t)len; /* 64KB wraps to 0 */
+        g_adma2_desc[n].addr = (uint32_t)addr;
+        addr += len;
+        sz -= len;
+        n++;
+    }
+    g_adma2_desc[n - 1].attr |= SDHCI_ADMA2_ATTR_END;
+    return n;
+}
+#endif /* SDHCI_ADMA2 */
+
 /* Transfer direction for sdhci_transfer() */
 #define SDHCI_DIR_READ  1
 #define SDHCI_DIR_WRITE 0
@@ -1355,6 +1411,9 @@ static int sdhci_transfer(int dir, uint32_t cmd_index, uint32_t block_addr,
     int status;
     uint32_t block_count, reg, cmd_reg, bcr_reg;
     int is_multi_block;
+#ifdef SDHCI_ADMA2
+    uint32_t adma2_desc_count = 0;
+#endif
 
     /* Determine if multi-block operation */
     is_multi_block = (dir == SDHCI_DIR_READ) ?
@@ -1416,6 +1475,44 @@ static int sdhci_transfer(int dir, uint32_t cmd_index, uint32_t block_addr,
     else if (is_multi_block) {
         cmd_reg |= SDHCI_SRS03_MSBS; /* enable multi-block select */
 
+    #ifdef SDHCI_ADMA2
+        if (g_adma2_enabled && sz >= SDHCI_DMA_THRESHOLD) {
+            adma2_desc_count = sdhci_adma2_build(buf, sz);
+        #ifdef SDHCI_FORCE_SINGLE_BLOCK_READ
+            /* Checked before CMD18 is issued: with SDMA/PIO, a multi-block
+             * read would bypass the single block read workaround */
+            if (adma2_desc_count == 0 && dir == SDHCI_DIR_READ) {
+                return SDHCI_ERR_ADMA2_NO_DESC;
+            }
+        #endif
+        }
+        if (adma2_desc_count > 0) {
+            cmd_reg |= SDHCI_SRS03_DMAE; /* enable DMA */
+
+            bcr_reg = (block_count << SDHCI_SRS01_BCCT_SHIFT) |
+                SDHCI_BLOCK_SIZE;
+
+            /* ADMA2 with 32-bit descriptors: Host Version 4 mode so the
+             * table address is taken from SRS22/SRS23, A64 cleared */
+            sdhci_reg_and(SDHCI_SRS10, ~SDHCI_SRS10_DMA_MASK);
+            sdhci_reg_or(SDHCI_SRS10, SDHCI_SRS10_DMA_ADMA2);
+            sdhci_reg_or(SDHCI_SRS15, SDHCI_SRS15_HV4E);
+            sdhci_reg_and(SDHCI_SRS15, ~SDHCI_SRS15_A64);
+
+            /* Platform DMA cache maintenance for the data and for the
+             * descriptor table, which the controller reads */
+            sdhci_platform_dma_prepare(buf, sz, dir == SDHCI_DIR_WRITE);
+            sdhci_platform_dma_prepare(g_adma2_desc,
+                adma2_desc_count * sizeof(g_adma2_desc[0]), 1);
+
+            /* Set ADMA2 descriptor table address */
+            SDHCI_REG_SET(SDHCI_SRS22, (uint32_t)(uintptr_t)g_adma2_desc);
+            SDHCI_REG_SET(SDHCI_SRS23, 0);
+
+            sdhci_enable_sdma_interrupts();
+        }
+        else
+    #endif /* SDHCI_ADMA2 */
     #ifndef SDHCI_SDMA_DISABLED
         if (sz >= SDHCI_DMA_THRESHOLD) { /* use DMA for large transfers */
             cmd_reg |= SDHCI_SRS03_DMAE; /* enable DMA */
@@ -1429,6 +1526,7 @@ static int sdhci_transfer(int dir, uint32_t cmd_index, uint32_t block_addr,
              * A64 is cleared in SRS15 to use 32-bit DMA addressing.
              * Note: Platform may redirect SRS22/SRS23 to SRS00 for legacy
              * SDMA on controllers that don't support HV4E. */
+            sdhci_reg_and(SDHCI_SRS10, ~SDHCI_SRS10_DMA_MASK);
             sdhci_reg_or(SDHCI_SRS10, SDHCI_SRS10_DMA_SDMA);
             sdhci_reg_or(SDHCI_SRS15, SDHCI_SRS15_HV4E);
             sdhci_reg_and(SDHCI_SRS15, ~SDHCI_SRS15_A64);
@@ -1462,7 +1560,21 @@ static int sdhci_transfer(int dir, uint32_t cmd_index, uint32_t block_addr,
         while (1) {
             status = sdhci_wait_irq(SDHCI_IRQ_FLAG_TC, 0x00FFFFFF);
             if (status != 0) {
-                wolfBoot_printf("sdhci_transfer: SDMA timeout/error\n");
+            #ifdef SDHCI_ADMA2
+                /* ADMA error or no completion at all: stop using ADMA2.
+                 * Card-side errors (CRC, data timeout) keep it enabled. */
+                if (adma2_desc_count > 0 &&
+                    ((g_mmc_irq_status & SDHCI_IRQ_FLAG_ADMA_ERR) ||
+                     !(g_mmc_irq_status & SDHCI_IRQ_FLAG_ERROR))) {
+                    wolfBoot_printf("sdhci_transfer: ADMA2 failed, "
+                        "using SDMA/PIO\n");
+                    g_adma2_enabled = 0;
+                }
+                else
+            #endif
+                {
+                    wolfBoot_printf("sdhci_transfer: SDMA timeout/error\n");
+                }
                 status = -1;
                 break;
             }
@@ -1473,10 +1585,10 @@ static int sdhci_transfer(int dir, uint32_t cmd_index, uint32_t block_addr,
         }
         sdhci_disable_sdma_interrupts();
 
-    #ifndef SDHCI_SDMA_DISABLED
+    #if !defined(SDHCI_SDMA_DISABLED) || defined(SDHCI_ADMA2)
         /* Platform DMA cache maintenance after transfer */
         sdhci_platform_dma_complete(buf, sz, dir == SDHCI_DIR_WRITE);
-    #endif /* !SDHCI_SDMA_DISABLED */
+    #endif
     }
     else {
         /* PIO (Programmed I/O) mode -- reads/writes data word-by-word via
@@ -1711,6 +1823,9 @@ int sdhci_init(void)
         reg |= SDHCI_SRS15_HV4E;
         SDHCI_REG_SET(SDHCI_SRS15, reg);
     }
+#ifdef SDHCI_ADMA2
+    g_adma2_enabled = (cap & SDHCI_SRS16_A2S) ? 1 : 0;
+#endif
     /* Set all status enables - 0xbff40ff */
     SDHCI_REG_SET(SDHCI_SRS13, (
         SDHCI_SRS13_ETUNE_SE | SDHCI_SRS13_EADMA_SE | SDHCI_SRS13_EAC_SE |
@@ -1815,6 +1930,60 @@ int sdhci_init(void)
  * disk.h Interface
  * ============================================================================ */
 
+/* Read full blocks to a 4-byte aligned buffer without ADMA2: one CMD18
+ * (SDMA or PIO), or a CMD17 per block with SDHCI_FORCE_SINGLE_BLOCK_READ */
+static int sdhci_read_blocks(uint32_t block_addr, uint8_t *buf,
+    uint32_t blocks)
+{
+    int status = 0;
+#if defined(SDHCI_FORCE_SINGLE_BLOCK_READ)
+    /* On Arasan/Cadence-family controllers (ZynqMP, Versal, MPFS)
+     * multi-block PIO reads (CMD18) suffer a documented BRR race
+     * (see CAUTION above) and SDMA does not restart cleanly across
+     * boundary crossings.  Force a sequence of CMD17 single-block
+     * reads instead - slower but reliable.  ~1024 reads of 512 B
+     * for one 512 KB chunk takes a few hundred ms. */
+    uint32_t i;
+#ifdef SDHCI_BLOCK_VIA_PDMA
+    /* 2-stage path for boards where direct CPU writes to the
+     * destination don't land (MPFS250 Video Kit): SDHCI PIO into a
+     * small staging buffer, then the platform copy hook lands each
+     * block at the final destination (e.g. via a DMA engine) with a
+     * read-back verify, returning < 0 if it cannot. */
+    static uint32_t sdhci_pdma_staging[SDHCI_BLOCK_SIZE / sizeof(uint32_t)];
+    for (i = 0; i < blocks && status == 0; i++) {
+        uint8_t *block_dst = buf + i * SDHCI_BLOCK_SIZE;
+        sdhci_platform_wdt_pet();
+        status = sdhci_read(MMC_CMD17_READ_SINGLE,
+            block_addr + i, sdhci_pdma_staging,
+            SDHCI_BLOCK_SIZE);
+        if (status != 0) {
+            continue;
+        }
+        if (sdhci_platform_block_copy(block_dst,
+                sdhci_pdma_staging, SDHCI_BLOCK_SIZE) != 0) {
+            wolfBoot_printf("SDHCI: block copy failed\n");
+            status = -1;
+        }
+    }
+#else
+    for (i = 0; i < blocks && status == 0; i++) {
+        uint8_t *block_dst = buf + i * SDHCI_BLOCK_SIZE;
+        status = sdhci_read(MMC_CMD17_READ_SINGLE,
+            block_addr + i,
+            (uint32_t*)block_dst,
+            SDHCI_BLOCK_SIZE);
+    }
+#endif
+#else
+    status = sdhci_read(blocks > 1 ?
+                        MMC_CMD18_READ_MULTIPLE :
+                        MMC_CMD17_READ_SINGLE,
+        block_addr, (uint32_t*)buf, blocks * SDHCI_BLOCK_SIZE);
+#endif
+    return status;
+}
+
 /* returns number of bytes read on success or negative on error */
 /* start may not be block aligned and count may not be block multiple */
 int disk_read(int drv, uint64_t start, uint32_t count, uint8_t *buf)
@@ -1879,56 +2048,31 @@ int disk_read(int drv, uint64_t start, uint32_t count, uint8_t *buf)
             /* direct full block(s) read */
             uint32_t blocks = (count / SDHCI_BLOCK_SIZE);
             read_sz = (blocks * SDHCI_BLOCK_SIZE);
-        #if defined(SDHCI_FORCE_SINGLE_BLOCK_READ)
-            /* On Arasan/Cadence-family controllers (ZynqMP, Versal, MPFS)
-             * multi-block PIO reads (CMD18) suffer a documented BRR race
-             * (see CAUTION above) and SDMA does not restart cleanly across
-             * boundary crossings.  Force a sequence of CMD17 single-block
-             * reads instead - slower but reliable.  ~1024 reads of 512 B
-             * for one 512 KB chunk takes a few hundred ms. */
-            uint32_t i;
-            status = 0;
-        #ifdef SDHCI_BLOCK_VIA_PDMA
-            /* 2-stage path for boards where direct CPU writes to the
-             * destination don't land (MPFS250 Video Kit): SDHCI PIO into a
-             * small staging buffer, then the platform copy hook lands each
-             * block at the final destination (e.g. via a DMA engine) with a
-             * read-back verify, returning < 0 if it cannot. */
-            {
-                static uint32_t sdhci_pdma_staging
-                    [SDHCI_BLOCK_SIZE / sizeof(uint32_t)];
-                for (i = 0; i < blocks && status == 0; i++) {
-                    uint8_t *block_dst = buf + i * SDHCI_BLOCK_SIZE;
-                    sdhci_platform_wdt_pet();
-                    status = sdhci_read(MMC_CMD17_READ_SINGLE,
-                        block_addr + i, sdhci_pdma_staging,
-                        SDHCI_BLOCK_SIZE);
-                    if (status != 0) {
-                        continue;
-                    }
-                    if (sdhci_platform_block_copy(block_dst,
-                            sdhci_pdma_staging, SDHCI_BLOCK_SIZE) != 0) {
-                        wolfBoot_printf("SDHCI: block copy failed\n");
-                        status = -1;
-                    }
+        #ifdef SDHCI_ADMA2
+            if (g_adma2_enabled && blocks > 1 &&
+                read_sz >= SDHCI_DMA_THRESHOLD) {
+                /* One CMD18 per descriptor table: the controller walks the
+                 * 64KB descriptors, so this also replaces the CMD17 loop of
+                 * SDHCI_FORCE_SINGLE_BLOCK_READ */
+                if (blocks > SDHCI_ADMA2_MAX_BLOCKS) {
+                    blocks = SDHCI_ADMA2_MAX_BLOCKS;
+                    read_sz = blocks * SDHCI_BLOCK_SIZE;
+                }
+                status = sdhci_read(MMC_CMD18_READ_MULTIPLE, block_addr,
+                    (uint32_t*)buf, read_sz);
+                if (status == SDHCI_ERR_ADMA2_NO_DESC) {
+                    /* Buffer not reachable by the descriptors */
+                    status = sdhci_read_blocks(block_addr, buf, blocks);
+                }
+                else if (status != 0 && !g_adma2_enabled) {
+                    continue; /* ADMA2 failed: retry chunk with SDMA/PIO */
                 }
             }
-        #else
-            for (i = 0; i < blocks && status == 0; i++) {
-                uint8_t *block_dst = buf + i * SDHCI_BLOCK_SIZE;
-                status = sdhci_read(MMC_CMD17_READ_SINGLE,
-                    block_addr + i,
-                    (uint32_t*)block_dst,
-                    SDHCI_BLOCK_SIZE);
-            }
-        #endif
-            read_sz = blocks * SDHCI_BLOCK_SIZE;
-        #else
-            status = sdhci_read(blocks > 1 ?
-                                MMC_CMD18_READ_MULTIPLE :
-                                MMC_CMD17_READ_SINGLE,
-                block_addr, (uint32_t*)buf, read_sz);
+            else
         #endif
+            {
+                status = sdhci_read_blocks(block_addr, buf, blocks);
+            }
         }
 #ifdef DISK_SDCARD
         if (status != 0 && !uhs_switched && sdhci_uhs_recover() == 0) {
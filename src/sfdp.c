@@ -0,0 +1,234 @@
+/* sfdp.c
+ *
+ * JEDEC Serial Flash Discoverable Parameters (JESD216) parser.
+ *
+ * Only the Basic Flash Parameter Table (BFPT) is used: device density,
+ * page size, the (up to four) erase types, the multi-line fast read modes
+ * and the Quad Enable requirements. The SFDP space is accessed through a
+ * callback, so that the same parser serves the SPI and QSPI drivers.
+ *
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "wolfboot/wolfboot.h"
+#include "sfdp.h"
+
+#define SFDP_HDR_SIZE       8
+#define SFDP_PHDR_SIZE      8
+#define SFDP_BFPT_ID_LSB    0x00
+#define SFDP_BFPT_ID_MSB    0xFF
+#define SFDP_BFPT_MIN_DW    9   /* JESD216 (rev 1.0) */
+#define SFDP_BFPT_MAX_DW    16  /* DWORDs used here (JESD216A and later) */
+#define SFDP_MAX_PHDRS      16
+
+static uint32_t sfdp_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+        ((uint32_t)p[3] << 24);
+}
+
+static void sfdp_read_mode(struct sfdp_read_mode *m, uint32_t half)
+{
+    m->dummy = (uint8_t)(half & 0x1F);
+    m->mode = (uint8_t)((half >> 5) & 0x07);
+    m->opcode = (uint8_t)(half >> 8);
+}
+
+static void sfdp_add_erase(struct sfdp_info *info, uint8_t size_pow,
+    uint8_t opcode)
+{
+    struct sfdp_erase_type e;
+    int i;
+
+    if (size_pow == 0 || size_pow >= 32 ||
+            info->n_erase >= SFDP_MAX_ERASE_TYPES)
+        return;
+    e.size = 1UL << size_pow;
+    e.opcode = opcode;
+    /* insertion, by increasing size */
+    i = info->n_erase;
+    while (i > 0 && info->erase[i - 1].size > e.size) {
+        info->erase[i] = info->erase[i - 1];
+        i--;
+    }
+    info->erase[i] = e;
+    info->n_erase++;
+}
+
+static int sfdp_parse_bfpt(const uint32_t *dw, uint32_t n_dw,
+    struct sfdp_info *info)
+{
+    uint32_t density;
+
+    /* DWORD 2: density in bits */
+    density = dw[1];
+    if (density & 0x80000000UL) {
+        density &= 0x7FFFFFFFUL;
+        if (density < 3 || density > 34)
+            return -1;
+        info->size = (uint32_t)(1ULL << (density - 3));
+    }
+    else {
+        info->size = (uint32_t)(((uint64_t)density + 1) / 8);
+    }
+    if (info->size == 0)
+        return -1;
+
+    /* DWORD 1: address bytes, supported fast read modes */
+    switch ((dw[0] >> 17) & 0x03) {
+        case 0:
+            info->addr_bytes = 3;
+            break;
+        case 1:
+            info->addr_bytes = 3;
+            info->addr4_supported = 1;
+            break;
+        case 2:
+            info->addr_bytes = 4;
+            info->addr4_supported = 1;
+            break;
+        default:
+            return -1;
+    }
+    if (dw[0] & (1UL << 16))
+        sfdp_read_mode(&info->read[SFDP_READ_1_1_2], dw[3] & 0xFFFF);
+    if (dw[0] & (1UL << 20))
+        sfdp_read_mode(&info->read[SFDP_READ_1_2_2], dw[3] >> 16);
+    if (dw[0] & (1UL << 21))
+        sfdp_read_mode(&info->read[SFDP_READ_1_4_4], dw[2] & 0xFFFF);
+    if (dw[0] & (1UL << 22))
+        sfdp_read_mode(&info->read[SFDP_READ_1_1_4], dw[2] >> 16);
+
+    /* DWORDs 8-9: erase types */
+    sfdp_add_erase(info, (uint8_t)dw[7], (uint8_t)(dw[7] >> 8));
+    sfdp_add_erase(info, (uint8_t)(dw[7] >> 16), (uint8_t)(dw[7] >> 24));
+    sfdp_add_erase(info, (uint8_t)dw[8], (uint8_t)(dw[8] >> 8));
+    sfdp_add_erase(info, (uint8_t)(dw[8] >> 16), (uint8_t)(dw[8] >> 24));
+    /* DWORD 1: 4 KB erase, for tables without erase types */
+    if (info->n_erase == 0 && (dw[0] & 0x03) == 0x01)
+        sfdp_add_erase(info, 12, (uint8_t)(dw[0] >> 8));
+    if (info->n_erase == 0)
+        return -1;
+
+    /* DWORD 11: page size (JESD216A) */
+    info->page_size = 256;
+    if (n_dw >= 11 && ((dw[10] >> 4) & 0x0F) != 0)
+        info->page_size = 1UL << ((dw[10] >> 4) & 0x0F);
+    /* DWORD 15: Quad Enable Requirements (JESD216A) */
+    if (n_dw >= 15)
+        info->quad_enable = (uint8_t)((dw[14] >> 20) & 0x07);
+    return 0;
+}
+
+int sfdp_probe(sfdp_read_cb read, struct sfdp_info *info)
+{
+    /* word aligned: some QSPI controllers transfer 32-bit words */
+    uint32_t hdr32[SFDP_HDR_SIZE / 4];
+    uint32_t phdr32[SFDP_PHDR_SIZE / 4];
+    uint32_t raw32[SFDP_BFPT_MAX_DW];
+    uint8_t *hdr = (uint8_t *)hdr32;
+    uint8_t *phdr = (uint8_t *)phdr32;
+    uint8_t *raw = (uint8_t *)raw32;
+    uint32_t dw[SFDP_BFPT_MAX_DW];
+    uint32_t n_phdr, i;
+    uint32_t bfpt_ptr = 0, bfpt_dw = 0;
+    int bfpt_minor = -1;
+
+    if (read == NULL || info == NULL)
+        return -1;
+    memset(info, 0, sizeof(*info));
+    if (read(0, hdr, SFDP_HDR_SIZE) != 0)
+        return -1;
+    if (sfdp_le32(hdr) != SFDP_SIGNATURE || hdr[5] != 1)
+        return -1;
+    n_phdr = (uint32_t)hdr[6] + 1;
+    if (n_phdr > SFDP_MAX_PHDRS)
+        n_phdr = SFDP_MAX_PHDRS;
+
+    /* Most recent BFPT revision supported by the device */
+    for (i = 0; i < n_phdr; i++) {
+        if (read(SFDP_HDR_SIZE + i * SFDP_PHDR_SIZE, phdr, SFDP_PHDR_SIZE) != 0)
+            return -1;
+        if (phdr[0] != SFDP_BFPT_ID_LSB || phdr[7] != SFDP_BFPT_ID_MSB ||
+                phdr[2] != 1 || (int)phdr[1] <= bfpt_minor)
+            continue;
+        if (phdr[3] < SFDP_BFPT_MIN_DW)
+            continue;
+        bfpt_minor = phdr[1];
+        bfpt_dw = phdr[3];
+        bfpt_ptr = sfdp_le32(phdr + 4) & 0x00FFFFFFUL;
+    }
+    if (bfpt_minor < 0)
+        return -1;
+    if (bfpt_dw > SFDP_BFPT_MAX_DW)
+        bfpt_dw = SFDP_BFPT_MAX_DW;
+    if (read(bfpt_ptr, raw, bfpt_dw * 4) != 0)
+        return -1;
+    for (i = 0; i < bfpt_dw; i++)
+        dw[i] = sfdp_le32(raw + i * 4);
+    if (sfdp_parse_bfpt(dw, bfpt_dw, info) != 0) {
+        memset(info, 0, sizeof(*info));
+        return -1;
+    }
+    return 0;
+}
+
+const struct sfdp_erase_type *RAMFUNCTION sfdp_erase_type_for(
+    const struct sfdp_info *info, uint32_t addr, uint32_t len)
+{
+    int i;
+
+    for (i = (int)info->n_erase - 1; i >= 0; i--) {
+        const struct sfdp_erase_type *e = &info->erase[i];
+        if (e->size <= len && (addr & (e->size - 1)) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+int RAMFUNCTION sfdp_erase_range(const struct sfdp_info *info, uint32_t addr,
+    uint32_t len, sfdp_erase_cb erase)
+{
+    const struct sfdp_erase_type *e;
+    uint32_t min, end;
+    int ret;
+
+    if (info->n_erase == 0)
+        return -1;
+    if (len == 0)
+        return 0;
+    min = info->erase[0].size;
+    end = addr + len;
+    if ((end & (min - 1)) != 0)
+        end = (end | (min - 1)) + 1;
+    addr &= ~(min - 1);
+    while (addr < end) {
+        e = sfdp_erase_type_for(info, addr, end - addr);
+        if (e == NULL)
+            return -1;
+        ret = erase(e->opcode, addr);
+        if (ret != 0)
+            return ret;
+        addr += e->size;
+    }
+    return 0;
+}
@@ -27,6 +27,9 @@
 #include "spi_flash.h"
 #include "printf.h"
 #include "string.h"
+#ifdef SPI_FLASH_SFDP
+#include "sfdp.h"
+#endif
 
 #ifdef SPI_FLASH
 
@@ -46,6 +49,7 @@
 #define SECTOR_ERASE    0x20
 #define CHIP_ERASE      0x60
 #define BYTE_READ       0x03
+#define FAST_READ       0x0B
 #define BYTE_WRITE      0x02
 #define AUTOINC         0xAD
 #define EWSR            0x50
@@ -61,34 +65,77 @@ static enum write_mode {
     SST_SINGLEBYTE = 0x01
 } chip_write_mode = WB_WRITEPAGE;
 
-static void RAMFUNCTION write_address(uint32_t address)
+#ifdef SPI_FLASH_SFDP
+/* Parameters discovered at probe (JESD216), hardcoded values otherwise */
+static struct sfdp_info sfdp;
+static int sfdp_found;
+static uint32_t page_size = SPI_FLASH_PAGE_SIZE;
+static uint8_t read_cmd = BYTE_READ;
+static uint8_t read_dummy_bytes = 0;
+#else
+#define page_size        SPI_FLASH_PAGE_SIZE
+#define read_cmd         BYTE_READ
+#define read_dummy_bytes 0
+#endif
+
+#define FLASH_CMD_HDR_MAX 5 /* opcode, 3 address bytes, 1 dummy byte */
+
+/* Generic bulk transfer, on top of the byte-level HAL. SPI drivers provide
+ * their own (FIFO or DMA based) implementation when available. */
+static int xfer_cs_held = 0;
+int RAMFUNCTION WEAKFUNCTION spi_xfer_buf(uint32_t base, int pin,
+    const uint8_t *tx, uint8_t *rx, uint32_t sz, int flags)
+{
+    uint32_t i;
+    uint8_t b;
+
+    if (!xfer_cs_held)
+        spi_cs_on(base, pin);
+    for (i = 0; i < sz; i++) {
+        spi_write((tx != NULL) ? (const char)tx[i] : (const char)0xFF);
+        b = spi_read();
+        if (rx != NULL)
+            rx[i] = b;
+    }
+    xfer_cs_held = (flags & SPI_XFER_FLAG_CONTINUE) ? 1 : 0;
+    if (!xfer_cs_held)
+        spi_cs_off(base, pin);
+    return 0;
+}
+
+static int RAMFUNCTION flash_xfer(const uint8_t *tx, uint8_t *rx, uint32_t sz,
+    int flags)
+{
+    return spi_xfer_buf(SPI_CS_PIO_BASE, SPI_CS_FLASH, tx, rx, sz, flags);
+}
+
+/* Send opcode, 24-bit address and dummy bytes. With SPI_XFER_FLAG_CONTINUE
+ * the data phase follows in the same transaction. */
+static int RAMFUNCTION flash_cmd_addr(uint8_t cmd, uint32_t address,
+    int dummy_bytes, int flags)
 {
-    spi_write((address & 0xFF0000) >> 16);
-    spi_read();
-    spi_write((address & 0xFF00) >> 8);
-    spi_read();
-    spi_write((address & 0xFF));
-    spi_read();
+    uint8_t hdr[FLASH_CMD_HDR_MAX];
+
+    hdr[0] = cmd;
+    hdr[1] = (uint8_t)((address & 0xFF0000) >> 16);
+    hdr[2] = (uint8_t)((address & 0xFF00) >> 8);
+    hdr[3] = (uint8_t)(address & 0xFF);
+    hdr[4] = 0xFF;
+    return flash_xfer(hdr, NULL, 4 + dummy_bytes, flags);
 }
 
 static uint8_t RAMFUNCTION read_status(void)
 {
-    uint8_t status;
-    spi_cs_on(SPI_CS_PIO_BASE, SPI_CS_FLASH);
-    spi_write(RDSR);
-    spi_read();
-    spi_write(0xFF);
-    status = spi_read();
-    spi_cs_off(SPI_CS_PIO_BASE, SPI_CS_FLASH);
-    return status;
+    uint8_t tx[2] = { RDSR, 0xFF };
+    uint8_t rx[2];
+
+    flash_xfer(tx, rx, sizeof(tx), SPI_XFER_FLAG_NONE);
+    return rx[1];
 }
 
 static void RAMFUNCTION spi_cmd(uint8_t cmd)
 {
-    spi_cs_on(SPI_CS_PIO_BASE, SPI_CS_FLASH);
-    spi_write(cmd);
-    spi_read();
-    spi_cs_off(SPI_CS_PIO_BASE, SPI_CS_FLASH);
+    flash_xfer(&cmd, NULL, 1, SPI_XFER_FLAG_NONE);
 }
 
 static void RAMFUNCTION flash_write_enable(void)
@@ -116,23 +163,21 @@ static void RAMFUNCTION wait_busy(void)
 static int RAMFUNCTION spi_flash_write_page(uint32_t address, const void *data, int len)
 {
     const uint8_t *buf = data;
-    int j = 0;
+    uint32_t chunk;
     if (len < 1)
         return -1;
     while (len > 0) {
+        /* one transaction per page: page program wraps at the boundary */
+        chunk = page_size - (address & (page_size - 1));
+        if (chunk > (uint32_t)len)
+            chunk = (uint32_t)len;
         wait_busy();
         flash_write_enable();
-        spi_cs_on(SPI_CS_PIO_BASE, SPI_CS_FLASH);
-        spi_write(BYTE_WRITE);
-        spi_read();
-        write_address(address);
-        do {
-            spi_write(buf[j++]);
-            address++;
-            spi_read();
-            len--;
-        } while (len > 0 && (address & (SPI_FLASH_PAGE_SIZE - 1)) != 0);
-        spi_cs_off(SPI_CS_PIO_BASE, SPI_CS_FLASH);
+        flash_cmd_addr(BYTE_WRITE, address, 0, SPI_XFER_FLAG_CONTINUE);
+        flash_xfer(buf, NULL, chunk, SPI_XFER_FLAG_NONE);
+        buf += chunk;
+        address += chunk;
+        len -= (int)chunk;
     }
     wait_busy();
     return 0;
@@ -149,13 +194,8 @@ static int RAMFUNCTION spi_flash_write_sb(uint32_t address, const void *data, in
         return -1;
     while (len > 0) {
         flash_write_enable();
-        spi_cs_on(SPI_CS_PIO_BASE, SPI_CS_FLASH);
-        spi_write(BYTE_WRITE);
-        spi_read();
-        write_address(address);
-        spi_write(buf[j]);
-        spi_read();
-        spi_cs_off(SPI_CS_PIO_BASE, SPI_CS_FLASH);
+        flash_cmd_addr(BYTE_WRITE, address, 0, SPI_XFER_FLAG_CONTINUE);
+        flash_xfer(&buf[j], NULL, 1, SPI_XFER_FLAG_NONE);
         wait_busy();
         spi_flash_read(address, &verify, 1);
         /* Check if the read value matches the written value */
@@ -177,23 +217,50 @@ static int RAMFUNCTION spi_flash_write_sb(uint32_t address, const void *data, in
     return 0;
 }
 
+#ifdef SPI_FLASH_SFDP
+static int spi_flash_sfdp_read(uint32_t address, uint8_t *buf, uint32_t len)
+{
+    wait_busy();
+    /* 8 dummy clocks */
+    flash_cmd_addr(SFDP_READ_CMD, address, 1, SPI_XFER_FLAG_CONTINUE);
+    return flash_xfer(NULL, buf, len, SPI_XFER_FLAG_NONE);
+}
+
+static void spi_flash_sfdp_probe(void)
+{
+    sfdp_found = (sfdp_probe(spi_flash_sfdp_read, &sfdp) == 0);
+    /* 3-byte addresses only; erase units must not exceed the sector size */
+    if (sfdp_found && (sfdp.addr_bytes != 3 ||
+            sfdp.erase[0].size > SPI_FLASH_SECTOR_SIZE))
+        sfdp_found = 0;
+    if (!sfdp_found) {
+        wolfBoot_printf("SPI SFDP: not found, using defaults\n");
+        return;
+    }
+    page_size = sfdp.page_size;
+    /* Fast read (JESD216 mandates 0Bh with 8 dummy clocks) */
+    read_cmd = FAST_READ;
+    read_dummy_bytes = 1;
+    wolfBoot_printf("SPI SFDP: %d KB, page %d, largest erase %d KB (0x%x)\n",
+        (int)(sfdp.size >> 10), (int)page_size,
+        (int)(sfdp.erase[sfdp.n_erase - 1].size >> 10),
+        sfdp.erase[sfdp.n_erase - 1].opcode);
+}
+#endif
+
 /* --- */
 
 uint16_t spi_flash_probe(void)
 {
-    uint8_t manuf, product, notused;
+    uint8_t tx[3] = { MDID, 0xFF, 0xFF };
+    uint8_t rx[3];
+    uint8_t manuf, product;
     uint16_t manuf_prod;
-    int i;
     spi_init(0,0);
     wait_busy();
-    spi_cs_on(SPI_CS_PIO_BASE, SPI_CS_FLASH);
-    spi_write(MDID);
-    notused = spi_read();
-    spi_write(0xFF);
-    manuf = spi_read();
-    spi_write(0xFF);
-    product = spi_read();
-    spi_cs_off(SPI_CS_PIO_BASE, SPI_CS_FLASH);
+    flash_xfer(tx, rx, sizeof(tx), SPI_XFER_FLAG_NONE);
+    manuf = rx[1];
+    product = rx[2];
     if (manuf == 0xBF || manuf == 0xC2)
         chip_write_mode = SST_SINGLEBYTE;
     if (manuf == 0xEF)
@@ -202,12 +269,9 @@ uint16_t spi_flash_probe(void)
 #ifndef READONLY
     wait_busy();
     flash_write_enable();
-    spi_cs_on(SPI_CS_PIO_BASE, SPI_CS_FLASH);
-    spi_write(WRSR);
-    spi_read();
-    spi_write(0x00);
-    spi_read();
-    spi_cs_off(SPI_CS_PIO_BASE, SPI_CS_FLASH);
+    tx[0] = WRSR;
+    tx[1] = 0x00;
+    flash_xfer(tx, NULL, 2, SPI_XFER_FLAG_NONE);
     wait_busy();
     flash_write_disable();
 #endif
@@ -215,6 +279,10 @@ uint16_t spi_flash_probe(void)
     wolfBoot_printf("SPI Probe: Manuf 0x%x, Product 0x%x\n", manuf, product);
     manuf_prod = (uint16_t)(manuf << 8) | (uint16_t)product;
 
+#ifdef SPI_FLASH_SFDP
+    spi_flash_sfdp_probe();
+#endif
+
 #ifdef SPI_FLASH_CHIP_ERASE
     spi_flash_chip_erase();
 #endif
@@ -226,52 +294,60 @@ uint16_t spi_flash_probe(void)
     return manuf_prod;
 }
 
-
-int RAMFUNCTION spi_flash_sector_erase(uint32_t address)
+static int RAMFUNCTION spi_flash_erase_cmd(uint8_t cmd, uint32_t address)
 {
-    address &= (~(SPI_FLASH_SECTOR_SIZE - 1));
-
     wait_busy();
     flash_write_enable();
     wait_busy();
-    spi_cs_on(SPI_CS_PIO_BASE, SPI_CS_FLASH);
-    spi_write(SECTOR_ERASE);
-    spi_read();
-    write_address(address);
-    spi_cs_off(SPI_CS_PIO_BASE, SPI_CS_FLASH);
+    flash_cmd_addr(cmd, address, 0, SPI_XFER_FLAG_NONE);
     wait_busy();
     return 0;
 }
 
+int RAMFUNCTION spi_flash_sector_erase(uint32_t address)
+{
+    address &= (~(SPI_FLASH_SECTOR_SIZE - 1));
+    return spi_flash_erase_cmd(SECTOR_ERASE, address);
+}
+
+#ifdef SPI_FLASH_SFDP
+int RAMFUNCTION spi_flash_erase(uint32_t address, int len)
+{
+    uint32_t end = address + len;
+    int ret = 0;
+
+    if (len <= 0)
+        return 0;
+    if (sfdp_found)
+        return sfdp_erase_range(&sfdp, address, (uint32_t)len,
+            spi_flash_erase_cmd);
+    for (address &= ~(SPI_FLASH_SECTOR_SIZE - 1); address < end && ret == 0;
+            address += SPI_FLASH_SECTOR_SIZE) {
+        ret = spi_flash_sector_erase(address);
+    }
+    return ret;
+}
+#endif
+
 int RAMFUNCTION spi_flash_chip_erase(void)
 {
     wait_busy();
     flash_write_enable();
     wait_busy();
-    spi_cs_on(SPI_CS_PIO_BASE, SPI_CS_FLASH);
-    spi_write(CHIP_ERASE);
-    spi_read();
-    spi_cs_off(SPI_CS_PIO_BASE, SPI_CS_FLASH);
+    spi_cmd(CHIP_ERASE);
     wait_busy();
     return 0;
 }
 
 int RAMFUNCTION spi_flash_read(uint32_t address, void *data, int len)
 {
-    uint8_t *buf = data;
-    int i = 0;
+    if (len < 0)
+        return -1;
     wait_busy();
-    spi_cs_on(SPI_CS_PIO_BASE, SPI_CS_FLASH);
-    spi_write(BYTE_READ);
-    spi_read();
-    write_address(address);
-    while (len > 0) {
-        spi_write(0xFF);
-        buf[i++] = spi_read();
-        len--;
-    }
-    spi_cs_off(SPI_CS_PIO_BASE, SPI_CS_FLASH);
-    return i;
+    /* whole range in one transaction */
+    flash_cmd_addr(read_cmd, address, read_dummy_bytes, SPI_XFER_FLAG_CONTINUE);
+    flash_xfer(NULL, data, (uint32_t)len, SPI_XFER_FLAG_NONE);
+    return len;
 }
 
 int RAMFUNCTION spi_flash_write(uint32_t address, const void *data, int len)
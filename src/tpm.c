@@ -31,6 +31,7 @@
 #include "printf.h"
 #include "spi_drv.h"
 #include "tpm.h"
+#include "measure_log.h"
 #include "wolftpm/tpm2_tis.h" /* for TIS header size and wait state */
 
 WOLFTPM2_DEV     wolftpm_dev;
@@ -243,6 +244,7 @@ static int TPM2_IoCb(TPM2_CTX* ctx, const uint8_t* txBuf, uint8_t* rxBuf,
     #ifndef WOLFBOOT_NO_PARTITIONS
         #define SELF_HASH_ADDR  ((uintptr_t)WOLFBOOT_PARTITION_BOOT_ADDRESS)
         #define SELF_HASH_SZ    ((uint32_t)WOLFBOOT_PARTITION_SIZE)
+        #define SELF_HASH_REGION WOLFBOOT_MLOG_BOOT_PARTITION
     #endif
 #elif defined(ARCH_SIM)
     /* Simulator: no linker script, use bootloader partition region */
@@ -250,6 +252,7 @@ static int TPM2_IoCb(TPM2_CTX* ctx, const uint8_t* txBuf, uint8_t* rxBuf,
         #define SELF_HASH_ADDR  ((uintptr_t)ARCH_FLASH_OFFSET)
         #define SELF_HASH_SZ    ((uint32_t)((uintptr_t)WOLFBOOT_PARTITION_BOOT_ADDRESS - \
                                             (uintptr_t)ARCH_FLASH_OFFSET))
+        #define SELF_HASH_REGION WOLFBOOT_MLOG_WOLFBOOT
     #endif
 #elif defined(WOLFBOOT_FSP)
     /* FSP: stage1 boot_x86_fsp.c handles measurement via self_extend_pcr()
@@ -262,9 +265,19 @@ static int TPM2_IoCb(TPM2_CTX* ctx, const uint8_t* txBuf, uint8_t* rxBuf,
     #define SELF_HASH_ADDR  ((uintptr_t)&_start_text)
     #define SELF_HASH_SZ    ((uint32_t)((uintptr_t)&_stored_data - \
                                         (uintptr_t)&_start_text))
+    #define SELF_HASH_REGION WOLFBOOT_MLOG_WOLFBOOT
 #endif
 
-#ifdef SELF_HASH_ADDR
+#if defined(SELF_HASH_ADDR) && defined(WOLFBOOT_MEASURE_LOG) && \
+    !(defined(EXT_FLASH) && defined(NO_XIP))
+/* Shared with DICE / attestation through the measurement log. With
+ * EXT_FLASH + NO_XIP the log reads regions from the external flash, which
+ * is only right for the boot partition: keep the local hash there. */
+#define SELF_HASH_MLOG
+#undef self_hash
+#define self_hash(h) \
+    wolfBoot_mlog_measure(SELF_HASH_REGION, SELF_HASH_ADDR, SELF_HASH_SZ, (h))
+#elif defined(SELF_HASH_ADDR)
 #ifdef WOLFBOOT_HASH_SHA256
 #include <wolfssl/wolfcrypt/sha256.h>
 static int self_sha256(uint8_t *hash)
@@ -1613,6 +1626,12 @@ int wolfBoot_tpm2_init(void)
         if (rc == 0) {
             rc = measure_boot(digest);
         }
+    #ifdef SELF_HASH_MLOG
+        if (rc == 0) {
+            (void)wolfBoot_mlog_set_pcr(SELF_HASH_REGION,
+                WOLFBOOT_MEASURED_PCR_A);
+        }
+    #endif
         if (rc != 0) {
             wolfBoot_printf("Error %d performing wolfBoot measurement!\n", rc);
         }
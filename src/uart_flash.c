@@ -31,6 +31,7 @@
 
 #include "wolfboot/wolfboot.h"
 #include "hal.h"
+#include "uart_flash.h"
 #include <stdint.h>
 #include <string.h>
 
@@ -44,8 +45,47 @@
 #define ERASE_TIMEOUT 5
 #define READ_TIMEOUT 1
 
-int uart_tx(const uint8_t c);
-int uart_rx(uint8_t *c);
+#ifdef UART_FLASH_V2
+/* Protocol v2: probed with 'W' + CMD_HDR_V2, then framed transfers:
+ *
+ *   SOF | type | seq | len (LE16) | payload | CRC32 (LE32)
+ *
+ * The CRC (IEEE 802.3) covers type, seq, len and payload. Each frame is
+ * acknowledged with ACK|seq|~seq, or NAK|seq|~seq where seq is the next
+ * frame the receiver expects. Up to 'window' frames can be in flight
+ * before the sender waits (go-back-N on NAK or timeout).
+ */
+#define CMD_HDR_V2     0x10
+#define CMD_NAK        0x15
+#define V2_SOF         0xA5
+#define V2_HELLO       0x10
+#define V2_WRITE       0x11
+#define V2_READ        0x12
+#define V2_DATA        0x13
+#define V2_ERASE       0x14
+#define V2_SYNC        0x15
+#define V2_VERSION     2
+#define V2_HDR_LEN     5
+#define V2_RETRIES     8
+/* Bytes received while transmitting (acks of earlier frames) */
+#define V2_RX_RING     32
+
+#ifndef UART_FLASH_V2_WINDOW
+    #define UART_FLASH_V2_WINDOW 4
+#endif
+#ifndef UART_FLASH_V2_FRAME_SIZE
+    #define UART_FLASH_V2_FRAME_SIZE 1024
+#endif
+#ifndef UART_FLASH_V2_BITRATE
+    #define UART_FLASH_V2_BITRATE 0 /* keep UART_FLASH_BITRATE */
+#endif
+#if (UART_FLASH_V2_WINDOW < 1) || (UART_FLASH_V2_WINDOW > 16)
+    #error "UART_FLASH_V2_WINDOW must be between 1 and 16"
+#endif
+#if (UART_FLASH_V2_FRAME_SIZE < 16) || (UART_FLASH_V2_FRAME_SIZE > 4096)
+    #error "UART_FLASH_V2_FRAME_SIZE must be between 16 and 4096"
+#endif
+#endif /* UART_FLASH_V2 */
 
 static int wait_ack(void)
 {
@@ -70,7 +110,7 @@ static int uart_rx_timeout(uint8_t *c)
 }
 
 
-int  ext_flash_write(uintptr_t address, const uint8_t *data, int len)
+static int uart_flash_v1_write(uintptr_t address, const uint8_t *data, int len)
 {
     int i;
     uint8_t cmd[10];
@@ -97,7 +137,7 @@ int  ext_flash_write(uintptr_t address, const uint8_t *data, int len)
     return len;
 }
 
-int  ext_flash_read(uintptr_t address, uint8_t *data, int len)
+static int uart_flash_v1_read(uintptr_t address, uint8_t *data, int len)
 {
     int i;
     uint8_t cmd[10];
@@ -124,7 +164,7 @@ int  ext_flash_read(uintptr_t address, uint8_t *data, int len)
     return i;
 }
 
-int  ext_flash_erase(uintptr_t address, int len)
+static int uart_flash_v1_erase(uintptr_t address, int len)
 {
     int i;
     uint8_t cmd[10];
@@ -149,6 +189,426 @@ int  ext_flash_erase(uintptr_t address, int len)
     return -1;
 }
 
+#ifdef UART_FLASH_V2
+
+#define UF_PROTO_UNKNOWN 0
+#define UF_PROTO_V1      1
+#define UF_PROTO_V2      2
+
+static int uf_proto = UF_PROTO_UNKNOWN;
+static uint8_t uf_seq;
+static uint8_t uf_window = UART_FLASH_V2_WINDOW;
+static uint16_t uf_frame = UART_FLASH_V2_FRAME_SIZE;
+static uint8_t uf_ring[V2_RX_RING];
+static uint8_t uf_ring_head, uf_ring_tail;
+
+static uint32_t uf_crc32(uint32_t crc, const uint8_t *p, uint32_t len)
+{
+    uint32_t i;
+    int k;
+    for (i = 0; i < len; i++) {
+        crc ^= p[i];
+        for (k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+    }
+    return crc;
+}
+
+static void uf_put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+static uint32_t uf_get_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Stash incoming bytes so that acks sent by the host while a frame is
+ * being transmitted are not lost in the UART receive register. */
+static void uf_rx_poll(void)
+{
+    uint8_t c;
+    while (((uint8_t)(uf_ring_head + 1) % V2_RX_RING) != uf_ring_tail) {
+        if (uart_rx(&c) != 1)
+            break;
+        uf_ring[uf_ring_head] = c;
+        uf_ring_head = (uf_ring_head + 1) % V2_RX_RING;
+    }
+}
+
+static void uf_tx(uint8_t c)
+{
+    uart_tx(c);
+    uf_rx_poll();
+}
+
+static int uf_rx(uint8_t *c, int timeout)
+{
+    volatile int count = 0;
+    if (uf_ring_tail != uf_ring_head) {
+        *c = uf_ring[uf_ring_tail];
+        uf_ring_tail = (uf_ring_tail + 1) % V2_RX_RING;
+        return 0;
+    }
+    while (++count < (WAIT_CYCLES * timeout)) {
+        if (uart_rx(c) == 1)
+            return 0;
+    }
+    return -1;
+}
+
+static void uf_rx_flush(void)
+{
+    uint8_t c;
+    uf_ring_head = uf_ring_tail = 0;
+    while (uart_rx(&c) == 1)
+        ;
+}
+
+static void uf_send_frame(uint8_t type, uint8_t seq, const uint8_t *hdr,
+    uint32_t hdr_len, const uint8_t *data, uint32_t data_len)
+{
+    uint8_t fh[V2_HDR_LEN];
+    uint8_t crc[4];
+    uint32_t len = hdr_len + data_len;
+    uint32_t i;
+
+    fh[0] = V2_SOF;
+    fh[1] = type;
+    fh[2] = seq;
+    fh[3] = len & 0xFF;
+    fh[4] = (len >> 8) & 0xFF;
+    uf_put_le32(crc, ~uf_crc32(uf_crc32(uf_crc32(0xFFFFFFFFU, fh + 1,
+        V2_HDR_LEN - 1), hdr, hdr_len), data, data_len));
+    for (i = 0; i < V2_HDR_LEN; i++)
+        uf_tx(fh[i]);
+    for (i = 0; i < hdr_len; i++)
+        uf_tx(hdr[i]);
+    for (i = 0; i < data_len; i++)
+        uf_tx(data[i]);
+    for (i = 0; i < 4; i++)
+        uf_tx(crc[i]);
+}
+
+/* Receive one frame. The first 'hdr_len' payload bytes are stored in 'hdr',
+ * the rest (up to 'max' bytes) in 'buf'. Returns the payload length, -1 on
+ * timeout or -2 if the frame is corrupted or too large. */
+static int uf_recv_frame(uint8_t *type, uint8_t *seq, uint8_t *hdr,
+    uint32_t hdr_len, uint8_t *buf, uint32_t max, int timeout)
+{
+    uint8_t fh[V2_HDR_LEN];
+    uint8_t crc[4];
+    uint32_t len, i;
+    uint32_t c;
+
+    do {
+        if (uf_rx(&fh[0], timeout) != 0)
+            return -1;
+    } while (fh[0] != V2_SOF);
+    for (i = 1; i < V2_HDR_LEN; i++) {
+        if (uf_rx(&fh[i], READ_TIMEOUT) != 0)
+            return -1;
+    }
+    len = fh[3] | (fh[4] << 8);
+    if ((len < hdr_len) || (len > hdr_len + max))
+        return -2;
+    for (i = 0; i < len; i++) {
+        uint8_t *p = (i < hdr_len) ? &hdr[i] : &buf[i - hdr_len];
+        if (uf_rx(p, READ_TIMEOUT) != 0)
+            return -1;
+    }
+    for (i = 0; i < 4; i++) {
+        if (uf_rx(&crc[i], READ_TIMEOUT) != 0)
+            return -1;
+    }
+    c = uf_crc32(0xFFFFFFFFU, fh + 1, V2_HDR_LEN - 1);
+    c = uf_crc32(c, hdr, hdr_len);
+    c = uf_crc32(c, buf, len - hdr_len);
+    if (uf_get_le32(crc) != ~c)
+        return -2;
+    *type = fh[1];
+    *seq = fh[2];
+    return (int)len;
+}
+
+static int uf_recv_ack(uint8_t *code, uint8_t *seq, int timeout)
+{
+    uint8_t inv;
+    do {
+        if (uf_rx(code, timeout) != 0)
+            return -1;
+    } while ((*code != CMD_ACK) && (*code != CMD_NAK));
+    if ((uf_rx(seq, READ_TIMEOUT) != 0) || (uf_rx(&inv, READ_TIMEOUT) != 0))
+        return -1;
+    if ((*seq ^ inv) != 0xFF)
+        return -1;
+    return 0;
+}
+
+static void uf_send_ack(uint8_t code, uint8_t seq)
+{
+    uf_tx(code);
+    uf_tx(seq);
+    uf_tx(~seq);
+}
+
+/* Send a single frame and wait until the host acknowledges it */
+static int uf_v2_request(uint8_t type, const uint8_t *hdr, uint32_t hdr_len,
+    int timeout)
+{
+    uint8_t code, s;
+    int retries;
+
+    for (retries = 0; retries < V2_RETRIES; retries++) {
+        uf_send_frame(type, uf_seq, hdr, hdr_len, NULL, 0);
+        if ((uf_recv_ack(&code, &s, timeout) == 0) && (code == CMD_ACK) &&
+                (s == uf_seq)) {
+            uf_seq++;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int uf_v2_hello(void)
+{
+    uint8_t req[8];
+    uint8_t hello[8];
+    uint8_t type, seq;
+    uint32_t baud;
+    int ret, retries;
+
+    req[0] = V2_VERSION;
+    req[1] = UART_FLASH_V2_WINDOW;
+    req[2] = UART_FLASH_V2_FRAME_SIZE & 0xFF;
+    req[3] = (UART_FLASH_V2_FRAME_SIZE >> 8) & 0xFF;
+    uf_put_le32(req + 4, UART_FLASH_V2_BITRATE);
+    uf_seq = 0;
+    for (retries = 0; retries < V2_RETRIES; retries++) {
+        uf_send_frame(V2_HELLO, uf_seq, req, sizeof(req), NULL, 0);
+        ret = uf_recv_frame(&type, &seq, NULL, 0, hello, sizeof(hello),
+            READ_TIMEOUT);
+        if ((ret == (int)sizeof(hello)) && (type == V2_HELLO) &&
+                (seq == uf_seq))
+            break;
+    }
+    if ((retries == V2_RETRIES) || (hello[0] != V2_VERSION))
+        return -1;
+    uf_seq++;
+    /* The host answers with the values both sides support */
+    if ((hello[1] == 0) || (hello[1] > UART_FLASH_V2_WINDOW))
+        return -1;
+    uf_window = hello[1];
+    uf_frame = hello[2] | (hello[3] << 8);
+    if ((uf_frame < 16) || (uf_frame > UART_FLASH_V2_FRAME_SIZE))
+        return -1;
+    baud = uf_get_le32(hello + 4);
+    if (baud != 0) {
+        uart_init(baud, 8, 'N', 1);
+        uf_rx_flush();
+        if (uf_v2_request(V2_SYNC, NULL, 0, READ_TIMEOUT) != 0) {
+            /* The host reverts to the old rate when no SYNC gets through */
+            uart_init(UART_FLASH_BITRATE, 8, 'N', 1);
+            uf_rx_flush();
+            if (uf_v2_request(V2_SYNC, NULL, 0, READ_TIMEOUT) != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+/* Probe the host for v2 support. A v1 server does not ack CMD_HDR_V2, and
+ * every transfer falls back to the byte-by-byte v1 commands. A v2 server
+ * stops accepting v1 commands after HELLO, so if the handshake fails the
+ * probe is repeated on the next access. */
+static int uf_proto_get(void)
+{
+    int tries;
+    if (uf_proto == UF_PROTO_UNKNOWN) {
+        for (tries = 0; tries < 3; tries++) {
+            uart_tx(CMD_HDR_WOLF);
+            if (wait_ack() != 0)
+                continue;
+            uart_tx(CMD_HDR_V2);
+            if (wait_ack() != 0)
+                continue;
+            if (uf_v2_hello() == 0)
+                uf_proto = UF_PROTO_V2;
+            return uf_proto;
+        }
+        uf_proto = UF_PROTO_V1;
+    }
+    return uf_proto;
+}
+
+static int uart_flash_v2_write(uintptr_t address, const uint8_t *data, int len)
+{
+    uint32_t nframes = ((uint32_t)len + uf_frame - 1) / uf_frame;
+    uint32_t base = 0, next = 0;
+    uint8_t seq0 = uf_seq;
+    uint8_t hdr[4];
+    uint8_t code, s, idx;
+    int retries = 0;
+
+    uf_rx_flush();
+    while (base < nframes) {
+        while ((next < nframes) && ((next - base) < uf_window)) {
+            uint32_t off = next * uf_frame;
+            uint32_t chunk = (uint32_t)len - off;
+            if (chunk > uf_frame)
+                chunk = uf_frame;
+            uf_put_le32(hdr, (uint32_t)address + off);
+            uf_send_frame(V2_WRITE, (uint8_t)(seq0 + next), hdr, 4,
+                data + off, chunk);
+            next++;
+        }
+        if (uf_recv_ack(&code, &s, READ_TIMEOUT) != 0) {
+            next = base;
+            if (++retries > V2_RETRIES)
+                return -1;
+            continue;
+        }
+        idx = (uint8_t)(s - (uint8_t)(seq0 + base));
+        if (code == CMD_ACK) {
+            if (idx < (next - base)) {
+                base += idx + 1;
+                retries = 0;
+            }
+        } else if (idx <= (next - base)) {
+            /* Everything before 's' was received */
+            base += idx;
+            next = base;
+            if (++retries > V2_RETRIES)
+                return -1;
+        }
+    }
+    uf_seq = (uint8_t)(seq0 + nframes);
+    return len;
+}
+
+/* DATA frames carry their flash address before the payload, so that a late
+ * retransmission for another request is never stored. */
+static int uart_flash_v2_read(uintptr_t address, uint8_t *data, int len)
+{
+    uint8_t req[8];
+    uint8_t addr[4];
+    uint8_t type, seq, exp = 0;
+    uint32_t off = 0, a;
+    int retries = 0, nak_sent = 0, ret;
+
+    uf_put_le32(req, (uint32_t)address);
+    uf_put_le32(req + 4, (uint32_t)len);
+    uf_rx_flush();
+    uf_send_frame(V2_READ, uf_seq, req, sizeof(req), NULL, 0);
+    while (off < (uint32_t)len) {
+        ret = uf_recv_frame(&type, &seq, addr, sizeof(addr), data + off,
+            (uint32_t)len - off, READ_TIMEOUT);
+        if ((ret > (int)sizeof(addr)) && (type == V2_DATA)) {
+            a = uf_get_le32(addr);
+            if ((a == (uint32_t)address + off) && (seq == exp)) {
+                uf_send_ack(CMD_ACK, seq);
+                off += ret - sizeof(addr);
+                exp++;
+                retries = 0;
+                nak_sent = 0;
+                continue;
+            }
+            if ((a >= (uint32_t)address) && (a < (uint32_t)address + off) &&
+                    ((uint8_t)(exp - seq) <= uf_window)) {
+                /* Retransmission of a frame already stored: ack it again */
+                uf_send_ack(CMD_ACK, seq);
+                continue;
+            }
+        }
+        if ((ret != -1) && nak_sent)
+            continue; /* frames in flight after the missing one */
+        if (++retries > V2_RETRIES)
+            return -1;
+        if ((ret == -1) && (off == 0)) {
+            /* Request lost: ask again */
+            uf_send_frame(V2_READ, uf_seq, req, sizeof(req), NULL, 0);
+        } else {
+            uf_send_ack(CMD_NAK, exp);
+            nak_sent = 1;
+        }
+    }
+    uf_seq++;
+    return len;
+}
+
+static int uart_flash_v2_erase(uintptr_t address, int len)
+{
+    uint8_t req[8];
+    uf_put_le32(req, (uint32_t)address);
+    uf_put_le32(req + 4, (uint32_t)len);
+    uf_rx_flush();
+    return uf_v2_request(V2_ERASE, req, sizeof(req), ERASE_TIMEOUT);
+}
+
+int ext_flash_write(uintptr_t address, const uint8_t *data, int len)
+{
+    int proto = uf_proto_get();
+    if (proto == UF_PROTO_V2)
+        return uart_flash_v2_write(address, data, len);
+    if (proto == UF_PROTO_V1)
+        return uart_flash_v1_write(address, data, len);
+    return -1;
+}
+
+int ext_flash_read(uintptr_t address, uint8_t *data, int len)
+{
+    int proto = uf_proto_get();
+    if (proto == UF_PROTO_V2)
+        return uart_flash_v2_read(address, data, len);
+    if (proto == UF_PROTO_V1)
+        return uart_flash_v1_read(address, data, len);
+    return -1;
+}
+
+int ext_flash_erase(uintptr_t address, int len)
+{
+    int proto = uf_proto_get();
+    if (proto == UF_PROTO_V2)
+        return uart_flash_v2_erase(address, len);
+    if (proto == UF_PROTO_V1)
+        return uart_flash_v1_erase(address, len);
+    return -1;
+}
+
+void ext_flash_lock(void)
+{
+    /* v2 transfers are acknowledged per frame: no stray ack to consume */
+    if (uf_proto != UF_PROTO_V2)
+        wait_ack();
+}
+
+void ext_flash_unlock(void)
+{
+    if (uf_proto != UF_PROTO_V2)
+        wait_ack();
+}
+
+#else
+
+int ext_flash_write(uintptr_t address, const uint8_t *data, int len)
+{
+    return uart_flash_v1_write(address, data, len);
+}
+
+int ext_flash_read(uintptr_t address, uint8_t *data, int len)
+{
+    return uart_flash_v1_read(address, data, len);
+}
+
+int ext_flash_erase(uintptr_t address, int len)
+{
+    return uart_flash_v1_erase(address, len);
+}
+
 void ext_flash_lock(void)
 {
     wait_ack();
@@ -159,6 +619,8 @@ void ext_flash_unlock(void)
     wait_ack();
 }
 
+#endif /* UART_FLASH_V2 */
+
 void uart_send_current_version(void)
 {
     uint32_t version = wolfBoot_current_firmware_version();
@@ -44,6 +44,7 @@
 #include "printf.h"
 #include "wolfboot/wolfboot.h"
 #include "disk.h"
+#include "measure_log.h"
 #ifdef WOLFBOOT_ELF
 #include "elf.h"
 #endif
@@ -247,6 +248,76 @@ static void disk_decrypted_header_clear(uint8_t *hdr)
 
 #endif /* DISK_ENCRYPT */
 
+/**
+ * @brief Load an image payload from disk into RAM at img->fw_base.
+ *
+ * The payload is read in DISK_BLOCK_SIZE chunks. With DISK_ENCRYPT each
+ * chunk is decrypted, and unless WOLFBOOT_SKIP_BOOT_VERIFY it is added to
+ * the image digest, right after it is read: the data is still in the data
+ * cache, and the image is not walked again for each step. The caller sets
+ * the cipher IV to the start of the payload and starts the digest with
+ * wolfBoot_image_hash_start().
+ *
+ * @param part Partition to read from.
+ * @param img Opened image; fw_size bytes are loaded at fw_base.
+ * @param loaded Set to the number of bytes loaded.
+ *
+ * @return The result of the last disk_part_read() (> 0 on success), or -1
+ * if hashing failed.
+ */
+static int disk_load_payload(uint32_t part, struct wolfBoot_image *img,
+    uint32_t *loaded)
+{
+    uint32_t off = 0;
+    int ret;
+    BENCHMARK_DECLARE();
+    BENCHMARK_LAP_DECLARE(read);
+#ifdef DISK_ENCRYPT
+    BENCHMARK_LAP_DECLARE(decrypt);
+#endif
+#ifndef WOLFBOOT_SKIP_BOOT_VERIFY
+    BENCHMARK_LAP_DECLARE(hash);
+#endif
+
+    BENCHMARK_START();
+    do {
+        uint8_t *chunk_ptr = img->fw_base + off;
+        uint32_t chunk = img->fw_size - off;
+        if (chunk > DISK_BLOCK_SIZE)
+            chunk = DISK_BLOCK_SIZE;
+        ret = disk_part_read(BOOT_DISK, part, IMAGE_HEADER_SIZE + off, chunk,
+            chunk_ptr);
+        BENCHMARK_LAP(read);
+        if (ret <= 0)
+            break;
+#ifdef DISK_ENCRYPT
+        crypto_decrypt(chunk_ptr, chunk_ptr, (uint32_t)ret);
+        BENCHMARK_LAP(decrypt);
+#endif
+#ifndef WOLFBOOT_SKIP_BOOT_VERIFY
+        if (wolfBoot_image_hash_update(img, (uint32_t)ret) != 0) {
+            ret = -1;
+            break;
+        }
+        BENCHMARK_LAP(hash);
+#endif
+        off += ret;
+    } while (off < img->fw_size);
+    *loaded = off;
+
+    if (ret > 0) {
+        wolfBoot_printf("done\r\n");
+        BENCHMARK_LAP_REPORT("  disk read", read);
+#ifdef DISK_ENCRYPT
+        BENCHMARK_LAP_REPORT("  decrypt", decrypt);
+#endif
+#ifndef WOLFBOOT_SKIP_BOOT_VERIFY
+        BENCHMARK_LAP_REPORT("  hash", hash);
+#endif
+    }
+    return ret;
+}
+
 extern int wolfBoot_get_dts_size(void *dts_addr);
 
 #if defined(WOLFBOOT_NO_LOAD_ADDRESS) || !defined(WOLFBOOT_LOAD_ADDRESS)
@@ -481,21 +552,28 @@ void RAMFUNCTION wolfBoot_start(void)
                             part_name);
 #endif
 
+        os_image.fw_base = (uint8_t*)load_address;
+#ifdef DISK_ENCRYPT
+        if ((IMAGE_HEADER_SIZE % ENCRYPT_BLOCK_SIZE) != 0) {
+            disk_decrypted_header_clear(dec_hdr);
+            disk_crypto_clear();
+            wolfBoot_printf("Encrypted disk images require aligned header size\r\n");
+            wolfBoot_panic();
+        }
+        disk_crypto_set_iv(IMAGE_HEADER_SIZE / ENCRYPT_BLOCK_SIZE);
+#endif
+#ifndef WOLFBOOT_SKIP_BOOT_VERIFY
+        if (wolfBoot_image_hash_start(&os_image) != 0) {
+            wolfBoot_printf("Error hashing image header for %s\r\n",
+                part_name);
+            selected ^= 1;
+            continue;
+        }
+#endif
+
         /* Read the payload into RAM (skip header) */
         wolfBoot_printf("Loading image from disk...");
-        BENCHMARK_START();
-        load_off = 0;
-        do {
-            uint32_t chunk = os_image.fw_size - load_off;
-            if (chunk > DISK_BLOCK_SIZE)
-                chunk = DISK_BLOCK_SIZE;
-            ret = disk_part_read(BOOT_DISK, cur_part,
-                IMAGE_HEADER_SIZE + load_off, chunk,
-                ((uint8_t *)load_address) + load_off);
-            if (ret <= 0)
-                break;
-            load_off += ret;
-        } while (load_off < os_image.fw_size);
+        ret = disk_load_payload(cur_part, &os_image, &load_off);
 
         /* A short read must fail here, as an I/O error. `ret == 0` breaks the
          * loop above without being negative, and a truncated load would
@@ -509,37 +587,11 @@ void RAMFUNCTION wolfBoot_start(void)
             selected ^= 1;
             continue;
         }
-        BENCHMARK_END("done");
-
-#ifdef DISK_ENCRYPT
-        /* Decrypt the payload in RAM */
-        wolfBoot_printf("Decrypting image...");
-        BENCHMARK_START();
-        if ((IMAGE_HEADER_SIZE % ENCRYPT_BLOCK_SIZE) != 0) {
-            disk_decrypted_header_clear(dec_hdr);
-            disk_crypto_clear();
-            wolfBoot_printf("Encrypted disk images require aligned header size\r\n");
-            wolfBoot_panic();
-        }
-        disk_crypto_set_iv(IMAGE_HEADER_SIZE / ENCRYPT_BLOCK_SIZE);
-        crypto_decrypt((uint8_t*)load_address, (uint8_t*)load_address,
-            os_image.fw_size);
-        BENCHMARK_END("done");
-#endif
-
-        memset(&os_image, 0, sizeof(os_image));
-        ret = wolfBoot_open_image_address(&os_image, (void*)hdr_ptr);
-        if (ret < 0) {
-            wolfBoot_printf("Error parsing loaded image\r\n");
-            selected ^= 1;
-            continue;
-        }
-        os_image.fw_base = (uint8_t*)load_address;
 
 #ifndef WOLFBOOT_SKIP_BOOT_VERIFY
         wolfBoot_printf("Checking image integrity...");
         BENCHMARK_START();
-        if (wolfBoot_verify_integrity(&os_image) != 0) {
+        if (wolfBoot_image_hash_verify(&os_image) != 0) {
             wolfBoot_printf("Error validating integrity for %s\r\n", part_name);
             selected ^= 1;
             continue;
@@ -683,6 +735,11 @@ void RAMFUNCTION wolfBoot_start(void)
 #endif
         wolfBoot_panic();
     }
+#endif
+    wolfBoot_mlog_handoff();
+#ifdef WOLFBOOT_BOOT_TIMING
+    (void)wolfBoot_timing_commit((uint8_t)selected,
+        selected ? pB_ver_u : pA_ver_u);
 #endif
     hal_prepare_boot();
 
@@ -33,6 +33,8 @@
 
 #include "delta.h"
 #include "printf.h"
+#include "measure_log.h"
+#include "verify_cache.h"
 static void wolfBoot_zeroize(void *ptr, size_t len)
 {
     volatile uint8_t *p = (volatile uint8_t *)ptr;
@@ -387,6 +389,66 @@ out:
     return ret;
 }
 
+#ifdef WOLFBOOT_BOOT_TIMING
+/* Charge every sector copy (including decryption) to the copy phase, and
+ * flag the boot as installing an update */
+static int RAMFUNCTION wolfBoot_copy_sector_timed(struct wolfBoot_image *src,
+    struct wolfBoot_image *dst, uint32_t sector)
+{
+    int ret;
+
+    BOOT_TIMING_FLAG(WOLFBOOT_TIMING_F_UPDATE);
+    BOOT_TIMING_BEGIN(WOLFBOOT_TIMING_COPY);
+    ret = wolfBoot_copy_sector(src, dst, sector);
+    BOOT_TIMING_END(WOLFBOOT_TIMING_COPY);
+    return ret;
+}
+#define wolfBoot_copy_sector wolfBoot_copy_sector_timed
+#endif
+
+#ifdef WOLFBOOT_SWAP_SKIP_UNCHANGED
+#ifdef EXT_ENCRYPTED
+    /* The backup copy in UPDATE is re-encrypted with the fallback IV, so a
+     * sector left in place would no longer decrypt on fallback */
+    #error "WOLFBOOT_SWAP_SKIP_UNCHANGED is not compatible with EXT_ENCRYPTED"
+#endif
+/* Returns 1 if BOOT and UPDATE hold the same bytes in this sector. Swapping
+ * such a sector leaves both partitions as they are, so the three copies
+ * (and their erase/program cycles) can be skipped. */
+static int RAMFUNCTION wolfBoot_sector_unchanged(struct wolfBoot_image *boot,
+    struct wolfBoot_image *update, uint32_t sector)
+{
+    uint32_t off = sector * WOLFBOOT_SECTOR_SIZE;
+    uint32_t pos;
+#ifdef EXT_FLASH
+    static uint8_t cmp_boot[FLASHBUFFER_SIZE] XALIGNED(4);
+    static uint8_t cmp_update[FLASHBUFFER_SIZE] XALIGNED(4);
+#endif
+
+    for (pos = 0; pos < WOLFBOOT_SECTOR_SIZE; pos += FLASHBUFFER_SIZE) {
+        const uint8_t *b = boot->hdr + off + pos;
+        const uint8_t *u = update->hdr + off + pos;
+#ifdef EXT_FLASH
+        if (PART_IS_EXT(boot)) {
+            if (ext_flash_read((uintptr_t)b, cmp_boot, FLASHBUFFER_SIZE)
+                    != FLASHBUFFER_SIZE)
+                return 0;
+            b = cmp_boot;
+        }
+        if (PART_IS_EXT(update)) {
+            if (ext_flash_read((uintptr_t)u, cmp_update, FLASHBUFFER_SIZE)
+                    != FLASHBUFFER_SIZE)
+                return 0;
+            u = cmp_update;
+        }
+#endif
+        if (memcmp(b, u, FLASHBUFFER_SIZE) != 0)
+            return 0;
+    }
+    return 1;
+}
+#endif /* WOLFBOOT_SWAP_SKIP_UNCHANGED */
+
 #ifdef EXT_ENCRYPTED
 static int RAMFUNCTION wolfBoot_backup_last_boot_sector(uint32_t sector)
 {
@@ -613,6 +675,9 @@ static int RAMFUNCTION wolfBoot_swap_and_final_erase(int resume)
 #endif
 #endif /* !DISABLE_BACKUP && !CUSTOM_PARTITION_TRAILER */
 
+static uint32_t wolfBoot_get_total_size(struct wolfBoot_image* boot,
+    struct wolfBoot_image* update);
+
 #ifdef DELTA_UPDATES
 
     #ifndef DELTA_BLOCK_SIZE
@@ -668,9 +733,7 @@ static int wolfBoot_delta_update(struct wolfBoot_image *boot,
     }
 
     /* Use biggest size for the swap */
-    total_size = boot->fw_size + IMAGE_HEADER_SIZE;
-    if ((update->fw_size + IMAGE_HEADER_SIZE) > total_size)
-            total_size = update->fw_size + IMAGE_HEADER_SIZE;
+    total_size = wolfBoot_get_total_size(boot, update);
 
     hal_flash_unlock();
 #ifdef EXT_FLASH
@@ -822,10 +885,15 @@ static int wolfBoot_delta_update(struct wolfBoot_image *boot,
         if (sector == 0) {
             /* New total image size after first sector is patched */
             volatile uint32_t update_size;
+            struct wolfBoot_image patched;
+            memset(&patched, 0, sizeof(patched));
+            patched.part = PART_BOOT;
+            patched.hdr = (uint8_t *)WOLFBOOT_PARTITION_BOOT_ADDRESS;
+            patched.hdr_ok = 1;
+            patched.not_ext = 1;
             hal_flash_lock();
-            update_size =
-                wolfBoot_image_size((uint8_t *)WOLFBOOT_PARTITION_BOOT_ADDRESS)
-                + IMAGE_HEADER_SIZE;
+            patched.fw_size = wolfBoot_image_size(patched.hdr);
+            update_size = wolfBoot_image_total_size(&patched);
             hal_flash_unlock();
             if (update_size > total_size)
                 total_size = update_size;
@@ -903,10 +971,11 @@ static uint32_t wolfBoot_get_total_size(struct wolfBoot_image* boot,
 {
     uint32_t total_size = 0;
 
-    /* Use biggest size for the swap */
-    total_size = boot->fw_size + IMAGE_HEADER_SIZE;
-    if ((update->fw_size + IMAGE_HEADER_SIZE) > total_size)
-        total_size = update->fw_size + IMAGE_HEADER_SIZE;
+    /* Use biggest size for the swap. Chunked images also need their chunk
+     * table, stored after the firmware. */
+    total_size = wolfBoot_image_total_size(boot);
+    if (wolfBoot_image_total_size(update) > total_size)
+        total_size = wolfBoot_image_total_size(update);
 
     return total_size;
 }
@@ -1145,7 +1214,11 @@ static int RAMFUNCTION wolfBoot_update(int fallback_allowed)
             inverse = 1;
         }
 
-        return wolfBoot_delta_update(&boot, &update, &swap, inverse, resume);
+        BOOT_TIMING_FLAG(WOLFBOOT_TIMING_F_UPDATE);
+        BOOT_TIMING_BEGIN(WOLFBOOT_TIMING_DELTA);
+        ret = wolfBoot_delta_update(&boot, &update, &swap, inverse, resume);
+        BOOT_TIMING_END(WOLFBOOT_TIMING_DELTA);
+        return ret;
     }
 #endif
 
@@ -1165,6 +1238,20 @@ static int RAMFUNCTION wolfBoot_update(int fallback_allowed)
         wolfBoot_get_update_sector_flag(sector, &flag);
         switch (flag) {
             case SECT_FLAG_NEW:
+#ifdef WOLFBOOT_SWAP_SKIP_UNCHANGED
+               /* Identical in both partitions: go straight from NEW to
+                * UPDATED. A single flag write keeps resume safe, as the
+                * SWAPPING/BACKUP states would restore BOOT from the swap
+                * sector, which does not hold this sector's data. */
+               if (wolfBoot_sector_unchanged(&boot, &update, sector)) {
+                   wolfBoot_printf("Sector %d unchanged, skipping copy\n",
+                       sector);
+                   if (((sector + 1) * sector_size) < WOLFBOOT_PARTITION_SIZE)
+                       wolfBoot_set_update_sector_flag(sector,
+                           SECT_FLAG_UPDATED);
+                   break;
+               }
+#endif
                flag = SECT_FLAG_SWAPPING;
                copy_ret = wolfBoot_copy_sector(&update, &swap, sector);
                if (copy_ret < 0)
@@ -1238,13 +1325,14 @@ static int RAMFUNCTION wolfBoot_update(int fallback_allowed)
             wolfBoot_open_image(&boot, PART_BOOT);
             wolfBoot_open_image(&update, PART_UPDATE);
 
+            /* get total size, while each header still matches its fw_size
+             * (the chunk table size depends on both) */
+            total_size = wolfBoot_get_total_size(&boot, &update);
+
             /* swap the fw_size since they're now swapped */
             fw_size = boot.fw_size;
             boot.fw_size = update.fw_size;
             update.fw_size = fw_size;
-
-            /* get total size */
-            total_size = wolfBoot_get_total_size(&boot, &update);
         }
     }
 
@@ -1513,6 +1601,22 @@ int wolfBoot_unlock_disk(void)
     return ret;
 }
 #endif
+#ifdef WOLFBOOT_IMG_CHUNKS_LAZY
+/* XIP boot image: only the first chunks are verified before boot, the
+ * application verifies the others (wolfBoot_lazy_verify_next()) */
+#define boot_verify_integrity(img) \
+    wolfBoot_verify_integrity_lazy(img, WOLFBOOT_IMG_CHUNKS_LAZY_PREFIX)
+#else
+#define boot_verify_integrity(img) wolfBoot_verify_integrity(img)
+#endif
+#ifdef WOLFBOOT_VERIFY_CACHE
+/* Unchanged boot image: the signature check is replaced by the check of the
+ * MAC stored after the last full verification */
+#define boot_verify_authenticity(img) wolfBoot_verify_authenticity_cached(img)
+#else
+#define boot_verify_authenticity(img) wolfBoot_verify_authenticity(img)
+#endif
+
 #ifdef __CCRX__
 #pragma section FRAM
 #endif
@@ -1612,14 +1716,14 @@ void RAMFUNCTION wolfBoot_start(void)
     if (bootRet >= 0) {
         wolfBoot_printf("Checking integrity...");
         BENCHMARK_START();
-        bootRet = wolfBoot_verify_integrity(&boot);
+        bootRet = boot_verify_integrity(&boot);
         if (bootRet >= 0)
             BENCHMARK_END("done");
     }
     if (bootRet >= 0) {
         wolfBoot_printf("Verifying signature...");
         BENCHMARK_START();
-        bootRet = wolfBoot_verify_authenticity(&boot);
+        bootRet = boot_verify_authenticity(&boot);
         if (bootRet >= 0)
             BENCHMARK_END("done");
     }
@@ -1642,8 +1746,8 @@ void RAMFUNCTION wolfBoot_start(void)
         } else {
             /* Emergency update successful, try to re-open boot image */
             if (unlikely(((wolfBoot_open_image(&boot, PART_BOOT) < 0) ||
-                    (wolfBoot_verify_integrity(&boot) < 0)  ||
-                    (wolfBoot_verify_authenticity(&boot) < 0)
+                    (boot_verify_integrity(&boot) < 0)  ||
+                    (boot_verify_authenticity(&boot) < 0)
                     ))) {
                 wolfBoot_printf("Boot (try 2) failed: Hdr %d, Hash %d, Sig %d\n",
                     boot.hdr_ok, boot.sha_ok, boot.signature_ok);
@@ -1722,6 +1826,11 @@ void RAMFUNCTION wolfBoot_start(void)
         wolfBoot_printf("Error protecting bootloader flash region\n");
         wolfBoot_panic();
     }
+#endif
+    wolfBoot_mlog_handoff();
+#ifdef WOLFBOOT_BOOT_TIMING
+    (void)wolfBoot_timing_commit(PART_BOOT,
+        wolfBoot_get_blob_version(boot.hdr));
 #endif
     hal_prepare_boot();
 
@@ -29,6 +29,7 @@
 #include "spi_flash.h"
 #include "printf.h"
 #include "wolfboot/wolfboot.h"
+#include "measure_log.h"
 #include <string.h>
 
 #ifdef WOLFBOOT_UBOOT_LEGACY
@@ -119,6 +120,19 @@ int wolfBoot_ramboot(struct wolfBoot_image *img, uint8_t *src, uint8_t *dst)
 
     /* determine size of partition */
     img_size = wolfBoot_image_size((uint8_t*)dst);
+#ifdef WOLFBOOT_IMG_CHUNKS
+    /* Chunked images: the chunk table follows the firmware, load it too */
+    {
+        struct wolfBoot_image hdr_img;
+        memset(&hdr_img, 0, sizeof(hdr_img));
+        hdr_img.hdr = dst;
+        hdr_img.part = img->part;
+        hdr_img.fw_size = img_size;
+        hdr_img.hdr_ok = 1;
+        hdr_img.not_ext = 1;
+        img_size = wolfBoot_image_total_size(&hdr_img) - IMAGE_HEADER_SIZE;
+    }
+#endif
 #if !defined(WOLFBOOT_FIXED_PARTITIONS) && !defined(WOLFBOOT_RAMBOOT_MAX_SIZE)
 #  error "WOLFBOOT_FIXED_PARTITIONS or WOLFBOOT_RAMBOOT_MAX_SIZE required to bound the RAM load"
 #endif
@@ -171,15 +185,18 @@ int wolfBoot_ramboot(struct wolfBoot_image *img, uint8_t *src, uint8_t *dst)
     wolfBoot_printf("Loading image %d bytes from %p to %p...",
         img_size, src + IMAGE_HEADER_SIZE, dst + IMAGE_HEADER_SIZE);
     BENCHMARK_START();
+    BOOT_TIMING_BEGIN(WOLFBOOT_TIMING_COPY);
 #if defined(EXT_FLASH) && defined(NO_XIP)
     ret = ext_flash_read((uintptr_t)src + IMAGE_HEADER_SIZE,
                                     dst + IMAGE_HEADER_SIZE, img_size);
+    BOOT_TIMING_END(WOLFBOOT_TIMING_COPY);
     if (ret < 0) {
         wolfBoot_printf("Error reading image at %p\n", src);
         return -1;
     }
 #else
     memcpy(dst + IMAGE_HEADER_SIZE, src + IMAGE_HEADER_SIZE, img_size);
+    BOOT_TIMING_END(WOLFBOOT_TIMING_COPY);
 #endif
     BENCHMARK_END("done");
 
@@ -771,6 +788,11 @@ backup_on_failure:
         wolfBoot_printf("Error protecting bootloader flash region\n");
         wolfBoot_panic();
     }
+#endif
+    wolfBoot_mlog_handoff();
+#ifdef WOLFBOOT_BOOT_TIMING
+    (void)wolfBoot_timing_commit((uint8_t)active,
+        wolfBoot_get_blob_version(os_image.hdr));
 #endif
     hal_prepare_boot();
 
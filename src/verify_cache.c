@@ -0,0 +1,245 @@
+/* verify_cache.c
+ *
+ * Verification cache.
+ *
+ * After the signature of the boot image has been verified, a record is
+ * stored in flash with a MAC over the image digest, its version, the key
+ * slot and the public key used, keyed with a secret unique to the device.
+ * On the next boots the integrity check computes the digest as usual, and
+ * the signature verification is replaced by the check of the MAC, which is
+ * much cheaper than RSA, LMS, XMSS or ML-DSA. Any change (new image after
+ * an update, different key in the keystore, missing device secret, corrupted
+ * record) makes the MAC check fail, and the signature is verified again.
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "hal.h"
+#include "printf.h"
+#include "verify_cache.h"
+#include "keystore.h"
+#ifdef WOLFBOOT_TPM_KEYSTORE
+#include "tpm.h"
+#endif
+
+#ifdef WOLFBOOT_VERIFY_CACHE
+
+#include <wolfssl/wolfcrypt/hmac.h>
+
+#ifndef WOLFBOOT_VERIFY_CACHE_ADDRESS
+#error "VERIFY_CACHE requires WOLFBOOT_VERIFY_CACHE_ADDRESS"
+#endif
+#if defined(WOLFBOOT_NO_KEYSTORE) || defined(WOLFBOOT_NO_SIGN) || \
+    defined(WOLFBOOT_RENESAS_SCEPROTECT) || defined(WOLFBOOT_RENESAS_TSIP) || \
+    defined(WOLFBOOT_RENESAS_RSIP) || defined(WOLFBOOT_ENABLE_WOLFHSM_CLIENT) \
+    || defined(WOLFBOOT_ENABLE_WOLFHSM_SERVER)
+#error "VERIFY_CACHE requires the public keys in the wolfBoot keystore"
+#endif
+
+#if defined(WOLFBOOT_HASH_SHA256)
+#   define VCACHE_HMAC_TYPE WC_SHA256
+#elif defined(WOLFBOOT_HASH_SHA384)
+#   define VCACHE_HMAC_TYPE WC_SHA384
+#elif defined(WOLFBOOT_HASH_SHA3_384)
+#   define VCACHE_HMAC_TYPE WC_SHA3_384
+#endif
+
+#define VCACHE_RECORD \
+    ((const struct wolfBoot_verify_cache_record *) \
+        (uintptr_t)(WOLFBOOT_VERIFY_CACHE_ADDRESS))
+
+/* Label of the MAC key derived from the device secret */
+static const char vcache_label[] = "wolfBoot verify cache";
+
+static void vcache_put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/* Slot of the key of a HDR_PUBKEY / HDR_SECONDARY_PUBKEY hint, -1 if the key
+ * is not in the keystore */
+static int vcache_key_slot(struct wolfBoot_image *img, uint16_t hint_type)
+{
+    uint8_t *hint = NULL;
+    int slot;
+
+    if (wolfBoot_get_header(img, hint_type, &hint) != WOLFBOOT_SHA_DIGEST_SIZE)
+        return -1;
+    slot = keyslot_id_by_sha(hint);
+#ifdef WOLFBOOT_TPM_KEYSTORE
+    if ((slot >= 0) && (wolfBoot_check_rot(slot, hint) != 0))
+        slot = -1;
+#endif
+    return slot;
+}
+
+static void vcache_mac_key(Hmac *hmac, int slot)
+{
+    uint8_t buf[8];
+
+    vcache_put_le32(buf, (uint32_t)slot);
+    vcache_put_le32(buf + 4, keystore_get_mask(slot));
+    wc_HmacUpdate(hmac, buf, sizeof(buf));
+    wc_HmacUpdate(hmac, keystore_get_buffer(slot),
+        (word32)keystore_get_size(slot));
+}
+
+/* MAC of the image in its current state: integrity must have been checked,
+ * so that img->sha_hash is the digest of the image. */
+static int vcache_mac(struct wolfBoot_image *img, int slot, uint8_t *mac)
+{
+    uint8_t secret[WOLFBOOT_VERIFY_CACHE_SECRET_SIZE];
+    uint8_t key[WOLFBOOT_SHA_DIGEST_SIZE];
+    uint8_t buf[8];
+    Hmac hmac;
+    int ret;
+#ifdef SIGN_HYBRID
+    int slot2;
+#endif
+
+    if ((img->sha_hash == NULL) || (img->sha_ok != 1U))
+        return -1;
+    if (hal_verify_cache_secret(secret, sizeof(secret)) != 0)
+        return -1;
+
+    ret = wc_HmacInit(&hmac, NULL, INVALID_DEVID);
+    if (ret == 0) {
+        /* MAC key = HMAC(device secret, label) */
+        ret = wc_HmacSetKey(&hmac, VCACHE_HMAC_TYPE, secret, sizeof(secret));
+        if (ret == 0)
+            ret = wc_HmacUpdate(&hmac, (const byte *)vcache_label,
+                sizeof(vcache_label) - 1);
+        if (ret == 0)
+            ret = wc_HmacFinal(&hmac, key);
+        if (ret == 0)
+            ret = wc_HmacSetKey(&hmac, VCACHE_HMAC_TYPE, key, sizeof(key));
+        if (ret == 0) {
+            vcache_put_le32(buf, wolfBoot_get_blob_version(img->hdr));
+            vcache_put_le32(buf + 4, img->part);
+            wc_HmacUpdate(&hmac, img->sha_hash, WOLFBOOT_SHA_DIGEST_SIZE);
+            wc_HmacUpdate(&hmac, buf, sizeof(buf));
+            vcache_mac_key(&hmac, slot);
+#ifdef SIGN_HYBRID
+            slot2 = vcache_key_slot(img, HDR_SECONDARY_PUBKEY);
+            if (slot2 < 0)
+                ret = -1;
+            else
+                vcache_mac_key(&hmac, slot2);
+#endif
+        }
+        if (ret == 0)
+            ret = wc_HmacFinal(&hmac, mac);
+        wc_HmacFree(&hmac);
+    }
+    wc_ForceZero(secret, sizeof(secret));
+    wc_ForceZero(key, sizeof(key));
+    return (ret == 0) ? 0 : -1;
+}
+
+/* Compare the MAC of the image with the stored one. Like the signature
+ * verify functions, *res is set to 1 on a match, for VERIFY_FN(). */
+static int vcache_verify_mac(struct wolfBoot_image *img, int slot,
+    const uint8_t *expected, int *res)
+{
+    uint8_t mac[WOLFBOOT_SHA_DIGEST_SIZE];
+    int ret;
+
+    *res = 0;
+    ret = vcache_mac(img, slot, mac);
+    if ((ret == 0) &&
+            (wolfBoot_hardened_CT_compare(mac, expected, sizeof(mac)) == 0))
+        *res = 1;
+    wc_ForceZero(mac, sizeof(mac));
+    return ret;
+}
+
+int wolfBoot_verify_cache_check(struct wolfBoot_image *img)
+{
+    const struct wolfBoot_verify_cache_record *rec = VCACHE_RECORD;
+    int verify_res = 0;
+    int slot;
+
+    if (img == NULL)
+        return -1;
+    if ((rec->magic != WOLFBOOT_VERIFY_CACHE_MAGIC) ||
+        (rec->version != wolfBoot_get_blob_version(img->hdr)))
+        return -1;
+    slot = vcache_key_slot(img, HDR_PUBKEY);
+    if ((slot < 0) || ((uint32_t)slot != rec->key_slot))
+        return -1;
+    /* The match is confirmed through the hardened checks of VERIFY_FN(),
+     * as for a signature: with WOLFBOOT_ARMORED, skipping one branch does
+     * not set signature_ok. */
+    VERIFY_FN(img, &verify_res, vcache_verify_mac, img, slot, rec->mac,
+        &verify_res);
+    if (!SIG_OK(img))
+        return -1;
+    return 0;
+}
+
+int wolfBoot_verify_cache_store(struct wolfBoot_image *img)
+{
+    struct wolfBoot_verify_cache_record rec;
+    int slot;
+    int ret;
+
+    if ((img == NULL) || (img->signature_ok != 1U))
+        return -1;
+    slot = vcache_key_slot(img, HDR_PUBKEY);
+    if (slot < 0)
+        return -1;
+    memset(&rec, 0, sizeof(rec));
+    rec.magic = WOLFBOOT_VERIFY_CACHE_MAGIC;
+    rec.version = wolfBoot_get_blob_version(img->hdr);
+    rec.key_slot = (uint32_t)slot;
+    if (vcache_mac(img, slot, rec.mac) != 0)
+        return -1;
+    /* Unchanged record: no flash cycle */
+    if (memcmp(&rec, VCACHE_RECORD, sizeof(rec)) == 0)
+        return 0;
+
+    hal_flash_unlock();
+    ret = hal_flash_erase(WOLFBOOT_VERIFY_CACHE_ADDRESS, WOLFBOOT_SECTOR_SIZE);
+    if (ret == 0)
+        ret = hal_flash_write(WOLFBOOT_VERIFY_CACHE_ADDRESS,
+            (const uint8_t *)&rec, sizeof(rec));
+    hal_flash_lock();
+    return (ret == 0) ? 0 : -1;
+}
+
+int wolfBoot_verify_authenticity_cached(struct wolfBoot_image *img)
+{
+    int ret;
+
+    if ((wolfBoot_verify_cache_check(img) == 0) && SIG_OK(img)) {
+        wolfBoot_printf("(cached) ");
+        return 0;
+    }
+    ret = wolfBoot_verify_authenticity(img);
+    if ((ret == 0) && (wolfBoot_verify_cache_store(img) != 0))
+        wolfBoot_printf("Verify cache: record not stored\n");
+    return ret;
+}
+
+#endif /* WOLFBOOT_VERIFY_CACHE */
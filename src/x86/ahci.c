@@ -85,6 +85,10 @@
 #define HBA_TBL_SIZE 0x800
 #define HBA_TBL_ALIGN 0x80
 
+#if (ATA_CMD_SLOTS * ATA_CMD_TABLE_SIZE) > HBA_TBL_SIZE
+#error "Command tables of the ATA_CMD_SLOTS slots do not fit in HBA_TBL_SIZE"
+#endif
+
 static uint8_t ahci_hba_fis[HBA_FIS_SIZE * AHCI_MAX_PORTS]
 __attribute__((aligned(HBA_FIS_SIZE)));
 static uint8_t ahci_hba_clb[HBA_CLB_SIZE * AHCI_MAX_PORTS]
@@ -60,7 +60,7 @@ static int ata_drive_count = -1;
 struct ata_async_info{
     int in_progress;
     int drv;
-    int slot;
+    uint32_t slots;
 };
 
 static struct ata_async_info ata_async_info;
@@ -78,6 +78,7 @@ struct ata_drive {
     uint8_t  sector_cache[MAX_SECTOR_SIZE];
     uint64_t cached;
     enum ata_security_state sec;
+    unsigned ncq_depth;
 };
 
 /**
@@ -106,7 +107,7 @@ struct __attribute__((packed)) hba_cmd_table {
     uint8_t cfis[64];
     uint8_t acmd[16];
     uint8_t _res[48];
-    struct hba_prdt_entry prdt_entry[8];
+    struct hba_prdt_entry prdt_entry[ATA_PRDT_ENTRIES];
 };
 
 /**
@@ -209,9 +210,21 @@ int ata_drive_new(uint32_t ahci_base, unsigned ahci_port, uint32_t clb,
     return ata_drive_count;
 }
 
+/**
+ * @brief This static function returns the command table of a command slot.
+ * Each slot owns one table in the area given to ata_drive_new(), so that
+ * queued commands do not overwrite each other's FIS and PRDT.
+ */
+static struct hba_cmd_table *cmd_table(struct ata_drive *ata, int slot)
+{
+    return (struct hba_cmd_table *)(uintptr_t)(ata->ctable_port +
+            slot * sizeof(struct hba_cmd_table));
+}
+
 /**
  * @brief This static function finds an available command slot for the specified
- * ATA drive and returns the slot number.
+ * ATA drive and returns the slot number. Only the slots that have a command
+ * table (ATA_CMD_SLOTS) are considered.
  *
  * @param[in] drv The index of the ATA drive in the ATA_Drv array.
  *
@@ -226,7 +239,7 @@ static int find_cmd_slot(int drv)
     sact = mmio_read32((AHCI_PxSACT(ata->ahci_base, ata->ahci_port)));
     ci = mmio_read32((AHCI_PxCI(ata->ahci_base, ata->ahci_port)));
     slots = sact | ci;
-    for (i = 0; i < 32; i++) {
+    for (i = 0; i < ATA_CMD_SLOTS; i++) {
         if ((slots & 1) == 0)
             return i;
         slots >>= 1;
@@ -236,40 +249,109 @@ static int find_cmd_slot(int drv)
 }
 
 /**
- * @brief This static function prepares a command slot for DMA data transfer by
- * initializing the command header and command table entries.
+ * @brief This static function initializes the command header and the command
+ * table of the given slot for DMA data transfer. The buffer is described by
+ * as many PRDT entries as needed, up to ATA_PRDT_ENTRIES of
+ * ATA_PRDT_MAX_BYTES each.
  *
  * @param[in] drv The index of the ATA drive in the ATA_Drv array.
+ * @param[in] slot The command slot to prepare.
  * @param[in] buf The buffer containing the data to be transferred.
  * @param[in] sz The size of the data to be transferred in bytes.
+ * @param[in] w 1 if the data is written to the device, 0 otherwise.
  *
- * @return The index of the prepared command slot if successful, or -1 if an error
- * occurs.
+ * @return 0 if successful, or -1 if the buffer does not fit in the PRDT.
  */
-static int prepare_cmd_h2d_slot(int drv, const uint8_t *buf, int sz, int w)
+static int prepare_cmd_h2d(int drv, int slot, const uint8_t *buf, uint32_t sz,
+        int w)
 {
     struct hba_cmd_header *cmd;
     struct hba_cmd_table *tbl;
     struct ata_drive *ata = &ATA_Drv[drv];
-    int slot = find_cmd_slot(drv);
-    if (slot < 0) {
-        wolfBoot_printf("ATA: Operation aborted: no free command slot\r\n");
+    uint32_t len;
+    int i = 0;
+
+    if (sz == 0 || sz > ATA_PRDT_ENTRIES * ATA_PRDT_MAX_BYTES) {
+        wolfBoot_printf("ATA: Operation aborted: invalid transfer size\r\n");
         return -1;
     }
     cmd = (struct hba_cmd_header *)(uintptr_t)ata->clb_port;
     cmd += slot;
+    tbl = cmd_table(ata, slot);
     memset(cmd, 0, sizeof(struct hba_cmd_header));
     cmd->cfl = FIS_LEN_H2D / 4;
-    cmd->ctba = (uint32_t)(ata->ctable_port);
-    tbl = (struct hba_cmd_table *)(uintptr_t)(ata->ctable_port);
+    cmd->ctba = (uint32_t)(uintptr_t)tbl;
     memset(tbl, 0, sizeof(struct hba_cmd_table));
-    cmd->prdtl = 1;
     cmd->w = w;
-    tbl->prdt_entry[0].dba = (uint32_t)(uintptr_t)buf;
-    tbl->prdt_entry[0].dbc = sz - 1;
+    while (sz > 0) {
+        len = sz;
+        if (len > ATA_PRDT_MAX_BYTES)
+            len = ATA_PRDT_MAX_BYTES;
+        tbl->prdt_entry[i].dba = (uint32_t)(uintptr_t)buf;
+        tbl->prdt_entry[i].dbc = len - 1;
+        buf += len;
+        sz -= len;
+        i++;
+    }
+    cmd->prdtl = i;
+    return 0;
+}
+
+/**
+ * @brief This static function finds a free command slot and prepares it for
+ * DMA data transfer, see prepare_cmd_h2d().
+ *
+ * @param[in] drv The index of the ATA drive in the ATA_Drv array.
+ * @param[in] buf The buffer containing the data to be transferred.
+ * @param[in] sz The size of the data to be transferred in bytes.
+ * @param[in] w 1 if the data is written to the device, 0 otherwise.
+ *
+ * @return The index of the prepared command slot if successful, or -1 if an error
+ * occurs.
+ */
+static int prepare_cmd_h2d_slot(int drv, const uint8_t *buf, uint32_t sz, int w)
+{
+    int slot = find_cmd_slot(drv);
+    if (slot < 0) {
+        wolfBoot_printf("ATA: Operation aborted: no free command slot\r\n");
+        return -1;
+    }
+    if (prepare_cmd_h2d(drv, slot, buf, sz, w) < 0)
+        return -1;
     return slot;
 }
 
+/**
+ * @brief This static function polls the command slots of the asynchronous
+ * operation in progress. Slots whose command has completed are removed from
+ * the operation and returned in `completed`.
+ *
+ * @param[out] completed The slots completed since the previous poll.
+ *
+ * @return
+ *   - 0: All the commands of the operation completed successfully.
+ *   - ATA_ERR_BUSY: Some commands are still in progress.
+ *   - -1: ATA Task File error.
+ */
+static int ata_async_poll(uint32_t *completed)
+{
+    struct ata_drive *ata = &ATA_Drv[ata_async_info.drv];
+    uint32_t busy;
+
+    *completed = 0;
+    if (mmio_read32(AHCI_PxIS(ata->ahci_base, ata->ahci_port)) & AHCI_PORT_IS_TFES) {
+        ata_async_info.slots = 0;
+        return -1;
+    }
+    busy = mmio_read32(AHCI_PxSACT(ata->ahci_base, ata->ahci_port)) |
+        mmio_read32(AHCI_PxCI(ata->ahci_base, ata->ahci_port));
+    *completed = ata_async_info.slots & ~busy;
+    ata_async_info.slots &= busy;
+    if (ata_async_info.slots != 0)
+        return ATA_ERR_BUSY;
+    return 0;
+}
+
 /**
  * @brief Check the completion status of an asynchronous ATA command.
  *
@@ -284,23 +366,15 @@ static int prepare_cmd_h2d_slot(int drv, const uint8_t *buf, int sz, int w)
  */
 int ata_cmd_complete_async()
 {
-    struct ata_drive *ata;
-    int slot;
+    uint32_t completed;
+    int ret;
 
     if (!ata_async_info.in_progress)
         return ATA_ERR_OP_NOT_IN_PROGRESS;
-    ata = &ATA_Drv[ata_async_info.drv];
-    if (mmio_read32(AHCI_PxIS(ata->ahci_base, ata->ahci_port)) & AHCI_PORT_IS_TFES) {
+    ret = ata_async_poll(&completed);
+    if (ret != ATA_ERR_BUSY)
         ata_async_info.in_progress = 0;
-        return -1;
-    }
-
-    slot = ata_async_info.slot;
-    if ((mmio_read32(AHCI_PxCI(ata->ahci_base, ata->ahci_port)) & (1 << slot)) != 0)
-        return ATA_ERR_BUSY;
-
-    ata_async_info.in_progress = 0;
-    return 0;
+    return ret;
 }
 
 /**
@@ -344,7 +418,7 @@ static int exec_cmd_slot_ex(int drv, int slot, int async)
     if (async) {
         ata_async_info.in_progress = 1;
         ata_async_info.drv = drv;
-        ata_async_info.slot = slot;
+        ata_async_info.slots = (1U << slot);
         return ATA_ERR_BUSY;
     }
 
@@ -393,6 +467,9 @@ static uint8_t buffer[ATA_BUF_SIZE];
 #define ATA_ID_MODEL_NO_LEN  40
 
 
+#define ATA_ID_QUEUE_DEPTH_POS 75 * 2
+#define ATA_ID_SATA_CAPABILITIES_POS 76 * 2
+#define ATA_ID_SATA_CAP_NCQ (1 << 8)
 #define ATA_ID_COMMAND_SET_SUPPORTED_POS 82 * 2
 #define ATA_ID_SECURITY_STATUS_POS 128 * 2
 
@@ -653,6 +730,26 @@ int ata_identify_device(int drv)
                 ATA_ID_MODEL_NO_LEN);
         ATA_DEBUG_PRINTF("Model: %s\r\n", model_no);
 
+        ata->ncq_depth = 0;
+#ifdef WOLFBOOT_AHCI_NCQ
+        {
+            uint16_t sata_cap, queue_depth;
+            uint32_t hba_cap;
+            memcpy(&sata_cap, buffer + ATA_ID_SATA_CAPABILITIES_POS, 2);
+            memcpy(&queue_depth, buffer + ATA_ID_QUEUE_DEPTH_POS, 2);
+            hba_cap = mmio_read32(AHCI_HBA_CAP(ata->ahci_base));
+            if ((sata_cap != 0xFFFF) && (sata_cap & ATA_ID_SATA_CAP_NCQ) &&
+                    (hba_cap & AHCI_CAP_SNCQ)) {
+                ata->ncq_depth = (queue_depth & 0x1F) + 1;
+                if (ata->ncq_depth > AHCI_CAP_NCS(hba_cap))
+                    ata->ncq_depth = AHCI_CAP_NCS(hba_cap);
+                if (ata->ncq_depth > ATA_NCQ_MAX_SLOTS)
+                    ata->ncq_depth = ATA_NCQ_MAX_SLOTS;
+            }
+            ATA_DEBUG_PRINTF("NCQ queue depth: %u\r\n", ata->ncq_depth);
+        }
+#endif
+
 
         ATA_DEBUG_PRINTF("Security mode information:\r\n");
         memcpy(&cmd_set_supported, buffer + ATA_ID_COMMAND_SET_SUPPORTED_POS, 2);
@@ -712,7 +809,21 @@ enum ata_security_state ata_security_get_state(int drv)
     return ata->sec;
 }
 
-static int ata_drive_read_sector(int drv, uint64_t start, uint32_t count,
+/**
+ * @brief This static function returns the largest number of sectors moved by
+ * a single DMA command: limited by the 16-bit sector count of the FIS and by
+ * the size of the PRDT.
+ */
+static uint32_t ata_max_xfer_sectors(struct ata_drive *ata)
+{
+    uint32_t max = (ATA_PRDT_ENTRIES * ATA_PRDT_MAX_BYTES) >>
+        ata->sector_size_shift;
+    if (max > 0xFFFF)
+        max = 0xFFFF;
+    return max;
+}
+
+static int ata_drive_read_cmd(int drv, uint64_t start, uint32_t count,
         uint8_t *buf)
 {
     struct ata_drive *ata = &ATA_Drv[drv];
@@ -738,10 +849,137 @@ static int ata_drive_read_sector(int drv, uint64_t start, uint32_t count,
     cmdfis->lba5 = (uint8_t)((start >> 40) & 0xFF);
     cmdfis->device = (1 << 6); /* LBA mode */
     cmdfis->count = (uint16_t)(count & 0xFFFF);
-    exec_cmd_slot(drv, slot);
+    if (exec_cmd_slot(drv, slot) != 0)
+        return -1;
     return count << ata->sector_size_shift;
 }
 
+/**
+ * @brief This static function reads `count` sectors with READ DMA EXT,
+ * one command at a time, each command moving up to ata_max_xfer_sectors().
+ */
+static int ata_drive_read_sector(int drv, uint64_t start, uint32_t count,
+        uint8_t *buf)
+{
+    struct ata_drive *ata = &ATA_Drv[drv];
+    uint32_t max = ata_max_xfer_sectors(ata);
+    uint32_t n, done = 0;
+
+    while (done < count) {
+        n = count - done;
+        if (n > max)
+            n = max;
+        if (ata_drive_read_cmd(drv, start + done, n,
+                    buf + (done << ata->sector_size_shift)) < 0)
+            return -1;
+        done += n;
+    }
+    return count << ata->sector_size_shift;
+}
+
+#ifdef WOLFBOOT_AHCI_NCQ
+/**
+ * @brief This static function prepares the command slot `tag` with a READ
+ * FPDMA QUEUED command and issues it. The command is added to the
+ * asynchronous operation in progress.
+ */
+static int ata_ncq_issue(int drv, int tag, uint64_t start, uint32_t count,
+        uint8_t *buf)
+{
+    struct ata_drive *ata = &ATA_Drv[drv];
+    struct hba_cmd_header *cmd;
+    struct hba_cmd_table *tbl;
+    struct fis_reg_h2d *cmdfis;
+
+    if (prepare_cmd_h2d(drv, tag, buf, count << ata->sector_size_shift, 0) < 0)
+        return -1;
+    cmd = (struct hba_cmd_header *)(uintptr_t)ata->clb_port;
+    cmd += tag;
+    tbl = (struct hba_cmd_table *)(uintptr_t)cmd->ctba;
+    cmdfis = (struct fis_reg_h2d *)(&tbl->cfis);
+    cmdfis->fis_type = FIS_TYPE_REG_H2D;
+    cmdfis->c = 1;
+    cmdfis->command = ATA_CMD_READ_FPDMA_QUEUED;
+    cmdfis->lba0 = (uint8_t)(start & 0xFF);
+    cmdfis->lba1 = (uint8_t)((start >> 8) & 0xFF);
+    cmdfis->lba2 = (uint8_t)((start >> 16) & 0xFF);
+    cmdfis->lba3 = (uint8_t)((start >> 24) & 0xFF);
+    cmdfis->lba4 = (uint8_t)((start >> 32) & 0xFF);
+    cmdfis->lba5 = (uint8_t)((start >> 40) & 0xFF);
+    cmdfis->device = (1 << 6); /* LBA mode */
+    /* Sector count in the feature field, tag in the count field */
+    cmdfis->feature_l = (uint8_t)(count & 0xFF);
+    cmdfis->feature_h = (uint8_t)((count >> 8) & 0xFF);
+    cmdfis->count = (uint16_t)(tag << 3);
+
+    ata_async_info.slots |= (1U << tag);
+    mmio_write32(AHCI_PxSACT(ata->ahci_base, ata->ahci_port), 1U << tag);
+    mmio_write32(AHCI_PxCI(ata->ahci_base, ata->ahci_port), 1U << tag);
+    return 0;
+}
+
+/**
+ * @brief This static function reads `count` sectors with READ FPDMA QUEUED.
+ * The transfer is split in commands of ATA_NCQ_XFER_SECTORS, and up to
+ * `ncq_depth` of them are kept in flight: the completion poller returns the
+ * tags of the finished commands, which are immediately reused for the next
+ * part of the transfer.
+ *
+ * @return The number of bytes read, -1 on error, or ATA_ERR_OP_IN_PROGRESS
+ * if another asynchronous operation is already in progress.
+ */
+static int ata_drive_read_ncq(int drv, uint64_t start, uint32_t count,
+        uint8_t *buf)
+{
+    struct ata_drive *ata = &ATA_Drv[drv];
+    uint32_t free_tags, completed, reg;
+    uint32_t n, done = 0;
+    int tag, ret, err = 0;
+
+    if (ata_async_info.in_progress)
+        return ATA_ERR_OP_IN_PROGRESS;
+
+    /* Clear IS */
+    reg = mmio_read32(AHCI_PxIS(ata->ahci_base, ata->ahci_port));
+    mmio_write32(AHCI_PxIS(ata->ahci_base, ata->ahci_port), reg);
+
+    /* Wait until port not busy */
+    while (mmio_read32(AHCI_PxTFD(ata->ahci_base, ata->ahci_port)) & (ATA_DEV_BUSY | ATA_DEV_DRQ))
+        ;
+
+    ata_async_info.in_progress = 1;
+    ata_async_info.drv = drv;
+    ata_async_info.slots = 0;
+    free_tags = (1U << ata->ncq_depth) - 1;
+    do {
+        for (tag = 0; (done < count) && (tag < (int)ata->ncq_depth); tag++) {
+            if ((free_tags & (1U << tag)) == 0)
+                continue;
+            n = count - done;
+            if (n > ATA_NCQ_XFER_SECTORS)
+                n = ATA_NCQ_XFER_SECTORS;
+            if (ata_ncq_issue(drv, tag, start + done, n,
+                        buf + (done << ata->sector_size_shift)) < 0) {
+                /* Nothing else is issued: drain the commands in flight */
+                err = 1;
+                count = done;
+                break;
+            }
+            free_tags &= ~(1U << tag);
+            done += n;
+        }
+        ret = ata_async_poll(&completed);
+        free_tags |= completed;
+    } while ((ret == ATA_ERR_BUSY) || ((ret == 0) && (done < count)));
+    ata_async_info.in_progress = 0;
+    if (ret != 0 || err) {
+        wolfBoot_printf("ATA: NCQ read error\r\n");
+        return -1;
+    }
+    return done << ata->sector_size_shift;
+}
+#endif /* WOLFBOOT_AHCI_NCQ */
+
 static int ata_drive_write_sector(int drv, uint64_t start, uint32_t count,
         const uint8_t *buf)
 {
@@ -837,7 +1075,14 @@ int ata_drive_read(int drv, uint64_t start, uint32_t size, uint8_t *buf)
     if (size > 0)
         count = size >> ata->sector_size_shift;
     if (count > 0) {
-        if (ata_drive_read_sector(drv, sect_start, count, buf + buffer_off) < 0)
+        int ret;
+#ifdef WOLFBOOT_AHCI_NCQ
+        if (ata->ncq_depth > 1 && count > ATA_NCQ_XFER_SECTORS)
+            ret = ata_drive_read_ncq(drv, sect_start, count, buf + buffer_off);
+        else
+#endif
+        ret = ata_drive_read_sector(drv, sect_start, count, buf + buffer_off);
+        if (ret < 0)
             return -1;
         size -= (count << ata->sector_size_shift);
         buffer_off += (count << ata->sector_size_shift);
@@ -122,6 +122,17 @@ int do_cmd(const char *cmd)
             printf("TLV 0x%x: not found!\r\n", tlv);
         }
     }
+#ifdef WOLFBOOT_IMG_CHUNKS_LAZY
+    /* verifies the chunks of the running image that wolfBoot left */
+    if (strcmp(cmd, "lazy_verify") == 0) {
+        int ret;
+
+        while ((ret = wolfBoot_lazy_verify_next()) > 0)
+            ;
+        printf("lazy verify: %s\n", (ret == 0) ? "OK" : "FAIL");
+        return (ret == 0) ? 0 : -1;
+    }
+#endif
 #ifdef WOLFBOOT_SELF_HEADER
     if (strcmp(cmd, "verify_self") == 0) {
         struct wolfBoot_image img;
@@ -28,11 +28,16 @@ ifeq ($(ARCH),)
   EXT_FLASH?=0
   SPI_FLASH?=0
   QSPI_FLASH?=0
+  SPI_FLASH_SFDP?=0
+  SPI_FLASH_DMA?=0
   NO_XIP?=0
   UART_FLASH?=0
+  UART_FLASH_V2?=0
   ALLOW_DOWNGRADE?=0
   NVM_FLASH_WRITEONCE?=0
+  NVM_FLASH_LOG?=0
   DISABLE_BACKUP?=0
+  SWAP_SKIP_UNCHANGED?=0
   WOLFBOOT_VERSION?=0
   V?=0
   LMS_LEVELS?=0
@@ -56,6 +61,11 @@ ifeq ($(ARCH),)
   WOLFTPM?=0
   WOLFBOOT_TPM_VERIFY?=0
   MEASURED_BOOT?=0
+  MEASURE_LOG?=0
+  MEASURE_LOG_ADDRESS?=
+  MEASURE_LOG_SIZE?=
+  VERIFY_CACHE?=0
+  VERIFY_CACHE_ADDRESS?=
   WOLFBOOT_TPM_SEAL?=0
   WOLFBOOT_TPM_KEYSTORE?=0
   WOLFBOOT_TPM_MFG_AUTH_DERIVE?=0
@@ -83,13 +93,22 @@ ifeq ($(ARCH),)
   DELTA_UPDATES?=0
   DELTA_BLOCK_SIZE?=256
   WOLFBOOT_IMG_HASH_ONESHOT?=0
+  IMG_CHUNKS?=0
+  IMG_CHUNK_SIZE?=0x10000
+  IMG_CHUNKS_PARALLEL?=0
+  IMG_CHUNKS_LAZY?=0
+  IMG_CHUNKS_LAZY_PREFIX?=0x4000
+  MP_DISPATCH?=0
   WOLFBOOT_HUGE_STACK?=0
   ARMORED?=0
   ELF?=0
   FORCE_32BIT=0
   DISK_LOCK?=0
   DISK_LOCK_PASSWORD?=
+  AHCI_NCQ?=0
   FLASH_OTP_KEYSTORE?=0
+  KEYSTORE_HINTS?=0
+  KEYSTORE_HINTS_VERIFY?=0
   BIG_ENDIAN?=0
   FLASH_MULTI_SECTOR_ERASE=0
   WOLFHSM_CLIENT=0
@@ -103,10 +122,13 @@ WOLFBOOT_LOAD_RAMDISK_ADDRESS?=0
 
 CONFIG_VARS:= ARCH TARGET SIGN HASH MCUXSDK MCUXPRESSO MCUXPRESSO_CPU MCUXPRESSO_DRIVERS \
 	MCUXPRESSO_CMSIS FREEDOM_E_SDK STM32CUBE CYPRESS_PDL CYPRESS_CORE_LIB CYPRESS_TARGET_LIB DEBUG VTOR \
-	CORTEX_M0 CORTEX_M7 CORTEX_M33 CORTEX_M55 NO_ASM EXT_FLASH SPI_FLASH NO_XIP UART_FLASH ALLOW_DOWNGRADE NVM_FLASH_WRITEONCE \
-	DISABLE_BACKUP WOLFBOOT_VERSION V NO_MPU ENCRYPT FLAGS_HOME FLAGS_INVERT \
+	CORTEX_M0 CORTEX_M7 CORTEX_M33 CORTEX_M55 NO_ASM EXT_FLASH SPI_FLASH SPI_FLASH_SFDP SPI_FLASH_DMA NO_XIP UART_FLASH UART_FLASH_V2 ALLOW_DOWNGRADE NVM_FLASH_WRITEONCE \
+	NVM_FLASH_LOG \
+	DISABLE_BACKUP SWAP_SKIP_UNCHANGED WOLFBOOT_VERSION V NO_MPU ENCRYPT FLAGS_HOME FLAGS_INVERT \
 	SPMATH SPMATHALL RAM_CODE DUALBANK_SWAP IMAGE_HEADER_SIZE PKA TZEN PSOC6_CRYPTO \
-	WOLFTPM WOLFBOOT_TPM_VERIFY MEASURED_BOOT WOLFBOOT_TPM_SEAL WOLFBOOT_TPM_KEYSTORE \
+	WOLFTPM WOLFBOOT_TPM_VERIFY MEASURED_BOOT MEASURE_LOG MEASURE_LOG_ADDRESS \
+	MEASURE_LOG_SIZE VERIFY_CACHE VERIFY_CACHE_ADDRESS \
+	WOLFBOOT_TPM_SEAL WOLFBOOT_TPM_KEYSTORE \
 	WOLFBOOT_TPM_MFG_AUTH_DERIVE \
 	WOLFBOOT_ATTESTATION_IAK \
 	WOLFBOOT_ATTESTATION_TEST \
@@ -122,17 +144,22 @@ CONFIG_VARS:= ARCH TARGET SIGN HASH MCUXSDK MCUXPRESSO MCUXPRESSO_CPU MCUXPRESSO
 	WOLFBOOT_LOAD_DTS_ADDRESS WOLFBOOT_LOAD_RAMDISK_ADDRESS \
 	WOLFBOOT_DTS_BOOT_ADDRESS WOLFBOOT_DTS_UPDATE_ADDRESS \
 	WOLFBOOT_SMALL_STACK DELTA_UPDATES DELTA_BLOCK_SIZE WOLFBOOT_IMG_HASH_ONESHOT \
+	IMG_CHUNKS IMG_CHUNK_SIZE IMG_CHUNKS_PARALLEL \
+	IMG_CHUNKS_LAZY IMG_CHUNKS_LAZY_PREFIX MP_DISPATCH \
 	WOLFBOOT_HUGE_STACK FORCE_32BIT\
 	ENCRYPT_WITH_CHACHA ENCRYPT_WITH_AES128 ENCRYPT_WITH_AES256 ARMORED \
 	LMS_LEVELS LMS_HEIGHT LMS_WINTERNITZ \
 	WOLFBOOT_UNIVERSAL_KEYSTORE \
 	XMSS_PARAMS \
 	ELF BIG_ENDIAN \
-	GZIP FIT_RAMDISK \
+	GZIP GZIP_FAST GZIP_CRC32_TABLE FIT_RAMDISK FDT_INDEX \
 	NXP_CUSTOM_DCD NXP_CUSTOM_DCD_OBJS \
 	FLASH_OTP_KEYSTORE \
+	KEYSTORE_HINTS KEYSTORE_HINTS_VERIFY \
+	AHCI_NCQ \
 	KEYVAULT_OBJ_SIZE \
 	KEYVAULT_MAX_ITEMS \
+	KEYVAULT_LOG \
 	NO_ARM_ASM \
 	SIGN_SECONDARY \
 	WOLFHSM_CLIENT \
@@ -0,0 +1,245 @@
+/* bmdiff-bench.c
+ *
+ * Compare patch size and wall time of the linear and the indexed
+ * wb_diff() match engines.
+ *
+ * Usage: bmdiff-bench [-n] base new
+ *        bmdiff-bench [-n] -s size
+ *
+ * The first form diffs two existing images, the second one generates a
+ * synthetic pair (shifted code, erased padding, a few patched bytes) of
+ * 'size' bytes. With -n the (quadratic) linear scan is skipped.
+ * WOLFBOOT_SECTOR_SIZE must be set in the environment, as for bmdiff.
+ *
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "delta.h"
+
+#define MAX_SRC_SIZE (1 << 24)
+#define BENCH_BLOCK_SIZE 4096
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1000000.0);
+}
+
+static uint8_t *load_file(const char *path, uint32_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t *buf = NULL;
+    long sz;
+
+    if (f == NULL) {
+        printf("Cannot open file %s\n", path);
+        return NULL;
+    }
+    fseek(f, 0L, SEEK_END);
+    sz = ftell(f);
+    fseek(f, 0L, SEEK_SET);
+    if ((sz <= 0) || (sz > MAX_SRC_SIZE)) {
+        printf("%s: invalid file size\n", path);
+    } else {
+        buf = malloc(sz);
+        if ((buf != NULL) && ((long)fread(buf, 1, sz, f) != sz)) {
+            free(buf);
+            buf = NULL;
+        }
+    }
+    fclose(f);
+    *len = (uint32_t)sz;
+    return buf;
+}
+
+static void gen_images(uint32_t size, uint8_t **a, uint8_t **b)
+{
+    uint32_t seed = 0x2545F491U;
+    uint32_t i;
+
+    *a = malloc(size);
+    *b = malloc(size);
+    if ((*a == NULL) || (*b == NULL)) {
+        printf("Out of memory\n");
+        exit(1);
+    }
+    for (i = 0; i < size; i++) {
+        seed = (seed * 1664525U) + 1013904223U;
+        /* Low-entropy "code": a small alphabet gives many short matches */
+        (*a)[i] = (uint8_t)((seed >> 24) & 0x3F);
+    }
+    /* Erased padding at the end of the base image */
+    memset(*a + size - (size / 8), 0xFF, size / 8);
+    /* New image: 200 bytes inserted near the start, a patched table in
+     * the middle and some bytes flipped every 64 KB.
+     */
+    memcpy(*b, *a, 128);
+    for (i = 128; i < 328; i++)
+        (*b)[i] = (uint8_t)i;
+    memcpy(*b + 328, *a + 128, size - 328);
+    for (i = size / 2; i < (size / 2) + 512; i++)
+        (*b)[i] ^= 0x5A;
+    for (i = 0; i < size; i += 65536)
+        (*b)[i] ^= 0x01;
+}
+
+static int run_diff(uint8_t *a, uint32_t len_a, uint8_t *b, uint32_t len_b,
+        int indexed, uint8_t **patch, uint32_t *patch_len, double *ms,
+        double *index_ms)
+{
+    WB_DIFF_CTX ctx;
+    uint32_t cap = len_b + (len_b / 2) + BENCH_BLOCK_SIZE;
+    uint32_t off = 0;
+    double t0;
+    int r;
+
+    *patch = malloc(cap);
+    if (*patch == NULL)
+        return -1;
+    t0 = now_ms();
+    if (wb_diff_init(&ctx, a, len_a, b, len_b) < 0)
+        return -1;
+    *index_ms = 0;
+    if (indexed) {
+        if (wb_diff_index_build(&ctx) < 0)
+            return -1;
+        *index_ms = now_ms() - t0;
+    }
+    do {
+        if (cap - off < BENCH_BLOCK_SIZE)
+            return -1;
+        r = wb_diff(&ctx, *patch + off, BENCH_BLOCK_SIZE);
+        if (r < 0)
+            return -1;
+        off += r;
+    } while (r > 0);
+    wb_diff_index_free(&ctx);
+    *ms = now_ms() - t0;
+    *patch_len = off;
+    return 0;
+}
+
+/* Apply the patch in place, as bmpatch and wolfBoot do: sectors already
+ * written replace the base, so backward references read the new image.
+ */
+static int check_patch(uint8_t *a, uint32_t len_a, uint8_t *b, uint32_t len_b,
+        uint8_t *patch, uint32_t patch_len)
+{
+    WB_PATCH_CTX ctx;
+    uint32_t blk_sz = (uint32_t)wb_diff_get_sector_size();
+    uint32_t img_sz = (len_a > len_b) ? len_a : len_b;
+    uint8_t *img = calloc(1, img_sz);
+    uint8_t *blk = malloc(blk_sz);
+    uint32_t off = 0;
+    int ret = -1;
+    int r;
+
+    if ((img == NULL) || (blk == NULL))
+        goto out;
+    memcpy(img, a, len_a);
+    if (wb_patch_init(&ctx, img, len_a, patch, patch_len) != 0)
+        goto out;
+    do {
+        r = wb_patch(&ctx, blk, blk_sz);
+        if ((r < 0) || (off + r > len_b))
+            goto out;
+        memcpy(img + off, blk, r);
+        off += r;
+    } while (r > 0);
+    if ((off == len_b) && (memcmp(img, b, len_b) == 0))
+        ret = 0;
+out:
+    free(blk);
+    free(img);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    uint8_t *a = NULL, *b = NULL;
+    uint32_t len_a = 0, len_b = 0;
+    uint8_t *p_lin = NULL, *p_idx = NULL;
+    uint32_t len_lin = 0, len_idx = 0;
+    double ms_lin = 0, ms_idx = 0, ms_build = 0, dummy;
+    int linear = 1;
+    int argi = 1;
+
+    if ((argc > argi) && (strcmp(argv[argi], "-n") == 0)) {
+        linear = 0;
+        argi++;
+    }
+    if ((argc == argi + 2) && (strcmp(argv[argi], "-s") == 0)) {
+        len_a = len_b = (uint32_t)strtoul(argv[argi + 1], NULL, 0);
+        if ((len_a < 1024) || (len_a > MAX_SRC_SIZE)) {
+            printf("Invalid size\n");
+            return 2;
+        }
+        gen_images(len_a, &a, &b);
+    } else if (argc == argi + 2) {
+        a = load_file(argv[argi], &len_a);
+        b = load_file(argv[argi + 1], &len_b);
+        if ((a == NULL) || (b == NULL))
+            return 3;
+    } else {
+        printf("Usage: %s [-n] base new | %s [-n] -s size\n", argv[0],
+                argv[0]);
+        return 2;
+    }
+
+    if (run_diff(a, len_a, b, len_b, 1, &p_idx, &len_idx, &ms_idx,
+                &ms_build) < 0) {
+        printf("indexed diff failed\n");
+        return 4;
+    }
+    if (check_patch(a, len_a, b, len_b, p_idx, len_idx) < 0) {
+        printf("indexed patch does not reproduce the new image\n");
+        return 5;
+    }
+    if (linear && (run_diff(a, len_a, b, len_b, 0, &p_lin, &len_lin, &ms_lin,
+                    &dummy) < 0)) {
+        printf("linear diff failed\n");
+        return 4;
+    }
+
+    printf("\nbase: %u bytes, new: %u bytes\n", len_a, len_b);
+    printf("%-10s %12s %12s\n", "matcher", "patch (B)", "time (ms)");
+    if (linear)
+        printf("%-10s %12u %12.1f\n", "linear", len_lin, ms_lin);
+    printf("%-10s %12u %12.1f (index: %.1f)\n", "indexed", len_idx, ms_idx,
+            ms_build);
+    if (linear) {
+        if ((len_lin != len_idx) || (memcmp(p_lin, p_idx, len_idx) != 0)) {
+            printf("Patches differ!\n");
+            return 1;
+        }
+        printf("Patches are byte-identical, speedup: %.1fx\n",
+                (ms_idx > 0) ? (ms_lin / ms_idx) : 0.0);
+    }
+    free(p_lin);
+    free(p_idx);
+    free(a);
+    free(b);
+    return 0;
+}
@@ -125,6 +125,8 @@ int main(int argc, char *argv[])
         if (wb_diff_init(&dx, base, len1, buffer, len2) < 0) {
             exit(6);
         }
+        if (wb_diff_index_build(&dx) < 0)
+            printf("Warning: cannot index base image, using linear scan\n");
         do {
             r = wb_diff(&dx, dest, blksz);
             if (r < 0)
@@ -132,6 +134,7 @@ int main(int argc, char *argv[])
             write(fd3, dest, r);
             len3 += r;
         } while (r > 0);
+        wb_diff_index_free(&dx);
         ftruncate(fd3, len3);
     }
     if (mode == MODE_PATCH) {
@@ -122,6 +122,17 @@ int wb_diff(WB_DIFF_CTX *ctx, uint8_t *patch, uint32_t len)
     return 0;
 }
 
+int wb_diff_index_build(WB_DIFF_CTX *ctx)
+{
+    (void)ctx;
+    return 0;
+}
+
+void wb_diff_index_free(WB_DIFF_CTX *ctx)
+{
+    (void)ctx;
+}
+
 int main(void)
 {
     char *argv[] = { (char *)"bmpatch", (char *)"source.bin", (char *)"patch.bin" };
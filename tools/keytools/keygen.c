@@ -83,6 +83,7 @@
 
 #include <wolfssl/wolfcrypt/random.h>
 #include <wolfssl/wolfcrypt/error-crypt.h>
+#include <wolfssl/wolfcrypt/hash.h>
 #ifdef DEBUG_SIGNTOOL
 #include <wolfssl/wolfcrypt/logging.h>
 #endif
@@ -109,6 +110,21 @@ static int exportPubKey = 0;
 static WC_RNG rng;
 static int noLocalKeys = 0;
 
+/* Digests of each public key added to the keystore, for all the hash
+ * algorithms wolfBoot can be built with. The matching table is emitted in
+ * keystore.c so the bootloader does not need to hash every key to find the
+ * slot referenced by the image pubkey hint.
+ */
+#define KEY_HINT_SHA256_SIZE 32
+#define KEY_HINT_SHA384_SIZE 48
+struct key_hint {
+    uint8_t sha256[KEY_HINT_SHA256_SIZE];
+    uint8_t sha384[KEY_HINT_SHA384_SIZE];
+    uint8_t sha3_384[KEY_HINT_SHA384_SIZE];
+};
+static struct key_hint *key_hints = NULL;
+static int n_key_hints = 0;
+
 /* ML-DSA pub keys are big. */
 #define KEYSLOT_MAX_PUBKEY_SIZE ML_DSA_L5_PUBKEY_SIZE
 
@@ -252,10 +268,51 @@ const char Keystore_API[] =
     "    return PubKeys[id].key_type;\n"
     "}\n"
     "\n"
+    "const uint8_t *keystore_get_key_hint(int id)\n"
+    "{\n"
+    "#ifdef KEYSTORE_HINT_SIZE\n"
+    "    if ((id < 0) || (id >= keystore_num_pubkeys()))\n"
+    "        return (const uint8_t *)0;\n"
+    "    return PubKeyHints[id];\n"
+    "#else\n"
+    "    (void)id;\n"
+    "    return (const uint8_t *)0;\n"
+    "#endif\n"
+    "}\n"
+    "\n"
     "#endif /* Keystore public key size check */\n"
     "#endif /* WOLFBOOT_NO_SIGN */\n";
 
 
+/* Precomputed digests of the public keys, in the same order as PubKeys.
+ * Not emitted with --nolocalkeys: the keys are zeroed in keystore.c and
+ * the real digests must not be known in advance.
+ */
+const char Hints_hdr[] =
+    "/* Digests of the public keys, used to look up the key slot from the\n"
+    " * image pubkey hint without hashing the whole keystore at boot.\n"
+    " */\n"
+#ifdef RENESAS_KEY
+    "#if !defined(WOLFBOOT_RENESAS_RSIP) && \\\n"
+    "    !defined(WOLFBOOT_RENESAS_TSIP) && \\\n"
+    "    !defined(WOLFBOOT_RENESAS_SCEPROTECT)\n"
+#endif
+    "#if defined(WOLFBOOT_HASH_SHA256)\n"
+    "    #define KEYSTORE_HINT_SIZE 32\n"
+    "#elif defined(WOLFBOOT_HASH_SHA384) || defined(WOLFBOOT_HASH_SHA3_384)\n"
+    "    #define KEYSTORE_HINT_SIZE 48\n"
+    "#endif\n"
+#ifdef RENESAS_KEY
+    "#endif\n"
+#endif
+    "#ifdef KEYSTORE_HINT_SIZE\n"
+    "static const uint8_t PubKeyHints[NUM_PUBKEYS][KEYSTORE_HINT_SIZE] = {\n";
+const char Hints_footer[] =
+    "#endif\n"
+    "};\n"
+    "#endif /* KEYSTORE_HINT_SIZE */\n"
+    "\n";
+
 static void usage(const char *pname) /* implies exit */
 {
     printf("Usage: %s [--ed25519 | --ed448 | --ecc256 | --ecc384 "
@@ -487,6 +544,61 @@ static uint32_t get_pubkey_size(uint32_t keyType)
     return size;
 }
 
+static void key_hint_add(const uint8_t *key, uint32_t sz)
+{
+    struct key_hint *h;
+    int ret;
+
+    h = realloc(key_hints, (n_key_hints + 1) * sizeof(struct key_hint));
+    if (h == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(1);
+    }
+    key_hints = h;
+    h = &key_hints[n_key_hints];
+    ret = wc_Sha256Hash(key, sz, h->sha256);
+    if (ret == 0)
+        ret = wc_Sha384Hash(key, sz, h->sha384);
+    if (ret == 0)
+        ret = wc_Sha3_384Hash(key, sz, h->sha3_384);
+    if (ret != 0) {
+        fprintf(stderr, "error: cannot compute key digest (%d)\n", ret);
+        exit(1);
+    }
+    n_key_hints++;
+}
+
+static void key_hints_write(FILE *f)
+{
+    int i;
+
+    if (n_key_hints == 0)
+        return;
+    fprintf(f, Hints_hdr);
+    fprintf(f, "#if defined(WOLFBOOT_HASH_SHA256)\n");
+    for (i = 0; i < n_key_hints; i++) {
+        fprintf(f, "    {");
+        fwritekey(key_hints[i].sha256, KEY_HINT_SHA256_SIZE, f);
+        fprintf(f, "\n    },\n");
+    }
+    fprintf(f, "#elif defined(WOLFBOOT_HASH_SHA384)\n");
+    for (i = 0; i < n_key_hints; i++) {
+        fprintf(f, "    {");
+        fwritekey(key_hints[i].sha384, KEY_HINT_SHA384_SIZE, f);
+        fprintf(f, "\n    },\n");
+    }
+    fprintf(f, "#else\n");
+    for (i = 0; i < n_key_hints; i++) {
+        fprintf(f, "    {");
+        fwritekey(key_hints[i].sha3_384, KEY_HINT_SHA384_SIZE, f);
+        fprintf(f, "\n    },\n");
+    }
+    fprintf(f, Hints_footer);
+    free(key_hints);
+    key_hints = NULL;
+    n_key_hints = 0;
+}
+
 void keystore_add(uint32_t ktype, uint8_t *key, uint32_t sz, const char *keyfile,
         uint32_t id_mask)
 {
@@ -509,6 +621,7 @@ void keystore_add(uint32_t ktype, uint8_t *key, uint32_t sz, const char *keyfile
         free(zero_key);
     } else {
         fwritekey(key, sz, fpub);
+        key_hint_add(key, sz);
     }
     fprintf(fpub, Pubkey_footer);
     fprintf(fpub, Slot_footer);
@@ -1699,6 +1812,7 @@ int main(int argc, char** argv)
     }
     wc_FreeRng(&rng);
     fprintf(fpub, Store_footer);
+    key_hints_write(fpub);
     fprintf(fpub, Keystore_API);
     if (fpub)
         fclose(fpub);
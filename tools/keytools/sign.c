@@ -57,6 +57,7 @@
 #ifdef _WIN32
 #include <io.h>
 #define HAVE_MMAP 0
+#define HAVE_FORK 0
 #define ftruncate(fd, len) _chsize(fd, len)
 static inline int fp_truncate(FILE *f, size_t len)
 {
@@ -68,11 +69,17 @@ static inline int fp_truncate(FILE *f, size_t len)
 }
 #else
 #define HAVE_MMAP 1
+#define HAVE_FORK 1
 #include <sys/mman.h>
+#include <sys/wait.h>
 #include <unistd.h>
+#include <time.h>
 #endif
 
 #define MAX_SRC_SIZE (1 << 24)
+/* Window of the delta search used for images larger than MAX_SRC_SIZE, when
+ * --delta-window is not given */
+#define DELTA_WINDOW_DEFAULT (1 << 20)
 
 #ifndef MAX_CUSTOM_TLVS
 #define MAX_CUSTOM_TLVS (16)
@@ -114,6 +121,7 @@ static inline int fp_truncate(FILE *f, size_t len)
 #ifdef WOLFSSL_SHA3
     #include <wolfssl/wolfcrypt/sha3.h>
 #endif
+#include <wolfssl/wolfcrypt/hash.h>
 #include <wolfssl/wolfcrypt/random.h>
 #include <wolfssl/wolfcrypt/error-crypt.h>
 
@@ -307,7 +315,43 @@ static void header_append_tag_u64(uint8_t *header, uint32_t *idx, uint16_t tag,
 #include "../xmss/xmss_common.h"
 
 /* Globals */
-static const char wolfboot_delta_file[] = "/tmp/wolfboot-delta.bin";
+/* Batch workers use a per-process name, see sign_batch() */
+static char wolfboot_delta_file[64] = "/tmp/wolfboot-delta.bin";
+
+/* Time spent in each stage of the signing of one image, reported by
+ * --batch. STAGE_HASH is not measured, it is what is left of the total:
+ * reading the image, hashing it and writing the output. */
+enum sign_stage {
+    STAGE_KEY = 0,
+    STAGE_HASH,
+    STAGE_SIGN,
+    STAGE_ENCRYPT,
+    STAGE_DELTA,
+    STAGE_COUNT
+};
+static uint64_t stage_us[STAGE_COUNT];
+static uint64_t stage_t0[STAGE_COUNT];
+
+static uint64_t sign_time_us(void)
+{
+#if HAVE_FORK
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+#else
+    return 0;
+#endif
+}
+
+static void stage_start(int stage)
+{
+    stage_t0[stage] = sign_time_us();
+}
+
+static void stage_stop(int stage)
+{
+    stage_us[stage] += sign_time_us() - stage_t0[stage];
+}
 
 struct signing_key {
     ed25519_key ed;
@@ -390,6 +434,7 @@ struct cmd_options {
     const char *policy_file;
     const char *encrypt_key_file;
     const char *delta_base_file;
+    uint32_t delta_window;
     const char *cert_chain_file;
     const char *dts_file;
     int no_base_sha;
@@ -402,6 +447,7 @@ struct cmd_options {
     uint32_t secondary_signature_sz;
     uint32_t policy_sz;
     uint8_t partition_id;
+    uint32_t chunk_sz;
     uint32_t custom_tlvs;
     struct cmd_tlv {
         uint16_t tag;
@@ -1121,7 +1167,7 @@ failure:
 }
 
 /* Sign the digest */
-static int sign_digest(int sign, int hash_algo,
+static int sign_digest_alg(int sign, int hash_algo,
     uint8_t* signature, uint32_t* signature_sz,
     uint8_t* digest, uint32_t digest_sz, int secondary)
 {
@@ -1300,6 +1346,18 @@ static int sign_digest(int sign, int hash_algo,
     return ret;
 }
 
+static int sign_digest(int sign, int hash_algo,
+    uint8_t* signature, uint32_t* signature_sz,
+    uint8_t* digest, uint32_t digest_sz, int secondary)
+{
+    int ret;
+    stage_start(STAGE_SIGN);
+    ret = sign_digest_alg(sign, hash_algo, signature, signature_sz, digest,
+            digest_sz, secondary);
+    stage_stop(STAGE_SIGN);
+    return ret;
+}
+
 #define ALIGN_8(x) while ((x % 8) != 4) { x++; }
 #define ALIGN_4(x) while ((x % 4) != 0) { x++; }
 
@@ -1507,6 +1565,10 @@ static uint32_t header_required_size(int is_diff, uint32_t cert_chain_sz,
             header_size_append_tag(&idx, digest_sz);
         }
     }
+    else if (CMD.chunk_sz > 0U) {
+        header_size_align_4(&idx);
+        header_size_append_tag(&idx, 4);
+    }
 
     for (i = 0; i < CMD.custom_tlvs; i++) {
         header_size_align_8(&idx);
@@ -1562,6 +1624,228 @@ static uint32_t header_required_size(int is_diff, uint32_t cert_chain_sz,
     return idx;
 }
 
+/* Firmware image being signed. On POSIX hosts it is mapped in memory, so
+ * that it is hashed and copied to the output files straight from the page
+ * cache. When it cannot be mapped, data is NULL and the image is read with
+ * stdio instead. */
+struct image_map {
+    const uint8_t *data;
+    uint32_t sz;
+};
+
+static void image_map_open(struct image_map *m, const char *image_file,
+    uint32_t image_sz)
+{
+#if HAVE_MMAP
+    int fd;
+    void *p;
+#endif
+
+    m->data = NULL;
+    m->sz = 0;
+#if HAVE_MMAP
+    if (image_sz == 0)
+        return;
+    fd = open(image_file, O_RDONLY);
+    if (fd < 0)
+        return;
+    p = mmap(NULL, image_sz, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return;
+    (void)posix_madvise(p, image_sz, POSIX_MADV_SEQUENTIAL);
+    m->data = p;
+    m->sz = image_sz;
+#else
+    (void)image_file;
+    (void)image_sz;
+#endif
+}
+
+static void image_map_close(struct image_map *m)
+{
+#if HAVE_MMAP
+    if (m->data != NULL)
+        munmap((void *)m->data, m->sz);
+#endif
+    m->data = NULL;
+    m->sz = 0;
+}
+
+/* Encryption of the signed image, fed by the same pass that writes it.
+ * The input is processed in whole cipher blocks; with AES the last block is
+ * padded with 0xFF. */
+struct enc_stream {
+    int mode;
+    uint32_t block_sz;
+#ifdef HAVE_CHACHA
+    ChaCha cha;
+#endif
+    Aes aes;
+    FILE *f;
+    uint8_t carry[ENC_MAX_BLOCK_SZ];
+    uint32_t carry_len;
+};
+
+static int enc_stream_blocks(struct enc_stream *es, const uint8_t *in,
+    uint32_t len)
+{
+    uint8_t out[4096]; /* multiple of every cipher block size */
+    uint32_t n;
+
+    while (len > 0) {
+        n = (len > sizeof(out)) ? (uint32_t)sizeof(out) : len;
+#ifdef HAVE_CHACHA
+        if (es->mode == ENC_CHACHA)
+            wc_Chacha_Process(&es->cha, out, in, n);
+        else
+#endif
+            wc_AesCtrEncrypt(&es->aes, out, in, n);
+        if (fwrite(out, 1, n, es->f) != n)
+            return -1;
+        in += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int enc_stream_update(struct enc_stream *es, const uint8_t *in,
+    uint32_t len)
+{
+    uint32_t n;
+    int ret = 0;
+
+    stage_start(STAGE_ENCRYPT);
+    if (es->carry_len > 0) {
+        n = es->block_sz - es->carry_len;
+        if (n > len)
+            n = len;
+        memcpy(es->carry + es->carry_len, in, n);
+        es->carry_len += n;
+        in += n;
+        len -= n;
+        if (es->carry_len == es->block_sz) {
+            ret = enc_stream_blocks(es, es->carry, es->block_sz);
+            es->carry_len = 0;
+        }
+    }
+    n = len - (len % es->block_sz);
+    if (ret == 0 && n > 0)
+        ret = enc_stream_blocks(es, in, n);
+    if (ret == 0 && len > n) {
+        memcpy(es->carry, in + n, len - n);
+        es->carry_len = len - n;
+    }
+    stage_stop(STAGE_ENCRYPT);
+    return ret;
+}
+
+static int enc_stream_final(struct enc_stream *es)
+{
+    int ret = 0;
+
+    stage_start(STAGE_ENCRYPT);
+    if (es->carry_len > 0) {
+        if (es->mode != ENC_CHACHA) {
+            memset(es->carry + es->carry_len, 0xFF,
+                es->block_sz - es->carry_len);
+            es->carry_len = es->block_sz;
+        }
+        ret = enc_stream_blocks(es, es->carry, es->carry_len);
+        es->carry_len = 0;
+    }
+    stage_stop(STAGE_ENCRYPT);
+    return ret;
+}
+
+/* Largest piece of the image written and encrypted at once: each piece is
+ * still in the cache when it is encrypted after being written. */
+#define OUTPUT_SLICE_SZ (1 << 20)
+
+static int output_write(FILE *f, struct enc_stream *es, const uint8_t *data,
+    uint32_t len)
+{
+    uint32_t n;
+
+    while (len > 0) {
+        n = (len > OUTPUT_SLICE_SZ) ? OUTPUT_SLICE_SZ : len;
+        if ((fwrite(data, 1, n, f) != n) ||
+                (es != NULL && enc_stream_update(es, data, n) != 0)) {
+            fprintf(stderr, "Error writing output image: %s\n",
+                    strerror(errno));
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* Digests of the chunks of the image, in order, for the chunk table that
+ * follows the firmware in chunked images (--chunk-size). */
+static uint8_t *chunk_table_create(const char *image_file,
+    const struct image_map *img, uint32_t image_sz, uint32_t *table_sz)
+{
+    uint32_t digest_sz = header_digest_size(CMD.hash_algo);
+    uint32_t n, i, len, pos = 0;
+    uint8_t *table = NULL;
+    uint8_t *chunk = NULL;
+    FILE *f = NULL;
+    int ret = -1;
+
+    if (digest_sz == 0 || image_sz == 0)
+        return NULL;
+    n = ((image_sz - 1) / CMD.chunk_sz) + 1;
+    table = malloc(n * digest_sz);
+    if (img->data == NULL) {
+        chunk = malloc(CMD.chunk_sz);
+        f = fopen(image_file, "rb");
+    }
+    if (table == NULL || (img->data == NULL && (chunk == NULL || f == NULL))) {
+        printf("Chunk table: cannot read %s\n", image_file);
+        goto out;
+    }
+    for (i = 0; i < n; i++) {
+        len = image_sz - pos;
+        if (len > CMD.chunk_sz)
+            len = CMD.chunk_sz;
+        if (img->data != NULL)
+            chunk = (uint8_t *)img->data + pos;
+        else if (fread(chunk, 1, len, f) != len)
+            goto out;
+        if (CMD.hash_algo == HASH_SHA256) {
+        #ifndef NO_SHA256
+            ret = wc_Sha256Hash(chunk, len, table + (i * digest_sz));
+        #endif
+        }
+        else if (CMD.hash_algo == HASH_SHA384) {
+        #ifndef NO_SHA384
+            ret = wc_Sha384Hash(chunk, len, table + (i * digest_sz));
+        #endif
+        }
+        else if (CMD.hash_algo == HASH_SHA3) {
+        #ifdef WOLFSSL_SHA3
+            ret = wc_Sha3_384Hash(chunk, len, table + (i * digest_sz));
+        #endif
+        }
+        if (ret != 0)
+            goto out;
+        pos += len;
+    }
+    printf("Chunk table: %u chunks of %u bytes\n", n, CMD.chunk_sz);
+    *table_sz = n * digest_sz;
+out:
+    if (f != NULL)
+        fclose(f);
+    if (img->data == NULL)
+        free(chunk);
+    if (ret != 0) {
+        free(table);
+        table = NULL;
+    }
+    return table;
+}
+
 static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
         const char *image_file, const char *outfile,
         uint32_t delta_base_version, uint32_t patch_len, uint32_t patch_inv_off,
@@ -1589,6 +1873,11 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
     int io_sz;
     uint8_t*    cert_chain    = NULL;
     uint32_t    cert_chain_sz = 0;
+    uint8_t*    chunk_table   = NULL;
+    uint32_t    chunk_table_sz = 0;
+    struct image_map img = { NULL, 0 };
+    struct enc_stream enc;
+    struct enc_stream *es = NULL;
 
     XMEMSET(key, 0, sizeof(key));
     XMEMSET(iv, 0, sizeof(iv));
@@ -1668,6 +1957,7 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
     fseek(f, 0, SEEK_SET);
     fclose(f);
     f = NULL; /* avoid a double fclose() if a later step jumps to 'failure' */
+    image_map_open(&img, image_file, image_sz);
 
     /* Append Magic header (spells 'WOLF') */
     header_append_u32(header, &header_idx, WOLFBOOT_MAGIC);
@@ -1753,6 +2043,16 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
             }
         }
     }
+    else if (CMD.chunk_sz > 0) {
+        /* Append pad bytes, so the chunk size is 4-byte aligned */
+        ALIGN_4(header_idx);
+        header_append_tag_u32(header, &header_idx, HDR_IMG_CHUNKS,
+            CMD.chunk_sz);
+        chunk_table = chunk_table_create(image_file, &img, image_sz,
+            &chunk_table_sz);
+        if (chunk_table == NULL)
+            goto failure;
+    }
 
     /* Add custom TLVs */
     if (CMD.custom_tlvs > 0) {
@@ -1925,29 +2225,40 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
             /* Hash Header */
             ret = wc_Sha256Update(&sha, header, header_idx);
 
-            /* Hash image file */
-            f = fopen(image_file, "rb");
-            if (f == NULL) {
-                printf("Open image file %s failed\n", image_file);
-                ret = -1;
-                wc_Sha256Free(&sha);
-                goto failure;
+            if (chunk_table != NULL) {
+                /* Chunked image: hash the chunk table */
+                if (ret == 0)
+                    ret = wc_Sha256Update(&sha, chunk_table, chunk_table_sz);
             }
-            pos = 0;
-            while (ret == 0 && pos < image_sz) {
-                read_sz = image_sz - pos;
-                if (read_sz > 32)
-                    read_sz = 32;
-                io_sz = (int)fread(buf, 1, read_sz, f);
-                if ((io_sz < 0) && !feof(f)) {
+            else if (img.data != NULL) {
+                /* Hash the mapped image */
+                ret = wc_Sha256Update(&sha, img.data, image_sz);
+            }
+            else {
+                /* Hash image file */
+                f = fopen(image_file, "rb");
+                if (f == NULL) {
+                    printf("Open image file %s failed\n", image_file);
                     ret = -1;
-                    break;
+                    wc_Sha256Free(&sha);
+                    goto failure;
                 }
-                ret = wc_Sha256Update(&sha, buf, read_sz);
-                pos += read_sz;
+                pos = 0;
+                while (ret == 0 && pos < image_sz) {
+                    read_sz = image_sz - pos;
+                    if (read_sz > 32)
+                        read_sz = 32;
+                    io_sz = (int)fread(buf, 1, read_sz, f);
+                    if ((io_sz < 0) && !feof(f)) {
+                        ret = -1;
+                        break;
+                    }
+                    ret = wc_Sha256Update(&sha, buf, read_sz);
+                    pos += read_sz;
+                }
+                fclose(f);
+                f = NULL;
             }
-            fclose(f);
-            f = NULL;
             if (ret == 0) {
                 wc_Sha256Final(&sha, digest);
                 digest_sz = HDR_SHA256_LEN;
@@ -2002,29 +2313,40 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
             /* Hash Header */
             ret = wc_Sha384Update(&sha, header, header_idx);
 
-            /* Hash image file */
-            f = fopen(image_file, "rb");
-            if (f == NULL) {
-                printf("Open image file %s failed\n", image_file);
-                ret = -1;
-                wc_Sha384Free(&sha);
-                goto failure;
+            if (chunk_table != NULL) {
+                /* Chunked image: hash the chunk table */
+                if (ret == 0)
+                    ret = wc_Sha384Update(&sha, chunk_table, chunk_table_sz);
             }
-            pos = 0;
-            while (ret == 0 && pos < image_sz) {
-                read_sz = image_sz - pos;
-                if (read_sz > 32)
-                    read_sz = 32;
-                io_sz = (int)fread(buf, 1, read_sz, f);
-                if ((io_sz < 0) && !feof(f)) {
+            else if (img.data != NULL) {
+                /* Hash the mapped image */
+                ret = wc_Sha384Update(&sha, img.data, image_sz);
+            }
+            else {
+                /* Hash image file */
+                f = fopen(image_file, "rb");
+                if (f == NULL) {
+                    printf("Open image file %s failed\n", image_file);
                     ret = -1;
-                    break;
+                    wc_Sha384Free(&sha);
+                    goto failure;
                 }
-                ret = wc_Sha384Update(&sha, buf, read_sz);
-                pos += read_sz;
+                pos = 0;
+                while (ret == 0 && pos < image_sz) {
+                    read_sz = image_sz - pos;
+                    if (read_sz > 32)
+                        read_sz = 32;
+                    io_sz = (int)fread(buf, 1, read_sz, f);
+                    if ((io_sz < 0) && !feof(f)) {
+                        ret = -1;
+                        break;
+                    }
+                    ret = wc_Sha384Update(&sha, buf, read_sz);
+                    pos += read_sz;
+                }
+                fclose(f);
+                f = NULL;
             }
-            fclose(f);
-            f = NULL;
             if (ret == 0) {
                 wc_Sha384Final(&sha, digest);
                 digest_sz = HDR_SHA384_LEN;
@@ -2077,29 +2399,40 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
             /* Hash Header */
             ret = wc_Sha3_384_Update(&sha, header, header_idx);
 
-            /* Hash image file */
-            f = fopen(image_file, "rb");
-            if (f == NULL) {
-                printf("Open image file %s failed\n", image_file);
-                ret = -1;
-                wc_Sha3_384_Free(&sha);
-                goto failure;
+            if (chunk_table != NULL) {
+                /* Chunked image: hash the chunk table */
+                if (ret == 0)
+                    ret = wc_Sha3_384_Update(&sha, chunk_table, chunk_table_sz);
             }
-            pos = 0;
-            while (ret == 0 && pos < image_sz) {
-                read_sz = image_sz - pos;
-                if (read_sz > 128)
-                    read_sz = 128;
-                io_sz = (int)fread(buf, 1, read_sz, f);
-                if ((io_sz < 0) && !feof(f)) {
+            else if (img.data != NULL) {
+                /* Hash the mapped image */
+                ret = wc_Sha3_384_Update(&sha, img.data, image_sz);
+            }
+            else {
+                /* Hash image file */
+                f = fopen(image_file, "rb");
+                if (f == NULL) {
+                    printf("Open image file %s failed\n", image_file);
                     ret = -1;
-                    break;
+                    wc_Sha3_384_Free(&sha);
+                    goto failure;
                 }
-                ret = wc_Sha3_384_Update(&sha, buf, read_sz);
-                pos += read_sz;
+                pos = 0;
+                while (ret == 0 && pos < image_sz) {
+                    read_sz = image_sz - pos;
+                    if (read_sz > 128)
+                        read_sz = 128;
+                    io_sz = (int)fread(buf, 1, read_sz, f);
+                    if ((io_sz < 0) && !feof(f)) {
+                        ret = -1;
+                        break;
+                    }
+                    ret = wc_Sha3_384_Update(&sha, buf, read_sz);
+                    pos += read_sz;
+                }
+                fclose(f);
+                f = NULL;
             }
-            fclose(f);
-            f = NULL;
             if (ret == 0) {
                 ret = wc_Sha3_384_Final(&sha, digest);
                 digest_sz = HDR_SHA3_384_LEN;
@@ -2358,7 +2691,8 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
             }
 
             {
-                uint32_t total_img_sz = CMD.header_sz + image_sz;
+                uint32_t total_img_sz = CMD.header_sz + image_sz +
+                    chunk_table_sz;
                 /* Only subtract sector for trailer when sector < partition.
                  * When sector >= partition (e.g. update_ram targets), the
                  * entire partition is available for the image.
@@ -2391,37 +2725,10 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
         }
     }
 
-    /* Create output image */
-    f = fopen(outfile, "w+b");
-    if (f == NULL) {
-        printf("Open output image file %s failed\n", outfile);
-        goto failure;
-    }
-    fwrite(header, 1, header_idx, f);
-    /* Copy image to output */
-    if (!CMD.header_only) {
-        f2  = fopen(image_file, "rb");
-        pos = 0;
-        while (pos < image_sz) {
-            read_sz = image_sz;
-            if (read_sz > sizeof(buf)) {
-                read_sz = sizeof(buf);
-            }
-            read_sz = (uint32_t)fread(buf, 1, read_sz, f2);
-            if ((read_sz == 0) && (feof(f2))) {
-                break;
-            }
-            fwrite(buf, 1, read_sz, f);
-            pos += read_sz;
-        }
-        fclose(f2);
-        f2 = NULL;
-    }
-
+    /* The encrypted image is produced in the same pass as the signed one:
+     * prepare the cipher first */
     if (!CMD.header_only && (CMD.encrypt != ENC_OFF) && CMD.encrypt_key_file) {
-        uint8_t enc_buf[ENC_MAX_BLOCK_SZ];
         int ivSz, keySz, encBlockSz;
-        uint32_t fsize = 0;
         switch (CMD.encrypt) {
             case ENC_CHACHA:
                 ivSz = ENCRYPT_NONCE_SIZE_CHACHA;
@@ -2464,53 +2771,86 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
         fclose(fek);
         fek = NULL;
 
-        fef = fopen(CMD.output_encrypted_image_file, "wb");
-        if (!fef) {
-            fprintf(stderr, "Open encrypted output file %s: %s\n",
-                    CMD.output_encrypted_image_file, strerror(errno));
-            goto failure;
-        }
-        fsize = ftell(f);
-        fseek(f, 0, SEEK_SET); /* restart the _signed file from 0 */
-
-        printf("Encrypting %u bytes...\n", fsize);
-
+        memset(&enc, 0, sizeof(enc));
+        enc.mode = CMD.encrypt;
+        enc.block_sz = (uint32_t)encBlockSz;
         if (CMD.encrypt == ENC_CHACHA) {
-            ChaCha cha;
 #ifndef HAVE_CHACHA
             fprintf(stderr, "Encryption not supported: chacha support not found"
                    "in wolfssl configuration.\n");
             ret = 100;
             goto failure;
+#else
+            wc_Chacha_SetKey(&enc.cha, key, sizeof(key));
+            wc_Chacha_SetIV(&enc.cha, iv, 0);
 #endif
-            wc_Chacha_SetKey(&cha, key, sizeof(key));
-            wc_Chacha_SetIV(&cha, iv, 0);
-            for (pos = 0; pos < fsize; pos += encBlockSz) {
-                int fread_retval;
-                fread_retval = (int)fread(buf, 1, encBlockSz, f);
-                if ((fread_retval == 0) && feof(f)) {
-                    break;
+        } else {
+            wc_AesInit(&enc.aes, NULL, 0);
+            wc_AesSetKeyDirect(&enc.aes, key, keySz, iv, AES_ENCRYPTION);
+        }
+
+        fef = fopen(CMD.output_encrypted_image_file, "wb");
+        if (!fef) {
+            fprintf(stderr, "Open encrypted output file %s: %s\n",
+                    CMD.output_encrypted_image_file, strerror(errno));
+            goto failure;
+        }
+        enc.f = fef;
+        es = &enc;
+        printf("Encrypting %u bytes...\n",
+                header_idx + image_sz + chunk_table_sz);
+    }
+
+    /* Create output image */
+    ret = -1;
+    f = fopen(outfile, "w+b");
+    if (f == NULL) {
+        printf("Open output image file %s failed\n", outfile);
+        goto failure;
+    }
+    if (output_write(f, es, header, header_idx) != 0)
+        goto failure;
+    /* Copy image to output */
+    if (!CMD.header_only) {
+        if (img.data != NULL) {
+            if (output_write(f, es, img.data, image_sz) != 0)
+                goto failure;
+        }
+        else {
+            f2  = fopen(image_file, "rb");
+            if (f2 == NULL) {
+                printf("Open image file %s failed\n", image_file);
+                goto failure;
+            }
+            pos = 0;
+            while (pos < image_sz) {
+                read_sz = image_sz;
+                if (read_sz > sizeof(buf)) {
+                    read_sz = sizeof(buf);
                 }
-                wc_Chacha_Process(&cha, enc_buf, buf, fread_retval);
-                fwrite(enc_buf, 1, fread_retval, fef);
-            }
-        } else if ((CMD.encrypt == ENC_AES128) || (CMD.encrypt == ENC_AES256)) {
-            Aes aes_e;
-            wc_AesInit(&aes_e, NULL, 0);
-            wc_AesSetKeyDirect(&aes_e, key, keySz, iv, AES_ENCRYPTION);
-            for (pos = 0; pos < fsize; pos += encBlockSz) {
-                int fread_retval;
-                fread_retval = (int)fread(buf, 1, encBlockSz, f);
-                if ((fread_retval == 0) && feof(f)) {
+                read_sz = (uint32_t)fread(buf, 1, read_sz, f2);
+                if ((read_sz == 0) && (feof(f2))) {
                     break;
                 }
-                /* Pad with FF if input is too short */
-                while((fread_retval % encBlockSz) != 0) {
-                    buf[fread_retval++] = 0xFF;
-                }
-                wc_AesCtrEncrypt(&aes_e, enc_buf, buf, fread_retval);
-                fwrite(enc_buf, 1, fread_retval, fef);
+                if (output_write(f, es, buf, read_sz) != 0)
+                    goto failure;
+                pos += read_sz;
             }
+            fclose(f2);
+            f2 = NULL;
+        }
+        /* Chunk table, right after the firmware */
+        if (chunk_table != NULL) {
+            if (output_write(f, es, chunk_table, chunk_table_sz) != 0)
+                goto failure;
+        }
+    }
+
+    if (es != NULL) {
+        if (enc_stream_final(es) != 0) {
+            fprintf(stderr, "Error writing %s: %s\n",
+                    CMD.output_encrypted_image_file, strerror(errno));
+            goto failure;
         }
         fclose(fef);
         fef = NULL;
@@ -2529,6 +2869,9 @@ static int make_header_ex(int is_diff, uint8_t *pubkey, uint32_t pubkey_sz,
 failure:
     wc_ForceZero(key, sizeof(key));
     wc_ForceZero(iv, sizeof(iv));
+    if (es != NULL)
+        wc_ForceZero(&enc, sizeof(enc));
+    image_map_close(&img);
     if (f)
         fclose(f);
     if (f2)
@@ -2539,6 +2882,8 @@ failure:
         fclose(fef);
     if (cert_chain)
         free(cert_chain);
+    if (chunk_table)
+        free(chunk_table);
     if (policy)
         free(policy);
     if (header)
@@ -2577,6 +2922,27 @@ static int make_hybrid_header(uint8_t *pubkey, uint32_t pubkey_sz,
             secondary_key, secondary_key_sz, NULL, 0);
 }
 
+/* Window of the delta search: --delta-window, or DELTA_WINDOW_DEFAULT for
+ * large images. Rounded up to a multiple of the sector size, two sectors at
+ * least. */
+static uint32_t delta_window_size(uint32_t sector_size)
+{
+    uint32_t window = CMD.delta_window;
+
+    if (window == 0)
+        window = DELTA_WINDOW_DEFAULT;
+    if (window < 2 * sector_size)
+        window = 2 * sector_size;
+    window = ((window + sector_size - 1) / sector_size) * sector_size;
+    return window;
+}
+
+#if HAVE_MMAP
+#define DELTA_OUT_WRITE(buf, sz) ((int)write(fd3, (buf), (sz)))
+#else
+#define DELTA_OUT_WRITE(buf, sz) ((int)fwrite((buf), 1, (sz), f3))
+#endif
+
 static int base_diff(const char *f_base, uint8_t *pubkey, uint32_t pubkey_sz, int padding)
 {
 #if HAVE_MMAP
@@ -2597,6 +2963,9 @@ static int base_diff(const char *f_base, uint8_t *pubkey, uint32_t pubkey_sz, in
     uint32_t delta_base_version_val = 0;
     uint16_t delta_base_version_sz = 0;
     WB_DIFF_CTX diff_ctx;
+    WB_DIFF_CTX inv_ctx;
+    FILE *inv_tmp = NULL;
+    uint32_t window = 0;
     int ret = -1;
     int io_sz;
     uint8_t *base_hash = NULL;
@@ -2604,6 +2973,9 @@ static int base_diff(const char *f_base, uint8_t *pubkey, uint32_t pubkey_sz, in
     uint32_t wolfboot_sector_size = 0;
     uint32_t blksz;
 
+    stage_start(STAGE_DELTA);
+    memset(&diff_ctx, 0, sizeof(diff_ctx));
+    memset(&inv_ctx, 0, sizeof(inv_ctx));
     wolfboot_sector_size = wb_diff_get_sector_size();
     printf("delta update: WOLFBOOT_SECTOR_SIZE: %u\n", wolfboot_sector_size);
     blksz = wolfboot_sector_size;
@@ -2618,12 +2990,13 @@ static int base_diff(const char *f_base, uint8_t *pubkey, uint32_t pubkey_sz, in
         printf("Cannot stat %s\n", f_base);
         goto cleanup;
     }
-    len1 = st.st_size;
-
-    if (len1 > MAX_SRC_SIZE) {
+    if ((uintmax_t)st.st_size > (uintmax_t)INT_MAX) {
         printf("%s: file too large\n", f_base);
         goto cleanup;
     }
+    len1 = st.st_size;
+    if ((CMD.delta_window != 0) || (len1 > MAX_SRC_SIZE))
+        window = delta_window_size(wolfboot_sector_size);
 
 #if HAVE_MMAP
     /* Open base image */
@@ -2691,11 +3064,13 @@ static int base_diff(const char *f_base, uint8_t *pubkey, uint32_t pubkey_sz, in
         printf("Cannot stat %s\n", CMD.output_image_file);
         goto cleanup;
     }
-    len2 = st.st_size;
-    if (len2 > MAX_SRC_SIZE) {
+    if ((uintmax_t)st.st_size > (uintmax_t)INT_MAX) {
         printf("%s: file too large\n", CMD.output_image_file);
         goto cleanup;
     }
+    len2 = st.st_size;
+    if ((window == 0) && (len2 > MAX_SRC_SIZE))
+        window = delta_window_size(wolfboot_sector_size);
     buffer = mmap(NULL, len2, PROT_READ, MAP_SHARED, fd2, 0);
     if (buffer == (void *)(-1)) {
         perror("mmap");
@@ -2731,10 +3106,12 @@ static int base_diff(const char *f_base, uint8_t *pubkey, uint32_t pubkey_sz, in
     fseek(f2, 0L, SEEK_END);
     len2 = ftell(f2);
     fseek(f2, 0L, SEEK_SET);
-    if (len2 > MAX_SRC_SIZE) {
+    if (len2 < 0) {
         printf("%s: file too large\n", CMD.output_image_file);
         goto cleanup;
     }
+    if ((window == 0) && (len2 > MAX_SRC_SIZE))
+        window = delta_window_size(wolfboot_sector_size);
     buffer = malloc(len2);
     if (buffer == NULL) {
         fprintf(stderr, "Error malloc for buffer %d\n", len2);
@@ -2766,20 +3143,60 @@ static int base_diff(const char *f_base, uint8_t *pubkey, uint32_t pubkey_sz, in
     if (wb_diff_init(&diff_ctx, base, len1, buffer, len2) < 0) {
         goto cleanup;
     }
-    do {
-        r = wb_diff(&diff_ctx, dest, blksz);
-        if (r < 0)
+    if (window != 0) {
+        /* Windowed mode: both patches are generated in a single pass, walking
+         * the two images front to back. The inverse patch is staged in a
+         * temporary file and appended after the forward one. */
+        int fwd_done = 0, inv_done = 0;
+        printf("Windowed delta: %u bytes window\n", window);
+        patch_inv_sz = 0;
+        inv_tmp = tmpfile();
+        if ((inv_tmp == NULL) ||
+                (wb_diff_set_window(&diff_ctx, window) < 0) ||
+                (wb_diff_init(&inv_ctx, buffer, len2, base, len1) < 0) ||
+                (wb_diff_set_window(&inv_ctx, window) < 0)) {
             goto cleanup;
+        }
+        (void)wb_diff_index_build(&diff_ctx);
+        (void)wb_diff_index_build(&inv_ctx);
+        while (!fwd_done || !inv_done) {
+            if (!fwd_done && (inv_done || (diff_ctx.off_b <= inv_ctx.off_b))) {
+                r = wb_diff(&diff_ctx, dest, blksz);
+                if (r < 0)
+                    goto cleanup;
+                if ((r > 0) && (DELTA_OUT_WRITE(dest, r) != r))
+                    goto cleanup;
+                len3 += r;
+                fwd_done = (r == 0);
+            } else {
+                r = wb_diff(&inv_ctx, dest, blksz);
+                if (r < 0)
+                    goto cleanup;
+                if ((r > 0) && ((int)fwrite(dest, 1, r, inv_tmp) != r))
+                    goto cleanup;
+                patch_inv_sz += r;
+                inv_done = (r == 0);
+            }
+        }
+    } else {
+        if (wb_diff_index_build(&diff_ctx) < 0) {
+            printf("Warning: cannot index delta base, using linear scan\n");
+        }
+        do {
+            r = wb_diff(&diff_ctx, dest, blksz);
+            if (r < 0)
+                goto cleanup;
 #if HAVE_MMAP
-        io_sz = write(fd3, dest, r);
+            io_sz = write(fd3, dest, r);
 #else
-        io_sz = (int)fwrite(dest, 1, r, f3);
+            io_sz = (int)fwrite(dest, 1, r, f3);
 #endif
-        if (io_sz != r) {
-            goto cleanup;
-        }
-        len3 += r;
-    } while (r > 0);
+            if (io_sz != r) {
+                goto cleanup;
+            }
+            len3 += r;
+        } while (r > 0);
+    }
     patch_sz = len3;
     while ((len3 % padding) != 0) {
         uint8_t zero = 0;
@@ -2833,27 +3250,44 @@ static int base_diff(const char *f_base, uint8_t *pubkey, uint32_t pubkey_sz, in
         }
     }
     patch_inv_off = (uint32_t)len3 + CMD.header_sz;
-    patch_inv_sz = 0;
 
-    /* Inverse second->base patch */
-    if (wb_diff_init(&diff_ctx, buffer, len2, base, len1) < 0) {
-        goto cleanup;
-    }
-    do {
-        r = wb_diff(&diff_ctx, dest, blksz);
-        if (r < 0)
+    if (inv_tmp != NULL) {
+        /* Append the inverse patch produced by the windowed pass */
+        rewind(inv_tmp);
+        while ((r = (int)fread(dest, 1, blksz, inv_tmp)) > 0) {
+            if (DELTA_OUT_WRITE(dest, r) != r)
+                goto cleanup;
+            len3 += r;
+        }
+        if (ferror(inv_tmp))
             goto cleanup;
+    } else {
+        patch_inv_sz = 0;
+
+        /* Inverse second->base patch */
+        wb_diff_index_free(&diff_ctx);
+        if (wb_diff_init(&diff_ctx, buffer, len2, base, len1) < 0) {
+            goto cleanup;
+        }
+        if (wb_diff_index_build(&diff_ctx) < 0) {
+            printf("Warning: cannot index delta base, using linear scan\n");
+        }
+        do {
+            r = wb_diff(&diff_ctx, dest, blksz);
+            if (r < 0)
+                goto cleanup;
 #if HAVE_MMAP
-        io_sz = write(fd3, dest, r);
+            io_sz = write(fd3, dest, r);
 #else
-        io_sz = (int)fwrite(dest, 1, r, f3);
+            io_sz = (int)fwrite(dest, 1, r, f3);
 #endif
-        if (io_sz != r) {
-            goto cleanup;
-        }
-        patch_inv_sz += r;
-        len3 += r;
-    } while (r > 0);
+            if (io_sz != r) {
+                goto cleanup;
+            }
+            patch_inv_sz += r;
+            len3 += r;
+        } while (r > 0);
+    }
 #if HAVE_MMAP
     if (fd3 >= 0) {
         if (len3 > 0) {
@@ -2876,6 +3310,7 @@ static int base_diff(const char *f_base, uint8_t *pubkey, uint32_t pubkey_sz, in
     if (ret != 0) {
         goto cleanup;
     }
+    stage_stop(STAGE_DELTA);
     printf("Successfully created output file %s\n", wolfboot_delta_file);
     /* Create delta file, with header, from the resulting patch */
 
@@ -2883,6 +3318,10 @@ static int base_diff(const char *f_base, uint8_t *pubkey, uint32_t pubkey_sz, in
             delta_base_version_val, patch_sz, patch_inv_off, patch_inv_sz, base_hash, base_hash_sz);
 
 cleanup:
+    wb_diff_index_free(&diff_ctx);
+    wb_diff_index_free(&inv_ctx);
+    if (inv_tmp != NULL)
+        fclose(inv_tmp);
     if (dest) {
         free(dest);
         dest = NULL;
@@ -3322,33 +3761,16 @@ static void set_signature_sizes(int secondary)
     printf("Manifest header size: %u\n", CMD.header_sz);
 }
 
-int main(int argc, char** argv)
+/* Parse the options of one signing invocation into CMD, print them and set
+ * the names of the output files. Exits on invalid arguments. */
+static void parse_cmdline(int argc, char** argv)
 {
-    int ret = 0;
     int i;
     char* tmpstr;
     const char* sign_str = "AUTO";
     const char* hash_str = "SHA256";
     const char* secondary_sign_str = "NONE";
     uint8_t  buf[PATH_MAX-32]; /* leave room to avoid "directive output may be truncated" */
-    uint8_t *pubkey = NULL;
-    uint32_t pubkey_sz = 0;
-    uint8_t *kbuf=NULL, *key_buffer, *key_buffer2;
-    uint32_t key_buffer_sz, key_buffer_sz2;
-
-#ifdef DEBUG_SIGNTOOL
-    wolfSSL_Debugging_ON();
-#endif
-
-    printf("wolfBoot KeyTools (Compiled C version)\n");
-    printf("wolfBoot version %X\n", WOLFBOOT_VERSION);
-
-    /* Check arguments and print usage */
-    if (argc < 4) {
-        printf("Usage: %s [options] image key version\n", argv[0]);
-        printf("For full usage manual, see 'docs/Signing.md'\n");
-        exit(1);
-    }
 
     /* Set initial manifest header size to a minimum default value */
     CMD.header_sz = 256;
@@ -3585,9 +4007,41 @@ int main(int argc, char** argv)
         } else if (strcmp(argv[i], "--no-base-sha") == 0) {
             CMD.no_base_sha = 1;
         }
+        else if (strcmp(argv[i], "--delta-window") == 0) {
+            unsigned long sz;
+            char *endptr;
+            if (argc <= (i + 1)) {
+                fprintf(stderr, "Missing delta window argument\n");
+                exit(16);
+            }
+            errno = 0;
+            sz = strtoul(argv[++i], &endptr, 0);
+            if ((endptr == argv[i]) || (*endptr != '\0') ||
+                    (errno == ERANGE) || (sz == 0) || (sz > 0x7FFFFFFFUL)) {
+                fprintf(stderr, "Invalid delta window: %s\n", argv[i]);
+                exit(16);
+            }
+            CMD.delta_window = (uint32_t)sz;
+        }
         else if (strcmp(argv[i], "--no-ts") == 0) {
             CMD.no_ts = 1;
         }
+        else if (strcmp(argv[i], "--chunk-size") == 0) {
+            unsigned long sz;
+            char *endptr;
+            if (argc <= (i + 1)) {
+                fprintf(stderr, "Missing chunk size argument\n");
+                exit(16);
+            }
+            errno = 0;
+            sz = strtoul(argv[++i], &endptr, 0);
+            if ((endptr == argv[i]) || (*endptr != '\0') ||
+                    (errno == ERANGE) || (sz == 0) || (sz > UINT32_MAX)) {
+                fprintf(stderr, "Invalid chunk size: %s\n", argv[i]);
+                exit(16);
+            }
+            CMD.chunk_sz = (uint32_t)sz;
+        }
         else if (strcmp(argv[i], "--policy") == 0) {
             CMD.policy_sign = 1;
             CMD.policy_file = argv[++i];
@@ -3858,6 +4312,10 @@ int main(int argc, char** argv)
             break;
         }
     }
+    if ((CMD.chunk_sz > 0) && CMD.header_only) {
+        fprintf(stderr, "--chunk-size cannot be used with --header-only\n");
+        exit(16);
+    }
     if ((CMD.sign == CMD.secondary_sign) && (CMD.hybrid)) {
         printf("Warning: Duplicate signature algorithm detected. Fix your command line!\n");
         CMD.hybrid = 0;
@@ -4005,44 +4463,80 @@ int main(int argc, char** argv)
                CMD.signature_sz, CMD.header_sz);
         exit(2);
     }
+}
 
+/* Private keys of one signing configuration, decoded into "key" / "key2" */
+struct sign_keys {
+    uint8_t *kbuf, *key_buffer, *pubkey;
+    uint32_t key_buffer_sz, pubkey_sz;
+    uint8_t *kbuf2, *key_buffer2, *pubkey2;
+    uint32_t key_buffer_sz2, pubkey_sz2;
+    int sign;
+    int secondary_sign;
+    int hybrid;
+};
+
+static int sign_keys_load(struct sign_keys *k)
+{
+    memset(k, 0, sizeof(*k));
     if (CMD.sign == NO_SIGN) {
         printf ("*** WARNING: cipher 'none' selected.\n"
                 "*** Image will not be authenticated!\n"
                 "*** SECURE BOOT DISABLED.\n");
     } else {
-        kbuf = load_key(&key_buffer, &key_buffer_sz, &pubkey, &pubkey_sz, 0);
-        if (!kbuf) {
-            ret = 1;
-            goto cleanup;
-        }
+        k->kbuf = load_key(&k->key_buffer, &k->key_buffer_sz, &k->pubkey,
+                &k->pubkey_sz, 0);
+        k->sign = CMD.sign;
+        if (!k->kbuf)
+            return 1;
     } /* CMD.sign != NO_SIGN */
 
     if (CMD.hybrid) {
-        uint8_t *kbuf2 = NULL;
-        uint8_t *pubkey2 = NULL;
-        uint32_t pubkey_sz2 = 0;
+        k->hybrid = 1;
         DEBUG_PRINT("Loading secondary key\n");
-        kbuf2 = load_key(&key_buffer2, &key_buffer_sz2, &pubkey2, &pubkey_sz2, 1);
-        if (!kbuf2) {
-            /* Fall through to the tail cleanup: the primary raw key buffer is
-             * still live and the primary key object is initialized, and
-             * exiting here would scrub neither. */
-            ret = 1;
-            goto cleanup;
+        k->kbuf2 = load_key(&k->key_buffer2, &k->key_buffer_sz2, &k->pubkey2,
+                &k->pubkey_sz2, 1);
+        k->secondary_sign = CMD.secondary_sign;
+        if (!k->kbuf2) {
+            /* The caller still has to release the primary raw key buffer and
+             * the primary key object with sign_keys_free(). */
+            return 1;
         }
+    }
+    return 0;
+}
+
+static void sign_keys_free(struct sign_keys *k)
+{
+    if (k->pubkey)
+        free(k->pubkey);
+    if (k->kbuf)
+        zero_and_free(k->kbuf, k->key_buffer_sz);
+    if (k->pubkey2)
+        free(k->pubkey2);
+    if (k->kbuf2)
+        zero_and_free(k->kbuf2, k->key_buffer_sz2);
+    free_key(k->sign, 0);
+    if (k->hybrid) {
+        free_key(k->secondary_sign, 1);
+    }
+    memset(k, 0, sizeof(*k));
+}
+
+/* Sign (and optionally encrypt and diff) the image selected in CMD */
+static int sign_image(struct sign_keys *k)
+{
+    int ret;
+
+    if (CMD.hybrid) {
         printf("Creating hybrid signature\n");
-        ret = make_hybrid_header(pubkey, pubkey_sz, CMD.image_file,
-                CMD.output_image_file, pubkey2, pubkey_sz2);
+        ret = make_hybrid_header(k->pubkey, k->pubkey_sz, CMD.image_file,
+                CMD.output_image_file, k->pubkey2, k->pubkey_sz2);
         DEBUG_PRINT("Signature size: %u\n", CMD.signature_sz);
         DEBUG_PRINT("Secondary signature size: %u\n", CMD.secondary_signature_sz);
         DEBUG_PRINT("Header size: %u\n", CMD.header_sz);
-        if (kbuf2)
-            zero_and_free(kbuf2, key_buffer_sz2);
-        if (pubkey2)
-            free(pubkey2);
     } else {
-        ret = make_header(pubkey, pubkey_sz, CMD.image_file,
+        ret = make_header(k->pubkey, k->pubkey_sz, CMD.image_file,
                 CMD.output_image_file);
     }
 
@@ -4050,21 +4544,580 @@ int main(int argc, char** argv)
      * signed image could not be created. */
     if ((ret == 0) && CMD.delta) {
         if (CMD.encrypt)
-            ret = base_diff(CMD.delta_base_file, pubkey, pubkey_sz, 64);
+            ret = base_diff(CMD.delta_base_file, k->pubkey, k->pubkey_sz, 64);
         else
-            ret = base_diff(CMD.delta_base_file, pubkey, pubkey_sz, 16);
+            ret = base_diff(CMD.delta_base_file, k->pubkey, k->pubkey_sz, 16);
     }
+    return ret;
+}
 
-cleanup:
-    /* Add pubkey cleanup */
-    if (pubkey)
-        free(pubkey);
+#if HAVE_FORK
+/* --batch: sign the images listed in a manifest, one signing invocation per
+ * line (the arguments of a single-image run, without the program name).
+ * Each private key is decoded once and inherited by forked workers, that
+ * run up to --jobs images at the same time. Stateful keys (LMS, XMSS) are
+ * never shared between processes: those images are signed by the main
+ * process, one at a time. */
+#define BATCH_MAX_ARGS 64
+#define BATCH_MAX_INPUTS 2  /* image, delta base */
+#define BATCH_MAX_OUTPUTS 3 /* signed image, encrypted image, delta */
+
+/* Options that decide how load_key() decodes a key and updates CMD */
+struct batch_key_id {
+    int sign;
+    int secondary_sign;
+    int hybrid;
+    int manual_sign;
+    int sha_only;
+    uint32_t header_sz;
+    const char *key_file;
+    const char *secondary_key_file;
+};
 
-    if (kbuf)
-        zero_and_free(kbuf, key_buffer_sz);
-    free_key(CMD.sign, 0);
-    if (CMD.hybrid) {
-        free_key(CMD.secondary_sign, 1);
+/* CMD fields set by load_key(), restored when a decoded key is reused */
+struct batch_key_state {
+    int sign;
+    int secondary_sign;
+    uint32_t header_sz;
+    uint32_t signature_sz;
+    uint32_t secondary_signature_sz;
+};
+
+struct batch_job {
+    int line;
+    char *buf; /* manifest line, argv[] points into it */
+    int argc;
+    char *argv[BATCH_MAX_ARGS + 1];
+    struct batch_key_id id;
+    const char *image;
+    /* Files read and written by the job, see batch_path() */
+    char *in[BATCH_MAX_INPUTS];
+    char *out[BATCH_MAX_OUTPUTS];
+    pid_t pid;
+    FILE *log;
+};
+
+/* Per-job results, in memory shared with the workers */
+struct batch_stats {
+    int ret;
+    uint64_t total_us;
+    uint64_t us[STAGE_COUNT];
+};
+
+static int batch_stdout = -1;
+static int batch_stderr = -1;
+static FILE *batch_check_log;
+static const char *batch_check_manifest;
+static int batch_check_line;
+
+/* Send stdout and stderr to the log of a job, or back to the console */
+static void batch_redirect(FILE *log)
+{
+    fflush(stdout);
+    fflush(stderr);
+    if (log != NULL) {
+        dup2(fileno(log), STDOUT_FILENO);
+        dup2(fileno(log), STDERR_FILENO);
+    } else {
+        dup2(batch_stdout, STDOUT_FILENO);
+        dup2(batch_stderr, STDERR_FILENO);
+    }
+}
+
+static void batch_print_log(FILE *log)
+{
+    char buf[4096];
+    size_t n;
+
+    if (log == NULL)
+        return;
+    fseek(log, 0, SEEK_SET);
+    while ((n = fread(buf, 1, sizeof(buf), log)) > 0)
+        fwrite(buf, 1, n, stdout);
+    fflush(stdout);
+    fclose(log);
+}
+
+/* parse_cmdline() exits on invalid arguments: show why, and where */
+static void batch_check_failed(void)
+{
+    if (batch_check_log == NULL)
+        return;
+    batch_redirect(NULL);
+    fprintf(stderr, "%s:%d: invalid signing arguments\n",
+            batch_check_manifest, batch_check_line);
+    batch_print_log(batch_check_log);
+    batch_check_log = NULL;
+}
+
+static int batch_strcmp(const char *a, const char *b)
+{
+    if (a == NULL || b == NULL)
+        return (a != NULL) - (b != NULL);
+    return strcmp(a, b);
+}
+
+static int batch_key_id_cmp(const struct batch_key_id *a,
+        const struct batch_key_id *b)
+{
+    int r = batch_strcmp(a->key_file, b->key_file);
+    if (r == 0)
+        r = batch_strcmp(a->secondary_key_file, b->secondary_key_file);
+    if (r == 0)
+        r = memcmp(a, b, offsetof(struct batch_key_id, key_file));
+    return r;
+}
+
+static int batch_job_cmp(const void *pa, const void *pb)
+{
+    const struct batch_job *a = *(const struct batch_job * const *)pa;
+    const struct batch_job *b = *(const struct batch_job * const *)pb;
+    int r = batch_key_id_cmp(&a->id, &b->id);
+    if (r == 0)
+        r = a->line - b->line;
+    return r;
+}
+
+static int batch_is_stateful(int sign)
+{
+    return (sign == SIGN_LMS) || (sign == SIGN_XMSS);
+}
+
+/* Sign the image selected in CMD, accounting the time of each stage */
+static void batch_run(struct sign_keys *k, struct batch_stats *st)
+{
+    uint64_t t0 = sign_time_us();
+    uint64_t other = 0;
+    int i;
+
+    st->ret = sign_image(k);
+    st->total_us = sign_time_us() - t0;
+    for (i = STAGE_SIGN; i < STAGE_COUNT; i++)
+        other += stage_us[i];
+    stage_us[STAGE_HASH] = (st->total_us > other) ? st->total_us - other : 0;
+    memcpy(st->us, stage_us, sizeof(st->us));
+}
+
+/* Wait for a worker, then show its output */
+static void batch_reap(struct batch_job *jobs, int njobs,
+        struct batch_stats *stats)
+{
+    int status, i;
+    pid_t pid = wait(&status);
+
+    if (pid < 0)
+        return;
+    for (i = 0; i < njobs; i++) {
+        if (jobs[i].pid != pid)
+            continue;
+        if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+            if (stats[i].ret == 0)
+                stats[i].ret = -1;
+        }
+        jobs[i].pid = 0;
+        batch_print_log(jobs[i].log);
+        jobs[i].log = NULL;
+        break;
+    }
+}
+
+static void batch_free_jobs(struct batch_job *jobs, int njobs)
+{
+    int i, k;
+
+    if (jobs == NULL)
+        return;
+    for (i = 0; i < njobs; i++) {
+        for (k = 0; k < BATCH_MAX_INPUTS; k++)
+            free(jobs[i].in[k]);
+        for (k = 0; k < BATCH_MAX_OUTPUTS; k++)
+            free(jobs[i].out[k]);
+        free(jobs[i].buf);
+    }
+    free(jobs);
+}
+
+/* Name of a file that may not exist yet, with its directory resolved, so
+ * that different spellings of the same path compare equal. NULL for an
+ * empty name. */
+static char *batch_path(const char *path)
+{
+    char dir[PATH_MAX], real[PATH_MAX];
+    const char *base;
+    char *ret;
+    size_t len;
+
+    if (path == NULL || *path == '\0')
+        return NULL;
+    base = strrchr(path, '/');
+    if (base == NULL) {
+        strcpy(dir, ".");
+        base = path;
+    } else {
+        len = (size_t)(base - path);
+        if (len == 0)
+            len = 1; /* root directory */
+        if (len >= sizeof(dir))
+            return strdup(path);
+        memcpy(dir, path, len);
+        dir[len] = '\0';
+        base++;
+    }
+    if (realpath(dir, real) == NULL)
+        return strdup(path);
+    len = strlen(real) + strlen(base) + 2;
+    ret = malloc(len);
+    if (ret != NULL)
+        snprintf(ret, len, "%s/%s", strcmp(real, "/") == 0 ? "" : real, base);
+    return ret;
+}
+
+/* Jobs run in parallel and in any order: no job may read a file that
+ * another one writes (e.g. a delta base signed in the same batch), and two
+ * jobs may not write the same file. */
+static int batch_check_files(const char *manifest, struct batch_job *jobs,
+        int njobs)
+{
+    int i, j, a, b;
+
+    for (i = 0; i < njobs; i++) {
+        for (j = 0; j < njobs; j++) {
+            for (b = 0; b < BATCH_MAX_OUTPUTS; b++) {
+                const char *out = jobs[j].out[b];
+                if (out == NULL)
+                    continue;
+                for (a = 0; a < BATCH_MAX_INPUTS; a++) {
+                    if (i != j && jobs[i].in[a] != NULL &&
+                            strcmp(jobs[i].in[a], out) == 0) {
+                        fprintf(stderr, "%s:%d: %s is written by line %d, "
+                                "sign it in a separate batch\n", manifest,
+                                jobs[i].line, out, jobs[j].line);
+                        return -1;
+                    }
+                }
+                for (a = 0; (j > i) && (a < BATCH_MAX_OUTPUTS); a++) {
+                    if (jobs[i].out[a] != NULL &&
+                            strcmp(jobs[i].out[a], out) == 0) {
+                        fprintf(stderr, "%s:%d: %s is also written by "
+                                "line %d\n", manifest, jobs[j].line, out,
+                                jobs[i].line);
+                        return -1;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static int batch_read_manifest(const char *manifest, const char *prog,
+        struct batch_job **out)
+{
+    FILE *f;
+    char *line = NULL;
+    size_t line_sz = 0;
+    struct batch_job *jobs = NULL, *tmp;
+    int njobs = 0, lineno = 0;
+    char *tok;
+
+    f = fopen(manifest, "r");
+    if (f == NULL) {
+        fprintf(stderr, "Open manifest %s: %s\n", manifest, strerror(errno));
+        return -1;
     }
+    while (getline(&line, &line_sz, f) > 0) {
+        struct batch_job *j;
+        lineno++;
+        tok = line + strspn(line, " \t\r\n");
+        if (*tok == '\0' || *tok == '#')
+            continue;
+        tmp = realloc(jobs, (njobs + 1) * sizeof(*jobs));
+        if (tmp == NULL) {
+            fprintf(stderr, "Error allocating batch job\n");
+            goto error;
+        }
+        jobs = tmp;
+        j = &jobs[njobs++];
+        memset(j, 0, sizeof(*j));
+        j->line = lineno;
+        j->buf = line;
+        j->argv[j->argc++] = (char *)prog;
+        /* The tokens point into the line, which is kept for the job */
+        for (tok = strtok(line, " \t\r\n"); tok != NULL;
+                tok = strtok(NULL, " \t\r\n")) {
+            if (j->argc == BATCH_MAX_ARGS) {
+                fprintf(stderr, "%s:%d: too many arguments\n", manifest,
+                        lineno);
+                goto error;
+            }
+            j->argv[j->argc++] = tok;
+        }
+        if (j->argc < 4) {
+            fprintf(stderr, "%s:%d: expected [options] image key version\n",
+                    manifest, lineno);
+            goto error;
+        }
+        line = NULL;
+        line_sz = 0;
+    }
+    free(line);
+    fclose(f);
+    *out = jobs;
+    return njobs;
+
+error:
+    if (njobs > 0 && jobs[njobs - 1].buf == line)
+        line = NULL; /* freed with the job */
+    free(line);
+    fclose(f);
+    batch_free_jobs(jobs, njobs);
+    return -1;
+}
+
+static void batch_usage(const char *prog)
+{
+    printf("Usage: %s --batch manifest [--jobs N]\n", prog);
+    exit(1);
+}
+
+static int sign_batch(int argc, char** argv)
+{
+    const char *manifest;
+    struct batch_job *jobs = NULL;
+    struct batch_job **order = NULL;
+    struct batch_stats *stats;
+    struct cmd_options defaults = CMD;
+    struct sign_keys keys;
+    struct batch_key_state state;
+    const struct batch_key_id *cur = NULL;
+    uint64_t t0, wall_us, sum[STAGE_COUNT];
+    long max_jobs = 0;
+    int njobs, i, n, running = 0, failed = 0, key_loads = 0;
+
+    if (argc < 3)
+        batch_usage(argv[0]);
+    manifest = argv[2];
+    if (argc == 5 && strcmp(argv[3], "--jobs") == 0) {
+        char *end = NULL;
+        max_jobs = strtol(argv[4], &end, 10);
+        if (end == argv[4] || *end != '\0' || max_jobs < 1) {
+            fprintf(stderr, "Invalid --jobs value: %s\n", argv[4]);
+            exit(1);
+        }
+    } else if (argc != 3) {
+        batch_usage(argv[0]);
+    }
+    if (max_jobs == 0)
+        max_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_jobs < 1)
+        max_jobs = 1;
+
+    njobs = batch_read_manifest(manifest, argv[0], &jobs);
+    if (njobs <= 0) {
+        if (njobs == 0)
+            fprintf(stderr, "No images to sign in %s\n", manifest);
+        return 1;
+    }
+    order = malloc(njobs * sizeof(*order));
+    stats = mmap(NULL, njobs * sizeof(*stats), PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    batch_stdout = dup(STDOUT_FILENO);
+    batch_stderr = dup(STDERR_FILENO);
+    if (order == NULL || stats == MAP_FAILED || batch_stdout < 0 ||
+            batch_stderr < 0) {
+        fprintf(stderr, "Error preparing the batch\n");
+        if (stats != MAP_FAILED)
+            munmap(stats, njobs * sizeof(*stats));
+        free(order);
+        batch_free_jobs(jobs, njobs);
+        return 1;
+    }
+    memset(stats, 0, njobs * sizeof(*stats));
+
+    /* Check every job before signing anything, and group them by key */
+    atexit(batch_check_failed);
+    batch_check_manifest = manifest;
+    for (i = 0; i < njobs; i++) {
+        struct batch_job *j = &jobs[i];
+        batch_check_line = j->line;
+        batch_check_log = tmpfile();
+        batch_redirect(batch_check_log);
+        CMD = defaults;
+        parse_cmdline(j->argc, j->argv);
+        batch_redirect(NULL);
+        if (batch_check_log != NULL)
+            fclose(batch_check_log);
+        batch_check_log = NULL;
+        j->id.sign = CMD.sign;
+        j->id.secondary_sign = CMD.secondary_sign;
+        j->id.hybrid = CMD.hybrid;
+        j->id.manual_sign = CMD.manual_sign;
+        j->id.sha_only = CMD.sha_only;
+        j->id.header_sz = CMD.header_sz;
+        j->id.key_file = CMD.key_file;
+        j->id.secondary_key_file = CMD.secondary_key_file;
+        j->image = CMD.image_file;
+        j->in[0] = batch_path(CMD.image_file);
+        if (CMD.delta)
+            j->in[1] = batch_path(CMD.delta_base_file);
+        j->out[0] = batch_path(CMD.output_image_file);
+        if (CMD.encrypt && !CMD.header_only)
+            j->out[1] = batch_path(CMD.output_encrypted_image_file);
+        if (CMD.delta)
+            j->out[2] = batch_path(CMD.output_diff_file);
+        order[i] = j;
+    }
+    if (batch_check_files(manifest, jobs, njobs) != 0) {
+        munmap(stats, njobs * sizeof(*stats));
+        free(order);
+        batch_free_jobs(jobs, njobs);
+        return 1;
+    }
+    qsort(order, njobs, sizeof(*order), batch_job_cmp);
+
+    printf("Signing %d image(s) from %s, %ld worker(s)\n", njobs, manifest,
+            max_jobs);
+    memset(&keys, 0, sizeof(keys));
+    memset(&state, 0, sizeof(state));
+    t0 = sign_time_us();
+    for (n = 0; n < njobs; n++) {
+        struct batch_job *j = order[n];
+        struct batch_stats *st = &stats[j - jobs];
+        int stateful;
+
+        j->log = tmpfile();
+        batch_redirect(j->log);
+        printf("\n=== %s:%d\n", manifest, j->line);
+        CMD = defaults;
+        memset(stage_us, 0, sizeof(stage_us));
+        parse_cmdline(j->argc, j->argv);
+        if (cur == NULL || batch_key_id_cmp(cur, &j->id) != 0) {
+            uint64_t tk = sign_time_us();
+            sign_keys_free(&keys);
+            cur = NULL;
+            key_loads++;
+            if (sign_keys_load(&keys) != 0) {
+                sign_keys_free(&keys);
+                st->ret = 1;
+                batch_redirect(NULL);
+                batch_print_log(j->log);
+                j->log = NULL;
+                continue;
+            }
+            stage_us[STAGE_KEY] = sign_time_us() - tk;
+            state.sign = CMD.sign;
+            state.secondary_sign = CMD.secondary_sign;
+            state.header_sz = CMD.header_sz;
+            state.signature_sz = CMD.signature_sz;
+            state.secondary_signature_sz = CMD.secondary_signature_sz;
+            cur = &j->id;
+        } else {
+            CMD.sign = state.sign;
+            CMD.secondary_sign = state.secondary_sign;
+            CMD.header_sz = state.header_sz;
+            CMD.signature_sz = state.signature_sz;
+            CMD.secondary_signature_sz = state.secondary_signature_sz;
+        }
+        stateful = batch_is_stateful(CMD.sign) ||
+            (CMD.hybrid && batch_is_stateful(CMD.secondary_sign));
+
+        if (!stateful) {
+            batch_redirect(NULL);
+            while (running >= max_jobs) {
+                batch_reap(jobs, njobs, stats);
+                running--;
+            }
+            batch_redirect(j->log);
+            j->pid = fork();
+            if (j->pid == 0) {
+                snprintf(wolfboot_delta_file, sizeof(wolfboot_delta_file),
+                        "/tmp/wolfboot-delta-%ld.bin", (long)getpid());
+                batch_run(&keys, st);
+                fflush(stdout);
+                fflush(stderr);
+                exit(st->ret == 0 ? 0 : 1);
+            }
+            if (j->pid > 0) {
+                batch_redirect(NULL);
+                running++;
+                continue;
+            }
+            perror("fork");
+        }
+        /* Stateful key, or no worker available: sign it here */
+        j->pid = 0;
+        batch_run(&keys, st);
+        batch_redirect(NULL);
+        batch_print_log(j->log);
+        j->log = NULL;
+    }
+    while (running > 0) {
+        batch_reap(jobs, njobs, stats);
+        running--;
+    }
+    wall_us = sign_time_us() - t0;
+    sign_keys_free(&keys);
+
+    memset(sum, 0, sizeof(sum));
+    printf("\n%-5s %-6s %9s %9s %9s %9s %9s %9s  %s\n", "line", "status",
+            "key", "hash/io", "sign", "encrypt", "delta", "total", "image");
+    for (i = 0; i < njobs; i++) {
+        int s;
+        if (stats[i].ret != 0)
+            failed++;
+        printf("%-5d %-6s", jobs[i].line, stats[i].ret == 0 ? "ok" : "FAIL");
+        for (s = 0; s < STAGE_COUNT; s++) {
+            printf(" %9.1f", stats[i].us[s] / 1000.0);
+            sum[s] += stats[i].us[s];
+        }
+        printf(" %9.1f  %s\n", (stats[i].us[STAGE_KEY] + stats[i].total_us) /
+                1000.0, jobs[i].image);
+    }
+    printf("%-12s", "sum (ms)");
+    for (i = 0; i < STAGE_COUNT; i++)
+        printf(" %9.1f", sum[i] / 1000.0);
+    printf("\n%d image(s) signed, %d failed, %d key load(s), %.1f ms\n",
+            njobs - failed, failed, key_loads, wall_us / 1000.0);
+    munmap(stats, njobs * sizeof(*stats));
+    free(order);
+    batch_free_jobs(jobs, njobs);
+    return failed ? 1 : 0;
+}
+#endif /* HAVE_FORK */
+
+int main(int argc, char** argv)
+{
+    int ret;
+    struct sign_keys keys;
+
+#ifdef DEBUG_SIGNTOOL
+    wolfSSL_Debugging_ON();
+#endif
+
+    printf("wolfBoot KeyTools (Compiled C version)\n");
+    printf("wolfBoot version %X\n", WOLFBOOT_VERSION);
+
+    if ((argc > 1) && (strcmp(argv[1], "--batch") == 0)) {
+#if HAVE_FORK
+        return sign_batch(argc, argv);
+#else
+        fprintf(stderr, "--batch is not supported on this platform\n");
+        exit(1);
+#endif
+    }
+
+    /* Check arguments and print usage */
+    if (argc < 4) {
+        printf("Usage: %s [options] image key version\n", argv[0]);
+        printf("       %s --batch manifest [--jobs N]\n", argv[0]);
+        printf("For full usage manual, see 'docs/Signing.md'\n");
+        exit(1);
+    }
+
+    parse_cmdline(argc, argv);
+    ret = sign_keys_load(&keys);
+    if (ret == 0)
+        ret = sign_image(&keys);
+    sign_keys_free(&keys);
     return ret;
 }
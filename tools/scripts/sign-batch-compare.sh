@@ -0,0 +1,90 @@
+#!/bin/bash
+#
+# Check that 'sign --batch' produces the same files as one 'sign' invocation
+# per manifest line. Only deterministic signatures (ED25519, ED448) and
+# --no-ts are used, so that the outputs can be compared byte by byte.
+#
+# Run from the wolfBoot root, after 'make -C tools/keytools'.
+
+SIGN=${SIGN:-./tools/keytools/sign}
+KEYGEN=${KEYGEN:-./tools/keytools/keygen}
+IMAGE=${IMAGE:-test-app/image.elf}
+JOBS=${JOBS:-4}
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+fail() {
+    echo "$1"
+    exit 1
+}
+
+[ -x "$SIGN" ] || fail "$SIGN not found, build tools/keytools first"
+[ -x "$KEYGEN" ] || fail "$KEYGEN not found, build tools/keytools first"
+[ -f "$IMAGE" ] || fail "$IMAGE not found"
+
+$KEYGEN --ed25519 -g "$WORK/ed25519.der" -keystoreDir "$WORK" >/dev/null ||
+    fail "keygen --ed25519 failed"
+$KEYGEN --ed448 -g "$WORK/ed448.der" -keystoreDir "$WORK" >/dev/null ||
+    fail "keygen --ed448 failed"
+# ChaCha20 key (32 bytes) and nonce (12 bytes)
+printf '0123456789abcdef0123456789abcdef0123456789ab' > "$WORK/enc_key.der"
+
+for i in 1 2 3 4 5; do
+    cp "$IMAGE" "$WORK/app$i.bin"
+done
+printf 'patched' | dd of="$WORK/app5.bin" bs=1 seek=256 conv=notrunc \
+    2>/dev/null
+# Base of the delta update, signed once for both runs
+$SIGN --ed25519 --sha256 --no-ts "$WORK/app1.bin" "$WORK/ed25519.der" 1 \
+    >/dev/null || fail "signing the delta base failed"
+mv "$WORK/app1_v1_signed.bin" "$WORK/base_v1_signed.bin"
+
+cat > "$WORK/manifest" <<EOF
+# Two keys, interleaved, to exercise the grouping by key
+--ed25519 --sha256 --no-ts $WORK/app1.bin $WORK/ed25519.der 2
+--ed448 --sha3 --no-ts $WORK/app2.bin $WORK/ed448.der 2
+--ed25519 --sha384 --no-ts $WORK/app3.bin $WORK/ed25519.der 2
+--ed25519 --sha256 --no-ts --encrypt $WORK/enc_key.der --chacha $WORK/app4.bin $WORK/ed25519.der 2
+--ed25519 --sha256 --no-ts --delta $WORK/base_v1_signed.bin $WORK/app5.bin $WORK/ed25519.der 2
+--ed448 --sha256 --no-ts --id 2 $WORK/app2.bin $WORK/ed448.der 3
+EOF
+
+# One invocation per line
+grep -v '^#' "$WORK/manifest" | while read -r line; do
+    $SIGN $line >/dev/null || fail "sign $line failed"
+done || exit 1
+mkdir "$WORK/seq"
+mv "$WORK"/app*_v*_signed*.bin "$WORK/seq/"
+
+# Same manifest, in one batch
+$SIGN --batch "$WORK/manifest" --jobs "$JOBS" >/dev/null ||
+    fail "sign --batch failed"
+
+n=0
+for f in "$WORK"/seq/*.bin; do
+    b=$(basename "$f")
+    [ -f "$WORK/$b" ] || fail "$b: not produced by --batch"
+    cmp "$f" "$WORK/$b" || fail "$b: --batch output differs"
+    n=$((n + 1))
+done
+for f in "$WORK"/app*_v*_signed*.bin; do
+    [ -f "$WORK/seq/$(basename "$f")" ] ||
+        fail "$(basename "$f"): only produced by --batch"
+done
+[ $n -ge 7 ] || fail "only $n output files compared"
+
+# A job reading the output of another one is rejected before signing
+rm -f "$WORK"/app*_v*_signed*.bin
+cat > "$WORK/manifest-dep" <<EOF
+--ed25519 --sha256 --no-ts $WORK/app1.bin $WORK/ed25519.der 4
+--ed25519 --sha256 --no-ts --delta $WORK/app1_v4_signed.bin $WORK/app5.bin $WORK/ed25519.der 5
+EOF
+$SIGN --batch "$WORK/manifest-dep" --jobs "$JOBS" >/dev/null 2>&1 &&
+    fail "sign --batch accepted a delta base signed in the same batch"
+for f in "$WORK"/app*_v*_signed*.bin; do
+    [ -f "$f" ] && fail "$(basename "$f"): written by a rejected batch"
+done
+
+echo "sign --batch: $n output files identical to the sequential run"
+exit 0
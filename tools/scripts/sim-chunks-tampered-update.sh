@@ -0,0 +1,28 @@
+#!/bin/bash
+# Corrupt one byte in the second chunk of the update image: the update
+# must be rejected, and version 1 keep running.
+
+UPDATE_ADDRESS=$((0x100000))
+HEADER_SIZE=${IMAGE_HEADER_SIZE:-256}
+CHUNK_SIZE=$((${IMG_CHUNK_SIZE:-0x4000}))
+OFF=$((UPDATE_ADDRESS + HEADER_SIZE + CHUNK_SIZE + 0x10))
+
+B=`od -An -tu1 -j $OFF -N1 internal_flash.dd | tr -d ' '`
+printf "$(printf '\\%03o' $((B ^ 0xFF)))" | \
+    dd of=internal_flash.dd bs=1 seek=$OFF conv=notrunc 2>/dev/null
+
+V=`./wolfboot.elf update_trigger get_version 2>/dev/null`
+if [ "x$V" != "x1" ]; then
+    echo "Failed first boot with update_trigger"
+    exit 1
+fi
+
+V=`./wolfboot.elf success get_version 2>/dev/null`
+if [ "x$V" != "x1" ]; then
+    echo "Error: Update with a corrupted chunk reported as successful."
+    exit 1
+fi
+echo "Update successfully rejected (V: $V)"
+
+echo Test successful.
+exit 0
@@ -0,0 +1,144 @@
+#!/bin/bash
+#
+# Compare the simulated flash cost of the update strategies supported by
+# wolfBoot: full three-way swap, delta, encrypted (external flash) and
+# hardware dual-bank swap.
+#
+# Each scenario is built from its example configuration, the update is run
+# to completion on the simulator, and the flash cost model in hal/sim.c
+# accounts for every erase/program operation. The latencies of the model
+# can be tuned with the SIM_FLASH_* environment variables (see hal/sim.c),
+# e.g.:
+#
+#   SIM_FLASH_ERASE_US=2000 SIM_FLASH_PAGE=16 tools/scripts/sim-update-benchmark.sh
+#
+# Run from the root of the repository. The current .config is restored on
+# exit.
+
+set -uo pipefail
+
+SCENARIOS="${SCENARIOS:-sunnyday delta encrypted dualbank}"
+LOG=$(mktemp /tmp/wolfboot-sim-cost.XXXXXX)
+MAKE="${MAKE:-make}"
+
+if [ ! -f "tools/scripts/sim-sunnyday-update.sh" ]; then
+    echo "Run this script from the wolfBoot root directory." >&2
+    exit 1
+fi
+
+if [ -f .config ]; then
+    cp .config .config.bench-orig
+fi
+
+cleanup() {
+    rm -f "$LOG" internal_flash.dd.wear external_flash.dd.wear
+    if [ -f .config.bench-orig ]; then
+        mv .config.bench-orig .config
+    fi
+}
+trap cleanup EXIT
+
+# build <config> <make target...>
+build() {
+    local config=$1
+    shift
+    cp "config/examples/$config" .config
+    $MAKE keysclean >/dev/null 2>&1
+    $MAKE clean >/dev/null 2>&1
+    if ! $MAKE "$@" >/dev/null 2>&1; then
+        echo "Build failed: $config $*" >&2
+        return 1
+    fi
+}
+
+# run <wolfboot.elf arguments...>: one power cycle of the simulator
+run() {
+    SIM_FLASH_COST="$LOG" ./wolfboot.elf "$@" 2>/dev/null
+}
+
+# Two boots for the update flows: the first one boots v1 and triggers the
+# update, the second one installs v2 and confirms it.
+update_flow() {
+    local v
+    v=$(run update_trigger get_version)
+    [ "$v" = "1" ] || { echo "first boot: expected v1, got '$v'" >&2; return 1; }
+    v=$(run success get_version)
+    [ "$v" = "2" ] || { echo "update: expected v2, got '$v'" >&2; return 1; }
+}
+
+# The dual-bank target boots the newest image directly, by swapping banks.
+dualbank_flow() {
+    local v
+    rm -f sim_registers.dd
+    v=$(run get_version)
+    [ "$v" = "2" ] || { echo "first boot: expected v2, got '$v'" >&2; return 1; }
+    v=$(run success get_version)
+    [ "$v" = "2" ] || { echo "confirm: expected v2, got '$v'" >&2; return 1; }
+}
+
+scenario() {
+    case "$1" in
+        sunnyday)
+            build sim.config test-sim-internal-flash-with-update && update_flow
+            ;;
+        delta)
+            build sim-delta-update.config \
+                test-sim-internal-flash-with-delta-update && update_flow
+            ;;
+        encrypted)
+            build sim-encrypt-update.config \
+                test-sim-external-flash-with-enc-update && update_flow
+            ;;
+        dualbank)
+            build sim-dualbank.config test-sim-internal-flash-with-update && \
+                dualbank_flow
+            ;;
+        *)
+            echo "Unknown scenario $1" >&2
+            return 1
+            ;;
+    esac
+}
+
+# Sum the fields of all the reports appended since the scenario started.
+# max_wear is cumulative over the boots (see hal/sim.c): keep the highest.
+summarize() {
+    awk -v name="$1" '
+        /^sim_flash_cost / {
+            for (i = 2; i <= NF; i++) {
+                split($i, kv, "=")
+                if (kv[1] ~ /max_wear$/) {
+                    if (kv[2] > v[kv[1]]) v[kv[1]] = kv[2]
+                } else {
+                    v[kv[1]] += kv[2]
+                }
+            }
+        }
+        END {
+            printf "%-10s %10.1f %6d %8d %10d %6d %8d %10d %6d\n", name,
+                v["time_us"] / 1000.0, v["swaps"],
+                v["int_erased_sectors"], v["int_prog_bytes"], v["int_max_wear"],
+                v["ext_erased_sectors"], v["ext_prog_bytes"], v["ext_max_wear"]
+        }' "$LOG"
+}
+
+printf "%-10s %10s %6s %8s %10s %6s %8s %10s %6s\n" "scenario" "time(ms)" \
+    "swaps" "int_ers" "int_prog" "int_w" "ext_ers" "ext_prog" "ext_w"
+fail=0
+for s in $SCENARIOS; do
+    : > "$LOG"
+    # Erase counts are kept across the boots of a scenario, not across
+    # scenarios
+    rm -f internal_flash.dd.wear external_flash.dd.wear
+    if scenario "$s"; then
+        summarize "$s"
+    else
+        printf "%-10s %10s\n" "$s" "FAILED"
+        fail=1
+    fi
+done
+
+echo
+echo "int_ers/ext_ers: sectors erased, int_w/ext_w: highest erase count of a"
+echo "single sector, int_prog/ext_prog: bytes programmed."
+exit $fail
@@ -0,0 +1,254 @@
+/* Test harness for the UART flash protocol.
+ *
+ * Links the target-side driver (src/uart_flash.c) against a pseudo-terminal
+ * and runs the real ufserver binary on the other end. Erase, write and read
+ * operations go through the ext_flash_* API and the results are checked
+ * against the image file served by ufserver.
+ *
+ * Usage: test_uart_flash [-1] [-e N] ./ufserver
+ *   -1:   start the server in v1-only mode (checks the fallback to v1)
+ *   -e N: corrupt one in N bytes on average, in each direction, to check
+ *         the v2 retransmissions
+ *
+ * Built with UART_FLASH_V2 this exercises protocol v2, without it the v1
+ * driver (against a v2-capable server).
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <pty.h>
+#include <sys/wait.h>
+
+#define FIRMWARE_PARTITION_SIZE 0x20000
+#define SWAP_SIZE 0x1000
+#define TEST_LEN 0x8000
+
+int ext_flash_write(uintptr_t address, const uint8_t *data, int len);
+int ext_flash_read(uintptr_t address, uint8_t *data, int len);
+int ext_flash_erase(uintptr_t address, int len);
+void ext_flash_lock(void);
+void ext_flash_unlock(void);
+
+static int master = -1;
+static unsigned long corrupt_every;
+static uint32_t corrupt_seed = 0x2545F491U;
+static uint32_t last_bitrate;
+
+static int corrupt_next(void)
+{
+    if (corrupt_every == 0)
+        return 0;
+    corrupt_seed = (corrupt_seed * 1664525U) + 1013904223U;
+    return ((corrupt_seed >> 8) % corrupt_every) == 0;
+}
+
+/* Target UART back-end on the pty master */
+int uart_tx(const uint8_t c)
+{
+    uint8_t b = c;
+    if (corrupt_next())
+        b ^= 0x40;
+    while (write(master, &b, 1) != 1) {
+        if (errno != EAGAIN)
+            return -1;
+    }
+    return 1;
+}
+
+int uart_rx(uint8_t *c)
+{
+    if (read(master, c, 1) != 1)
+        return 0;
+    if (corrupt_next())
+        *c ^= 0x40;
+    return 1;
+}
+
+int uart_init(uint32_t bitrate, uint8_t data, char parity, uint8_t stop)
+{
+    (void)data;
+    (void)parity;
+    (void)stop;
+    last_bitrate = bitrate;
+    return 0;
+}
+
+uint32_t wolfBoot_get_image_version(uint8_t part)
+{
+    (void)part;
+    return 1;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static int check_file(const char *path, uint32_t off, const uint8_t *exp,
+    uint32_t len)
+{
+    uint8_t *buf = malloc(len);
+    int fd = open(path, O_RDONLY);
+    int ret = -1;
+    if ((buf != NULL) && (fd >= 0) &&
+            (pread(fd, buf, len, off) == (ssize_t)len) &&
+            (memcmp(buf, exp, len) == 0))
+        ret = 0;
+    if (fd >= 0)
+        close(fd);
+    free(buf);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    static uint8_t wbuf[TEST_LEN], rbuf[TEST_LEN], ff[TEST_LEN];
+    char tmpl[] = "/tmp/ufserver_fw_XXXXXX";
+    char slavename[256];
+    const char *server;
+    int v1_only = 0;
+    int slave, fd, i, status;
+    int ret = 1;
+    pid_t pid;
+    double t0, t_wr, t_rd;
+
+    while ((argc > 2) && (argv[1][0] == '-')) {
+        if (strcmp(argv[1], "-1") == 0) {
+            v1_only = 1;
+        } else if ((strcmp(argv[1], "-e") == 0) && (argc > 3)) {
+            corrupt_every = strtoul(argv[2], NULL, 0);
+            argc--;
+            argv++;
+        } else {
+            break;
+        }
+        argc--;
+        argv++;
+    }
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s [-1] [-e N] ./ufserver\n", argv[0]);
+        return 2;
+    }
+    server = argv[1];
+
+    fd = mkstemp(tmpl);
+    if (fd < 0) { perror("mkstemp"); return 2; }
+    memset(wbuf, 0xA5, 64);
+    if (write(fd, wbuf, 64) != 64) { perror("write"); return 2; }
+    close(fd);
+
+    if (openpty(&master, &slave, slavename, NULL, NULL) != 0) {
+        perror("openpty");
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    pid = fork();
+    if (pid < 0) { perror("fork"); return 2; }
+    if (pid == 0) {
+        close(master);
+        close(slave);
+        fd = open("/dev/null", O_WRONLY);
+        if (fd >= 0) { dup2(fd, STDOUT_FILENO); }
+        if (v1_only)
+            execl(server, server, "-1", tmpl, slavename, (char *)NULL);
+        else
+            execl(server, server, tmpl, slavename, (char *)NULL);
+        perror("execl");
+        _exit(127);
+    }
+    close(slave);
+    fcntl(master, F_SETFL, O_NONBLOCK);
+    usleep(200000); /* let the server open and configure the port */
+
+    srand(1);
+    for (i = 0; i < TEST_LEN; i++)
+        wbuf[i] = (uint8_t)rand();
+    memset(ff, 0xFF, sizeof(ff));
+
+    ext_flash_unlock();
+    if (ext_flash_erase(0, FIRMWARE_PARTITION_SIZE) != 0) {
+        fprintf(stderr, "FAIL: erase\n");
+        goto out;
+    }
+    if (check_file(tmpl, 0, ff, TEST_LEN) != 0) {
+        fprintf(stderr, "FAIL: partition not erased\n");
+        goto out;
+    }
+    /* Unaligned start, length not a multiple of the frame size */
+    t0 = now_s();
+    if (ext_flash_write(0x101, wbuf, TEST_LEN - 0x201) != TEST_LEN - 0x201) {
+        fprintf(stderr, "FAIL: write\n");
+        goto out;
+    }
+    t_wr = now_s() - t0;
+    if (check_file(tmpl, 0x101, wbuf, TEST_LEN - 0x201) != 0) {
+        fprintf(stderr, "FAIL: written data does not match\n");
+        goto out;
+    }
+    t0 = now_s();
+    if (ext_flash_read(0x101, rbuf, TEST_LEN - 0x201) != TEST_LEN - 0x201) {
+        fprintf(stderr, "FAIL: read\n");
+        goto out;
+    }
+    t_rd = now_s() - t0;
+    if (memcmp(rbuf, wbuf, TEST_LEN - 0x201) != 0) {
+        fprintf(stderr, "FAIL: read data does not match\n");
+        goto out;
+    }
+    /* Swap area, past the partition */
+    if ((ext_flash_write(FIRMWARE_PARTITION_SIZE, wbuf, SWAP_SIZE) != SWAP_SIZE)
+            || (ext_flash_read(FIRMWARE_PARTITION_SIZE, rbuf, SWAP_SIZE)
+                != SWAP_SIZE) || (memcmp(rbuf, wbuf, SWAP_SIZE) != 0)) {
+        fprintf(stderr, "FAIL: swap sector write/read\n");
+        goto out;
+    }
+    if ((ext_flash_erase(FIRMWARE_PARTITION_SIZE, SWAP_SIZE) != 0) ||
+            (ext_flash_read(FIRMWARE_PARTITION_SIZE, rbuf, SWAP_SIZE)
+                != SWAP_SIZE) || (memcmp(rbuf, ff, SWAP_SIZE) != 0)) {
+        fprintf(stderr, "FAIL: swap sector erase\n");
+        goto out;
+    }
+    ext_flash_lock();
+#ifdef UART_FLASH_V2_BITRATE
+    if (!v1_only && (last_bitrate != UART_FLASH_V2_BITRATE)) {
+        fprintf(stderr, "FAIL: bitrate not switched to %u\n",
+            UART_FLASH_V2_BITRATE);
+        goto out;
+    }
+#endif
+    printf("PASS: %u bytes, write %.1f KB/s, read %.1f KB/s\n",
+        TEST_LEN - 0x201, (TEST_LEN - 0x201) / 1024.0 / t_wr,
+        (TEST_LEN - 0x201) / 1024.0 / t_rd);
+    ret = 0;
+out:
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+    unlink(tmpl);
+    return ret;
+}
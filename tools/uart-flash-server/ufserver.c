@@ -36,6 +36,7 @@
 #include <errno.h>
 #include <string.h>
 #include <libgen.h>
+#include <poll.h>
 
 #ifndef __MACH__
 #include <termio.h>
@@ -50,6 +51,26 @@
 #define CMD_HDR_READ  0x02
 #define CMD_HDR_ERASE 0x03
 #define CMD_ACK       0x06
+#define CMD_NAK       0x15
+
+/* Protocol v2 (see src/uart_flash.c): 'W' + CMD_HDR_V2 selects framed
+ * transfers with CRC32 and a window of unacknowledged frames. */
+#define CMD_HDR_V2    0x10
+#define V2_SOF        0xA5
+#define V2_HELLO      0x10
+#define V2_WRITE      0x11
+#define V2_READ       0x12
+#define V2_DATA       0x13
+#define V2_ERASE      0x14
+#define V2_SYNC       0x15
+#define V2_VERSION    2
+#define V2_HDR_LEN    5
+#define V2_MAX_WINDOW 16
+#define V2_MAX_FRAME  4096
+#define V2_RETRIES    8
+#define V2_BYTE_TIMEOUT_MS 200
+#define V2_ACK_TIMEOUT_MS  500
+#define V2_SYNC_TIMEOUT_MS 1000
 
 #define FIRMWARE_PARTITION_SIZE 0x20000
 #define SWAP_SIZE 0x1000
@@ -72,6 +93,13 @@ extern uint16_t wolfBoot_find_header(uint8_t *haystack, uint16_t type,
 
 const char blinker[]="-\\|/";
 static int valid_update = 1;
+static int v1_only = 0;
+static int uart_rate = UART_BITRATE;
+static int v2_active = 0;
+static uint8_t v2_rx_seq;
+static int v2_nak_sent;
+static uint8_t v2_window = 1;
+static uint16_t v2_frame = 16;
 
 void printmsg(const char *msg)
 {
@@ -250,6 +278,22 @@ int open_uart(const char *uart_dev)
     return serial_open(uart_dev, UART_BITRATE);
 }
 
+static int serial_set_rate(int fd, int rate)
+{
+    struct termios options;
+    int speed = rate_to_constant(rate);
+    if (speed == 0)
+        return -1;
+    if (tcgetattr(fd, &options) != 0)
+        return -1;
+    cfsetispeed(&options, speed);
+    cfsetospeed(&options, speed);
+    if (tcsetattr(fd, TCSADRAIN, &options) != 0)
+        return -1;
+    uart_rate = rate;
+    return 0;
+}
+
 static void send_ack(int ud)
 {
     uint8_t ack = CMD_ACK;
@@ -354,6 +398,312 @@ static void uart_flash_write(uint8_t *base, int ud)
 }
 
 
+static uint32_t v2_crc32(uint32_t crc, const uint8_t *p, uint32_t len)
+{
+    uint32_t i;
+    int k;
+    for (i = 0; i < len; i++) {
+        crc ^= p[i];
+        for (k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+    }
+    return crc;
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+static int read_byte_timeout(int ud, uint8_t *c, int ms)
+{
+    struct pollfd pfd;
+    pfd.fd = ud;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, ms) <= 0)
+        return -1;
+    if (read(ud, c, 1) != 1)
+        return -1;
+    return 0;
+}
+
+static void v2_send_frame(int ud, uint8_t type, uint8_t seq,
+    const uint8_t *payload, uint32_t len)
+{
+    uint8_t frame[V2_HDR_LEN + 4 + V2_MAX_FRAME + 4];
+    uint32_t crc;
+    frame[0] = V2_SOF;
+    frame[1] = type;
+    frame[2] = seq;
+    frame[3] = len & 0xFF;
+    frame[4] = (len >> 8) & 0xFF;
+    memcpy(frame + V2_HDR_LEN, payload, len);
+    crc = ~v2_crc32(0xFFFFFFFFU, frame + 1, V2_HDR_LEN - 1 + len);
+    put_le32(frame + V2_HDR_LEN + len, crc);
+    if (write(ud, frame, V2_HDR_LEN + len + 4) < 0)
+        perror("write");
+}
+
+static void v2_send_ack(int ud, uint8_t code, uint8_t seq)
+{
+    uint8_t ack[3];
+    ack[0] = code;
+    ack[1] = seq;
+    ack[2] = ~seq;
+    if (write(ud, ack, 3) < 0)
+        perror("write");
+}
+
+/* Receive the rest of a frame after its SOF byte. Returns the payload
+ * length, or -1 if the frame is truncated or corrupted. */
+static int v2_recv_frame(int ud, uint8_t *type, uint8_t *seq, uint8_t *buf,
+    uint32_t max)
+{
+    uint8_t fh[V2_HDR_LEN];
+    uint8_t crc[4];
+    uint32_t len, i;
+    fh[0] = V2_SOF;
+    for (i = 1; i < V2_HDR_LEN; i++) {
+        if (read_byte_timeout(ud, &fh[i], V2_BYTE_TIMEOUT_MS) != 0)
+            return -1;
+    }
+    len = fh[3] | (fh[4] << 8);
+    if (len > max)
+        return -1;
+    for (i = 0; i < len; i++) {
+        if (read_byte_timeout(ud, &buf[i], V2_BYTE_TIMEOUT_MS) != 0)
+            return -1;
+    }
+    for (i = 0; i < 4; i++) {
+        if (read_byte_timeout(ud, &crc[i], V2_BYTE_TIMEOUT_MS) != 0)
+            return -1;
+    }
+    if (get_le32(crc) != ~v2_crc32(v2_crc32(0xFFFFFFFFU, fh + 1,
+            V2_HDR_LEN - 1), buf, len))
+        return -1;
+    *type = fh[1];
+    *seq = fh[2];
+    return (int)len;
+}
+
+/* Returns 1 if a new frame starts instead: the target has all the data */
+static int v2_recv_ack(int ud, uint8_t *code, uint8_t *seq)
+{
+    uint8_t inv;
+    do {
+        if (read_byte_timeout(ud, code, V2_ACK_TIMEOUT_MS) != 0)
+            return -1;
+        if (*code == V2_SOF)
+            return 1;
+    } while ((*code != CMD_ACK) && (*code != CMD_NAK));
+    if ((read_byte_timeout(ud, seq, V2_BYTE_TIMEOUT_MS) != 0) ||
+            (read_byte_timeout(ud, &inv, V2_BYTE_TIMEOUT_MS) != 0))
+        return -1;
+    if ((*seq ^ inv) != 0xFF)
+        return -1;
+    return 0;
+}
+
+static void v2_nak(int ud)
+{
+    /* One NAK per missing frame: the target rewinds to it */
+    if (!v2_nak_sent)
+        v2_send_ack(ud, CMD_NAK, v2_rx_seq);
+    v2_nak_sent = 1;
+}
+
+/* Stream DATA frames back to the target, keeping up to v2_window of them
+ * unacknowledged. Each frame starts with its flash address, so that a
+ * late retransmission is never taken for the data of another request.
+ * Returns 1 if the SOF of the next frame from the target was consumed. */
+static int v2_serve_read(uint8_t *base, int ud, uint32_t address,
+    uint32_t len)
+{
+    static uint8_t data[4 + V2_MAX_FRAME];
+    uint32_t chunk_max = v2_frame;
+    uint32_t nframes = (len + chunk_max - 1) / chunk_max;
+    uint32_t b = 0, next = 0;
+    uint8_t code, s, idx;
+    int retries = 0, ret;
+
+    while (b < nframes) {
+        while ((next < nframes) && ((next - b) < v2_window)) {
+            uint32_t off = next * chunk_max;
+            uint32_t chunk = len - off;
+            if (chunk > chunk_max)
+                chunk = chunk_max;
+            put_le32(data, address + off);
+            memcpy(data + 4, base + address + off, chunk);
+            v2_send_frame(ud, V2_DATA, (uint8_t)next, data, 4 + chunk);
+            next++;
+        }
+        ret = v2_recv_ack(ud, &code, &s);
+        if (ret == 1)
+            return 1;
+        if (ret != 0) {
+            next = b;
+            if (++retries > V2_RETRIES)
+                return 0;
+            continue;
+        }
+        idx = (uint8_t)(s - (uint8_t)b);
+        if (code == CMD_ACK) {
+            if (idx < (next - b)) {
+                b += idx + 1;
+                retries = 0;
+            }
+        } else if (idx <= (next - b)) {
+            b += idx;
+            next = b;
+            if (++retries > V2_RETRIES)
+                return 0;
+        }
+    }
+    return 0;
+}
+
+static void v2_hello(int ud, uint8_t seq, const uint8_t *req, int len)
+{
+    uint8_t resp[8];
+    uint16_t frame;
+    uint32_t baud;
+    int old_rate = uart_rate;
+
+    if ((len != 8) || (req[0] != V2_VERSION))
+        return;
+    frame = req[2] | (req[3] << 8);
+    if (frame > V2_MAX_FRAME)
+        frame = V2_MAX_FRAME;
+    if (frame < 16)
+        return;
+    v2_window = req[1];
+    if (v2_window > V2_MAX_WINDOW)
+        v2_window = V2_MAX_WINDOW;
+    if (v2_window == 0)
+        return;
+    v2_frame = frame;
+    baud = get_le32(req + 4);
+    if ((baud == (uint32_t)uart_rate) || (rate_to_constant(baud) == 0))
+        baud = 0;
+    resp[0] = V2_VERSION;
+    resp[1] = v2_window;
+    resp[2] = v2_frame & 0xFF;
+    resp[3] = (v2_frame >> 8) & 0xFF;
+    put_le32(resp + 4, baud);
+    v2_send_frame(ud, V2_HELLO, seq, resp, sizeof(resp));
+    v2_active = 1;
+    v2_rx_seq = seq + 1;
+    v2_nak_sent = 0;
+    printf("\r\nProtocol v2: window %u, frame %u bytes\n", v2_window,
+        v2_frame);
+    if (baud == 0)
+        return;
+    tcdrain(ud);
+    if (serial_set_rate(ud, baud) != 0)
+        return;
+    /* Wait for a SYNC frame at the new rate, go back to the old one if it
+     * does not get through. */
+    while (1) {
+        uint8_t c, type, s;
+        uint8_t buf[16];
+        if (read_byte_timeout(ud, &c, V2_SYNC_TIMEOUT_MS) != 0)
+            break;
+        if ((c == V2_SOF) &&
+                (v2_recv_frame(ud, &type, &s, buf, sizeof(buf)) == 0) &&
+                (type == V2_SYNC) && (s == v2_rx_seq)) {
+            v2_send_ack(ud, CMD_ACK, s);
+            v2_rx_seq++;
+            printf("Switched to %d bps\n", uart_rate);
+            return;
+        }
+    }
+    fprintf(stderr, "No SYNC at %u bps, back to %d bps\n", baud, old_rate);
+    serial_set_rate(ud, old_rate);
+}
+
+/* Handle one v2 frame, after its SOF byte. Returns 1 if the SOF of the
+ * following frame was consumed already. */
+static int uart_v2_frame(uint8_t *base, int ud)
+{
+    static uint8_t buf[4 + V2_MAX_FRAME];
+    uint8_t type, seq;
+    uint32_t address, len;
+    int ret;
+
+    ret = v2_recv_frame(ud, &type, &seq, buf, sizeof(buf));
+    if (ret < 0) {
+        v2_nak(ud);
+        return 0;
+    }
+    if (type == V2_HELLO) {
+        v2_hello(ud, seq, buf, ret);
+        return 0;
+    }
+    if (seq != v2_rx_seq) {
+        if ((uint8_t)(v2_rx_seq - seq) <= V2_MAX_WINDOW) {
+            /* Retransmission of a frame already processed */
+            if ((type == V2_READ) && ((uint8_t)(seq + 1) == v2_rx_seq) &&
+                    (ret == 8)) {
+                address = get_le32(buf);
+                len = get_le32(buf + 4);
+                if ((uint64_t)address + (uint64_t)len <=
+                        (FIRMWARE_PARTITION_SIZE + SWAP_SIZE))
+                    return v2_serve_read(base, ud, address, len);
+            } else if (type != V2_READ) {
+                v2_send_ack(ud, CMD_ACK, seq);
+            }
+        } else {
+            v2_nak(ud);
+        }
+        return 0;
+    }
+    v2_nak_sent = 0;
+    if ((type == V2_SYNC) && (ret == 0)) {
+        v2_rx_seq++;
+        v2_send_ack(ud, CMD_ACK, seq);
+        return 0;
+    }
+    if ((type == V2_WRITE) ? (ret <= 4) : (ret != 8))
+        return 0;
+    address = get_le32(buf);
+    len = (type == V2_WRITE) ? (uint32_t)(ret - 4) : get_le32(buf + 4);
+    if ((uint64_t)address + (uint64_t)len > (FIRMWARE_PARTITION_SIZE + SWAP_SIZE))
+        return 0;
+    v2_rx_seq++;
+    switch (type) {
+        case V2_WRITE:
+            printmsg((address < FIRMWARE_PARTITION_SIZE) ? msgWriteUpdate :
+                msgWriteSwap);
+            memcpy(base + address, buf + 4, len);
+            v2_send_ack(ud, CMD_ACK, seq);
+            msync(base, FIRMWARE_PARTITION_SIZE + SWAP_SIZE, MS_ASYNC);
+            break;
+        case V2_ERASE:
+            printmsg((address < FIRMWARE_PARTITION_SIZE) ? msgEraseUpdate :
+                msgEraseSwap);
+            memset(base + address, 0xFF, len);
+            msync(base, FIRMWARE_PARTITION_SIZE + SWAP_SIZE, MS_SYNC);
+            v2_send_ack(ud, CMD_ACK, seq);
+            break;
+        case V2_READ:
+            printmsg((address < FIRMWARE_PARTITION_SIZE) ? msgReadUpdate :
+                msgReadSwap);
+            return v2_serve_read(base, ud, address, len);
+        default:
+            fprintf(stderr, "Unrecognized v2 frame: %02X\n", type);
+            break;
+    }
+    return 0;
+}
+
 static void serve_update(uint8_t *base, const char *uart_dev)
 {
     int ret = 0;
@@ -373,6 +723,11 @@ static void serve_update(uint8_t *base, const char *uart_dev)
        if (ret == 0)
            continue;
 
+       if ((buf[0] == V2_SOF) && !v1_only) {
+           while (uart_v2_frame(base, ud) == 1)
+               ;
+           continue;
+       }
        if ((buf[0] != CMD_HDR_WOLF) &&
            (buf[0] != CMD_HDR_VER) &&
            (buf[0] != CMD_APP_VER)) {
@@ -395,6 +750,7 @@ static void serve_update(uint8_t *base, const char *uart_dev)
        if (buf[0] == CMD_HDR_VER) {
             uint32_t v;
             int idx = 1;
+            v2_active = 0;
             send_ack(ud);
             while (idx < 5) {
                 ret = read(ud, buf + idx, 1);
@@ -424,6 +780,10 @@ static void serve_update(uint8_t *base, const char *uart_dev)
           printf("Timeout!\n");
           continue;
        }
+       /* During a v2 session, only a new probe is accepted after a 'W', which
+        * may be a stray byte. A target reboot ('V') re-enables v1. */
+       if (v2_active && (buf[0] != CMD_HDR_V2))
+           continue;
        /* Read command code */
        switch(buf[0]) {
            case CMD_HDR_ERASE:
@@ -438,6 +798,11 @@ static void serve_update(uint8_t *base, const char *uart_dev)
                send_ack(ud);
                uart_flash_write(base, ud);
                break;
+           case CMD_HDR_V2:
+               /* Left unacknowledged in v1 mode: the target keeps using v1 */
+               if (!v1_only)
+                   send_ack(ud);
+               break;
            default:
                fprintf(stderr, "Unrecognized command: %02X\n", buf[0]);
                break;
@@ -447,8 +812,9 @@ static void serve_update(uint8_t *base, const char *uart_dev)
 
 void usage(char *pname)
 {
-    printf("Usage: %s binary_file serial_port\nExample:\n"
-        "%s firmware_v3_signed.bin /dev/ttyUSB0\n",
+    printf("Usage: %s [-1] binary_file serial_port\nExample:\n"
+        "%s firmware_v3_signed.bin /dev/ttyUSB0\n"
+        "  -1: only serve protocol v1 (byte by byte)\n",
         pname, pname);
     exit(1);
 }
@@ -457,6 +823,11 @@ int main(int argc, char *argv[])
 {
     uint8_t *base_fw;
     uint32_t base_fw_ver = 0;
+    if ((argc == 4) && (strcmp(argv[1], "-1") == 0)) {
+        v1_only = 1;
+        argc--;
+        argv++;
+    }
     if (argc != 3) {
         usage(argv[0]);
     }
@@ -0,0 +1,385 @@
+/* unit-ata-ncq.c
+ *
+ * Unit tests for the multi-slot READ FPDMA QUEUED path of src/x86/ata.c.
+ * The AHCI port is a small model: commands issued through PxCI (and PxSACT
+ * for queued commands) are executed against a RAM disk when the driver polls
+ * PxSACT/PxCI, the newest command first, so completions arrive out of order.
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#include <check.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define WOLFBOOT_AHCI_NCQ
+#define ATA_NCQ_MAX_SLOTS 8
+#define ATA_NCQ_XFER_SECTORS 16
+
+#include <x86/ahci.h>
+#include <x86/ata.h>
+
+#define TEST_AHCI_BASE 0x10000U
+#define TEST_DISK_SECTORS 4096
+#define TEST_BUF_SIZE (1024 * 1024)
+
+/* Model of the AHCI port 0 */
+static uint32_t hba_cap;
+static uint32_t port_sact, port_ci, port_is;
+static uint16_t id_sata_cap, id_queue_depth;
+static uint8_t *disk;
+static int64_t fail_lba = -1;
+static int hba_stalled;
+static unsigned int ncq_cmds, dma_cmds, max_in_flight, max_prdtl;
+
+uint32_t mmio_read32(uintptr_t address);
+void mmio_write32(uintptr_t address, uint32_t value);
+
+void panic(void)
+{
+    ck_abort_msg("panic!");
+}
+
+#include "../../src/x86/ata.c"
+
+static uint8_t *clb_mem;
+static uint8_t *ctable_mem;
+static uint8_t *buf;
+
+static unsigned int popcount(uint32_t v)
+{
+    unsigned int n = 0;
+    while (v) {
+        n += v & 1;
+        v >>= 1;
+    }
+    return n;
+}
+
+static void prdt_copy(struct hba_cmd_header *cmd, struct hba_cmd_table *tbl,
+        const uint8_t *src, uint32_t len)
+{
+    uint32_t i, l;
+
+    if (cmd->prdtl > max_prdtl)
+        max_prdtl = cmd->prdtl;
+    for (i = 0; i < cmd->prdtl && len > 0; i++) {
+        l = tbl->prdt_entry[i].dbc + 1;
+        if (l > len)
+            l = len;
+        memcpy((uint8_t *)(uintptr_t)tbl->prdt_entry[i].dba, src, l);
+        src += l;
+        len -= l;
+    }
+    ck_assert_uint_eq(len, 0);
+}
+
+static void hba_execute(int slot)
+{
+    struct hba_cmd_header *cmd = (struct hba_cmd_header *)clb_mem + slot;
+    struct hba_cmd_table *tbl = (struct hba_cmd_table *)(uintptr_t)cmd->ctba;
+    struct fis_reg_h2d *fis = (struct fis_reg_h2d *)tbl->cfis;
+    uint64_t lba;
+    uint32_t count;
+    uint8_t id[ATA_IDENTIFY_DEVICE_COMMAND_LEN];
+
+    /* Each slot uses its own command table */
+    ck_assert_ptr_eq(tbl, ctable_mem + slot * sizeof(struct hba_cmd_table));
+    lba = (uint64_t)fis->lba0 | ((uint64_t)fis->lba1 << 8) |
+        ((uint64_t)fis->lba2 << 16) | ((uint64_t)fis->lba3 << 24) |
+        ((uint64_t)fis->lba4 << 32) | ((uint64_t)fis->lba5 << 40);
+    switch (fis->command) {
+        case ATA_CMD_IDENTIFY_DEVICE:
+            memset(id, 0, sizeof(id));
+            memcpy(id + ATA_ID_SATA_CAPABILITIES_POS, &id_sata_cap, 2);
+            memcpy(id + ATA_ID_QUEUE_DEPTH_POS, &id_queue_depth, 2);
+            prdt_copy(cmd, tbl, id, sizeof(id));
+            return;
+        case ATA_CMD_READ_FPDMA_QUEUED:
+            ck_assert_uint_eq(fis->count >> 3, (unsigned)slot);
+            ck_assert_uint_ne(port_sact & (1U << slot), 0);
+            count = fis->feature_l | (fis->feature_h << 8);
+            ncq_cmds++;
+            break;
+        case ATA_CMD_READ_DMA_EX:
+            count = fis->count;
+            dma_cmds++;
+            break;
+        default:
+            ck_abort_msg("unexpected ATA command %02x", fis->command);
+            return;
+    }
+    ck_assert_uint_gt(count, 0);
+    ck_assert_uint_le(lba + count, TEST_DISK_SECTORS);
+    if (fail_lba >= (int64_t)lba && fail_lba < (int64_t)(lba + count)) {
+        port_is |= AHCI_PORT_IS_TFES;
+        return;
+    }
+    prdt_copy(cmd, tbl, disk + lba * 512, count * 512);
+}
+
+/* Complete the newest command still in progress */
+static void hba_step(void)
+{
+    uint32_t busy = port_sact | port_ci;
+    int slot;
+
+    if (popcount(busy) > max_in_flight)
+        max_in_flight = popcount(busy);
+    if (busy == 0 || hba_stalled || (port_is & AHCI_PORT_IS_TFES))
+        return;
+    for (slot = 31; slot >= 0; slot--) {
+        if (busy & (1U << slot))
+            break;
+    }
+    hba_execute(slot);
+    if (port_is & AHCI_PORT_IS_TFES)
+        return;
+    port_ci &= ~(1U << slot);
+    port_sact &= ~(1U << slot);
+}
+
+uint32_t mmio_read32(uintptr_t address)
+{
+    uintptr_t port = TEST_AHCI_BASE + AHCI_PORT_START;
+
+    if (address == AHCI_HBA_CAP(TEST_AHCI_BASE))
+        return hba_cap;
+    if (address == port + AHCI_PORT_IS_OFFSET)
+        return port_is;
+    if (address == port + AHCI_PORT_SACT_OFFSET) {
+        hba_step();
+        return port_sact;
+    }
+    if (address == port + AHCI_PORT_CI_OFFSET) {
+        hba_step();
+        return port_ci;
+    }
+    return 0;
+}
+
+void mmio_write32(uintptr_t address, uint32_t value)
+{
+    uintptr_t port = TEST_AHCI_BASE + AHCI_PORT_START;
+
+    if (address == port + AHCI_PORT_IS_OFFSET)
+        port_is &= ~value;
+    else if (address == port + AHCI_PORT_SACT_OFFSET)
+        port_sact |= value;
+    else if (address == port + AHCI_PORT_CI_OFFSET)
+        port_ci |= value;
+}
+
+static void setup(void)
+{
+    uint32_t i;
+
+    clb_mem = mmap(NULL, sizeof(struct hba_cmd_header) * 32,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    ck_assert_ptr_ne(clb_mem, MAP_FAILED);
+    ctable_mem = mmap(NULL, ATA_CMD_SLOTS * sizeof(struct hba_cmd_table),
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    ck_assert_ptr_ne(ctable_mem, MAP_FAILED);
+    buf = mmap(NULL, TEST_BUF_SIZE, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    ck_assert_ptr_ne(buf, MAP_FAILED);
+    disk = mmap(NULL, TEST_DISK_SECTORS * 512, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ck_assert_ptr_ne(disk, MAP_FAILED);
+    for (i = 0; i < TEST_DISK_SECTORS * 512; i++)
+        disk[i] = (uint8_t)((i * 7) ^ (i >> 9));
+
+    port_sact = port_ci = port_is = 0;
+    fail_lba = -1;
+    hba_stalled = 0;
+    ncq_cmds = dma_cmds = max_in_flight = max_prdtl = 0;
+    memset(&ata_async_info, 0, sizeof(ata_async_info));
+    memset(ATA_Drv, 0, sizeof(ATA_Drv));
+    ata_drive_count = -1;
+    ck_assert_int_eq(ata_drive_new(TEST_AHCI_BASE, 0,
+        (uint32_t)(uintptr_t)clb_mem, (uint32_t)(uintptr_t)ctable_mem, 0), 0);
+
+    /* 32 slots, NCQ, queue depth 32 */
+    hba_cap = AHCI_CAP_SNCQ | (31 << 8);
+    id_sata_cap = ATA_ID_SATA_CAP_NCQ;
+    id_queue_depth = 31;
+}
+
+static void teardown(void)
+{
+    munmap(clb_mem, sizeof(struct hba_cmd_header) * 32);
+    munmap(ctable_mem, ATA_CMD_SLOTS * sizeof(struct hba_cmd_table));
+    munmap(buf, TEST_BUF_SIZE);
+    munmap(disk, TEST_DISK_SECTORS * 512);
+}
+
+START_TEST(test_ncq_depth_from_identify)
+{
+    ck_assert_int_eq(ata_identify_device(0), 0);
+    ck_assert_uint_eq(ATA_Drv[0].ncq_depth, ATA_NCQ_MAX_SLOTS);
+
+    /* Limited by the device queue depth */
+    id_queue_depth = 3;
+    ck_assert_int_eq(ata_identify_device(0), 0);
+    ck_assert_uint_eq(ATA_Drv[0].ncq_depth, 4);
+
+    /* Limited by the number of command slots of the HBA */
+    id_queue_depth = 31;
+    hba_cap = AHCI_CAP_SNCQ | (1 << 8);
+    ck_assert_int_eq(ata_identify_device(0), 0);
+    ck_assert_uint_eq(ATA_Drv[0].ncq_depth, 2);
+
+    /* No NCQ support on either side */
+    hba_cap = 31 << 8;
+    ck_assert_int_eq(ata_identify_device(0), 0);
+    ck_assert_uint_eq(ATA_Drv[0].ncq_depth, 0);
+    hba_cap = AHCI_CAP_SNCQ | (31 << 8);
+    id_sata_cap = 0;
+    ck_assert_int_eq(ata_identify_device(0), 0);
+    ck_assert_uint_eq(ATA_Drv[0].ncq_depth, 0);
+}
+END_TEST
+
+START_TEST(test_ncq_large_read)
+{
+    uint32_t size = 300 * 512 + 100;
+    uint64_t start = 7 * 512 + 33;
+
+    ck_assert_int_eq(ata_identify_device(0), 0);
+    ck_assert_int_eq(ata_drive_read(0, start, size, buf), (int)size);
+    ck_assert_mem_eq(buf, disk + start, size);
+    /* Middle part queued in commands of ATA_NCQ_XFER_SECTORS */
+    ck_assert_uint_eq(ncq_cmds, (299 + ATA_NCQ_XFER_SECTORS - 1) /
+        ATA_NCQ_XFER_SECTORS);
+    ck_assert_uint_eq(max_in_flight, ATA_NCQ_MAX_SLOTS);
+    ck_assert_int_eq(ata_async_info.in_progress, 0);
+    ck_assert_uint_eq(port_sact | port_ci, 0);
+}
+END_TEST
+
+START_TEST(test_ncq_small_read_not_queued)
+{
+    ck_assert_int_eq(ata_identify_device(0), 0);
+    ck_assert_int_eq(ata_drive_read(0, 512, ATA_NCQ_XFER_SECTORS * 512, buf),
+        ATA_NCQ_XFER_SECTORS * 512);
+    ck_assert_mem_eq(buf, disk + 512, ATA_NCQ_XFER_SECTORS * 512);
+    ck_assert_uint_eq(ncq_cmds, 0);
+    ck_assert_uint_eq(dma_cmds, 1);
+}
+END_TEST
+
+START_TEST(test_no_ncq_single_command)
+{
+    id_sata_cap = 0;
+    ck_assert_int_eq(ata_identify_device(0), 0);
+    ck_assert_int_eq(ata_drive_read(0, 0, 1000 * 512, buf), 1000 * 512);
+    ck_assert_mem_eq(buf, disk, 1000 * 512);
+    ck_assert_uint_eq(ncq_cmds, 0);
+    ck_assert_uint_eq(dma_cmds, 1);
+}
+END_TEST
+
+START_TEST(test_prdt_scatter)
+{
+    struct hba_cmd_header *cmd = (struct hba_cmd_header *)clb_mem;
+    struct hba_cmd_table *tbl = (struct hba_cmd_table *)ctable_mem;
+    uint32_t sz = 2 * ATA_PRDT_MAX_BYTES + 1024;
+
+    ck_assert_int_eq(prepare_cmd_h2d(0, 0, buf, sz, 0), 0);
+    ck_assert_uint_eq(cmd->prdtl, 3);
+    ck_assert_uint_eq(tbl->prdt_entry[0].dba, (uint32_t)(uintptr_t)buf);
+    ck_assert_uint_eq(tbl->prdt_entry[0].dbc, ATA_PRDT_MAX_BYTES - 1);
+    ck_assert_uint_eq(tbl->prdt_entry[1].dba,
+        (uint32_t)(uintptr_t)buf + ATA_PRDT_MAX_BYTES);
+    ck_assert_uint_eq(tbl->prdt_entry[2].dbc, 1023);
+    ck_assert_int_eq(prepare_cmd_h2d(0, 0, buf,
+        ATA_PRDT_ENTRIES * ATA_PRDT_MAX_BYTES, 0), 0);
+    ck_assert_uint_eq(cmd->prdtl, ATA_PRDT_ENTRIES);
+    ck_assert_int_eq(prepare_cmd_h2d(0, 0, buf,
+        ATA_PRDT_ENTRIES * ATA_PRDT_MAX_BYTES + 512, 0), -1);
+    ck_assert_int_eq(prepare_cmd_h2d(0, 0, buf, 0, 0), -1);
+    ck_assert_uint_le(ata_max_xfer_sectors(&ATA_Drv[0]), 0xFFFF);
+}
+END_TEST
+
+START_TEST(test_ncq_error)
+{
+    ck_assert_int_eq(ata_identify_device(0), 0);
+    fail_lba = 100;
+    ck_assert_int_eq(ata_drive_read(0, 0, 256 * 512, buf), -1);
+    ck_assert_int_eq(ata_async_info.in_progress, 0);
+
+    /* Busy with another asynchronous operation */
+    fail_lba = -1;
+    port_is = 0;
+    port_sact = port_ci = 0;
+    ncq_cmds = 0;
+    ata_async_info.in_progress = 1;
+    ck_assert_int_eq(ata_drive_read(0, 0, 256 * 512, buf), -1);
+    ck_assert_uint_eq(ncq_cmds, 0);
+    ata_async_info.in_progress = 0;
+    ck_assert_int_eq(ata_drive_read(0, 0, 256 * 512, buf), 256 * 512);
+    ck_assert_mem_eq(buf, disk, 256 * 512);
+}
+END_TEST
+
+START_TEST(test_cmd_complete_async_slots)
+{
+    ck_assert_int_eq(ata_cmd_complete_async(), ATA_ERR_OP_NOT_IN_PROGRESS);
+    ata_async_info.in_progress = 1;
+    ata_async_info.slots = (1U << 2);
+    port_ci = (1U << 2);
+    hba_stalled = 1;
+    ck_assert_int_eq(ata_cmd_complete_async(), ATA_ERR_BUSY);
+    ck_assert_int_eq(ata_async_info.in_progress, 1);
+    port_is = AHCI_PORT_IS_TFES;
+    ck_assert_int_eq(ata_cmd_complete_async(), -1);
+    ck_assert_int_eq(ata_async_info.in_progress, 0);
+    ck_assert_uint_eq(ata_async_info.slots, 0);
+}
+END_TEST
+
+static Suite *ata_ncq_suite(void)
+{
+    Suite *s = suite_create("ata_ncq");
+    TCase *tc = tcase_create("ncq");
+    tcase_add_checked_fixture(tc, setup, teardown);
+    tcase_add_test(tc, test_ncq_depth_from_identify);
+    tcase_add_test(tc, test_ncq_large_read);
+    tcase_add_test(tc, test_ncq_small_read_not_queued);
+    tcase_add_test(tc, test_no_ncq_single_command);
+    tcase_add_test(tc, test_prdt_scatter);
+    tcase_add_test(tc, test_ncq_error);
+    tcase_add_test(tc, test_cmd_complete_async_slots);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main(void)
+{
+    Suite *s = ata_ncq_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return failed == 0 ? 0 : 1;
+}
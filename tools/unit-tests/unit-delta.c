@@ -690,6 +690,254 @@ START_TEST(test_wb_patch_and_diff_single_byte_difference)
 }
 END_TEST
 
+static uint8_t *diff_to_buffer(uint8_t *src_a, uint32_t size_a,
+    uint8_t *src_b, uint32_t size_b, int indexed, uint32_t window,
+    uint32_t *patch_len)
+{
+    WB_DIFF_CTX diff_ctx;
+    uint32_t capacity = size_b + size_b / 2 + DELTA_BLOCK_SIZE;
+    uint8_t *patch = malloc(capacity);
+    uint32_t p_written = 0;
+    int ret;
+
+    ck_assert_ptr_nonnull(patch);
+    ck_assert_int_eq(wb_diff_init(&diff_ctx, src_a, size_a, src_b, size_b), 0);
+    if (window != 0)
+        ck_assert_int_eq(wb_diff_set_window(&diff_ctx, window), 0);
+    if (indexed) {
+        ck_assert_int_eq(wb_diff_index_build(&diff_ctx), 0);
+        if (window == 0) {
+            ck_assert_ptr_nonnull(diff_ctx.idx_a);
+            ck_assert_ptr_nonnull(diff_ctx.idx_b);
+        }
+    }
+    do {
+        ck_assert_uint_ge(capacity - p_written, DELTA_BLOCK_SIZE);
+        ret = wb_diff(&diff_ctx, patch + p_written, DELTA_BLOCK_SIZE);
+        ck_assert_int_ge(ret, 0);
+        p_written += (uint32_t)ret;
+    } while (ret > 0);
+    ck_assert_uint_eq(diff_ctx.off_b, size_b);
+    wb_diff_index_free(&diff_ctx);
+    ck_assert_ptr_null(diff_ctx.idx_a);
+    ck_assert_ptr_null(diff_ctx.idx_b);
+    *patch_len = p_written;
+    return patch;
+}
+
+START_TEST(test_wb_diff_indexed_matches_linear_scan)
+{
+    int sector_size_ret;
+    uint32_t size_a, size_b, i;
+    uint8_t *src_a, *src_b;
+    uint8_t *patch_lin, *patch_idx;
+    uint32_t len_lin, len_idx;
+
+    sector_size_ret = wb_diff_get_sector_size();
+    ck_assert_int_gt(sector_size_ret, BLOCK_HDR_SIZE);
+    size_a = (uint32_t)(24 * sector_size_ret + 11);
+    size_b = (uint32_t)(26 * sector_size_ret + 3);
+    src_a = malloc(size_a);
+    src_b = malloc(size_b);
+    ck_assert_ptr_nonnull(src_a);
+    ck_assert_ptr_nonnull(src_b);
+
+    /* Shifted code, erased padding, repeated tables, ESC bytes and a few
+     * patched bytes: exercises both forward and backward matches.
+     */
+    fill_pattern(src_a, size_a, 0xC0FFEE11U);
+    memset(src_a + 4 * sector_size_ret, 0xFF, 2 * sector_size_ret);
+    for (i = 0; i < 64; i++)
+        src_a[(10 * sector_size_ret) + i] = (uint8_t)(i & 0x3);
+    fill_pattern(src_b, size_b, 0x1234ABCDU);
+    memcpy(src_b + 37, src_a, size_a / 2);
+    memcpy(src_b + (size_b / 2) + 5, src_a + (size_a / 2), size_a / 3);
+    memcpy(src_b + size_b - 3 * sector_size_ret, src_b + 100,
+        2 * sector_size_ret);
+    for (i = 0; i < size_b; i += 97)
+        src_b[i] = ESC;
+    src_b[size_b / 3] ^= 0x5A;
+
+    patch_lin = diff_to_buffer(src_a, size_a, src_b, size_b, 0, 0, &len_lin);
+    patch_idx = diff_to_buffer(src_a, size_a, src_b, size_b, 1, 0, &len_idx);
+    ck_assert_uint_eq(len_idx, len_lin);
+    ck_assert_mem_eq(patch_idx, patch_lin, len_lin);
+
+    /* Same for the inverse direction */
+    free(patch_idx);
+    free(patch_lin);
+    patch_lin = diff_to_buffer(src_b, size_b, src_a, size_a, 0, 0, &len_lin);
+    patch_idx = diff_to_buffer(src_b, size_b, src_a, size_a, 1, 0, &len_idx);
+    ck_assert_uint_eq(len_idx, len_lin);
+    ck_assert_mem_eq(patch_idx, patch_lin, len_lin);
+
+    free(patch_idx);
+    free(patch_lin);
+    free(src_b);
+    free(src_a);
+}
+END_TEST
+
+START_TEST(test_wb_diff_indexed_skips_esc_offsets)
+{
+    static uint8_t src_a[0x800100];
+    uint8_t src_b[7];
+    const uint32_t esc_off = 0x7f0010;
+    const uint32_t good_off = 0x800020;
+    const uint8_t needle[6] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 };
+    uint8_t *patch_lin, *patch_idx;
+    uint32_t len_lin, len_idx;
+
+    memset(src_a, 0, sizeof(src_a));
+    memcpy(src_a + esc_off, needle, sizeof(needle));
+    memcpy(src_a + good_off, needle, sizeof(needle));
+    memcpy(src_b, needle, sizeof(needle));
+    src_b[6] = 0xAA;
+
+    patch_lin = diff_to_buffer(src_a, sizeof(src_a), src_b, sizeof(src_b), 0, 0,
+        &len_lin);
+    patch_idx = diff_to_buffer(src_a, sizeof(src_a), src_b, sizeof(src_b), 1, 0,
+        &len_idx);
+    ck_assert_uint_eq(len_idx, len_lin);
+    ck_assert_mem_eq(patch_idx, patch_lin, len_lin);
+    ck_assert_uint_eq(patch_idx[0], ESC);
+    ck_assert_uint_eq(patch_idx[1], (good_off >> 16) & 0xFF);
+    ck_assert_uint_eq(patch_idx[2], (good_off >> 8) & 0xFF);
+    ck_assert_uint_eq(patch_idx[3], good_off & 0xFF);
+
+    free(patch_idx);
+    free(patch_lin);
+}
+END_TEST
+
+/* Apply a patch the way the bootloader does: sector by sector over the base
+ * image, so that references to 'B' read the sectors already patched.
+ */
+static void patch_in_place(const uint8_t *src_a, uint32_t size_a,
+    uint8_t *patch, uint32_t patch_len, const uint8_t *src_b, uint32_t size_b)
+{
+    WB_PATCH_CTX patch_ctx;
+    uint32_t sector_size = (uint32_t)wb_diff_get_sector_size();
+    uint32_t work_size = (size_a > size_b) ? size_a : size_b;
+    uint8_t *work = malloc(work_size);
+    uint8_t *block = malloc(sector_size);
+    uint32_t off = 0;
+    int ret;
+
+    ck_assert_ptr_nonnull(work);
+    ck_assert_ptr_nonnull(block);
+    memset(work, 0xFF, work_size);
+    memcpy(work, src_a, size_a);
+    ck_assert_int_eq(wb_patch_init(&patch_ctx, work, work_size, patch,
+        patch_len), 0);
+    for (;;) {
+        ret = wb_patch(&patch_ctx, block, sector_size);
+        ck_assert_int_ge(ret, 0);
+        if (ret == 0)
+            break;
+        ck_assert_uint_le(off + (uint32_t)ret, size_b);
+        memcpy(work + off, block, (uint32_t)ret);
+        off += (uint32_t)ret;
+    }
+    ck_assert_uint_eq(off, size_b);
+    ck_assert_int_eq(memcmp(work, src_b, size_b), 0);
+    free(block);
+    free(work);
+}
+
+START_TEST(test_wb_diff_window_roundtrip)
+{
+    int sector_size_ret;
+    uint32_t size_a, size_b, window, i;
+    uint8_t *src_a, *src_b;
+    uint8_t *patch_lin, *patch_idx, *patch_full;
+    uint32_t len_lin, len_idx, len_full;
+
+    sector_size_ret = wb_diff_get_sector_size();
+    ck_assert_int_gt(sector_size_ret, BLOCK_HDR_SIZE);
+    ck_assert_int_eq(wb_diff_set_window(NULL, 4 * sector_size_ret), -1);
+    size_a = (uint32_t)(40 * sector_size_ret + 11);
+    size_b = (uint32_t)(43 * sector_size_ret + 3);
+    window = (uint32_t)(4 * sector_size_ret);
+    src_a = malloc(size_a);
+    src_b = malloc(size_b);
+    ck_assert_ptr_nonnull(src_a);
+    ck_assert_ptr_nonnull(src_b);
+
+    /* Small shifts, a relocated block within the window and one far away,
+     * repeated data in the new image and ESC bytes */
+    fill_pattern(src_a, size_a, 0x5EEDF00DU);
+    fill_pattern(src_b, size_b, 0x0BADCAFEU);
+    memcpy(src_b + 21, src_a, 20 * sector_size_ret);
+    memcpy(src_b + 22 * sector_size_ret, src_a + 23 * sector_size_ret,
+        2 * sector_size_ret);
+    memcpy(src_b + 30 * sector_size_ret, src_a + 3 * sector_size_ret,
+        sector_size_ret);
+    memcpy(src_b + 38 * sector_size_ret, src_b + 35 * sector_size_ret,
+        2 * sector_size_ret);
+    for (i = 0; i < size_b; i += 131)
+        src_b[i] = ESC;
+
+    patch_lin = diff_to_buffer(src_a, size_a, src_b, size_b, 0, window,
+        &len_lin);
+    patch_idx = diff_to_buffer(src_a, size_a, src_b, size_b, 1, window,
+        &len_idx);
+    patch_full = diff_to_buffer(src_a, size_a, src_b, size_b, 1, 0,
+        &len_full);
+    /* The index finds the same matches within the window */
+    ck_assert_uint_eq(len_idx, len_lin);
+    ck_assert_mem_eq(patch_idx, patch_lin, len_lin);
+    /* Only the far away block is lost */
+    ck_assert_uint_ge(len_idx, len_full);
+    ck_assert_uint_lt(len_idx, len_full + sector_size_ret + 64);
+    patch_in_place(src_a, size_a, patch_idx, len_idx, src_b, size_b);
+    free(patch_idx);
+    free(patch_lin);
+    free(patch_full);
+
+    /* Inverse direction */
+    patch_idx = diff_to_buffer(src_b, size_b, src_a, size_a, 1, window,
+        &len_idx);
+    patch_in_place(src_b, size_b, patch_idx, len_idx, src_a, size_a);
+    free(patch_idx);
+    free(src_b);
+    free(src_a);
+}
+END_TEST
+
+START_TEST(test_wb_diff_window_beyond_24_bits)
+{
+    int sector_size_ret;
+    uint32_t size, window;
+    uint8_t *src_a, *src_b;
+    uint8_t *patch;
+    uint32_t len;
+
+    sector_size_ret = wb_diff_get_sector_size();
+    size = DELTA_OFFSET_LIMIT + (uint32_t)(6 * sector_size_ret) + 5;
+    window = (uint32_t)(64 * sector_size_ret);
+    src_a = malloc(size);
+    src_b = malloc(size);
+    ck_assert_ptr_nonnull(src_a);
+    ck_assert_ptr_nonnull(src_b);
+    fill_pattern(src_a, size, 0x13572468U);
+    memcpy(src_b, src_a, size);
+    src_b[1000] ^= 0x01;
+    src_b[DELTA_OFFSET_LIMIT - 3] ^= 0x02;
+    src_b[DELTA_OFFSET_LIMIT + 2 * sector_size_ret] ^= 0x04;
+
+    /* Matches are only encoded within the 24-bit offset range, the tail is
+     * sent as literals */
+    patch = diff_to_buffer(src_a, size, src_b, size, 1, window, &len);
+    ck_assert_uint_lt(len, (size / sector_size_ret) * 2 * BLOCK_HDR_SIZE +
+        7 * sector_size_ret);
+    patch_in_place(src_a, size, patch, len, src_b, size);
+    free(patch);
+    free(src_b);
+    free(src_a);
+}
+END_TEST
+
 
 Suite *patch_diff_suite(void)
 {
@@ -724,6 +972,10 @@ Suite *patch_diff_suite(void)
     tcase_add_test(tc_wolfboot_delta, test_wb_patch_and_diff_size_changing_update);
     tcase_add_test(tc_wolfboot_delta, test_wb_patch_and_diff_shrinking_update);
     tcase_add_test(tc_wolfboot_delta, test_wb_patch_and_diff_single_byte_difference);
+    tcase_add_test(tc_wolfboot_delta, test_wb_diff_indexed_matches_linear_scan);
+    tcase_add_test(tc_wolfboot_delta, test_wb_diff_indexed_skips_esc_offsets);
+    tcase_add_test(tc_wolfboot_delta, test_wb_diff_window_roundtrip);
+    tcase_add_test(tc_wolfboot_delta, test_wb_diff_window_beyond_24_bits);
     suite_add_tcase(s, tc_wolfboot_delta);
 
     return s;
@@ -250,6 +250,170 @@ START_TEST(test_torn_write_recovery)
 }
 END_TEST
 
+#ifdef WOLFBOOT_BOOT_TIMING
+static uint64_t mock_timer_us;
+
+uint64_t hal_get_timer_us(void)
+{
+    return mock_timer_us;
+}
+
+static void timing_reset(void)
+{
+    memset(timing_total, 0, sizeof(timing_total));
+    timing_running = 0;
+    timing_flags = 0;
+}
+
+static void timed_phase(int phase, uint32_t us)
+{
+    wolfBoot_timing_begin(phase);
+    mock_timer_us += us;
+    wolfBoot_timing_end(phase);
+}
+
+START_TEST(test_timing_encoding)
+{
+    static const uint32_t values[] = {
+        0, 1, 999, 32767, 32768, 32769, 100000, 1234567, 600000000UL
+    };
+    struct wolfBoot_timing_record rec;
+    uint32_t v, d;
+    unsigned int i;
+
+    memset(&rec, 0, sizeof(rec));
+    for (i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        v = values[i];
+        rec.duration[0] = timing_encode(v);
+        d = wolfBoot_timing_us(&rec, 0);
+        if (v < 32768U)
+            ck_assert_uint_eq(d, v);
+        else {
+            ck_assert_uint_le(d, v);
+            ck_assert_uint_le(v - d, v / 2048U);
+        }
+    }
+    /* saturation */
+    rec.duration[0] = timing_encode(0xFFFFFFFFUL);
+    ck_assert_uint_eq(rec.duration[0], 0xFFFF);
+    ck_assert_uint_eq(wolfBoot_timing_us(&rec, WOLFBOOT_TIMING_PHASES), 0);
+    ck_assert_uint_eq(wolfBoot_timing_us(NULL, 0), 0);
+}
+END_TEST
+
+START_TEST(test_timing_record)
+{
+    struct wolfBoot_timing_record t;
+    struct wolfBoot_failure_record rec;
+    uint8_t *p;
+
+    diag_mmap("/tmp/wolfboot-unit-diag-timing.bin");
+    ck_assert_int_eq(wolfBoot_clear_failures(), 0);
+    timing_reset();
+
+    record_one(WOLFBOOT_FAILURE_PHASE_UPDATE,
+            WOLFBOOT_FAILURE_CAUSE_HASH, PART_UPDATE, 1);
+
+    /* A boot with an update is always recorded */
+    mock_timer_us = 1000;
+    wolfBoot_timing_flag(WOLFBOOT_TIMING_F_UPDATE);
+    timed_phase(WOLFBOOT_TIMING_HASH, 1500);
+    timed_phase(WOLFBOOT_TIMING_SIGNATURE, 20000);
+    timed_phase(WOLFBOOT_TIMING_COPY, 2000000);
+    timed_phase(WOLFBOOT_TIMING_HASH, 500); /* accumulated */
+    wolfBoot_timing_end(WOLFBOOT_TIMING_DELTA); /* not started: ignored */
+    mock_timer_us = 2100001;
+    ck_assert_int_eq(wolfBoot_timing_commit(PART_BOOT, 2), 0);
+
+    /* Timing records do not show up as failures, and vice versa */
+    ck_assert_int_eq(wolfBoot_get_failure_count(), 1);
+    ck_assert_int_eq(wolfBoot_get_failure(0, &rec), 0);
+    ck_assert_uint_eq(rec.fw_version, 1);
+    ck_assert_int_eq(wolfBoot_get_failure(1, &rec), -1);
+    ck_assert_int_eq(wolfBoot_get_timing_count(), 1);
+    ck_assert_int_eq(wolfBoot_get_timing(1, &t), -1);
+    ck_assert_int_eq(wolfBoot_get_timing(0, NULL), -1);
+
+    ck_assert_int_eq(wolfBoot_get_timing(0, &t), 0);
+    ck_assert_uint_eq(t.phase, WOLFBOOT_FAILURE_PHASE_TIMING);
+    ck_assert_uint_eq(t.flags, WOLFBOOT_TIMING_F_UPDATE);
+    ck_assert_uint_eq(t.partition, PART_BOOT);
+    ck_assert_uint_eq(t.fw_version, 2);
+    ck_assert_uint_eq(t.seq, 2);
+    ck_assert_uint_eq(wolfBoot_timing_us(&t, WOLFBOOT_TIMING_HASH), 2000);
+    ck_assert_uint_eq(wolfBoot_timing_us(&t, WOLFBOOT_TIMING_SIGNATURE),
+            20000);
+    ck_assert_uint_eq(wolfBoot_timing_us(&t, WOLFBOOT_TIMING_DECRYPT), 0);
+    ck_assert_uint_eq(wolfBoot_timing_us(&t, WOLFBOOT_TIMING_DELTA), 0);
+    ck_assert_uint_le(2000000 - wolfBoot_timing_us(&t, WOLFBOOT_TIMING_COPY),
+            2000000 / 2048);
+    ck_assert_uint_le(2100001 - wolfBoot_timing_us(&t, WOLFBOOT_TIMING_TOTAL),
+            2100001 / 2048);
+
+    /* Durations torn by a power failure are rejected */
+    p = (uint8_t *)(uintptr_t)(DIAG_SECTOR_ADDR(0) + DIAG_HDR_SIZE +
+            1 * DIAG_RECORD_SIZE + 16);
+    p[0] ^= 0x01;
+    ck_assert_int_eq(wolfBoot_get_timing_count(), 1);
+    ck_assert_int_eq(wolfBoot_get_timing(0, &t), -1);
+    p[0] ^= 0x01;
+    ck_assert_int_eq(wolfBoot_get_timing(0, &t), 0);
+}
+END_TEST
+
+#ifdef DIAG_BOOT_COUNT
+START_TEST(test_timing_sampling)
+{
+    struct wolfBoot_timing_record t;
+    int i, boots;
+
+    diag_mmap("/tmp/wolfboot-unit-diag-timing.bin");
+    ck_assert_int_eq(wolfBoot_clear_failures(), 0);
+
+    /* Plain boots are sampled on a boot counter kept in flash, whatever the
+     * timer value. A RAM load (copy phase without the update flag) is a
+     * plain boot. */
+    for (i = 1; i < WOLFBOOT_BOOT_TIMING_SAMPLE; i++) {
+        timing_reset();
+        mock_timer_us = 0;
+        timed_phase(WOLFBOOT_TIMING_COPY, 1000);
+        ck_assert_int_eq(wolfBoot_timing_commit(PART_BOOT, 3), 0);
+        ck_assert_int_eq(wolfBoot_get_timing_count(), 0);
+    }
+    timing_reset();
+    mock_timer_us = 0;
+    timed_phase(WOLFBOOT_TIMING_COPY, 1000);
+    ck_assert_int_eq(wolfBoot_timing_commit(PART_BOOT, 3), 0);
+    ck_assert_int_eq(wolfBoot_get_timing_count(), 1);
+    ck_assert_int_eq(wolfBoot_get_timing(0, &t), 0);
+    ck_assert_uint_eq(t.flags, 0);
+    ck_assert_uint_eq(wolfBoot_timing_us(&t, WOLFBOOT_TIMING_COPY), 1000);
+
+    /* The counter is not reported, and survives its record filling up */
+    ck_assert_int_eq(wolfBoot_get_failure_count(), 0);
+    boots = (int)DIAG_COUNT_BITS + 3 * WOLFBOOT_BOOT_TIMING_SAMPLE;
+    for (i = 0; i < boots; i++) {
+        timing_reset();
+        ck_assert_int_eq(wolfBoot_timing_commit(PART_BOOT, 3), 0);
+    }
+    ck_assert_int_eq(wolfBoot_get_timing_count(),
+            1 + boots / WOLFBOOT_BOOT_TIMING_SAMPLE);
+    ck_assert_int_eq(wolfBoot_get_failure_count(), 0);
+
+    /* Updates are always recorded and do not count as plain boots */
+    timing_reset();
+    wolfBoot_timing_flag(WOLFBOOT_TIMING_F_UPDATE);
+    ck_assert_int_eq(wolfBoot_timing_commit(PART_BOOT, 4), 0);
+    ck_assert_int_eq(wolfBoot_get_timing_count(),
+            2 + boots / WOLFBOOT_BOOT_TIMING_SAMPLE);
+    ck_assert_int_eq(wolfBoot_get_timing(0, &t), 0);
+    ck_assert_uint_eq(t.flags, WOLFBOOT_TIMING_F_UPDATE);
+    ck_assert_uint_eq(t.fw_version, 4);
+}
+END_TEST
+#endif /* DIAG_BOOT_COUNT */
+#endif /* WOLFBOOT_BOOT_TIMING */
+
 Suite *wolfboot_suite(void)
 {
     Suite *s = suite_create("wolfboot-diagnostics");
@@ -259,6 +423,13 @@ Suite *wolfboot_suite(void)
     tcase_add_test(diag, test_crc_rejection);
     tcase_add_test(diag, test_clear);
     tcase_add_test(diag, test_torn_write_recovery);
+#ifdef WOLFBOOT_BOOT_TIMING
+    tcase_add_test(diag, test_timing_encoding);
+    tcase_add_test(diag, test_timing_record);
+#ifdef DIAG_BOOT_COUNT
+    tcase_add_test(diag, test_timing_sampling);
+#endif
+#endif
     suite_add_tcase(s, diag);
     return s;
 }
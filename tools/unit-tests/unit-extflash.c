@@ -51,6 +51,14 @@
 
 #include "libwolfboot.c"
 
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #define BENCH_UNIT "cycles"
+#else
+    #include <time.h>
+    #define BENCH_UNIT "ns"
+#endif
+
 #if defined(ENCRYPT_WITH_AES256) || defined(ENCRYPT_WITH_AES128)
     #include "wolfcrypt/src/aes.c"
 #endif
@@ -373,6 +381,101 @@ START_TEST(test_ext_enc_flash_oversized_write) {
 }
 END_TEST
 
+#ifdef EXT_ENCRYPTED
+
+#if defined(ENCRYPT_WITH_AES128)
+    #define BENCH_CIPHER "AES128-CTR"
+#elif defined(ENCRYPT_WITH_AES256)
+    #define BENCH_CIPHER "AES256-CTR"
+#else
+    #define BENCH_CIPHER "ChaCha20"
+#endif
+#define BENCH_SIZE  (16 * WOLFBOOT_SECTOR_SIZE)
+#define BENCH_ROUNDS 64
+
+static uint64_t bench_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* Old staging pattern: copy each block aside, one cipher call per block */
+static void bench_per_block(uint8_t *out, const uint8_t *in, int len)
+{
+    uint8_t block[ENCRYPT_BLOCK_SIZE];
+    int i;
+
+    for (i = 0; i < len / ENCRYPT_BLOCK_SIZE; i++) {
+        XMEMCPY(block, in + (ENCRYPT_BLOCK_SIZE * i), ENCRYPT_BLOCK_SIZE);
+        crypto_encrypt(out + (ENCRYPT_BLOCK_SIZE * i), block,
+            ENCRYPT_BLOCK_SIZE);
+    }
+}
+
+/* New staging pattern: one cipher call per ENCRYPT_STAGE_SIZE */
+static void bench_per_stage(uint8_t *out, const uint8_t *in, int len)
+{
+    int off;
+
+    for (off = 0; off < len; off += ENCRYPT_STAGE_SIZE)
+        crypto_encrypt(out + off, (uint8_t *)in + off, ENCRYPT_STAGE_SIZE);
+}
+
+/* Batching the cipher calls must not change the keystream: the ciphertext
+ * written by ext_flash_encrypt_write() matches a per-block encryption, and
+ * ext_flash_decrypt_read() returns the plaintext. Also reports the cost of
+ * both calling patterns for the configured cipher. */
+START_TEST(test_ext_enc_flash_bulk_cipher)
+{
+    const uint32_t address = 0x1000;
+    static uint8_t plain[BENCH_SIZE];
+    static uint8_t expected[BENCH_SIZE];
+    static uint8_t out[BENCH_SIZE];
+    uint64_t t0, t_block = 0, t_stage = 0;
+    int i;
+
+    for (i = 0; i < BENCH_SIZE; i++)
+        plain[i] = (uint8_t)((i * 31) ^ (i >> 7));
+
+    ck_assert_int_eq(wolfBoot_initialize_encryption(), 0);
+    wolfBoot_crypto_set_iv(encrypt_iv_nonce,
+        (address - WOLFBOOT_PARTITION_UPDATE_ADDRESS) / ENCRYPT_BLOCK_SIZE);
+    bench_per_block(expected, plain, BENCH_SIZE);
+
+    ck_assert_int_eq(ext_flash_encrypt_write(address, plain, BENCH_SIZE), 0);
+    ck_assert_mem_eq(&flash[address], expected, BENCH_SIZE);
+
+    memset(out, 0, sizeof(out));
+    ck_assert_int_eq(ext_flash_decrypt_read(address, out, BENCH_SIZE),
+        BENCH_SIZE);
+    ck_assert_mem_eq(out, plain, BENCH_SIZE);
+
+    for (i = 0; i < BENCH_ROUNDS; i++) {
+        wolfBoot_crypto_set_iv(encrypt_iv_nonce, 0);
+        t0 = bench_now();
+        bench_per_block(out, plain, BENCH_SIZE);
+        t_block += bench_now() - t0;
+
+        wolfBoot_crypto_set_iv(encrypt_iv_nonce, 0);
+        t0 = bench_now();
+        bench_per_stage(out, plain, BENCH_SIZE);
+        t_stage += bench_now() - t0;
+    }
+    printf("%s, %d bytes x %d: per-block %.2f " BENCH_UNIT "/byte, "
+        "per-stage (%d bytes) %.2f " BENCH_UNIT "/byte\n", BENCH_CIPHER,
+        BENCH_SIZE, BENCH_ROUNDS,
+        (double)t_block / ((double)BENCH_SIZE * BENCH_ROUNDS),
+        (int)ENCRYPT_STAGE_SIZE,
+        (double)t_stage / ((double)BENCH_SIZE * BENCH_ROUNDS));
+}
+END_TEST
+#endif /* EXT_ENCRYPTED */
+
 
 Suite *wolfboot_suite(void)
 {
@@ -386,6 +489,9 @@ Suite *wolfboot_suite(void)
     TCase *ext_enc_flash_short_read  = tcase_create("External encrypted flash short unaligned read");
     TCase *ext_enc_flash_short_write = tcase_create("External encrypted flash short unaligned write");
     TCase *ext_enc_flash_oversized_write = tcase_create("External encrypted flash oversized write");
+#ifdef EXT_ENCRYPTED
+    TCase *ext_enc_flash_bulk_cipher = tcase_create("External encrypted flash bulk cipher");
+#endif
 
     /* Set parameters + add to suite */
     tcase_add_test(ext_flash_operations, test_ext_flash_operations);
@@ -396,6 +502,11 @@ Suite *wolfboot_suite(void)
             test_ext_enc_flash_short_unaligned_write);
     tcase_add_test(ext_enc_flash_oversized_write,
             test_ext_enc_flash_oversized_write);
+#ifdef EXT_ENCRYPTED
+    tcase_add_test(ext_enc_flash_bulk_cipher, test_ext_enc_flash_bulk_cipher);
+    tcase_set_timeout(ext_enc_flash_bulk_cipher, 60);
+    suite_add_tcase(s, ext_enc_flash_bulk_cipher);
+#endif
 
     tcase_set_timeout(ext_flash_operations, 20);
     tcase_set_timeout(ext_enc_flash_operations, 20);
@@ -0,0 +1,424 @@
+/* unit-fdt-index.c
+ *
+ * Unit tests for the FDT node index (WOLFBOOT_FDT_INDEX) and the batched
+ * property fixups: the indexed lookups must return what the structure walks
+ * return, also after the blob is edited.
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#include <check.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../src/fdt.c"
+
+#define BLOB_SIZE 8192
+
+static uint8_t blob[BLOB_SIZE];
+static uint8_t blob2[BLOB_SIZE];
+
+/* Empty tree: root node only */
+static void fdt_create(void *fdt)
+{
+    uint32_t *s;
+
+    memset(fdt, 0, BLOB_SIZE);
+    fdt_set_header(fdt, magic, FDT_MAGIC);
+    fdt_set_header(fdt, totalsize, BLOB_SIZE);
+    fdt_set_header(fdt, off_mem_rsvmap, sizeof(struct fdt_header));
+    fdt_set_header(fdt, off_dt_struct, sizeof(struct fdt_header) +
+        sizeof(struct fdt_reserve_entry));
+    fdt_set_header(fdt, size_dt_struct, 16);
+    fdt_set_header(fdt, off_dt_strings, fdt_off_dt_struct(fdt) + 16);
+    fdt_set_header(fdt, size_dt_strings, 0);
+    fdt_set_header(fdt, version, 17);
+    fdt_set_header(fdt, last_comp_version, 16);
+    s = (uint32_t *)((uint8_t *)fdt + fdt_off_dt_struct(fdt));
+    s[0] = cpu_to_fdt32(FDT_BEGIN_NODE);
+    s[1] = 0; /* "" */
+    s[2] = cpu_to_fdt32(FDT_END_NODE);
+    s[3] = cpu_to_fdt32(FDT_END);
+}
+
+static int add_node(void *fdt, const char *parent, const char *name)
+{
+    int off = 0;
+
+    if (parent != NULL)
+        off = fdt_find_node_offset(fdt, -1, parent);
+    ck_assert_int_ge(off, 0);
+    off = fdt_add_subnode(fdt, off, name);
+    ck_assert_int_gt(off, 0);
+    return off;
+}
+
+static void set_str(void *fdt, const char *node, const char *name,
+    const char *val)
+{
+    int off = fdt_find_node_offset(fdt, -1, node);
+    ck_assert_int_gt(off, 0);
+    ck_assert_int_eq(fdt_setprop(fdt, off, name, val, strlen(val) + 1), 0);
+}
+
+static void set_u32(void *fdt, const char *node, const char *name,
+    uint32_t val)
+{
+    int off = fdt_find_node_offset(fdt, -1, node);
+    ck_assert_int_gt(off, 0);
+    val = cpu_to_fdt32(val);
+    ck_assert_int_eq(fdt_setprop(fdt, off, name, &val, sizeof(val)), 0);
+}
+
+static void build_tree(void *fdt)
+{
+    fdt_create(fdt);
+    add_node(fdt, NULL, "soc");
+    add_node(fdt, NULL, "chosen");
+    add_node(fdt, NULL, "memory@0");
+    add_node(fdt, NULL, "cpus");
+    add_node(fdt, "cpus", "cpu@1");
+    add_node(fdt, "cpus", "cpu@0");
+    add_node(fdt, "soc", "serial@2000");
+    add_node(fdt, "soc", "serial@1000");
+    set_str(fdt, "memory@0", "device_type", "memory");
+    set_str(fdt, "cpu@0", "device_type", "cpu");
+    set_str(fdt, "cpu@1", "device_type", "cpu");
+    set_str(fdt, "cpu@0", "compatible", "arm,cortex-a53\0arm,armv8");
+    set_str(fdt, "cpu@1", "compatible", "arm,cortex-a53\0arm,armv8");
+    set_str(fdt, "serial@1000", "compatible", "ns16550a");
+    set_str(fdt, "serial@2000", "compatible", "ns16550a");
+    set_u32(fdt, "cpu@0", "phandle", 1);
+    set_u32(fdt, "cpu@1", "phandle", 2);
+    set_u32(fdt, "serial@2000", "linux,phandle", 3);
+}
+
+/* The index must be what fdt_index_build() makes of the current blob */
+static void check_index(void *fdt)
+{
+    struct fdt_index_node saved[FDT_INDEX_MAX_NODES];
+    int count;
+
+    ck_assert_ptr_eq(fdt_idx.fdt, fdt);
+    count = fdt_idx.count;
+    memcpy(saved, fdt_idx.node, count * sizeof(saved[0]));
+    ck_assert_int_eq(fdt_index_build(fdt), count);
+    ck_assert_mem_eq(saved, fdt_idx.node, count * sizeof(saved[0]));
+}
+
+static void check_same(int indexed, int walk)
+{
+    if (walk >= 0)
+        ck_assert_int_eq(indexed, walk);
+    else
+        ck_assert_int_lt(indexed, 0);
+}
+
+/* Same answers with and without the index */
+static void check_lookups(void *fdt)
+{
+    static const char *names[] = { "", "cpus", "cpu@0", "cpu@1", "memory@0",
+        "chosen", "soc", "serial@1000", "serial@2000", "serial@3000" };
+    int i, walk, indexed;
+
+    for (i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+        fdt_index_release();
+        walk = fdt_find_node_offset(fdt, -1, names[i]);
+        ck_assert_int_ge(fdt_index_build(fdt), 0);
+        check_same(fdt_find_node_offset(fdt, -1, names[i]), walk);
+    }
+    for (i = 1; i < 16; i++) {
+        fdt_index_release();
+        walk = fdt_node_offset_by_phandle(fdt, i);
+        ck_assert_int_ge(fdt_index_build(fdt), 0);
+        check_same(fdt_node_offset_by_phandle(fdt, i), walk);
+    }
+
+    /* iterations from the previous match */
+    walk = indexed = -1;
+    do {
+        fdt_index_release();
+        walk = fdt_node_offset_by_compatible(fdt, walk, "arm,armv8");
+        ck_assert_int_ge(fdt_index_build(fdt), 0);
+        indexed = fdt_node_offset_by_compatible(fdt, indexed, "arm,armv8");
+        check_same(indexed, walk);
+    } while (walk >= 0);
+    walk = indexed = -1;
+    do {
+        fdt_index_release();
+        walk = fdt_find_devtype(fdt, walk, "cpu");
+        ck_assert_int_ge(fdt_index_build(fdt), 0);
+        indexed = fdt_find_devtype(fdt, indexed, "cpu");
+        check_same(indexed, walk);
+    } while (walk >= 0);
+}
+
+/* Same tree: headers, strings and structure tags, with the property values
+ * compared up to their length (the padding is not initialized by setprop) */
+static void check_blob(const void *fdt, const void *ref)
+{
+    int off = 0, next, ref_next, len;
+    uint32_t tag;
+    const struct fdt_property *p, *q;
+
+    ck_assert_mem_eq(fdt, ref, sizeof(struct fdt_header));
+    ck_assert_mem_eq((const uint8_t *)fdt + fdt_off_dt_strings(fdt),
+        (const uint8_t *)ref + fdt_off_dt_strings(ref),
+        fdt_size_dt_strings(ref));
+    do {
+        tag = fdt_next_tag(fdt, off, &next);
+        ck_assert_uint_eq(fdt_next_tag(ref, off, &ref_next), tag);
+        ck_assert_int_eq(next, ref_next);
+        if (tag == FDT_BEGIN_NODE) {
+            ck_assert_str_eq(fdt_get_name(fdt, off, NULL),
+                fdt_get_name(ref, off, NULL));
+        }
+        else if (tag == FDT_PROP) {
+            p = fdt_get_property_by_offset(fdt, off, &len);
+            q = fdt_get_property_by_offset(ref, off, NULL);
+            ck_assert_mem_eq(p, q, sizeof(*p));
+            ck_assert_mem_eq(p->data, q->data, len);
+        }
+        off = next;
+    } while (tag != FDT_END);
+}
+
+static void setup(void)
+{
+    fdt_index_release();
+    build_tree(blob);
+}
+
+START_TEST(test_index_build)
+{
+    int off;
+
+    ck_assert_int_eq(fdt_index_build(blob), 9);
+    off = fdt_find_node_offset(blob, -1, "cpu@1");
+    ck_assert_int_gt(off, 0);
+    ck_assert_int_eq(fdt_node_offset_by_phandle(blob, 2), off);
+    off = fdt_find_node_offset(blob, -1, "serial@2000");
+    ck_assert_int_eq(fdt_node_offset_by_phandle(blob, 3), off);
+    ck_assert_int_eq(fdt_node_offset_by_phandle(blob, 4), -FDT_ERR_NOTFOUND);
+    ck_assert_int_eq(fdt_find_node_offset(blob, off, "serial@2000"),
+        -FDT_ERR_NOTFOUND);
+    check_lookups(blob);
+
+    /* another blob is not served from the index */
+    build_tree(blob2);
+    ck_assert_int_eq(fdt_index_build(blob), 9);
+    set_u32(blob2, "chosen", "phandle", 7);
+    ck_assert_int_eq(fdt_node_offset_by_phandle(blob2, 7),
+        fdt_find_node_offset(blob2, -1, "chosen"));
+    check_index(blob);
+}
+END_TEST
+
+START_TEST(test_index_follows_edits)
+{
+    int off;
+    char bootargs[64];
+
+    ck_assert_int_eq(fdt_index_build(blob), 9);
+
+    /* properties growing and shrinking before other nodes */
+    memset(bootargs, 'a', sizeof(bootargs) - 1);
+    bootargs[sizeof(bootargs) - 1] = '\0';
+    set_str(blob, "soc", "ranges", bootargs);
+    check_index(blob);
+    set_str(blob, "soc", "ranges", "");
+    check_index(blob);
+    set_str(blob, "memory@0", "device_type", "memory-with-a-longer-name");
+    check_index(blob);
+
+    /* new nodes, phandles */
+    add_node(blob, "soc", "i2c@3000");
+    check_index(blob);
+    set_u32(blob, "i2c@3000", "phandle", 9);
+    check_index(blob);
+    ck_assert_int_eq(fdt_node_offset_by_phandle(blob, 9),
+        fdt_find_node_offset(blob, -1, "i2c@3000"));
+    set_u32(blob, "cpu@0", "phandle", 5);
+    check_index(blob);
+    ck_assert_int_lt(fdt_node_offset_by_phandle(blob, 1), 0);
+
+    /* removed node and its subnodes */
+    off = fdt_find_node_offset(blob, -1, "cpus");
+    ck_assert_int_eq(fdt_del_node(blob, off), 0);
+    check_index(blob);
+    ck_assert_int_eq(fdt_idx.count, 7);
+    ck_assert_int_lt(fdt_find_node_offset(blob, -1, "cpu@1"), 0);
+    ck_assert_int_lt(fdt_node_offset_by_phandle(blob, 2), 0);
+
+    /* struct block moved by a reserve entry: offsets are unchanged */
+    ck_assert_int_eq(fdt_add_mem_rsv(blob, 0x80000000ULL, 0x1000ULL), 0);
+    check_index(blob);
+    check_lookups(blob);
+}
+END_TEST
+
+START_TEST(test_index_full)
+{
+    int i, off;
+    char name[16];
+
+    fdt_create(blob);
+    for (i = 1; i < FDT_INDEX_MAX_NODES; i++) {
+        snprintf(name, sizeof(name), "n%d", i);
+        ck_assert_int_gt(fdt_add_subnode(blob, 0, name), 0);
+    }
+    ck_assert_int_eq(fdt_index_build(blob), FDT_INDEX_MAX_NODES);
+
+    /* no room for one more node: back to the structure walks */
+    off = fdt_add_subnode(blob, 0, "one-more");
+    ck_assert_int_gt(off, 0);
+    ck_assert_ptr_null(fdt_idx.fdt);
+    ck_assert_int_eq(fdt_find_node_offset(blob, -1, "one-more"), off);
+    ck_assert_int_eq(fdt_index_build(blob), -FDT_ERR_NOSPACE);
+    ck_assert_ptr_null(fdt_idx.fdt);
+    ck_assert_int_eq(fdt_find_node_offset(blob, -1, "n5"),
+        fdt_find_node_offset(blob, 0, "n5"));
+}
+END_TEST
+
+static const uint32_t mem_reg[4] = { 0, 0x80, 0, 0x4000 };
+
+static void fixups(struct fdt_fixup *f, int *count, int memoff)
+{
+    static uint32_t freq, ph;
+    int n = 0;
+
+    memset(f, 0, 9 * sizeof(*f));
+    freq = cpu_to_fdt32(100000000);
+    ph = cpu_to_fdt32(12);
+    f[n].node = "chosen"; f[n].name = "bootargs";
+    f[n].val = "console=ttyS0,115200 root=/dev/mmcblk0p2";
+    f[n].len = (int)strlen(f[n].val) + 1; n++;
+    f[n].node = NULL; f[n].off = memoff; f[n].name = "reg";
+    f[n].val = mem_reg; f[n].len = sizeof(mem_reg); n++;
+    f[n].node = "serial@1000"; f[n].name = "clock-frequency";
+    f[n].val = &freq; f[n].len = sizeof(freq); n++;
+    f[n].node = "chosen"; f[n].name = "stdout-path";
+    f[n].val = "serial0"; f[n].len = 8; n++;
+    f[n].node = "cpu@1"; f[n].name = "compatible";
+    f[n].val = "arm,cortex-a72"; f[n].len = 15; n++;
+    f[n].node = "memory@0"; f[n].name = "device_type";
+    f[n].val = "mem"; f[n].len = 4; n++;
+    f[n].node = "soc"; f[n].name = "phandle";
+    f[n].val = &ph; f[n].len = sizeof(ph); n++;
+    f[n].node = "serial@2000"; f[n].name = "status";
+    f[n].val = NULL; f[n].len = 0; n++;
+    *count = n;
+}
+
+START_TEST(test_fixup_batch_matches_setprop)
+{
+    struct fdt_fixup f[16];
+    int i, n, off;
+
+    build_tree(blob2);
+    fixups(f, &n, fdt_find_node_offset(blob2, -1, "memory@0"));
+    for (i = 0; i < n; i++) {
+        off = (f[i].node != NULL) ?
+            fdt_find_node_offset(blob2, -1, f[i].node) : f[i].off;
+        ck_assert_int_eq(fdt_setprop(blob2, off, f[i].name, f[i].val,
+            f[i].len), 0);
+    }
+
+    ck_assert_int_eq(fdt_index_build(blob), 9);
+    ck_assert_int_eq(fdt_fixup_batch(blob, f, n), 0);
+    check_blob(blob, blob2);
+    check_index(blob);
+    ck_assert_int_eq(fdt_node_offset_by_phandle(blob, 12),
+        fdt_find_node_offset(blob, -1, "soc"));
+    check_lookups(blob);
+
+    /* same batch again: only resizes, no change */
+    ck_assert_int_eq(fdt_index_build(blob), 9);
+    ck_assert_int_eq(fdt_fixup_batch(blob, f, n), 0);
+    check_blob(blob, blob2);
+    check_index(blob);
+}
+END_TEST
+
+START_TEST(test_fixup_batch_errors)
+{
+    struct fdt_fixup f[16];
+    int n;
+
+    fixups(f, &n, fdt_find_node_offset(blob, -1, "memory@0"));
+    memcpy(blob2, blob, BLOB_SIZE);
+    ck_assert_int_eq(fdt_index_build(blob), 9);
+
+    /* duplicated property */
+    f[n] = f[1];
+    f[n].node = "memory@0";
+    ck_assert_int_eq(fdt_fixup_batch(blob, f, n + 1), -FDT_ERR_EXISTS);
+    check_blob(blob, blob2);
+
+    /* unknown node */
+    f[n].node = "serial@3000";
+    ck_assert_int_eq(fdt_fixup_batch(blob, f, n + 1), -FDT_ERR_NOTFOUND);
+    check_blob(blob, blob2);
+    f[n].node = NULL;
+    f[n].off = 6;
+    ck_assert_int_eq(fdt_fixup_batch(blob, f, n + 1), -FDT_ERR_BADOFFSET);
+
+    /* no space: the strings added by the batch are dropped */
+    fdt_set_totalsize(blob, fdt_off_dt_strings(blob) +
+        fdt_size_dt_strings(blob) + 24);
+    fdt_set_totalsize(blob2, fdt_totalsize(blob));
+    ck_assert_int_eq(fdt_fixup_batch(blob, f, n), -FDT_ERR_NOSPACE);
+    check_blob(blob, blob2);
+    check_index(blob);
+
+    ck_assert_int_eq(fdt_fixup_batch(blob, f, FDT_FIXUP_BATCH_MAX + 1),
+        -FDT_ERR_NOSPACE);
+    ck_assert_int_eq(fdt_fixup_batch(blob, f, 0), 0);
+}
+END_TEST
+
+static Suite *fdt_index_suite(void)
+{
+    Suite *s = suite_create("fdt-index");
+    TCase *tc = tcase_create("fdt-index");
+
+    tcase_add_checked_fixture(tc, setup, NULL);
+    tcase_add_test(tc, test_index_build);
+    tcase_add_test(tc, test_index_follows_edits);
+    tcase_add_test(tc, test_index_full);
+    tcase_add_test(tc, test_fixup_batch_matches_setprop);
+    tcase_add_test(tc, test_fixup_batch_errors);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main(void)
+{
+    int fails;
+    Suite *s = fdt_index_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    fails = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return fails;
+}
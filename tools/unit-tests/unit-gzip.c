@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "gzip.h"
@@ -522,6 +523,228 @@ START_TEST(test_fixture_truncated_fextra)
 }
 END_TEST
 
+/* ------------------------------------------------------------------------- */
+/* Streaming API                                                             */
+/* ------------------------------------------------------------------------- */
+
+/* Feed 'gz' in 'chunk'-byte pieces; returns the finish() result */
+static int stream_inflate(const uint8_t *gz, size_t gz_len, size_t chunk,
+                          uint8_t *out, uint32_t out_max, uint32_t *out_len)
+{
+    WOLFBOOT_GUNZIP_CTX *ctx;
+    size_t off = 0, n;
+    int rc;
+
+    ctx = (WOLFBOOT_GUNZIP_CTX*)malloc(sizeof(*ctx));
+    ck_assert_ptr_nonnull(ctx);
+    ck_assert_int_eq(wolfBoot_gunzip_init(ctx, out, out_max), 0);
+    rc = 0;
+    while ((off < gz_len) && (rc == 0)) {
+        n = gz_len - off;
+        if (n > chunk) {
+            n = chunk;
+        }
+        rc = wolfBoot_gunzip_feed(ctx, gz + off, (uint32_t)n);
+        off += n;
+    }
+    if (rc == 1) {
+        /* Done only once the last byte of the trailer was fed */
+        ck_assert_uint_eq(off, gz_len);
+    }
+    rc = wolfBoot_gunzip_finish(ctx, out_len);
+    free(ctx);
+    return rc;
+}
+
+static void stream_check(const uint8_t *input, size_t in_len)
+{
+    static const size_t chunks[] = { 1, 7, 512, 4096, 0 };
+    uint8_t *gz;
+    size_t gz_len = 0;
+    uint8_t *out;
+    uint32_t out_len = 0;
+    size_t i, chunk;
+
+    gz = gz_compress_buf(input, in_len, &gz_len);
+    ck_assert_ptr_nonnull(gz);
+    out = (uint8_t*)malloc(in_len + 16);
+    ck_assert_ptr_nonnull(out);
+
+    for (i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        chunk = (chunks[i] == 0) ? gz_len : chunks[i];
+        memset(out, 0, in_len + 16);
+        ck_assert_int_eq(stream_inflate(gz, gz_len, chunk, out,
+                                        (uint32_t)(in_len + 16), &out_len), 0);
+        ck_assert_uint_eq((unsigned)out_len, (unsigned)in_len);
+        if (in_len > 0) {
+            ck_assert_int_eq(memcmp(out, input, in_len), 0);
+        }
+    }
+    free(out);
+    free(gz);
+}
+
+START_TEST(test_stream_roundtrip)
+{
+    size_t n = 256 * 1024;
+    uint8_t *buf = (uint8_t*)malloc(n);
+    uint32_t state = 0xC0FFEE01U;
+    size_t i;
+
+    ck_assert_ptr_nonnull(buf);
+    for (i = 0; i < n; i++) {
+        state = state * 1664525U + 1013904223U;
+        /* Mix of compressible text and noise: dynamic blocks, long
+         * back-references and literals all cross chunk boundaries */
+        buf[i] = ((i & 0x1FFF) < 0x1000) ?
+                 (uint8_t)("streaming gunzip "[i % 17]) :
+                 (uint8_t)(state >> 24);
+    }
+    stream_check((const uint8_t*)"", 0);
+    stream_check(buf, n);
+    free(buf);
+}
+END_TEST
+
+START_TEST(test_stream_fixtures)
+{
+    uint8_t out[128];
+    uint32_t out_len = 0;
+
+    /* Stored block split across feeds, fixed Huffman, header flags */
+    ck_assert_int_eq(stream_inflate(stored_gz, sizeof(stored_gz), 1, out,
+                                    sizeof(out), &out_len), 0);
+    ck_assert_uint_eq(out_len, sizeof(stored_input) - 1);
+    ck_assert_int_eq(memcmp(out, stored_input, out_len), 0);
+
+    ck_assert_int_eq(stream_inflate(fixed_gz, sizeof(fixed_gz), 1, out,
+                                    sizeof(out), &out_len), 0);
+    ck_assert_uint_eq(out_len, sizeof(fixed_input) - 1);
+    ck_assert_int_eq(memcmp(out, fixed_input, out_len), 0);
+
+    ck_assert_int_eq(stream_inflate(gz_all_flags, sizeof(gz_all_flags), 3,
+                                    out, sizeof(out), &out_len), 0);
+    ck_assert_uint_eq(out_len, sizeof(flag_payload) - 1);
+    ck_assert_int_eq(memcmp(out, flag_payload, out_len), 0);
+}
+END_TEST
+
+START_TEST(test_stream_truncated)
+{
+    const char *msg = "truncated streaming input truncated streaming input";
+    uint8_t *gz;
+    size_t gz_len = 0;
+    uint8_t out[128];
+    uint32_t out_len = 0;
+
+    gz = gz_compress_buf((const uint8_t*)msg, strlen(msg), &gz_len);
+    ck_assert_ptr_nonnull(gz);
+    /* Missing trailer bytes: feed() keeps asking for more, finish() fails */
+    ck_assert_int_eq(stream_inflate(gz, gz_len - 3, 5, out, sizeof(out),
+                                    &out_len), WOLFBOOT_GZIP_E_TRUNCATED);
+    ck_assert_int_eq(stream_inflate(gz, 4, 1, out, sizeof(out),
+                                    &out_len), WOLFBOOT_GZIP_E_TRUNCATED);
+    free(gz);
+}
+END_TEST
+
+START_TEST(test_stream_sticky_error)
+{
+    const char *msg = "sticky errors";
+    WOLFBOOT_GUNZIP_CTX *ctx;
+    uint8_t *gz;
+    size_t gz_len = 0;
+    uint8_t out[64];
+    uint32_t out_len = 0;
+
+    gz = gz_compress_buf((const uint8_t*)msg, strlen(msg), &gz_len);
+    ck_assert_ptr_nonnull(gz);
+    gz[gz_len - 8] ^= 0x01; /* CRC32 */
+
+    ctx = (WOLFBOOT_GUNZIP_CTX*)malloc(sizeof(*ctx));
+    ck_assert_ptr_nonnull(ctx);
+    ck_assert_int_eq(wolfBoot_gunzip_init(ctx, out, sizeof(out)), 0);
+    ck_assert_int_eq(wolfBoot_gunzip_feed(ctx, gz, (uint32_t)gz_len),
+                     WOLFBOOT_GZIP_E_CRC32);
+    ck_assert_int_eq(wolfBoot_gunzip_feed(ctx, gz, 1), WOLFBOOT_GZIP_E_CRC32);
+    ck_assert_int_eq(wolfBoot_gunzip_finish(ctx, &out_len),
+                     WOLFBOOT_GZIP_E_CRC32);
+
+    ck_assert_int_eq(wolfBoot_gunzip_init(NULL, out, sizeof(out)),
+                     WOLFBOOT_GZIP_E_PARAM);
+    ck_assert_int_eq(wolfBoot_gunzip_init(ctx, out, sizeof(out)), 0);
+    ck_assert_int_eq(wolfBoot_gunzip_feed(ctx, NULL, 1),
+                     WOLFBOOT_GZIP_E_PARAM);
+    free(ctx);
+    free(gz);
+}
+END_TEST
+
+/* ------------------------------------------------------------------------- */
+/* Throughput report                                                         */
+/* ------------------------------------------------------------------------- */
+
+START_TEST(test_throughput_report)
+{
+    /* Kernel-like input: runs of text, tables and noise. Reports MB/s for
+     * the build configuration (WOLFBOOT_GZIP_FAST / _CRC32_TABLE) under
+     * test, so the variants can be compared side by side. */
+    const size_t len = 4 * 1024 * 1024;
+    const int rounds = 4;
+    uint8_t *buf = (uint8_t*)malloc(len);
+    uint8_t *out = (uint8_t*)malloc(len);
+    uint8_t *gz;
+    size_t gz_len = 0;
+    uint32_t out_len = 0;
+    uint32_t state = 0x12345678U;
+    struct timespec t0, t1;
+    double secs;
+    size_t i;
+    int r;
+
+    ck_assert_ptr_nonnull(buf);
+    ck_assert_ptr_nonnull(out);
+    for (i = 0; i < len; i++) {
+        state = state * 1103515245U + 12345U;
+        if ((i & 0x3FFF) < 0x1000) {
+            buf[i] = (uint8_t)("wolfBoot gunzip throughput "[i % 27]);
+        }
+        else if ((i & 0x3FFF) < 0x3000) {
+            buf[i] = (uint8_t)((i * 31) ^ (i >> 4));
+        }
+        else {
+            buf[i] = (uint8_t)((state >> 16) & 0x3F);
+        }
+    }
+    gz = gz_compress_buf(buf, len, &gz_len);
+    ck_assert_ptr_nonnull(gz);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (r = 0; r < rounds; r++) {
+        ck_assert_int_eq(wolfBoot_gunzip(gz, (uint32_t)gz_len, out,
+                                         (uint32_t)len, &out_len), 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    ck_assert_uint_eq(out_len, len);
+    ck_assert_int_eq(memcmp(out, buf, len), 0);
+
+    secs = (double)(t1.tv_sec - t0.tv_sec) +
+           (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("gunzip (fast=%d, crc32 table=%d): %.1f MB/s\n",
+#ifdef WOLFBOOT_GZIP_FAST
+           1,
+#else
+           0,
+#endif
+           WOLFBOOT_GZIP_CRC32_TABLE,
+           (secs > 0) ? ((double)len * rounds / (1024.0 * 1024.0)) / secs : 0.0);
+
+    free(gz);
+    free(out);
+    free(buf);
+}
+END_TEST
+
 /* ------------------------------------------------------------------------- */
 /* Test runner                                                               */
 /* ------------------------------------------------------------------------- */
@@ -532,11 +755,15 @@ static Suite *gzip_suite(void)
     TCase *tc_pos = tcase_create("roundtrip");
     TCase *tc_neg = tcase_create("negative");
     TCase *tc_fix = tcase_create("fixtures");
+    TCase *tc_stream = tcase_create("stream");
+    TCase *tc_perf = tcase_create("throughput");
 
     /* The 2 MB test pushes past the default 4-second per-test budget */
     tcase_set_timeout(tc_pos, 30);
     tcase_set_timeout(tc_neg, 10);
     tcase_set_timeout(tc_fix, 10);
+    tcase_set_timeout(tc_stream, 30);
+    tcase_set_timeout(tc_perf, 60);
 
     tcase_add_test(tc_pos, test_roundtrip_empty);
     tcase_add_test(tc_pos, test_roundtrip_short_text);
@@ -565,9 +792,18 @@ static Suite *gzip_suite(void)
     tcase_add_test(tc_fix, test_fixture_all_flags);
     tcase_add_test(tc_fix, test_fixture_truncated_fextra);
 
+    tcase_add_test(tc_stream, test_stream_roundtrip);
+    tcase_add_test(tc_stream, test_stream_fixtures);
+    tcase_add_test(tc_stream, test_stream_truncated);
+    tcase_add_test(tc_stream, test_stream_sticky_error);
+
+    tcase_add_test(tc_perf, test_throughput_report);
+
     suite_add_tcase(s, tc_pos);
     suite_add_tcase(s, tc_neg);
     suite_add_tcase(s, tc_fix);
+    suite_add_tcase(s, tc_stream);
+    suite_add_tcase(s, tc_perf);
     return s;
 }
 
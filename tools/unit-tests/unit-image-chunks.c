@@ -0,0 +1,535 @@
+/* unit-image-chunks.c
+ *
+ * Unit tests for chunked image verification (WOLFBOOT_IMG_CHUNKS):
+ * wolfBoot_verify_integrity() on an image carrying an HDR_IMG_CHUNKS TLV and
+ * a chunk digest table after the firmware, with the chunks verified in order
+ * (default) or by a pool of threads (WOLFBOOT_IMG_CHUNKS_PARALLEL, which
+ * provides hal_verify_image_chunks() below, as hal/sim.c does).
+ * With WOLFBOOT_IMG_CHUNKS_LAZY, wolfBoot_verify_integrity_lazy() only
+ * checks the chunks the HAL cannot protect (hal_lazy_xip_protect() below).
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <check.h>
+#ifdef WOLFBOOT_IMG_CHUNKS_PARALLEL
+#include <pthread.h>
+#endif
+
+#include "user_settings.h"
+#include "wolfboot/wolfboot.h"
+
+#include "image.c"
+
+#include "unit-mock-flash.c"
+
+#define MOCK_ADDRESS_BOOT 0xCD000000
+
+#define CHUNK_SIZE      0x400U
+#define IMG_FW_SIZE     0x1123U
+#define IMG_N_CHUNKS    (((IMG_FW_SIZE - 1) / CHUNK_SIZE) + 1)
+
+/* Header layout: magic, size, HDR_IMG_CHUNKS at 8, HDR_HASH at 16 */
+#define CHUNKS_TLV_OFF  8
+#define HASH_TLV_OFF    16
+
+uint32_t wolfBoot_get_blob_version(uint8_t *blob)
+{
+    (void)blob;
+    return 1;
+}
+
+uint16_t wolfBoot_get_blob_type(uint8_t *blob)
+{
+    (void)blob;
+    return HDR_IMG_TYPE_APP;
+}
+
+/* Minimal TLV lookup, as in libwolfboot.c */
+uint16_t wolfBoot_find_header(uint8_t *haystack, uint16_t type, uint8_t **ptr)
+{
+    uint8_t *p = haystack;
+    uint8_t *max_p = haystack - IMAGE_HEADER_OFFSET + IMAGE_HEADER_SIZE;
+    uint16_t len, htype;
+
+    *ptr = NULL;
+    while (p + 4 <= max_p) {
+        htype = (uint16_t)(p[0] | (p[1] << 8));
+        if (htype == 0)
+            break;
+        if ((p[0] == HDR_PADDING) || ((((uintptr_t)p) & 0x01U) != 0U)) {
+            p++;
+            continue;
+        }
+        len = (uint16_t)(p[2] | (p[3] << 8));
+        if (p + 4 + len > max_p)
+            break;
+        if (htype == type) {
+            *ptr = p + 4;
+            return len;
+        }
+        p += 4 + len;
+    }
+    return 0;
+}
+
+#ifdef WOLFBOOT_IMG_CHUNKS_PARALLEL
+#define TEST_CHUNK_THREADS 3
+
+struct test_chunk_job {
+    struct wolfBoot_image *img;
+    uint32_t n;
+    uint32_t next;
+    int failed;
+    pthread_mutex_t lock;
+};
+
+static int chunk_threads_used;
+
+static void *test_chunk_worker(void *arg)
+{
+    struct test_chunk_job *job = (struct test_chunk_job *)arg;
+    uint32_t idx;
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        idx = job->next;
+        if (idx < job->n)
+            job->next++;
+        pthread_mutex_unlock(&job->lock);
+        if (idx >= job->n)
+            break;
+        if (wolfBoot_verify_image_chunk(job->img, idx) != 0) {
+            pthread_mutex_lock(&job->lock);
+            job->failed = 1;
+            pthread_mutex_unlock(&job->lock);
+        }
+    }
+    return NULL;
+}
+
+int hal_verify_image_chunks(struct wolfBoot_image *img, uint32_t n)
+{
+    pthread_t th[TEST_CHUNK_THREADS];
+    struct test_chunk_job job;
+    int i;
+
+    memset(&job, 0, sizeof(job));
+    job.img = img;
+    job.n = n;
+    pthread_mutex_init(&job.lock, NULL);
+    for (i = 0; i < TEST_CHUNK_THREADS; i++)
+        ck_assert_int_eq(pthread_create(&th[i], NULL, test_chunk_worker,
+            &job), 0);
+    for (i = 0; i < TEST_CHUNK_THREADS; i++)
+        pthread_join(th[i], NULL);
+    pthread_mutex_destroy(&job.lock);
+    chunk_threads_used = TEST_CHUNK_THREADS;
+    return job.failed ? -1 : 0;
+}
+#endif
+
+#ifdef WOLFBOOT_IMG_CHUNKS_LAZY
+/* Protection granularity of the emulated MPU, 0 if there is none */
+static uintptr_t lazy_align;
+static uintptr_t lazy_start, lazy_end;
+/* Set while a protection plan is pending, as mpu_lazy_count in boot_arm.c */
+static int lazy_planned;
+
+uintptr_t hal_lazy_xip_protect(uintptr_t start, uintptr_t end)
+{
+    lazy_start = start;
+    lazy_end = end;
+    if (lazy_align == 0)
+        return 0;
+    lazy_planned = 1;
+    return (start + lazy_align - 1) & ~(lazy_align - 1);
+}
+
+void hal_lazy_xip_reset(void)
+{
+    lazy_planned = 0;
+}
+#endif
+
+static uint8_t *boot_hdr(void)
+{
+    return (uint8_t *)(uintptr_t)MOCK_ADDRESS_BOOT;
+}
+
+static uint8_t *boot_table(void)
+{
+    return boot_hdr() + IMAGE_HEADER_SIZE + IMG_FW_SIZE;
+}
+
+static void write_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v & 0xFFU);
+    p[1] = (uint8_t)((v >> 8) & 0xFFU);
+}
+
+static void write_le32(uint8_t *p, uint32_t v)
+{
+    write_le16(p, (uint16_t)(v & 0xFFFFU));
+    write_le16(p + 2, (uint16_t)(v >> 16));
+}
+
+/* Digest of one chunk, hashed block by block like the bootloader does */
+static void chunk_digest(const uint8_t *p, uint32_t len, uint8_t *out)
+{
+    wolfBoot_hash_t ctx;
+    uint32_t blk;
+
+    ck_assert_int_eq(wolfBoot_hash_init(&ctx), 0);
+    while (len > 0) {
+        blk = len > WOLFBOOT_SHA_BLOCK_SIZE ? WOLFBOOT_SHA_BLOCK_SIZE : len;
+        wolfBoot_hash_update(&ctx, p, blk);
+        p += blk;
+        len -= blk;
+    }
+    wolfBoot_hash_final(&ctx, out);
+    wolfBoot_hash_free(&ctx);
+}
+
+/* Builds the header, the firmware and the chunk table in the BOOT
+ * partition, then stores the root digest (header + table) in HDR_HASH,
+ * as sign --chunk-size does. */
+static void build_chunked_image(uint32_t chunk_sz)
+{
+    struct wolfBoot_image img;
+    wolfBoot_hash_t ctx;
+    uint8_t *hdr = boot_hdr();
+    uint8_t *fw = hdr + IMAGE_HEADER_SIZE;
+    uint8_t root[WOLFBOOT_SHA_DIGEST_SIZE];
+    uint32_t i, n, len;
+
+    memset(hdr, 0xFF, WOLFBOOT_PARTITION_SIZE);
+    memset(hdr, 0, IMAGE_HEADER_SIZE);
+    write_le32(hdr, WOLFBOOT_MAGIC);
+    write_le32(hdr + 4, IMG_FW_SIZE);
+    write_le16(hdr + CHUNKS_TLV_OFF, HDR_IMG_CHUNKS);
+    write_le16(hdr + CHUNKS_TLV_OFF + 2, 4);
+    write_le32(hdr + CHUNKS_TLV_OFF + 4, chunk_sz);
+    write_le16(hdr + HASH_TLV_OFF, HDR_HASH);
+    write_le16(hdr + HASH_TLV_OFF + 2, WOLFBOOT_SHA_DIGEST_SIZE);
+    for (i = 0; i < IMG_FW_SIZE; i++)
+        fw[i] = (uint8_t)((i * 7) + (i >> 8));
+
+    n = ((IMG_FW_SIZE - 1) / chunk_sz) + 1;
+    if (IMAGE_HEADER_SIZE + IMG_FW_SIZE + (n * WOLFBOOT_SHA_DIGEST_SIZE) <=
+            WOLFBOOT_PARTITION_SIZE) {
+        for (i = 0; i < n; i++) {
+            len = IMG_FW_SIZE - (i * chunk_sz);
+            if (len > chunk_sz)
+                len = chunk_sz;
+            chunk_digest(fw + (i * chunk_sz), len,
+                boot_table() + (i * WOLFBOOT_SHA_DIGEST_SIZE));
+        }
+    }
+
+    ck_assert_int_eq(wolfBoot_open_image(&img, PART_BOOT), 0);
+    ck_assert_int_eq(header_hash(&ctx, &img), 0);
+    if (IMAGE_HEADER_SIZE + IMG_FW_SIZE + (n * WOLFBOOT_SHA_DIGEST_SIZE) <=
+            WOLFBOOT_PARTITION_SIZE)
+        wolfBoot_hash_update(&ctx, boot_table(), n * WOLFBOOT_SHA_DIGEST_SIZE);
+    wolfBoot_hash_final(&ctx, root);
+    wolfBoot_hash_free(&ctx);
+    memcpy(hdr + HASH_TLV_OFF + 4, root, WOLFBOOT_SHA_DIGEST_SIZE);
+}
+
+static int verify_boot(void)
+{
+    struct wolfBoot_image img;
+
+    if (wolfBoot_open_image(&img, PART_BOOT) != 0)
+        return -2;
+    return wolfBoot_verify_integrity(&img);
+}
+
+static void setup(void)
+{
+    int ret = mmap_file("/tmp/wolfboot-unit-image-chunks-boot.bin",
+        (void *)MOCK_ADDRESS_BOOT, WOLFBOOT_PARTITION_SIZE, NULL);
+    ck_assert_int_ge(ret, 0);
+}
+
+static void teardown(void)
+{
+    munmap((void *)MOCK_ADDRESS_BOOT, WOLFBOOT_PARTITION_SIZE);
+}
+
+START_TEST(test_chunks_valid_image)
+{
+    struct wolfBoot_image img;
+    uint32_t i;
+
+    setup();
+    build_chunked_image(CHUNK_SIZE);
+    ck_assert_int_eq(wolfBoot_open_image(&img, PART_BOOT), 0);
+    ck_assert_uint_eq(wolfBoot_image_chunks(&img), IMG_N_CHUNKS);
+    for (i = 0; i < IMG_N_CHUNKS; i++)
+        ck_assert_int_eq(wolfBoot_verify_image_chunk(&img, i), 0);
+    ck_assert_int_ne(wolfBoot_verify_image_chunk(&img, IMG_N_CHUNKS), 0);
+    ck_assert_int_eq(verify_boot(), 0);
+#ifdef WOLFBOOT_IMG_CHUNKS_PARALLEL
+    ck_assert_int_eq(chunk_threads_used, TEST_CHUNK_THREADS);
+#endif
+    teardown();
+}
+END_TEST
+
+START_TEST(test_chunks_corrupted_chunk)
+{
+    struct wolfBoot_image img;
+    uint8_t *fw;
+
+    setup();
+    build_chunked_image(CHUNK_SIZE);
+    ck_assert_int_eq(verify_boot(), 0);
+    /* Last byte of the partial last chunk */
+    fw = boot_hdr() + IMAGE_HEADER_SIZE;
+    fw[IMG_FW_SIZE - 1] ^= 0x01;
+    ck_assert_int_eq(wolfBoot_open_image(&img, PART_BOOT), 0);
+    ck_assert_int_eq(wolfBoot_verify_image_chunk(&img, 0), 0);
+    ck_assert_int_ne(wolfBoot_verify_image_chunk(&img, IMG_N_CHUNKS - 1), 0);
+    ck_assert_int_eq(verify_boot(), -1);
+    ck_assert_int_eq(img.sha_ok, 0);
+    fw[IMG_FW_SIZE - 1] ^= 0x01;
+    /* First chunk */
+    fw[1] ^= 0x80;
+    ck_assert_int_eq(verify_boot(), -1);
+    teardown();
+}
+END_TEST
+
+START_TEST(test_chunks_corrupted_table)
+{
+    uint8_t *fw;
+    uint8_t *entry;
+
+    setup();
+    build_chunked_image(CHUNK_SIZE);
+    /* Chunk and table entry changed consistently: the root digest must
+     * still catch it */
+    fw = boot_hdr() + IMAGE_HEADER_SIZE;
+    entry = boot_table() + WOLFBOOT_SHA_DIGEST_SIZE;
+    fw[CHUNK_SIZE + 3] ^= 0x10;
+    chunk_digest(fw + CHUNK_SIZE, CHUNK_SIZE, entry);
+    ck_assert_int_eq(verify_boot(), -1);
+    teardown();
+}
+END_TEST
+
+START_TEST(test_chunks_table_out_of_partition)
+{
+    struct wolfBoot_image img;
+
+    setup();
+    /* One digest per byte: the table cannot fit after the firmware */
+    build_chunked_image(1);
+    ck_assert_int_eq(wolfBoot_open_image(&img, PART_BOOT), 0);
+    ck_assert_uint_eq(wolfBoot_image_chunks(&img), 0);
+    ck_assert_int_ne(wolfBoot_verify_image_chunk(&img, 0), 0);
+    ck_assert_int_eq(verify_boot(), -1);
+    teardown();
+}
+END_TEST
+
+/* The root digest is only restored for a zero chunk result, whatever the
+ * bits set in a failed one */
+START_TEST(test_chunks_seal)
+{
+    static const uint32_t failed[] = { 1U, 0xFFFFFFFFU, 0x80000000U, 0x100U };
+    uint8_t root[WOLFBOOT_SHA_DIGEST_SIZE];
+    uint8_t ref[WOLFBOOT_SHA_DIGEST_SIZE];
+    uint32_t i;
+
+    for (i = 0; i < WOLFBOOT_SHA_DIGEST_SIZE; i++)
+        ref[i] = (uint8_t)(i * 13);
+    for (i = 0; i < sizeof(failed) / sizeof(failed[0]); i++) {
+        memcpy(root, ref, sizeof(root));
+        image_chunks_seal(root, failed[i]);
+        ck_assert_mem_eq(root, ref, sizeof(root));
+    }
+    image_chunks_seal(root, 0);
+    for (i = 0; i < WOLFBOOT_SHA_DIGEST_SIZE; i++)
+        ck_assert_uint_eq(root[i], (uint8_t)~ref[i]);
+}
+END_TEST
+
+START_TEST(test_chunks_stream_hash_rejected)
+{
+    struct wolfBoot_image img;
+
+    setup();
+    build_chunked_image(CHUNK_SIZE);
+    ck_assert_int_eq(wolfBoot_open_image(&img, PART_BOOT), 0);
+    ck_assert_int_eq(wolfBoot_image_hash_start(&img), -1);
+    teardown();
+}
+END_TEST
+
+#ifdef WOLFBOOT_IMG_CHUNKS_LAZY
+static int verify_boot_lazy(uint32_t prefix)
+{
+    struct wolfBoot_image img;
+
+    if (wolfBoot_open_image(&img, PART_BOOT) != 0)
+        return -2;
+    return wolfBoot_verify_integrity_lazy(&img, prefix);
+}
+
+START_TEST(test_chunks_lazy_prefix)
+{
+    uint8_t *fw;
+
+    setup();
+    build_chunked_image(CHUNK_SIZE);
+    fw = boot_hdr() + IMAGE_HEADER_SIZE;
+    lazy_align = 32;
+    ck_assert_int_eq(verify_boot_lazy(CHUNK_SIZE), 0);
+    ck_assert_ptr_eq((void *)lazy_start, fw + CHUNK_SIZE);
+    ck_assert_ptr_eq((void *)lazy_end, fw + IMG_FW_SIZE);
+
+    /* Chunks after the prefix are left to the application */
+    fw[IMG_FW_SIZE - 1] ^= 0x01;
+    ck_assert_int_eq(verify_boot_lazy(CHUNK_SIZE), 0);
+    /* A prefix ending inside a chunk covers the whole chunk */
+    fw[CHUNK_SIZE + 5] ^= 0x01;
+    ck_assert_int_eq(verify_boot_lazy(CHUNK_SIZE), 0);
+    ck_assert_int_eq(verify_boot_lazy(CHUNK_SIZE + 1), -1);
+    fw[CHUNK_SIZE + 5] ^= 0x01;
+    /* Neither the prefix nor the table can be skipped */
+    fw[0] ^= 0x01;
+    ck_assert_int_eq(verify_boot_lazy(CHUNK_SIZE), -1);
+    fw[0] ^= 0x01;
+    boot_table()[(IMG_N_CHUNKS - 1) * WOLFBOOT_SHA_DIGEST_SIZE] ^= 0x01;
+    ck_assert_int_eq(verify_boot_lazy(CHUNK_SIZE), -1);
+    teardown();
+}
+END_TEST
+
+START_TEST(test_chunks_lazy_protection)
+{
+    uint8_t *fw;
+
+    setup();
+    build_chunked_image(CHUNK_SIZE);
+    fw = boot_hdr() + IMAGE_HEADER_SIZE;
+    fw[(2 * CHUNK_SIZE) + 1] ^= 0x01;
+
+    /* No protection: everything is verified */
+    lazy_align = 0;
+    ck_assert_int_eq(verify_boot_lazy(CHUNK_SIZE), -1);
+    /* Protection starting inside the fourth chunk: four chunks checked */
+    lazy_align = 4 * CHUNK_SIZE;
+    ck_assert_int_eq(verify_boot_lazy(CHUNK_SIZE), -1);
+    /* Protection starting inside the second chunk: the third is skipped */
+    lazy_align = CHUNK_SIZE;
+    ck_assert_int_eq(verify_boot_lazy(CHUNK_SIZE), 0);
+    /* Prefix covering the whole image: nothing left to protect */
+    lazy_start = 0;
+    ck_assert_int_eq(verify_boot_lazy(IMG_FW_SIZE), -1);
+    ck_assert_ptr_null((void *)lazy_start);
+    /* wolfBoot_verify_integrity() is never lazy */
+    ck_assert_int_eq(verify_boot(), -1);
+    teardown();
+}
+END_TEST
+
+/* The plan of an image must not outlive its verification: a failed image
+ * followed by another one (fallback, emergency update) boots the second
+ * without the execute-never regions of the first. */
+START_TEST(test_chunks_lazy_plan_reset)
+{
+    uint8_t *fw;
+
+    setup();
+    build_chunked_image(CHUNK_SIZE);
+    fw = boot_hdr() + IMAGE_HEADER_SIZE;
+    lazy_align = 32;
+    lazy_planned = 0;
+    ck_assert_int_eq(verify_boot_lazy(CHUNK_SIZE), 0);
+    ck_assert_int_eq(lazy_planned, 1);
+    /* Prefix covering the whole image: no plan */
+    ck_assert_int_eq(verify_boot_lazy(IMG_FW_SIZE), 0);
+    ck_assert_int_eq(lazy_planned, 0);
+    /* Full verification: no plan */
+    ck_assert_int_eq(verify_boot_lazy(CHUNK_SIZE), 0);
+    ck_assert_int_eq(lazy_planned, 1);
+    ck_assert_int_eq(verify_boot(), 0);
+    ck_assert_int_eq(lazy_planned, 0);
+
+    /* Image failing its hash check after its plan is made */
+    fw[0] ^= 0x01;
+    ck_assert_int_eq(verify_boot_lazy(CHUNK_SIZE), -1);
+    ck_assert_ptr_eq((void *)lazy_start, fw + CHUNK_SIZE);
+    ck_assert_int_eq(lazy_planned, 0);
+    fw[0] ^= 0x01;
+    /* Image passing the hash check (then failing its signature check),
+     * replaced by another one with a different chunk geometry */
+    ck_assert_int_eq(verify_boot_lazy(CHUNK_SIZE), 0);
+    ck_assert_int_eq(lazy_planned, 1);
+    build_chunked_image(CHUNK_SIZE / 2);
+    ck_assert_int_eq(verify_boot_lazy(IMG_FW_SIZE), 0);
+    ck_assert_int_eq(lazy_planned, 0);
+    teardown();
+}
+END_TEST
+#endif
+
+Suite *wolfboot_suite(void)
+{
+    Suite *s = suite_create("wolfBoot-image-chunks");
+    TCase *tc = tcase_create("chunked-image");
+
+    tcase_add_test(tc, test_chunks_valid_image);
+    tcase_add_test(tc, test_chunks_corrupted_chunk);
+    tcase_add_test(tc, test_chunks_corrupted_table);
+    tcase_add_test(tc, test_chunks_table_out_of_partition);
+    tcase_add_test(tc, test_chunks_seal);
+    tcase_add_test(tc, test_chunks_stream_hash_rejected);
+#ifdef WOLFBOOT_IMG_CHUNKS_LAZY
+    tcase_add_test(tc, test_chunks_lazy_prefix);
+    tcase_add_test(tc, test_chunks_lazy_protection);
+    tcase_add_test(tc, test_chunks_lazy_plan_reset);
+#endif
+    tcase_set_timeout(tc, 10);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main(void)
+{
+    int fails;
+    Suite *s = wolfboot_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    fails = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return fails;
+}
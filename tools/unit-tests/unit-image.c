@@ -534,6 +534,66 @@ START_TEST(test_keyslot_id_by_sha_scans_all_slots)
 }
 END_TEST
 
+#ifdef WOLFBOOT_KEYSTORE_HINTS
+static void set_all_key_hints(void)
+{
+    uint8_t hint[WOLFBOOT_SHA_DIGEST_SIZE];
+    int id;
+
+    for (id = 0; id < keystore_num_pubkeys(); id++) {
+        key_hash(id, hint);
+        unit_keystore_set_hint(id, hint);
+    }
+}
+
+START_TEST(test_keyslot_id_by_sha_uses_hints)
+{
+    int id;
+    uint8_t digest[WOLFBOOT_SHA_DIGEST_SIZE];
+
+    set_all_key_hints();
+    key_hash(2, digest);
+    unit_keystore_reset_counters();
+    id = keyslot_id_by_sha(digest);
+
+    ck_assert_int_eq(id, 2);
+#ifdef WOLFBOOT_KEYSTORE_HINTS_VERIFY
+    /* Only the matching key is hashed */
+    ck_assert_int_eq(unit_keystore_get_buffer_calls(), 1);
+#else
+    ck_assert_int_eq(unit_keystore_get_buffer_calls(), 0);
+#endif
+
+    memset(digest, 0x5A, sizeof(digest));
+    unit_keystore_reset_counters();
+    ck_assert_int_eq(keyslot_id_by_sha(digest), -1);
+    ck_assert_int_eq(unit_keystore_get_buffer_calls(), 0);
+}
+END_TEST
+
+START_TEST(test_keyslot_id_by_sha_stale_hint)
+{
+    int id;
+    uint8_t digest[WOLFBOOT_SHA_DIGEST_SIZE];
+
+    /* Slot 1 advertises the digest of slot 0: the hint table does not
+     * match the key stored in the slot.
+     */
+    set_all_key_hints();
+    memset(digest, 0x5A, sizeof(digest));
+    unit_keystore_set_hint(0, digest);
+    key_hash(0, digest);
+    unit_keystore_set_hint(1, digest);
+    id = keyslot_id_by_sha(digest);
+#ifdef WOLFBOOT_KEYSTORE_HINTS_VERIFY
+    ck_assert_int_eq(id, -1);
+#else
+    ck_assert_int_eq(id, 1);
+#endif
+}
+END_TEST
+#endif /* WOLFBOOT_KEYSTORE_HINTS */
+
 START_TEST(test_key_hash_zeroes_output_on_invalid_slot)
 {
     uint8_t hash[WOLFBOOT_SHA_DIGEST_SIZE];
@@ -1187,6 +1247,15 @@ Suite *wolfboot_suite(void)
     return s;
 #endif
 
+#if defined(UNIT_IMAGE_KEYHINTS_ONLY) && defined(WOLFBOOT_KEYSTORE_HINTS)
+    TCase* tcase_key_hints = tcase_create("key_hints");
+    tcase_set_timeout(tcase_key_hints, 20);
+    tcase_add_test(tcase_key_hints, test_keyslot_id_by_sha_uses_hints);
+    tcase_add_test(tcase_key_hints, test_keyslot_id_by_sha_stale_hint);
+    suite_add_tcase(s, tcase_key_hints);
+    return s;
+#endif
+
 #if defined(UNIT_IMAGE_DTS_ONLY) && (defined(WOLFBOOT_FDT) || defined(MMU))
     /* Only the raw-DTB digest test. Used by the sha384/sha3-384 variants,
      * whose non-SHA256 hash config would break the other unit-image tests. */
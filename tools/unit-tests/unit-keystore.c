@@ -181,4 +181,25 @@ int unit_keystore_get_size_calls(void)
     return keystore_get_size_calls;
 }
 
+#ifdef WOLFBOOT_KEYSTORE_HINTS
+/* Precomputed key digests, filled in by the tests (keygen emits them in
+ * the generated keystore.c).
+ */
+static uint8_t PubKeyHints[NUM_PUBKEYS][WOLFBOOT_SHA_DIGEST_SIZE];
+static int keystore_hints_set;
+
+const uint8_t *keystore_get_key_hint(int id)
+{
+    if (!keystore_hints_set || (id < 0) || (id >= keystore_num_pubkeys()))
+        return (const uint8_t *)0;
+    return PubKeyHints[id];
+}
+
+void unit_keystore_set_hint(int id, const uint8_t *hint)
+{
+    memcpy(PubKeyHints[id], hint, WOLFBOOT_SHA_DIGEST_SIZE);
+    keystore_hints_set = 1;
+}
+#endif
+
 #endif /* WOLFBOOT_NO_SIGN */
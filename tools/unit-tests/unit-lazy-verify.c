@@ -0,0 +1,226 @@
+/* unit-lazy-verify.c
+ *
+ * Unit tests for the lazy verification of the running image by the
+ * application (WOLFBOOT_IMG_CHUNKS_LAZY): wolfBoot_lazy_verify_next() and
+ * wolfBoot_lazy_verify_range() on a chunked image in the BOOT partition,
+ * with WOLFBOOT_IMG_CHUNKS_LAZY_PREFIX set to one chunk.
+ * libwolfboot.c is linked separately, so that wolfBoot_lazy_xip_verified()
+ * below replaces its weak default. The verification state of the library
+ * is reset by running each test in its own process (CK_FORK).
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#define MOCK_ADDRESS_BOOT 0xCD000000
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <check.h>
+
+#include "hal.h"
+#include "wolfboot/wolfboot.h"
+#include "wolfssl/wolfcrypt/sha256.h"
+
+#include "unit-mock-flash.c"
+
+#define CHUNK_SIZE      0x400U
+/* The first chunk is in the prefix verified by wolfBoot before boot */
+#define FIRST_CHUNK     1U
+#define IMG_FW_SIZE     0x1123U
+#define IMG_N_CHUNKS    (((IMG_FW_SIZE - 1) / CHUNK_SIZE) + 1)
+
+static uintptr_t verified_start, verified_end;
+static int verified_calls;
+
+void wolfBoot_lazy_xip_verified(uintptr_t start, uintptr_t end)
+{
+    ck_assert_uint_gt(end, verified_end);
+    verified_start = start;
+    verified_end = end;
+    verified_calls++;
+}
+
+static uint8_t *boot_fw(void)
+{
+    return (uint8_t *)(uintptr_t)(MOCK_ADDRESS_BOOT + IMAGE_HEADER_SIZE);
+}
+
+static void write_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/* Header with HDR_IMG_CHUNKS (if chunk_sz != 0), firmware, chunk table */
+static void build_image(uint32_t chunk_sz)
+{
+    uint8_t *hdr = (uint8_t *)(uintptr_t)MOCK_ADDRESS_BOOT;
+    uint8_t *fw = boot_fw();
+    wc_Sha256 sha;
+    uint32_t i, len;
+
+    memset(hdr, 0xFF, WOLFBOOT_PARTITION_SIZE);
+    memset(hdr, 0, IMAGE_HEADER_SIZE);
+    write_le32(hdr, WOLFBOOT_MAGIC);
+    write_le32(hdr + 4, IMG_FW_SIZE);
+    if (chunk_sz != 0) {
+        hdr[8] = (uint8_t)HDR_IMG_CHUNKS;
+        hdr[9] = (uint8_t)(HDR_IMG_CHUNKS >> 8);
+        hdr[10] = 4;
+        write_le32(hdr + 12, chunk_sz);
+    }
+    for (i = 0; i < IMG_FW_SIZE; i++)
+        fw[i] = (uint8_t)((i * 11) + (i >> 9));
+    for (i = 0; chunk_sz != 0 && i < IMG_N_CHUNKS; i++) {
+        len = IMG_FW_SIZE - (i * chunk_sz);
+        if (len > chunk_sz)
+            len = chunk_sz;
+        wc_InitSha256(&sha);
+        wc_Sha256Update(&sha, fw + (i * chunk_sz), len);
+        wc_Sha256Final(&sha, fw + IMG_FW_SIZE + (i * WC_SHA256_DIGEST_SIZE));
+    }
+}
+
+static void setup(void)
+{
+    int ret = mmap_file("/tmp/wolfboot-unit-lazy-verify-boot.bin",
+        (void *)MOCK_ADDRESS_BOOT, WOLFBOOT_PARTITION_SIZE, NULL);
+    ck_assert_int_ge(ret, 0);
+    verified_start = 0;
+    verified_end = 0;
+    verified_calls = 0;
+}
+
+static void teardown(void)
+{
+    munmap((void *)MOCK_ADDRESS_BOOT, WOLFBOOT_PARTITION_SIZE);
+}
+
+START_TEST(test_lazy_verify_all)
+{
+    uint32_t i;
+
+    build_image(CHUNK_SIZE);
+    for (i = FIRST_CHUNK + 1; i < IMG_N_CHUNKS; i++) {
+        ck_assert_int_eq(wolfBoot_lazy_verify_next(), 1);
+        ck_assert_ptr_eq((void *)verified_start, boot_fw());
+        ck_assert_ptr_eq((void *)verified_end, boot_fw() + (i * CHUNK_SIZE));
+    }
+    ck_assert_int_eq(wolfBoot_lazy_verify_next(), 0);
+    ck_assert_ptr_eq((void *)verified_end, boot_fw() + IMG_FW_SIZE);
+    ck_assert_int_eq(verified_calls, IMG_N_CHUNKS - FIRST_CHUNK);
+    /* Nothing left */
+    ck_assert_int_eq(wolfBoot_lazy_verify_next(), 0);
+    ck_assert_int_eq(wolfBoot_lazy_verify_range((uintptr_t)boot_fw(), 1), 0);
+    ck_assert_int_eq(verified_calls, IMG_N_CHUNKS - FIRST_CHUNK);
+}
+END_TEST
+
+START_TEST(test_lazy_verify_prefix_skipped)
+{
+    /* The prefix was verified by wolfBoot: it is not hashed again */
+    build_image(CHUNK_SIZE);
+    boot_fw()[7] ^= 0x40;
+    ck_assert_int_eq(wolfBoot_lazy_verify_range((uintptr_t)boot_fw(),
+        CHUNK_SIZE), 0);
+    ck_assert_int_eq(verified_calls, 0);
+    ck_assert_int_eq(wolfBoot_lazy_verify_next(), 1);
+    ck_assert_int_eq(verified_calls, 1);
+    ck_assert_uint_eq(verified_end, (uintptr_t)boot_fw() + (2 * CHUNK_SIZE));
+}
+END_TEST
+
+START_TEST(test_lazy_verify_corrupted)
+{
+    build_image(CHUNK_SIZE);
+    boot_fw()[(2 * CHUNK_SIZE) + 7] ^= 0x40;
+    ck_assert_int_eq(wolfBoot_lazy_verify_next(), 1);
+    ck_assert_int_eq(wolfBoot_lazy_verify_next(), -1);
+    ck_assert_int_eq(verified_calls, 1);
+    /* Failures are sticky, even if the chunk reads back fine */
+    boot_fw()[(2 * CHUNK_SIZE) + 7] ^= 0x40;
+    ck_assert_int_eq(wolfBoot_lazy_verify_next(), -1);
+    ck_assert_int_eq(wolfBoot_lazy_verify_range((uintptr_t)boot_fw(), 1), -1);
+}
+END_TEST
+
+START_TEST(test_lazy_verify_range)
+{
+    uintptr_t fw = (uintptr_t)boot_fw();
+
+    build_image(CHUNK_SIZE);
+    ck_assert_int_eq(wolfBoot_lazy_verify_range(fw + CHUNK_SIZE, 1), 0);
+    ck_assert_int_eq(verified_calls, 1);
+    /* Up to the chunk holding the last byte of the range */
+    ck_assert_int_eq(wolfBoot_lazy_verify_range(fw + CHUNK_SIZE,
+        2 * CHUNK_SIZE + 1), 0);
+    ck_assert_int_eq(verified_calls, 3);
+    ck_assert_uint_eq(verified_end, fw + (4 * CHUNK_SIZE));
+    /* Out of the firmware */
+    ck_assert_int_eq(wolfBoot_lazy_verify_range(fw - 1, 2), -1);
+    ck_assert_int_eq(wolfBoot_lazy_verify_range(fw + IMG_FW_SIZE, 1), -1);
+    ck_assert_int_eq(wolfBoot_lazy_verify_range(fw + IMG_FW_SIZE - 1, 2), -1);
+    ck_assert_int_eq(wolfBoot_lazy_verify_range(fw, 0), -1);
+    ck_assert_int_eq(verified_calls, 3);
+    ck_assert_int_eq(wolfBoot_lazy_verify_range(fw + IMG_FW_SIZE - 1, 1), 0);
+    ck_assert_uint_eq(verified_end, fw + IMG_FW_SIZE);
+    ck_assert_int_eq(wolfBoot_lazy_verify_next(), 0);
+}
+END_TEST
+
+START_TEST(test_lazy_verify_not_chunked)
+{
+    /* Verified as a whole by wolfBoot before boot */
+    build_image(0);
+    ck_assert_int_eq(wolfBoot_lazy_verify_next(), 0);
+    ck_assert_int_eq(wolfBoot_lazy_verify_range((uintptr_t)boot_fw(), 1), 0);
+    ck_assert_int_eq(verified_calls, 0);
+}
+END_TEST
+
+Suite *wolfboot_suite(void)
+{
+    Suite *s = suite_create("wolfBoot-lazy-verify");
+    TCase *tc = tcase_create("lazy-verify");
+
+    tcase_add_checked_fixture(tc, setup, teardown);
+    tcase_add_test(tc, test_lazy_verify_all);
+    tcase_add_test(tc, test_lazy_verify_prefix_skipped);
+    tcase_add_test(tc, test_lazy_verify_corrupted);
+    tcase_add_test(tc, test_lazy_verify_range);
+    tcase_add_test(tc, test_lazy_verify_not_chunked);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main(void)
+{
+    int fails;
+    Suite *s = wolfboot_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    fails = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return fails;
+}
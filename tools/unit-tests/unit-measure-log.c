@@ -0,0 +1,200 @@
+/* unit-measure-log.c
+ *
+ * Unit tests for the boot-time measurement log (src/measure_log.c).
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <check.h>
+
+#define WOLFBOOT_MLOG_MAX_ENTRIES 3
+
+#include "measure_log.c"
+
+static uint8_t region[1000];
+
+static void sha256(const uint8_t *p, uint32_t len, uint8_t *out)
+{
+    wc_Sha256 sha;
+    wc_InitSha256(&sha);
+    wc_Sha256Update(&sha, p, len);
+    wc_Sha256Final(&sha, out);
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+        ((uint32_t)p[3] << 24);
+}
+
+static void setup(void)
+{
+    uint32_t i;
+
+    wolfBoot_mlog_reset();
+    for (i = 0; i < sizeof(region); i++)
+        region[i] = (uint8_t)(i * 13);
+}
+
+START_TEST(test_measure_once)
+{
+    uint8_t d1[WOLFBOOT_SHA_DIGEST_SIZE], d2[WOLFBOOT_SHA_DIGEST_SIZE];
+    uint8_t ref[WOLFBOOT_SHA_DIGEST_SIZE];
+    const struct wolfBoot_mlog_entry *e;
+
+    sha256(region, sizeof(region), ref);
+    ck_assert_int_eq(wolfBoot_mlog_measure(WOLFBOOT_MLOG_WOLFBOOT,
+        (uintptr_t)region, sizeof(region), d1), 0);
+    ck_assert_mem_eq(d1, ref, sizeof(ref));
+    e = wolfBoot_mlog_get(WOLFBOOT_MLOG_WOLFBOOT);
+    ck_assert_ptr_nonnull(e);
+    ck_assert_uint_eq(e->alg, 0x000B);
+    ck_assert_uint_eq(e->digest_len, WOLFBOOT_SHA_DIGEST_SIZE);
+    ck_assert_uint_eq(e->pcr, WOLFBOOT_MLOG_NO_PCR);
+
+    /* Second consumer: served from the log, the region is not read again */
+    region[10] ^= 0xFF;
+    ck_assert_int_eq(wolfBoot_mlog_measure(WOLFBOOT_MLOG_WOLFBOOT,
+        (uintptr_t)region, sizeof(region), d2), 0);
+    ck_assert_mem_eq(d2, ref, sizeof(ref));
+
+    /* A different range of the same region is hashed and replaces it */
+    ck_assert_int_eq(wolfBoot_mlog_measure(WOLFBOOT_MLOG_WOLFBOOT,
+        (uintptr_t)region, 500, d2), 0);
+    sha256(region, 500, ref);
+    ck_assert_mem_eq(d2, ref, sizeof(ref));
+    ck_assert_uint_eq(wolfBoot_mlog_get(WOLFBOOT_MLOG_WOLFBOOT)->size, 500);
+}
+END_TEST
+
+START_TEST(test_record_forget)
+{
+    uint8_t d[WOLFBOOT_SHA_DIGEST_SIZE];
+    uint8_t out[WOLFBOOT_SHA_DIGEST_SIZE];
+
+    memset(d, 0xA5, sizeof(d));
+    ck_assert_int_eq(wolfBoot_mlog_record(WOLFBOOT_MLOG_BOOT_IMAGE,
+        (uintptr_t)region, 256, d), 0);
+    /* Recorded by the integrity check: no hashing for the consumers */
+    ck_assert_int_eq(wolfBoot_mlog_measure(WOLFBOOT_MLOG_BOOT_IMAGE,
+        (uintptr_t)region, 256, out), 0);
+    ck_assert_mem_eq(out, d, sizeof(d));
+
+    ck_assert_int_eq(wolfBoot_mlog_set_pcr(WOLFBOOT_MLOG_BOOT_IMAGE, 9), 0);
+    ck_assert_uint_eq(wolfBoot_mlog_get(WOLFBOOT_MLOG_BOOT_IMAGE)->pcr, 9);
+    wolfBoot_mlog_forget(WOLFBOOT_MLOG_BOOT_IMAGE);
+    ck_assert_ptr_null(wolfBoot_mlog_get(WOLFBOOT_MLOG_BOOT_IMAGE));
+    ck_assert_int_eq(wolfBoot_mlog_set_pcr(WOLFBOOT_MLOG_BOOT_IMAGE, 9), -1);
+
+    ck_assert_int_eq(wolfBoot_mlog_record(0, 0, 0, d), -1);
+    ck_assert_int_eq(wolfBoot_mlog_record(1, 0, 0, NULL), -1);
+    ck_assert_int_eq(wolfBoot_mlog_measure(1, 0, 0, NULL), -1);
+}
+END_TEST
+
+START_TEST(test_log_full)
+{
+    uint8_t d[WOLFBOOT_SHA_DIGEST_SIZE];
+
+    memset(d, 1, sizeof(d));
+    ck_assert_int_eq(wolfBoot_mlog_record(1, 0, 0, d), 0);
+    ck_assert_int_eq(wolfBoot_mlog_record(2, 0, 0, d), 0);
+    ck_assert_int_eq(wolfBoot_mlog_record(3, 0, 0, d), 0);
+    ck_assert_int_eq(wolfBoot_mlog_record(4, 0, 0, d), -1);
+    /* Replacing an entry still works */
+    ck_assert_int_eq(wolfBoot_mlog_record(2, 0, 0, d), 0);
+    /* Measuring still returns the digest when it cannot be recorded */
+    ck_assert_int_eq(wolfBoot_mlog_measure(4, (uintptr_t)region, 64, d), 0);
+    ck_assert_ptr_null(wolfBoot_mlog_get(4));
+}
+END_TEST
+
+START_TEST(test_export_tcg_log)
+{
+    uint8_t d[WOLFBOOT_SHA_DIGEST_SIZE];
+    uint8_t log[512];
+    uint32_t len = 0, sz;
+    const uint8_t *p;
+
+    ck_assert_int_eq(wolfBoot_mlog_measure(WOLFBOOT_MLOG_WOLFBOOT,
+        (uintptr_t)region, sizeof(region), d), 0);
+    ck_assert_int_eq(wolfBoot_mlog_set_pcr(WOLFBOOT_MLOG_WOLFBOOT, 16), 0);
+    /* Not extended into a PCR: not in the event log */
+    ck_assert_int_eq(wolfBoot_mlog_record(WOLFBOOT_MLOG_BOOT_IMAGE,
+        (uintptr_t)region, 64, d), 0);
+    ck_assert_int_eq(wolfBoot_mlog_export(NULL, &len), 0);
+    sz = len;
+    ck_assert_uint_le(sz, sizeof(log));
+    len = sz - 1;
+    ck_assert_int_eq(wolfBoot_mlog_export(log, &len), -1);
+    len = sizeof(log);
+    ck_assert_int_eq(wolfBoot_mlog_export(log, &len), 0);
+    ck_assert_uint_eq(len, sz);
+
+    /* Spec ID header event */
+    p = log;
+    ck_assert_uint_eq(get_le32(p), 0);
+    ck_assert_uint_eq(get_le32(p + 4), TCG_EV_NO_ACTION);
+    ck_assert_uint_eq(get_le32(p + 28), TCG_SPEC_ID_EVENT_SZ);
+    ck_assert_mem_eq(p + 32, "Spec ID Event03", 16);
+    ck_assert_uint_eq(get_le32(p + 56), 1); /* numberOfAlgorithms */
+    ck_assert_uint_eq(p[60] | (p[61] << 8), 0x000B);
+    ck_assert_uint_eq(p[62] | (p[63] << 8), WOLFBOOT_SHA_DIGEST_SIZE);
+    p += TCG_SPEC_ID_HDR_SZ + TCG_SPEC_ID_EVENT_SZ;
+
+    /* TCG_PCR_EVENT2 of wolfBoot */
+    ck_assert_uint_eq(get_le32(p), 16);
+    ck_assert_uint_eq(get_le32(p + 4), TCG_EV_POST_CODE);
+    ck_assert_uint_eq(get_le32(p + 8), 1);
+    ck_assert_uint_eq(p[12] | (p[13] << 8), 0x000B);
+    ck_assert_mem_eq(p + 14, d, WOLFBOOT_SHA_DIGEST_SIZE);
+    p += 14 + WOLFBOOT_SHA_DIGEST_SIZE;
+    ck_assert_uint_eq(get_le32(p), sizeof("wolfBoot"));
+    ck_assert_str_eq((const char *)p + 4, "wolfBoot");
+    ck_assert_ptr_eq(p + 4 + sizeof("wolfBoot"), log + sz);
+}
+END_TEST
+
+Suite *wolfboot_suite(void)
+{
+    Suite *s = suite_create("wolfBoot-measure-log");
+    TCase *tc = tcase_create("measure-log");
+
+    tcase_add_checked_fixture(tc, setup, NULL);
+    tcase_add_test(tc, test_measure_once);
+    tcase_add_test(tc, test_record_forget);
+    tcase_add_test(tc, test_log_full);
+    tcase_add_test(tc, test_export_tcg_log);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main(void)
+{
+    int fails;
+    Suite *s = wolfboot_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    fails = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return fails;
+}
@@ -34,6 +34,8 @@ static int erased_swap = 0;
 static int erased_nvm_bank0 = 0;
 static int erased_nvm_bank1 = 0;
 static int erased_vault = 0;
+static int erased_vault_sectors = 0;
+static int erased_verify_cache = 0;
 static int hal_flash_write_fail = 0;
 const char *argv0;
 
@@ -86,6 +88,15 @@ int hal_flash_write(haladdr_t address, const uint8_t *data, int len)
             a[i] = data[i];
         }
     }
+#endif
+#ifdef WOLFBOOT_VERIFY_CACHE_ADDRESS
+    if ((address >= (haladdr_t)WOLFBOOT_VERIFY_CACHE_ADDRESS) &&
+            (address < (haladdr_t)WOLFBOOT_VERIFY_CACHE_ADDRESS +
+                WOLFBOOT_SECTOR_SIZE)) {
+        for (i = 0; i < len; i++) {
+            a[i] = data[i];
+        }
+    }
 #endif
     return 0;
 }
@@ -118,6 +129,7 @@ int hal_flash_erase(haladdr_t address, int len)
     } else if ((address >= (uintptr_t)vault_base) && (address < (uintptr_t)vault_base + keyvault_size)) {
         printf("Erasing vault from %p : %p bytes\n", address, len);
         erased_vault++;
+        erased_vault_sectors += len / WOLFBOOT_SECTOR_SIZE;
         memset((void *)(uintptr_t)address, 0xFF, len);
 #endif
 #ifdef WOLFBOOT_DIAGNOSTICS_ADDRESS
@@ -125,6 +137,13 @@ int hal_flash_erase(haladdr_t address, int len)
             (address < (haladdr_t)WOLFBOOT_DIAGNOSTICS_ADDRESS +
                 WOLFBOOT_DIAGNOSTICS_SECTORS * WOLFBOOT_SECTOR_SIZE)) {
         memset((void *)(uintptr_t)address, 0xFF, len);
+#endif
+#ifdef WOLFBOOT_VERIFY_CACHE_ADDRESS
+    } else if ((address >= (haladdr_t)WOLFBOOT_VERIFY_CACHE_ADDRESS) &&
+            (address < (haladdr_t)WOLFBOOT_VERIFY_CACHE_ADDRESS +
+                WOLFBOOT_SECTOR_SIZE)) {
+        erased_verify_cache++;
+        memset((void *)(uintptr_t)address, 0xFF, len);
 #endif
     } else {
         fail("Invalid address\n");
@@ -0,0 +1,312 @@
+/* unit-mp-dispatch.c
+ *
+ * Unit tests for the secondary core work dispatch (src/mp_dispatch.c),
+ * with the secondary cores emulated by pthreads: hal_mp_kick() wakes the
+ * thread of the worker, which then polls its mailbox like the park loop of
+ * a real core. Workers can be configured to never answer, to check the
+ * single-core fallback.
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <check.h>
+
+#define WOLFBOOT_MP_DISPATCH
+#define WOLFBOOT_MP_MAX_WORKERS 4
+#define WOLFBOOT_MP_ACK_TIMEOUT 200000U
+#define WOLFBOOT_MP_DONE_TIMEOUT 20000000U
+#define WOLFBOOT_MP_RELAX() sched_yield()
+
+#include "mp_dispatch.c"
+
+#define TEST_MAX_ITEMS 64
+
+static struct wolfBoot_mp_shared test_shared;
+static unsigned int test_workers;
+static int worker_dead[WOLFBOOT_MP_MAX_WORKERS + 1];
+static unsigned int kicks[WOLFBOOT_MP_MAX_WORKERS + 1];
+static unsigned int pending[WOLFBOOT_MP_MAX_WORKERS + 1];
+static int stop_workers;
+static pthread_t threads[WOLFBOOT_MP_MAX_WORKERS + 1];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+/* Work: count the runs of each item, and the thread that ran it */
+static volatile uint32_t item_runs[TEST_MAX_ITEMS];
+static volatile int fail_item = -1;
+static pthread_t boot_thread;
+static volatile int items_off_boot;
+
+struct wolfBoot_mp_shared *hal_mp_shared(void)
+{
+    return &test_shared;
+}
+
+unsigned int hal_mp_workers(void)
+{
+    return test_workers;
+}
+
+void hal_mp_kick(unsigned int w)
+{
+    ck_assert_uint_ge(w, 1);
+    ck_assert_uint_le(w, test_workers);
+    pthread_mutex_lock(&lock);
+    kicks[w]++;
+    pending[w] = 1;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+}
+
+static void *worker_thread(void *arg)
+{
+    unsigned int w = (unsigned int)(uintptr_t)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&lock);
+        while (!pending[w] && !stop_workers)
+            pthread_cond_wait(&cond, &lock);
+        pending[w] = 0;
+        if (stop_workers) {
+            pthread_mutex_unlock(&lock);
+            break;
+        }
+        pthread_mutex_unlock(&lock);
+        if (!worker_dead[w])
+            wolfBoot_mp_worker_poll(w);
+    }
+    return NULL;
+}
+
+/* Runs on the worker threads too: no ck_assert() here */
+static int count_item(void *arg, uint32_t idx)
+{
+    if ((arg != (void *)item_runs) || (idx >= TEST_MAX_ITEMS))
+        return -1;
+    __sync_fetch_and_add(&item_runs[idx], 1);
+    if (!pthread_equal(pthread_self(), boot_thread))
+        items_off_boot = 1;
+    return ((int)idx == fail_item) ? -1 : 0;
+}
+
+static void start_workers(unsigned int n)
+{
+    unsigned int w;
+
+    memset(&test_shared, 0, sizeof(test_shared));
+    memset((void *)item_runs, 0, sizeof(item_runs));
+    memset(worker_dead, 0, sizeof(worker_dead));
+    memset(kicks, 0, sizeof(kicks));
+    memset(pending, 0, sizeof(pending));
+    fail_item = -1;
+    items_off_boot = 0;
+    stop_workers = 0;
+    test_workers = n;
+    boot_thread = pthread_self();
+    for (w = 1; w <= n; w++)
+        ck_assert_int_eq(pthread_create(&threads[w], NULL, worker_thread,
+            (void *)(uintptr_t)w), 0);
+}
+
+static void stop_all_workers(void)
+{
+    unsigned int w;
+
+    pthread_mutex_lock(&lock);
+    stop_workers = 1;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+    for (w = 1; w <= test_workers; w++)
+        pthread_join(threads[w], NULL);
+}
+
+static void check_each_item_once(uint32_t n)
+{
+    uint32_t i;
+
+    for (i = 0; i < n; i++)
+        ck_assert_uint_eq(item_runs[i], 1);
+    for (; i < TEST_MAX_ITEMS; i++)
+        ck_assert_uint_eq(item_runs[i], 0);
+}
+
+START_TEST(test_mp_all_workers)
+{
+    unsigned int w;
+
+    start_workers(4);
+    ck_assert_int_eq(wolfBoot_mp_run(count_item, (void *)item_runs, 37), 0);
+    check_each_item_once(37);
+    ck_assert_int_eq(items_off_boot, 1);
+    for (w = 1; w <= 4; w++) {
+        ck_assert_uint_eq(kicks[w], 1);
+        ck_assert_uint_eq(test_shared.mb[w - 1].done, test_shared.seq);
+    }
+    ck_assert_uint_eq(test_shared.offline, 0);
+    ck_assert_uint_eq(test_shared.active, 0);
+
+    /* A second job reuses the same workers */
+    memset((void *)item_runs, 0, sizeof(item_runs));
+    ck_assert_int_eq(wolfBoot_mp_run(count_item, (void *)item_runs, 12), 0);
+    check_each_item_once(12);
+    for (w = 1; w <= 4; w++)
+        ck_assert_uint_eq(kicks[w], 2);
+    stop_all_workers();
+}
+END_TEST
+
+START_TEST(test_mp_fewer_items_than_cores)
+{
+    start_workers(4);
+    ck_assert_int_eq(wolfBoot_mp_run(count_item, (void *)item_runs, 3), 0);
+    check_each_item_once(3);
+    /* Only two workers needed besides the boot core */
+    ck_assert_uint_eq(kicks[1], 1);
+    ck_assert_uint_eq(kicks[2], 1);
+    ck_assert_uint_eq(kicks[3], 0);
+    ck_assert_uint_eq(kicks[4], 0);
+
+    /* A single item stays on the boot core */
+    memset((void *)item_runs, 0, sizeof(item_runs));
+    ck_assert_int_eq(wolfBoot_mp_run(count_item, (void *)item_runs, 1), 0);
+    check_each_item_once(1);
+    ck_assert_uint_eq(kicks[1], 1);
+    stop_all_workers();
+}
+END_TEST
+
+START_TEST(test_mp_no_workers)
+{
+    start_workers(0);
+    ck_assert_int_eq(wolfBoot_mp_run(count_item, (void *)item_runs, 20), 0);
+    check_each_item_once(20);
+    ck_assert_int_eq(items_off_boot, 0);
+    ck_assert_uint_eq(test_shared.seq, 0);
+    stop_all_workers();
+}
+END_TEST
+
+START_TEST(test_mp_dead_worker_fallback)
+{
+    start_workers(3);
+    worker_dead[2] = 1;
+    ck_assert_int_eq(wolfBoot_mp_run(count_item, (void *)item_runs, 30), 0);
+    /* The boot core ran the share of worker 2 */
+    check_each_item_once(30);
+    ck_assert_uint_eq(test_shared.offline, 1U << 2);
+
+    /* Worker 2 is not used anymore */
+    memset((void *)item_runs, 0, sizeof(item_runs));
+    ck_assert_int_eq(wolfBoot_mp_run(count_item, (void *)item_runs, 30), 0);
+    check_each_item_once(30);
+    ck_assert_uint_eq(kicks[1], 2);
+    ck_assert_uint_eq(kicks[2], 1);
+    ck_assert_uint_eq(kicks[3], 2);
+    stop_all_workers();
+}
+END_TEST
+
+START_TEST(test_mp_all_dead_single_core)
+{
+    start_workers(2);
+    worker_dead[1] = 1;
+    worker_dead[2] = 1;
+    ck_assert_int_eq(wolfBoot_mp_run(count_item, (void *)item_runs, 9), 0);
+    check_each_item_once(9);
+    ck_assert_int_eq(items_off_boot, 0);
+    ck_assert_uint_eq(test_shared.offline, (1U << 1) | (1U << 2));
+    stop_all_workers();
+}
+END_TEST
+
+START_TEST(test_mp_item_failure)
+{
+    uint32_t i;
+
+    start_workers(4);
+    /* Fail one item in each lane in turn */
+    for (i = 0; i < 5; i++) {
+        memset((void *)item_runs, 0, sizeof(item_runs));
+        fail_item = (int)(10 + i);
+        ck_assert_int_eq(wolfBoot_mp_run(count_item, (void *)item_runs, 25),
+            -1);
+        check_each_item_once(25);
+    }
+    fail_item = -1;
+    memset((void *)item_runs, 0, sizeof(item_runs));
+    ck_assert_int_eq(wolfBoot_mp_run(count_item, (void *)item_runs, 25), 0);
+    ck_assert_int_eq(wolfBoot_mp_run(NULL, NULL, 25), -1);
+    stop_all_workers();
+}
+END_TEST
+
+START_TEST(test_mp_stale_mailbox_ignored)
+{
+    start_workers(1);
+    /* Nothing posted, or already acknowledged: no work */
+    ck_assert_int_eq(wolfBoot_mp_worker_poll(1), 0);
+    test_shared.mb[0].start = 5;
+    test_shared.mb[0].ack = 5;
+    ck_assert_int_eq(wolfBoot_mp_worker_poll(1), 0);
+    /* Posted but the job is over: reported as failed, nothing run */
+    test_shared.mb[0].start = 6;
+    test_shared.active = 0;
+    ck_assert_int_eq(wolfBoot_mp_worker_poll(1), 1);
+    ck_assert_int_eq(test_shared.mb[0].status, -1);
+    ck_assert_uint_eq(test_shared.mb[0].done, 6);
+    ck_assert_int_eq(wolfBoot_mp_worker_poll(0), 0);
+    ck_assert_int_eq(wolfBoot_mp_worker_poll(WOLFBOOT_MP_MAX_WORKERS + 1), 0);
+    check_each_item_once(0);
+    stop_all_workers();
+}
+END_TEST
+
+Suite *wolfboot_suite(void)
+{
+    Suite *s = suite_create("wolfBoot-mp-dispatch");
+    TCase *tc = tcase_create("mp-dispatch");
+
+    tcase_add_test(tc, test_mp_all_workers);
+    tcase_add_test(tc, test_mp_fewer_items_than_cores);
+    tcase_add_test(tc, test_mp_no_workers);
+    tcase_add_test(tc, test_mp_dead_worker_fallback);
+    tcase_add_test(tc, test_mp_all_dead_single_core);
+    tcase_add_test(tc, test_mp_item_failure);
+    tcase_add_test(tc, test_mp_stale_mailbox_ignored);
+    tcase_set_timeout(tc, 60);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main(void)
+{
+    int fails;
+    Suite *s = wolfboot_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    fails = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return fails;
+}
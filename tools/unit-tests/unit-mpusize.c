@@ -94,6 +94,57 @@ START_TEST(test_mpusize_encoding)
 }
 END_TEST
 
+#ifdef MPU_LAZY_XIP
+/* Checks that the planned regions are naturally aligned powers of two,
+ * contiguous, and cover [first, end) */
+static void check_lazy_plan(uint32_t first, uint32_t end)
+{
+    uint32_t addr = first, sz;
+    int i;
+
+    for (i = 0; i < mpu_lazy_count; i++) {
+        sz = 1U << ((mpu_lazy_rasr[i] >> 1) + 1);
+        ck_assert_uint_ge(sz, MPU_LAZY_MIN_REGION);
+        ck_assert_uint_eq(mpu_lazy_base[i], addr);
+        ck_assert_uint_eq(mpu_lazy_base[i] & (sz - 1), 0);
+        addr += sz;
+    }
+    ck_assert_uint_ge(addr, end);
+    ck_assert_uint_lt(addr - end, MPU_LAZY_MIN_REGION);
+}
+
+START_TEST(test_mpu_lazy_plan)
+{
+    /* Aligned range: a single region */
+    ck_assert_uint_eq(mpu_lazy_plan(0x08010000, 0x08020000, 8), 0x08010000);
+    ck_assert_int_eq(mpu_lazy_count, 1);
+    ck_assert_uint_eq(mpu_lazy_rasr[0], MPUSIZE_64K);
+    check_lazy_plan(0x08010000, 0x08020000);
+
+    /* Unaligned bounds, enough regions to start exactly there */
+    ck_assert_uint_eq(mpu_lazy_plan(0x08004120, 0x08011123, 16), 0x08004120);
+    check_lazy_plan(0x08004120, 0x08011123);
+
+    /* Fewer regions: the start moves up to a coarser alignment */
+    ck_assert_uint_eq(mpu_lazy_plan(0x08004120, 0x08011123, 3), 0x08010000);
+    ck_assert_int_le(mpu_lazy_count, 3);
+    check_lazy_plan(0x08010000, 0x08011123);
+
+    /* Start rounded up past the end, or no region at all */
+    ck_assert_uint_eq(mpu_lazy_plan(0x08000020, 0x08000040, 0), 0);
+    ck_assert_int_eq(mpu_lazy_count, 0);
+    ck_assert_uint_eq(mpu_lazy_plan(0x08000040, 0x08000020, 8), 0);
+    ck_assert_uint_eq(mpu_lazy_plan(0x08000021, 0x08000030, 8), 0);
+
+    /* Dropped before the next image is verified */
+    ck_assert_uint_eq(mpu_lazy_plan(0x08010000, 0x08020000, 8), 0x08010000);
+    ck_assert_int_eq(mpu_lazy_count, 1);
+    hal_lazy_xip_reset();
+    ck_assert_int_eq(mpu_lazy_count, 0);
+}
+END_TEST
+#endif
+
 Suite *mpusize_suite(void)
 {
     Suite *s = suite_create("mpusize");
@@ -103,6 +154,9 @@ Suite *mpusize_suite(void)
     tcase_add_test(tc, test_mpusize_above_64k_is_not_err);
     tcase_add_test(tc, test_mpusize_large_sizes_round_up);
     tcase_add_test(tc, test_mpusize_encoding);
+#ifdef MPU_LAZY_XIP
+    tcase_add_test(tc, test_mpu_lazy_plan);
+#endif
 
     suite_add_tcase(s, tc);
     return s;
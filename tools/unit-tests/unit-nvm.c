@@ -39,7 +39,33 @@
 
 Suite *wolfboot_suite(void);
 
+static void nvm_test_map(const char *name)
+{
+    char path[64];
+    int ret;
+
+    snprintf(path, sizeof(path), "/tmp/wolfboot-unit-%s.bin", name);
+    ret = mmap_file(path, (void *)MOCK_ADDRESS, WOLFBOOT_PARTITION_SIZE, NULL);
+    ck_assert(ret >= 0);
+#ifdef FLAGS_HOME
+    snprintf(path, sizeof(path), "/tmp/wolfboot-unit-%s-int.bin", name);
+    ret = mmap_file(path, (void *)MOCK_ADDRESS_BOOT, WOLFBOOT_PARTITION_SIZE,
+            NULL);
+    ck_assert(ret >= 0);
+#endif
+    snprintf(path, sizeof(path), "/tmp/wolfboot-unit-%s-swap.bin", name);
+    ret = mmap_file(path, (void *)MOCK_ADDRESS_SWAP, WOLFBOOT_SECTOR_SIZE,
+            NULL);
+    ck_assert(ret >= 0);
+}
+
+#ifdef FLAGS_HOME
+#define NVM_TEST_FLAGS_PART PART_BOOT
+#else
+#define NVM_TEST_FLAGS_PART PART_UPDATE
+#endif
 
+#ifndef NVM_FLASH_LOG
 START_TEST (test_nvm_select_fresh_sector)
 {
     int ret, i;
@@ -333,6 +359,163 @@ START_TEST(test_partition_magic_write_stops_on_flash_write_error)
 }
 END_TEST
 
+#endif /* !NVM_FLASH_LOG */
+
+/* Sector flag updates of a full swap: three transitions per sector. Each
+ * update costs two erases with the redundant two-sector trailer, the log
+ * only erases a sector when it is full. */
+START_TEST(test_nvm_trailer_erase_count)
+{
+    const int n_sectors = (WOLFBOOT_PARTITION_SIZE / WOLFBOOT_SECTOR_SIZE) - 2;
+    const uint8_t steps[3] = { SECT_FLAG_SWAPPING, SECT_FLAG_BACKUP,
+        SECT_FLAG_UPDATED };
+    int updates = 0;
+    int erases;
+    int i, j, ret;
+    uint8_t st;
+
+    nvm_test_map("erase-count");
+    wolfBoot_erase_partition(NVM_TEST_FLAGS_PART);
+    hal_flash_unlock();
+    wolfBoot_set_partition_state(PART_UPDATE, IMG_STATE_UPDATING);
+
+    erased_nvm_bank0 = 0;
+    erased_nvm_bank1 = 0;
+    for (i = 0; i < n_sectors; i++) {
+        for (j = 0; j < 3; j++) {
+            ret = wolfBoot_set_update_sector_flag(i, steps[j]);
+            ck_assert_int_eq(ret, 0);
+            updates++;
+        }
+    }
+    erases = erased_nvm_bank0 + erased_nvm_bank1;
+#ifdef NVM_FLASH_LOG
+    /* Initial log created by set_partition_state, then one compaction each
+     * time the free slots run out */
+    ck_assert_int_le(erases, 1 + (updates /
+            (NVM_LOG_SLOTS - 1 - (NVM_LOG_TRAILER_SIZE / 4))));
+    /* Drop the RAM mirror, as after a reboot */
+    memset(nvm_logs, 0, sizeof(nvm_logs));
+#else
+    ck_assert_int_ge(erases, 2 * updates);
+#endif
+    for (i = 0; i < n_sectors; i++) {
+        ret = wolfBoot_get_update_sector_flag(i, &st);
+        ck_assert_int_eq(ret, 0);
+        ck_assert_uint_eq(st, SECT_FLAG_UPDATED);
+    }
+    ret = wolfBoot_get_partition_state(PART_UPDATE, &st);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_uint_eq(st, IMG_STATE_UPDATING);
+    hal_flash_lock();
+}
+END_TEST
+
+#ifdef NVM_FLASH_LOG
+/* A compaction interrupted before its header is programmed must leave the
+ * previous generation active. */
+START_TEST(test_nvm_log_compaction_power_fail)
+{
+    struct nvm_log *log;
+    uintptr_t sector;
+    int area = nvm_log_area(PART_UPDATE);
+    int i, sel, ret;
+    uint8_t st;
+
+    nvm_test_map("log-powerfail");
+    wolfBoot_erase_partition(NVM_TEST_FLAGS_PART);
+    hal_flash_unlock();
+    wolfBoot_set_partition_state(PART_UPDATE, IMG_STATE_UPDATING);
+
+    /* Fill the active log, toggling sector 0 */
+    log = nvm_log_sync(PART_UPDATE);
+    sel = log->sel;
+    for (i = 0; log->next < NVM_LOG_SLOTS; i++) {
+        wolfBoot_set_update_sector_flag(0,
+            (i & 1) ? SECT_FLAG_SWAPPING : SECT_FLAG_BACKUP);
+    }
+    ret = wolfBoot_get_update_sector_flag(0, &st);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_uint_eq(st, (i & 1) ? SECT_FLAG_BACKUP : SECT_FLAG_SWAPPING);
+
+    /* The next update compacts into the other sector */
+    erased_nvm_bank0 = 0;
+    erased_nvm_bank1 = 0;
+    wolfBoot_set_update_sector_flag(0, SECT_FLAG_UPDATED);
+    log = nvm_log_sync(PART_UPDATE);
+    ck_assert_int_eq(log->sel, !sel);
+    ck_assert_int_eq(erased_nvm_bank0 + erased_nvm_bank1, 1);
+    ret = wolfBoot_get_update_sector_flag(0, &st);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_uint_eq(st, SECT_FLAG_UPDATED);
+
+    /* Power failure before the header write: erase the new header */
+    sector = nvm_log_sector(area, !sel);
+    memset((void *)sector, FLASH_BYTE_ERASED, NVM_LOG_RECORD_SIZE);
+    log = nvm_log_sync(PART_UPDATE);
+    ck_assert_int_eq(log->active, 1);
+    ck_assert_int_eq(log->sel, sel);
+    ret = wolfBoot_get_update_sector_flag(0, &st);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_uint_eq(st, (i & 1) ? SECT_FLAG_BACKUP : SECT_FLAG_SWAPPING);
+    ret = wolfBoot_get_partition_state(PART_UPDATE, &st);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_uint_eq(st, IMG_STATE_UPDATING);
+
+    /* A torn record at the end of the log is ignored */
+    hal_flash_lock();
+    wolfBoot_erase_partition(NVM_TEST_FLAGS_PART);
+    hal_flash_unlock();
+    wolfBoot_set_partition_state(PART_UPDATE, IMG_STATE_NEW);
+    wolfBoot_set_update_sector_flag(1, SECT_FLAG_SWAPPING);
+    log = nvm_log_sync(PART_UPDATE);
+    sector = nvm_log_sector(area, log->sel);
+    ((uint8_t *)sector)[log->next * NVM_LOG_RECORD_SIZE] = 0x00;
+    memset(nvm_logs, 0, sizeof(nvm_logs));
+    ret = wolfBoot_get_update_sector_flag(1, &st);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_uint_eq(st, SECT_FLAG_SWAPPING);
+    wolfBoot_set_update_sector_flag(1, SECT_FLAG_UPDATED);
+    memset(nvm_logs, 0, sizeof(nvm_logs));
+    ret = wolfBoot_get_update_sector_flag(1, &st);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_uint_eq(st, SECT_FLAG_UPDATED);
+    hal_flash_lock();
+}
+END_TEST
+
+START_TEST(test_nvm_log_update_trigger)
+{
+    int ret;
+    uint8_t st;
+
+    nvm_test_map("log-trigger");
+    wolfBoot_erase_partition(NVM_TEST_FLAGS_PART);
+    hal_flash_unlock();
+    wolfBoot_set_partition_state(PART_BOOT, IMG_STATE_SUCCESS);
+    wolfBoot_set_update_sector_flag(0, SECT_FLAG_UPDATED);
+    wolfBoot_set_update_sector_flag(3, SECT_FLAG_BACKUP);
+    hal_flash_lock();
+
+    wolfBoot_update_trigger();
+    ck_assert_msg(locked, "The FLASH was left unlocked.\n");
+
+    ret = wolfBoot_get_partition_state(PART_UPDATE, &st);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_uint_eq(st, IMG_STATE_UPDATING);
+    ret = wolfBoot_get_update_sector_flag(0, &st);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_uint_eq(st, SECT_FLAG_NEW);
+    ret = wolfBoot_get_update_sector_flag(3, &st);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_uint_eq(st, SECT_FLAG_NEW);
+    ret = wolfBoot_get_partition_state(PART_BOOT, &st);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_uint_eq(st, IMG_STATE_SUCCESS);
+}
+END_TEST
+#endif /* NVM_FLASH_LOG */
+
 START_TEST(test_get_update_sector_flag_rejects_invalid_magic)
 {
     int ret;
@@ -365,6 +548,8 @@ START_TEST(test_get_update_sector_flag_rejects_invalid_magic)
 }
 END_TEST
 
+#ifndef NVM_FLASH_LOG
+/* The sector flags of the log trailer are sized for the partition */
 START_TEST(test_update_sector_flag_high_index_does_not_alias_low_index)
 {
     int ret;
@@ -401,6 +586,7 @@ START_TEST(test_update_sector_flag_high_index_does_not_alias_low_index)
     hal_flash_lock();
 }
 END_TEST
+#endif
 
 
 Suite *wolfboot_suite(void)
@@ -410,13 +596,23 @@ Suite *wolfboot_suite(void)
 
     /* Test cases */
     TCase *nvm_select_fresh_sector = tcase_create("NVM select fresh sector");
+#ifndef NVM_FLASH_LOG
     tcase_add_test(nvm_select_fresh_sector, test_nvm_select_fresh_sector);
     tcase_add_test(nvm_select_fresh_sector,
             test_partition_magic_write_stops_on_flash_write_error);
+#endif
     tcase_add_test(nvm_select_fresh_sector,
             test_get_update_sector_flag_rejects_invalid_magic);
+#ifndef NVM_FLASH_LOG
     tcase_add_test(nvm_select_fresh_sector,
             test_update_sector_flag_high_index_does_not_alias_low_index);
+#endif
+    tcase_add_test(nvm_select_fresh_sector, test_nvm_trailer_erase_count);
+#ifdef NVM_FLASH_LOG
+    tcase_add_test(nvm_select_fresh_sector,
+            test_nvm_log_compaction_power_fail);
+    tcase_add_test(nvm_select_fresh_sector, test_nvm_log_update_trigger);
+#endif
     suite_add_tcase(s, nvm_select_fresh_sector);
 
     return s;
@@ -62,6 +62,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <time.h>
 
 #define MOCK_ADDRESS 0xCF000000
 uint8_t *vault_base = (uint8_t *)MOCK_ADDRESS;
@@ -72,6 +73,9 @@ uint8_t *vault_base = (uint8_t *)MOCK_ADDRESS;
 char vault_path[64] = "/tmp/wolfboot-unit-keyvault.bin";
 #include "unit-keystore.c"
 #include "pkcs11_store.c"
+#ifdef WOLFBOOT_KEYVAULT_LOG
+#include "keyvault_log.c"
+#endif
 const uint32_t keyvault_size = KEYVAULT_OBJ_SIZE * KEYVAULT_MAX_ITEMS + 2 * WOLFBOOT_SECTOR_SIZE;
 #include "unit-mock-flash.c"
 
@@ -158,6 +162,7 @@ START_TEST (test_store_and_load_objs) {
     ck_assert_msg(store != NULL, "Did not receive a store address for vault");
     fprintf(stderr, "open 2 successful\n");
     ret = wolfPKCS11_Store_Write(store, secret1, strlen(secret1) + 1);
+    wolfPKCS11_Store_Close(store);
 
     id_tok = 3;
     id_obj = 23;
@@ -197,6 +202,7 @@ START_TEST (test_store_and_load_objs) {
     ret = wolfPKCS11_Store_Open(type, id_tok, id_obj, readonly, &store);
     ck_assert_msg(ret != 0, "Returned with success with invalid type %d", type);
 
+#ifndef WOLFBOOT_KEYVAULT_LOG
     /* Test backup recovery for allocation table */
     memset(vault_base, 0xEE, WOLFBOOT_SECTOR_SIZE);
     type = DYNAMIC_TYPE_RSA;
@@ -226,6 +232,7 @@ START_TEST (test_store_and_load_objs) {
     ck_assert(ret == strlen(secret2) + 1);
     ck_assert(strcmp(secret2, secret_rd) == 0);
     wolfPKCS11_Store_Close(store);
+#endif
 
     /* Test with very large payload */
     type = DYNAMIC_TYPE_RSA;
@@ -285,6 +292,7 @@ START_TEST (test_store_and_load_objs) {
 }
 END_TEST
 
+#ifndef WOLFBOOT_KEYVAULT_LOG
 START_TEST(test_cross_sector_write_preserves_length)
 {
     const int type = DYNAMIC_TYPE_RSA;
@@ -504,32 +512,422 @@ START_TEST(test_shorter_overwrite_erases_residual_key_material)
 }
 END_TEST
 
+#endif /* !WOLFBOOT_KEYVAULT_LOG */
+
+#ifdef WOLFBOOT_KEYVAULT_LOG
+static void log_put(int type, CK_ULONG id_tok, CK_ULONG id_obj,
+    const void *data, int len)
+{
+    void *store = NULL;
+    int ret;
+
+    ret = wolfPKCS11_Store_Open(type, id_tok, id_obj, 0, &store);
+    ck_assert_int_eq(ret, 0);
+    ret = wolfPKCS11_Store_Write(store, (unsigned char *)data, len);
+    ck_assert_int_eq(ret, len);
+    wolfPKCS11_Store_Close(store);
+}
+
+static int log_get(int type, CK_ULONG id_tok, CK_ULONG id_obj, void *data,
+    int len)
+{
+    void *store = NULL;
+    int ret;
+
+    ret = wolfPKCS11_Store_Open(type, id_tok, id_obj, 1, &store);
+    if (ret != 0)
+        return ret;
+    ret = wolfPKCS11_Store_Read(store, data, len);
+    wolfPKCS11_Store_Close(store);
+    return ret;
+}
+
+static void log_check(int type, CK_ULONG id_tok, CK_ULONG id_obj,
+    const void *data, int len)
+{
+    unsigned char rd[KEYVAULT_OBJ_SIZE];
+    ck_assert_int_eq(log_get(type, id_tok, id_obj, rd, sizeof(rd)), len);
+    ck_assert_mem_eq(rd, data, len);
+}
+
+START_TEST(test_log_remount)
+{
+    const int type = DYNAMIC_TYPE_ECC;
+    char secret1[] = "Everyone gets Friday off.";
+    char secret2[] = "This is just a test string.";
+    unsigned char rd[64];
+    int ret;
+
+    ret = mmap_file(vault_path, vault_base, keyvault_size, NULL);
+    ck_assert_int_eq(ret, 0);
+    memset(vault_base, 0xEE, keyvault_size);
+
+    log_put(type, 1, 1, secret1, sizeof(secret1));
+    log_put(type, 1, 2, secret2, sizeof(secret2));
+    log_put(type, 2, 1, secret1, sizeof(secret1));
+    log_put(type, 1, 1, secret2, sizeof(secret2));
+    ck_assert_int_eq(wolfPKCS11_Store_Remove(type, 1, 2), 0);
+
+    /* The RAM index is rebuilt from flash */
+    kv_log_unmount();
+    log_check(type, 1, 1, secret2, sizeof(secret2));
+    log_check(type, 2, 1, secret1, sizeof(secret1));
+    ck_assert_int_eq(log_get(type, 1, 2, rd, sizeof(rd)), NOT_AVAILABLE_E);
+    ck_assert_int_eq(wolfPKCS11_Store_Remove(type, 1, 2), NOT_AVAILABLE_E);
+
+    /* Sequence numbers continue after the remount */
+    log_put(type, 1, 1, secret1, sizeof(secret1));
+    log_put(type, 1, 2, secret1, sizeof(secret1));
+    kv_log_unmount();
+    log_check(type, 1, 1, secret1, sizeof(secret1));
+    log_check(type, 1, 2, secret1, sizeof(secret1));
+}
+END_TEST
+
+/* Leave the vault as if the power was lost while a new version was being
+ * appended: only the first 'programmed' bytes of its record reached the
+ * flash, and the previous version was not scrubbed yet. */
+static void log_put_interrupted(int type, CK_ULONG id_tok, CK_ULONG id_obj,
+    const void *data, int len, uint32_t programmed)
+{
+    uint8_t *before = malloc(keyvault_size);
+    struct kv_entry *e;
+
+    ck_assert_ptr_nonnull(before);
+    memcpy(before, vault_base, keyvault_size);
+    log_put(type, id_tok, id_obj, data, len);
+    e = kv_index_find(type, id_tok, id_obj);
+    ck_assert_ptr_nonnull(e);
+    memcpy(before + e->off, vault_base + e->off, programmed);
+    memcpy(vault_base, before, keyvault_size);
+    free(before);
+    kv_log_unmount();
+}
+
+START_TEST(test_log_power_fail)
+{
+    const int type = DYNAMIC_TYPE_RSA;
+    unsigned char v1[300], v2[300], v3[300];
+    int ret;
+
+    memset(v1, 0x11, sizeof(v1));
+    memset(v2, 0x22, sizeof(v2));
+    memset(v3, 0x33, sizeof(v3));
+    ret = mmap_file(vault_path, vault_base, keyvault_size, NULL);
+    ck_assert_int_eq(ret, 0);
+    memset(vault_base, 0xEE, keyvault_size);
+
+    log_put(type, 5, 5, v1, sizeof(v1));
+
+    /* Failed flash write while closing: the previous version stays */
+    hal_flash_write_fail = 1;
+    log_put(type, 5, 5, v2, sizeof(v2));
+    log_check(type, 5, 5, v1, sizeof(v1));
+    kv_log_unmount();
+    log_check(type, 5, 5, v1, sizeof(v1));
+
+    /* Interrupted before the commit slot */
+    log_put_interrupted(type, 5, 5, v2, sizeof(v2),
+        KV_REC_SIZE + KV_ALIGN_UP(sizeof(v2)));
+    log_check(type, 5, 5, v1, sizeof(v1));
+
+    /* Interrupted while programming the payload */
+    log_put_interrupted(type, 5, 5, v2, sizeof(v2), KV_REC_SIZE + 100);
+    log_check(type, 5, 5, v1, sizeof(v1));
+
+    /* Torn record header: the rest of the block is not used any more */
+    log_put_interrupted(type, 5, 5, v2, sizeof(v2), 8);
+    log_check(type, 5, 5, v1, sizeof(v1));
+
+    /* The vault is still writable */
+    log_put(type, 5, 5, v3, sizeof(v3));
+    kv_log_unmount();
+    log_check(type, 5, 5, v3, sizeof(v3));
+}
+END_TEST
+
+START_TEST(test_log_gc)
+{
+    const int type = DYNAMIC_TYPE_RSA;
+    struct keyvault_log_stats st;
+    unsigned char obj[3][1000];
+    unsigned char cold[500];
+    unsigned char gone[200];
+    unsigned char rd[16];
+    int i, ret;
+
+    ret = mmap_file(vault_path, vault_base, keyvault_size, NULL);
+    ck_assert_int_eq(ret, 0);
+    memset(vault_base, 0xEE, keyvault_size);
+
+    /* Never updated: moved by the wear leveling */
+    memset(cold, 0x55, sizeof(cold));
+    log_put(type, 8, 8, cold, sizeof(cold));
+    memset(gone, 0x77, sizeof(gone));
+    log_put(type, 9, 9, gone, sizeof(gone));
+    ck_assert_int_eq(wolfPKCS11_Store_Remove(type, 9, 9), 0);
+
+    /* Many times the size of the vault */
+    for (i = 0; i < 600; i++) {
+        memset(obj[i % 3], i & 0xFF, sizeof(obj[0]));
+        log_put(type, 1, i % 3, obj[i % 3], sizeof(obj[0]));
+    }
+    ck_assert_int_eq(keyvault_log_get_stats(&st), 0);
+    printf("keyvault_log: %u blocks of %u bytes, %u records, %u gc runs, "
+        "%u bytes moved, erase count %u..%u\n", st.blocks, st.block_size,
+        st.records, st.gc_runs, st.gc_bytes, st.min_erase_count,
+        st.max_erase_count);
+    ck_assert_uint_gt(st.gc_runs, 0);
+    ck_assert_uint_le(st.live_bytes, st.capacity);
+    /* Wear leveling: every block is reused */
+    ck_assert_uint_le(st.max_erase_count - st.min_erase_count,
+        KEYVAULT_LOG_WEAR_DELTA + 1);
+
+    ck_assert_uint_gt(st.gc_bytes, 0);
+
+    for (i = 0; i < 3; i++)
+        log_check(type, 1, i, obj[i], sizeof(obj[0]));
+    log_check(type, 8, 8, cold, sizeof(cold));
+    ck_assert_int_eq(log_get(type, 9, 9, rd, sizeof(rd)), NOT_AVAILABLE_E);
+    kv_log_unmount();
+    for (i = 0; i < 3; i++)
+        log_check(type, 1, i, obj[i], sizeof(obj[0]));
+    log_check(type, 8, 8, cold, sizeof(cold));
+    ck_assert_int_eq(log_get(type, 9, 9, rd, sizeof(rd)), NOT_AVAILABLE_E);
+}
+END_TEST
+
+START_TEST(test_log_full)
+{
+    const int type = DYNAMIC_TYPE_RSA;
+    void *store = NULL;
+    int i, n, ret;
+
+    ret = mmap_file(vault_path, vault_base, keyvault_size, NULL);
+    ck_assert_int_eq(ret, 0);
+    memset(vault_base, 0xEE, keyvault_size);
+
+    /* Objects of maximum size until the capacity is reached */
+    for (n = 0; n < KEYVAULT_MAX_ITEMS; n++) {
+        ret = wolfPKCS11_Store_Open(type, 3, n, 0, &store);
+        if (ret != 0) {
+            ck_assert_int_eq(ret, FIND_FULL_E);
+            break;
+        }
+        ret = wolfPKCS11_Store_Write(store, (unsigned char *)dante_filler,
+            KEYVAULT_OBJ_SIZE);
+        wolfPKCS11_Store_Close(store);
+        if (ret < 0)
+            break;
+        ck_assert_int_eq(ret, KEYVAULT_OBJ_SIZE - 8);
+    }
+    ck_assert_int_gt(n, 0);
+    for (i = 0; i < n; i++)
+        log_check(type, 3, i, dante_filler, KEYVAULT_OBJ_SIZE - 8);
+
+    /* Room again after a removal, also across a remount */
+    ck_assert_int_eq(wolfPKCS11_Store_Remove(type, 3, 0), 0);
+    kv_log_unmount();
+    log_put(type, 3, n, dante_filler, KEYVAULT_OBJ_SIZE - 8);
+    for (i = 1; i <= n; i++)
+        log_check(type, 3, i, dante_filler, KEYVAULT_OBJ_SIZE - 8);
+
+    /* Index full */
+    kv_log_unmount();
+    memset(vault_base, 0xEE, keyvault_size);
+    for (i = 0; i < KEYVAULT_MAX_ITEMS; i++)
+        log_put(type, 4, i, &i, sizeof(i));
+    ret = wolfPKCS11_Store_Open(type, 4, i, 0, &store);
+    ck_assert_int_eq(ret, FIND_FULL_E);
+}
+END_TEST
+
+START_TEST(test_log_handles)
+{
+    const int type = DYNAMIC_TYPE_RSA;
+    char secret1[] = "Everyone gets Friday off.";
+    char secret2[] = "This is just a test string.";
+    unsigned char rd[64];
+    void *wr = NULL, *wr2 = NULL, *rd1 = NULL;
+    int ret;
+
+    ret = mmap_file(vault_path, vault_base, keyvault_size, NULL);
+    ck_assert_int_eq(ret, 0);
+    memset(vault_base, 0xEE, keyvault_size);
+    log_put(type, 1, 1, secret1, sizeof(secret1));
+
+    /* One writer at a time; readers see the committed version */
+    ck_assert_int_eq(wolfPKCS11_Store_Open(type, 1, 1, 0, &wr), 0);
+    ck_assert_int_eq(wolfPKCS11_Store_Open(type, 1, 2, 0, &wr2),
+        SESSION_COUNT_E);
+    ck_assert_ptr_null(wr2);
+    ck_assert_int_eq(wolfPKCS11_Store_Open(type, 1, 1, 1, &rd1), 0);
+    ck_assert_int_eq(wolfPKCS11_Store_Write(wr, (unsigned char *)secret2,
+        sizeof(secret2)), sizeof(secret2));
+    ck_assert_int_eq(wolfPKCS11_Store_Read(rd1, rd, 4), 4);
+    ck_assert_mem_eq(rd, secret1, 4);
+    ck_assert_int_eq(wolfPKCS11_Store_Write(rd1, rd, 4), -1);
+    wolfPKCS11_Store_Close(wr);
+
+    /* Replaced while open for reading */
+    ck_assert_int_eq(wolfPKCS11_Store_Read(rd1, rd, 4), -1);
+    wolfPKCS11_Store_Close(rd1);
+    log_check(type, 1, 1, secret2, sizeof(secret2));
+
+    /* Opening for writing and closing truncates the object */
+    ck_assert_int_eq(wolfPKCS11_Store_Open(type, 1, 1, 0, &wr), 0);
+    wolfPKCS11_Store_Close(wr);
+    ck_assert_int_eq(log_get(type, 1, 1, rd, sizeof(rd)), 0);
+}
+END_TEST
+
+#ifdef KEYVAULT_LOG_SCRUB
+/* Superseded versions are overwritten with zeros: the old key must not be
+ * found anywhere in the vault. */
+START_TEST(test_log_scrub)
+{
+    const int type = DYNAMIC_TYPE_RSA;
+    unsigned char large_key[512];
+    unsigned char small_key[50];
+    uint32_t i, run = 0;
+    int ret;
+
+    memset(large_key, 0xAA, sizeof(large_key));
+    memset(small_key, 0xBB, sizeof(small_key));
+    ret = mmap_file(vault_path, vault_base, keyvault_size, NULL);
+    ck_assert_int_eq(ret, 0);
+    memset(vault_base, 0xEE, keyvault_size);
+
+    log_put(type, 42, 84, large_key, sizeof(large_key));
+    log_put(type, 42, 84, small_key, sizeof(small_key));
+    log_put(type, 42, 85, large_key, sizeof(large_key));
+    ck_assert_int_eq(wolfPKCS11_Store_Remove(type, 42, 85), 0);
+
+    for (i = 0; i < keyvault_size; i++) {
+        run = (vault_base[i] == 0xAA) ? run + 1 : 0;
+        ck_assert_msg(run < 16, "Residual key material at vault offset %u",
+            i);
+    }
+    kv_log_unmount();
+    log_check(type, 42, 84, small_key, sizeof(small_key));
+}
+END_TEST
+#endif
+#endif /* WOLFBOOT_KEYVAULT_LOG */
+
+#define STORE_METRICS_UPDATES 300
+
+/* Flash erases and speed of repeated updates of one object, e.g. a token
+ * changing its state. */
+START_TEST(test_update_metrics)
+{
+    const int type = DYNAMIC_TYPE_RSA;
+    unsigned char key[256], rd[256];
+    struct timespec t0, t1;
+    double elapsed;
+    void *store = NULL;
+    int erases, i, ret;
+
+    ret = mmap_file(vault_path, vault_base, keyvault_size, NULL);
+    ck_assert_int_eq(ret, 0);
+    memset(vault_base, 0xEE, keyvault_size);
+    memset(key, 0x5A, sizeof(key));
+
+    /* Formatting the vault is not counted */
+    ret = wolfPKCS11_Store_Open(type, 1, 1, 0, &store);
+    ck_assert_int_eq(ret, 0);
+    ret = wolfPKCS11_Store_Write(store, key, sizeof(key));
+    ck_assert_int_eq(ret, sizeof(key));
+    wolfPKCS11_Store_Close(store);
+
+    erased_vault_sectors = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < STORE_METRICS_UPDATES; i++) {
+        key[0] = (unsigned char)i;
+        ret = wolfPKCS11_Store_Open(type, 1, 1, 0, &store);
+        ck_assert_int_eq(ret, 0);
+        ret = wolfPKCS11_Store_Write(store, key, sizeof(key));
+        ck_assert_int_eq(ret, sizeof(key));
+        wolfPKCS11_Store_Close(store);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    erases = erased_vault_sectors;
+    elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    ret = wolfPKCS11_Store_Open(type, 1, 1, 1, &store);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_int_eq(wolfPKCS11_Store_Read(store, rd, sizeof(rd)), sizeof(rd));
+    ck_assert_mem_eq(rd, key, sizeof(key));
+    wolfPKCS11_Store_Close(store);
+
+    printf("pkcs11_store: %d updates of %d bytes: %d sector erases "
+        "(%.2f per update), %.0f updates/s\n", STORE_METRICS_UPDATES,
+        (int)sizeof(key), erases, (double)erases / STORE_METRICS_UPDATES,
+        elapsed > 0 ? STORE_METRICS_UPDATES / elapsed : 0.0);
+#ifdef WOLFBOOT_KEYVAULT_LOG
+    /* A block is erased once for many records */
+    ck_assert_int_lt(erases, STORE_METRICS_UPDATES);
+#endif
+}
+END_TEST
+
 Suite *wolfboot_suite(void)
 {
     /* Suite initialization */
     Suite *s = suite_create("wolfBoot-pkcs11-store");
 
     TCase* tcase_store_and_load_objs = tcase_create("store_and_load_objs");
+    TCase* tcase_metrics = tcase_create("update_metrics");
+#ifndef WOLFBOOT_KEYVAULT_LOG
     TCase* tcase_cross_sector_write = tcase_create("cross_sector_write");
     TCase* tcase_close = tcase_create("close_state");
     TCase* tcase_delete_object = tcase_create("delete_object");
     TCase* tcase_delete_corrupted = tcase_create("delete_corrupted_pos");
     TCase* tcase_find_bounds = tcase_create("find_bounds");
     TCase* tcase_remanence = tcase_create("shorter_overwrite_erases_residual");
+#else
+    TCase* tcase_log_remount = tcase_create("log_remount");
+    TCase* tcase_log_power_fail = tcase_create("log_power_fail");
+    TCase* tcase_log_gc = tcase_create("log_gc");
+    TCase* tcase_log_full = tcase_create("log_full");
+    TCase* tcase_log_handles = tcase_create("log_handles");
+#ifdef KEYVAULT_LOG_SCRUB
+    TCase* tcase_log_scrub = tcase_create("log_scrub");
+#endif
+#endif
     tcase_add_test(tcase_store_and_load_objs, test_store_and_load_objs);
+    tcase_add_test(tcase_metrics, test_update_metrics);
+    suite_add_tcase(s, tcase_store_and_load_objs);
+    suite_add_tcase(s, tcase_metrics);
+#ifndef WOLFBOOT_KEYVAULT_LOG
     tcase_add_test(tcase_cross_sector_write, test_cross_sector_write_preserves_length);
     tcase_add_test(tcase_close, test_close_clears_handle_state);
     tcase_add_test(tcase_delete_object, test_delete_object_ignores_metadata_prefix);
     tcase_add_test(tcase_delete_corrupted, test_delete_object_corrupted_pos_no_oob);
     tcase_add_test(tcase_find_bounds, test_find_object_search_stops_at_header_sector);
     tcase_add_test(tcase_remanence, test_shorter_overwrite_erases_residual_key_material);
-    suite_add_tcase(s, tcase_store_and_load_objs);
     suite_add_tcase(s, tcase_cross_sector_write);
     suite_add_tcase(s, tcase_close);
     suite_add_tcase(s, tcase_delete_object);
     suite_add_tcase(s, tcase_delete_corrupted);
     suite_add_tcase(s, tcase_find_bounds);
     suite_add_tcase(s, tcase_remanence);
+#else
+    tcase_add_test(tcase_log_remount, test_log_remount);
+    tcase_add_test(tcase_log_power_fail, test_log_power_fail);
+    tcase_add_test(tcase_log_gc, test_log_gc);
+    tcase_add_test(tcase_log_full, test_log_full);
+    tcase_add_test(tcase_log_handles, test_log_handles);
+    suite_add_tcase(s, tcase_log_remount);
+    suite_add_tcase(s, tcase_log_power_fail);
+    suite_add_tcase(s, tcase_log_gc);
+    suite_add_tcase(s, tcase_log_full);
+    suite_add_tcase(s, tcase_log_handles);
+#ifdef KEYVAULT_LOG_SCRUB
+    tcase_add_test(tcase_log_scrub, test_log_scrub);
+    suite_add_tcase(s, tcase_log_scrub);
+#endif
+#endif
     return s;
 }
 
@@ -45,13 +45,18 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <time.h>
 
 #define MOCK_ADDRESS 0xCF000000
 uint8_t *vault_base = (uint8_t *)MOCK_ADDRESS;
 #include "psa_store.c"
+#ifdef WOLFBOOT_KEYVAULT_LOG
+#include "keyvault_log.c"
+#endif
 const uint32_t keyvault_size = KEYVAULT_OBJ_SIZE * KEYVAULT_MAX_ITEMS + 2 * WOLFBOOT_SECTOR_SIZE;
 #include "unit-mock-flash.c"
 
+#ifndef WOLFBOOT_KEYVAULT_LOG
 START_TEST(test_cross_sector_write_preserves_length)
 {
     enum { type = WOLFPSA_STORE_KEY };
@@ -290,9 +295,116 @@ START_TEST(test_cache_commit_zeroizes_cached_sector)
 }
 END_TEST
 
+#endif /* !WOLFBOOT_KEYVAULT_LOG */
+
+#ifdef WOLFBOOT_KEYVAULT_LOG
+START_TEST(test_log_store_and_remount)
+{
+    enum { type = WOLFPSA_STORE_KEY };
+    unsigned char key1[100], key2[40], rd[128];
+    void *store = NULL;
+    int ret;
+
+    memset(key1, 0x11, sizeof(key1));
+    memset(key2, 0x22, sizeof(key2));
+    ret = mmap_file("/tmp/wolfboot-unit-psa-keyvault.bin", vault_base,
+        keyvault_size, NULL);
+    ck_assert_int_eq(ret, 0);
+    memset(vault_base, 0xEE, keyvault_size);
+
+    ret = wolfPSA_Store_OpenSz(type, 1, 2, 0, sizeof(key1), &store);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_int_eq(wolfPSA_Store_Write(store, key1, sizeof(key1)),
+        sizeof(key1));
+    wolfPSA_Store_Close(store);
+    ret = wolfPSA_Store_Open(type, 1, 3, 0, &store);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_int_eq(wolfPSA_Store_Write(store, key1, sizeof(key1)),
+        sizeof(key1));
+    wolfPSA_Store_Close(store);
+
+    /* Shorter replacement, then removal of the other object */
+    ret = wolfPSA_Store_Open(type, 1, 2, 0, &store);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_int_eq(wolfPSA_Store_Write(store, key2, sizeof(key2)),
+        sizeof(key2));
+    wolfPSA_Store_Close(store);
+    ck_assert_int_eq(wolfPSA_Store_Remove(type, 1, 3), 0);
+    ck_assert_int_eq(wolfPSA_Store_Remove(type, 1, 3), NOT_AVAILABLE_E);
+
+    kv_log_unmount();
+    ret = wolfPSA_Store_Open(type, 1, 2, 1, &store);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_int_eq(wolfPSA_Store_Read(store, rd, sizeof(rd)), sizeof(key2));
+    ck_assert_mem_eq(rd, key2, sizeof(key2));
+    wolfPSA_Store_Close(store);
+    ret = wolfPSA_Store_Open(type, 1, 3, 1, &store);
+    ck_assert_int_eq(ret, NOT_AVAILABLE_E);
+}
+END_TEST
+#endif
+
+#define STORE_METRICS_UPDATES 300
+
+/* Flash erases and speed of repeated updates of one key */
+START_TEST(test_update_metrics)
+{
+    enum { type = WOLFPSA_STORE_KEY };
+    unsigned char key[256], rd[256];
+    struct timespec t0, t1;
+    double elapsed;
+    void *store = NULL;
+    int erases, i, ret;
+
+    ret = mmap_file("/tmp/wolfboot-unit-psa-keyvault.bin", vault_base,
+        keyvault_size, NULL);
+    ck_assert_int_eq(ret, 0);
+    memset(vault_base, 0xEE, keyvault_size);
+    memset(key, 0xA5, sizeof(key));
+
+    /* Formatting the vault is not counted */
+    ret = wolfPSA_Store_Open(type, 1, 1, 0, &store);
+    ck_assert_int_eq(ret, 0);
+    ret = wolfPSA_Store_Write(store, key, sizeof(key));
+    ck_assert_int_eq(ret, sizeof(key));
+    wolfPSA_Store_Close(store);
+
+    erased_vault_sectors = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < STORE_METRICS_UPDATES; i++) {
+        key[0] = (unsigned char)i;
+        ret = wolfPSA_Store_Open(type, 1, 1, 0, &store);
+        ck_assert_int_eq(ret, 0);
+        ret = wolfPSA_Store_Write(store, key, sizeof(key));
+        ck_assert_int_eq(ret, sizeof(key));
+        wolfPSA_Store_Close(store);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    erases = erased_vault_sectors;
+    elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    ret = wolfPSA_Store_Open(type, 1, 1, 1, &store);
+    ck_assert_int_eq(ret, 0);
+    ck_assert_int_eq(wolfPSA_Store_Read(store, rd, sizeof(rd)), sizeof(rd));
+    ck_assert_mem_eq(rd, key, sizeof(key));
+    wolfPSA_Store_Close(store);
+
+    printf("psa_store: %d updates of %d bytes: %d sector erases "
+        "(%.2f per update), %.0f updates/s\n", STORE_METRICS_UPDATES,
+        (int)sizeof(key), erases, (double)erases / STORE_METRICS_UPDATES,
+        elapsed > 0 ? STORE_METRICS_UPDATES / elapsed : 0.0);
+#ifdef WOLFBOOT_KEYVAULT_LOG
+    /* A block is erased once for many records */
+    ck_assert_int_lt(erases, STORE_METRICS_UPDATES);
+#endif
+}
+END_TEST
+
 Suite *wolfboot_suite(void)
 {
     Suite *s = suite_create("wolfBoot-psa-store");
+    TCase *tcase_metrics = tcase_create("update_metrics");
+#ifndef WOLFBOOT_KEYVAULT_LOG
     TCase *tcase_write = tcase_create("cross_sector_write");
     TCase *tcase_close = tcase_create("close_state");
     TCase *tcase_delete = tcase_create("delete_object");
@@ -315,6 +427,14 @@ Suite *wolfboot_suite(void)
     suite_add_tcase(s, tcase_find_bounds);
     suite_add_tcase(s, tcase_tail);
     suite_add_tcase(s, tcase_zeroize);
+#else
+    TCase *tcase_log = tcase_create("log_store_and_remount");
+
+    tcase_add_test(tcase_log, test_log_store_and_remount);
+    suite_add_tcase(s, tcase_log);
+#endif
+    tcase_add_test(tcase_metrics, test_update_metrics);
+    suite_add_tcase(s, tcase_metrics);
     return s;
 }
 
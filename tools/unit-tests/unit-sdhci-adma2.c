@@ -0,0 +1,389 @@
+/* unit-sdhci-adma2.c
+ *
+ * ADMA2 multi-block reads: disk_read() must move the block-aligned body of
+ * a request with CMD18 + ADMA2 descriptor tables (64KB per descriptor, one
+ * command per table), leave the unaligned head/tail to the CPU bounce
+ * buffer, and fall back to SDMA when the controller reports an ADMA error
+ * or has no ADMA2 support. A buffer above 4GB cannot be described: with
+ * SDHCI_FORCE_SINGLE_BLOCK_READ (unit-sdhci-adma2-single) it must be read
+ * with CMD17s, never with a plain CMD18.
+ *
+ * The register mock walks the descriptor table like the controller would
+ * and copies from a host "disk". Built with -no-pie so the static buffers
+ * and the descriptor table are 32-bit DMA addressable.
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#define DISK_SDCARD 1
+#define SDHCI_ADMA2 1
+/* Small table so a 300KB read needs more than one CMD18 */
+#define SDHCI_ADMA2_MAX_DESC 4
+
+#include <check.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "sdhci.h"
+
+#define MOCK_DISK_SIZE (512U * 1024U)
+
+static uint32_t mock_regs[0x260 / sizeof(uint32_t)];
+static uint8_t mock_disk[MOCK_DISK_SIZE];
+static uint8_t out_buf[320U * 1024U] __attribute__((aligned(4)));
+
+struct transfer_state {
+    int active;
+    uint32_t block_addr;
+    uint32_t word_index;
+};
+static struct transfer_state xfer;
+
+/* Observed controller activity */
+static int cmd17_count;
+static int adma2_count;
+static int sdma_count;
+static int adma2_desc_seen;
+static int adma2_bad_desc;
+static int adma2_inject_error;
+
+uint64_t hal_get_timer_us(void)
+{
+    static uint64_t now;
+    return ++now;
+}
+
+uint32_t sdhci_reg_read(uint32_t offset)
+{
+    if (offset == SDHCI_SRS08 && xfer.active) {
+        uint32_t pos = xfer.block_addr * SDHCI_BLOCK_SIZE +
+            (xfer.word_index * 4);
+        uint32_t val;
+
+        memcpy(&val, &mock_disk[pos], sizeof(val));
+        xfer.word_index++;
+        return val;
+    }
+    return mock_regs[offset / sizeof(uint32_t)];
+}
+
+static uint64_t mock_dma_addr(void)
+{
+    return ((uint64_t)mock_regs[SDHCI_SRS23 / sizeof(uint32_t)] << 32) |
+        mock_regs[SDHCI_SRS22 / sizeof(uint32_t)];
+}
+
+/* ADMA2 32-bit descriptor as the controller sees it */
+struct mock_adma2_desc {
+    uint16_t attr;
+    uint16_t len;
+    uint32_t addr;
+};
+
+/* Walk the ADMA2 table and copy from the disk; returns bytes moved */
+static uint32_t mock_adma2_run(uint32_t block_addr)
+{
+    const struct mock_adma2_desc *d =
+        (const struct mock_adma2_desc *)(uintptr_t)mock_dma_addr();
+    uint32_t pos = block_addr * SDHCI_BLOCK_SIZE;
+    uint32_t moved = 0;
+    int n;
+
+    for (n = 0; n < SDHCI_ADMA2_MAX_DESC; n++) {
+        uint32_t len = (d[n].len == 0) ? 0x10000U : d[n].len;
+        if ((d[n].attr & SDHCI_ADMA2_ATTR_VALID) == 0 ||
+            (d[n].attr & 0x30U) != SDHCI_ADMA2_ATTR_ACT_TRAN ||
+            pos + len > MOCK_DISK_SIZE) {
+            adma2_bad_desc++;
+            break;
+        }
+        memcpy((void *)(uintptr_t)d[n].addr, &mock_disk[pos], len);
+        pos += len;
+        moved += len;
+        adma2_desc_seen++;
+        if (d[n].attr & SDHCI_ADMA2_ATTR_END) {
+            break;
+        }
+    }
+    return moved;
+}
+
+void sdhci_reg_write(uint32_t offset, uint32_t val)
+{
+    uint32_t *reg = &mock_regs[offset / sizeof(uint32_t)];
+
+    if (offset == SDHCI_SRS11) {
+        *reg = val | (val & SDHCI_SRS11_ICE ? SDHCI_SRS11_ICS : 0);
+        *reg &= ~SDHCI_SRS11_RESET_DAT_CMD;
+        return;
+    }
+    if (offset == SDHCI_SRS12) {
+        *reg &= ~val;
+        return;
+    }
+
+    *reg = val;
+
+    if (offset == SDHCI_SRS03) {
+        uint32_t *srs12 = &mock_regs[SDHCI_SRS12 / sizeof(uint32_t)];
+        uint32_t block_addr = mock_regs[SDHCI_SRS02 / sizeof(uint32_t)];
+        uint32_t blocks = mock_regs[SDHCI_SRS01 / sizeof(uint32_t)] >>
+            SDHCI_SRS01_BCCT_SHIFT;
+
+        if ((val & SDHCI_SRS03_DPS) && (val & SDHCI_SRS03_DMAE)) {
+            uint32_t dma = mock_regs[SDHCI_SRS10 / sizeof(uint32_t)] &
+                SDHCI_SRS10_DMA_MASK;
+            if (dma == SDHCI_SRS10_DMA_ADMA2) {
+                adma2_count++;
+                if (adma2_inject_error) {
+                    adma2_inject_error = 0;
+                    *srs12 |= SDHCI_SRS12_EADMA | SDHCI_SRS12_EINT;
+                    return;
+                }
+                if (mock_adma2_run(block_addr) != blocks * SDHCI_BLOCK_SIZE) {
+                    *srs12 |= SDHCI_SRS12_EADMA | SDHCI_SRS12_EINT;
+                    return;
+                }
+            }
+            else {
+                sdma_count++;
+                memcpy((void *)(uintptr_t)mock_dma_addr(),
+                    &mock_disk[block_addr * SDHCI_BLOCK_SIZE],
+                    blocks * SDHCI_BLOCK_SIZE);
+            }
+            *srs12 |= SDHCI_SRS12_TC;
+        }
+        else if (val & SDHCI_SRS03_DPS) {
+            if ((val >> SDHCI_SRS03_CIDX_SHIFT) == MMC_CMD17_READ_SINGLE) {
+                cmd17_count++;
+            }
+            xfer.active = 1;
+            xfer.block_addr = block_addr;
+            xfer.word_index = 0;
+            *srs12 |= SDHCI_SRS12_BRR | SDHCI_SRS12_TC;
+        }
+        else {
+            mock_regs[SDHCI_SRS04 / sizeof(uint32_t)] = (1U << 8);
+            *srs12 |= SDHCI_SRS12_CC;
+        }
+    }
+}
+
+void sdhci_platform_init(void)
+{
+}
+
+void sdhci_platform_irq_init(void)
+{
+}
+
+void sdhci_platform_set_bus_mode(int is_emmc)
+{
+    (void)is_emmc;
+}
+
+#include "../../src/sdhci.c"
+
+static void reset_mock_state(int adma2)
+{
+    uint32_t i;
+
+    memset(mock_regs, 0, sizeof(mock_regs));
+    memset(&xfer, 0, sizeof(xfer));
+    memset(out_buf, 0, sizeof(out_buf));
+    for (i = 0; i < sizeof(mock_disk); i++) {
+        mock_disk[i] = (uint8_t)((i * 7) ^ (i >> 9));
+    }
+    cmd17_count = 0;
+    adma2_count = 0;
+    sdma_count = 0;
+    adma2_desc_seen = 0;
+    adma2_bad_desc = 0;
+    adma2_inject_error = 0;
+    g_adma2_enabled = adma2;
+}
+
+START_TEST(test_adma2_descriptor_split)
+{
+    uint32_t n;
+    uintptr_t base = (uintptr_t)out_buf;
+
+    reset_mock_state(1);
+
+    /* 200KB: three full 64KB descriptors (length 0) and an 8KB one */
+    n = sdhci_adma2_build((uint32_t *)out_buf, 200U * 1024U);
+    ck_assert_uint_eq(n, 4);
+    ck_assert_uint_eq(g_adma2_desc[0].len, 0);
+    ck_assert_uint_eq(g_adma2_desc[1].len, 0);
+    ck_assert_uint_eq(g_adma2_desc[2].len, 0);
+    ck_assert_uint_eq(g_adma2_desc[3].len, 8U * 1024U);
+    for (n = 0; n < 4; n++) {
+        ck_assert_uint_eq(g_adma2_desc[n].addr,
+            (uint32_t)(base + n * SDHCI_ADMA2_DESC_MAX_LEN));
+        ck_assert_uint_eq(g_adma2_desc[n].attr & SDHCI_ADMA2_ATTR_END,
+            (n == 3) ? SDHCI_ADMA2_ATTR_END : 0);
+        ck_assert(g_adma2_desc[n].attr & SDHCI_ADMA2_ATTR_VALID);
+    }
+
+    /* Not describable: unaligned buffer, larger than the table */
+    ck_assert_uint_eq(sdhci_adma2_build((uint32_t *)(out_buf + 2), 4096), 0);
+    ck_assert_uint_eq(sdhci_adma2_build((uint32_t *)out_buf,
+        (SDHCI_ADMA2_MAX_DESC + 1) * SDHCI_ADMA2_DESC_MAX_LEN), 0);
+}
+END_TEST
+
+START_TEST(test_disk_read_adma2_unaligned)
+{
+    const uint32_t start = 100;
+    const uint32_t len = 300U * 1024U;
+
+    reset_mock_state(1);
+
+    ck_assert_int_eq(disk_read(0, start, len, out_buf), 0);
+    ck_assert_mem_eq(out_buf, &mock_disk[start], len);
+
+    /* 412-byte head and 100-byte tail through CMD17 + bounce buffer, the
+     * 599 blocks between in two CMD18s (256KB table limit + remainder) */
+    ck_assert_int_eq(cmd17_count, 2);
+    ck_assert_int_eq(adma2_count, 2);
+    ck_assert_int_eq(sdma_count, 0);
+    ck_assert_int_eq(adma2_desc_seen, 4 + 1);
+    ck_assert_int_eq(adma2_bad_desc, 0);
+    ck_assert_uint_eq(mock_regs[SDHCI_SRS10 / sizeof(uint32_t)] &
+        SDHCI_SRS10_DMA_MASK, SDHCI_SRS10_DMA_ADMA2);
+    ck_assert_uint_eq(mock_regs[SDHCI_SRS22 / sizeof(uint32_t)],
+        (uint32_t)(uintptr_t)g_adma2_desc);
+    ck_assert_int_eq(g_adma2_enabled, 1);
+}
+END_TEST
+
+#ifndef SDHCI_FORCE_SINGLE_BLOCK_READ
+START_TEST(test_adma2_error_falls_back_to_sdma)
+{
+    const uint32_t len = 64U * 1024U;
+
+    reset_mock_state(1);
+    adma2_inject_error = 1;
+
+    ck_assert_int_eq(disk_read(0, 0, len, out_buf), 0);
+    ck_assert_mem_eq(out_buf, mock_disk, len);
+    ck_assert_int_eq(adma2_count, 1);
+    ck_assert_int_eq(sdma_count, 1);
+    ck_assert_int_eq(g_adma2_enabled, 0);
+    ck_assert_uint_eq(mock_regs[SDHCI_SRS10 / sizeof(uint32_t)] &
+        SDHCI_SRS10_DMA_MASK, SDHCI_SRS10_DMA_SDMA);
+
+    /* Later reads stay on SDMA */
+    ck_assert_int_eq(disk_read(0, len, len, out_buf), 0);
+    ck_assert_mem_eq(out_buf, &mock_disk[len], len);
+    ck_assert_int_eq(adma2_count, 1);
+    ck_assert_int_eq(sdma_count, 2);
+}
+END_TEST
+
+START_TEST(test_no_adma2_support_uses_sdma)
+{
+    const uint32_t len = 32U * 1024U;
+
+    reset_mock_state(0);
+
+    ck_assert_int_eq(disk_read(0, SDHCI_BLOCK_SIZE, len, out_buf), 0);
+    ck_assert_mem_eq(out_buf, &mock_disk[SDHCI_BLOCK_SIZE], len);
+    ck_assert_int_eq(adma2_count, 0);
+    ck_assert_int_eq(sdma_count, 1);
+}
+END_TEST
+#else
+START_TEST(test_adma2_error_falls_back_to_single_block)
+{
+    const uint32_t len = 64U * 1024U;
+
+    reset_mock_state(1);
+    adma2_inject_error = 1;
+
+    ck_assert_int_eq(disk_read(0, 0, len, out_buf), 0);
+    ck_assert_mem_eq(out_buf, mock_disk, len);
+    ck_assert_int_eq(adma2_count, 1);
+    ck_assert_int_eq(sdma_count, 0);
+    ck_assert_int_eq(cmd17_count, len / SDHCI_BLOCK_SIZE);
+    ck_assert_int_eq(g_adma2_enabled, 0);
+}
+END_TEST
+#endif
+
+/* Destination above 4GB: no descriptor table can reach it */
+START_TEST(test_adma2_buffer_not_describable)
+{
+    const uint32_t len = 64U * 1024U;
+    uint8_t *high = mmap((void *)(uintptr_t)0x200000000ULL, len,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+    ck_assert_ptr_eq(high, (void *)(uintptr_t)0x200000000ULL);
+    reset_mock_state(1);
+
+    ck_assert_int_eq(disk_read(0, 0, len, high), 0);
+    ck_assert_mem_eq(high, mock_disk, len);
+    ck_assert_int_eq(adma2_count, 0);
+#ifdef SDHCI_FORCE_SINGLE_BLOCK_READ
+    /* Not a plain CMD18 through SDMA/PIO: the single block reads */
+    ck_assert_int_eq(sdma_count, 0);
+    ck_assert_int_eq(cmd17_count, len / SDHCI_BLOCK_SIZE);
+#else
+    ck_assert_int_eq(sdma_count, 1);
+    ck_assert_int_eq(cmd17_count, 0);
+#endif
+    /* ADMA2 stays enabled for the buffers it can reach */
+    ck_assert_int_eq(g_adma2_enabled, 1);
+    munmap(high, len);
+}
+END_TEST
+
+Suite *sdhci_adma2_suite(void)
+{
+    Suite *s = suite_create("sdhci-adma2");
+    TCase *tc = tcase_create("adma2");
+
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_adma2_descriptor_split);
+    tcase_add_test(tc, test_disk_read_adma2_unaligned);
+#ifndef SDHCI_FORCE_SINGLE_BLOCK_READ
+    tcase_add_test(tc, test_adma2_error_falls_back_to_sdma);
+    tcase_add_test(tc, test_no_adma2_support_uses_sdma);
+#else
+    tcase_add_test(tc, test_adma2_error_falls_back_to_single_block);
+#endif
+    tcase_add_test(tc, test_adma2_buffer_not_describable);
+    suite_add_tcase(s, tc);
+
+    return s;
+}
+
+int main(void)
+{
+    int fails;
+    SRunner *sr = srunner_create(sdhci_adma2_suite());
+
+    srunner_run_all(sr, CK_NORMAL);
+    fails = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return fails;
+}
@@ -0,0 +1,390 @@
+/* unit-spi-flash-sfdp.c
+ *
+ * Unit tests for the SFDP discovery (src/sfdp.c) and its use in
+ * spi_flash.c: a software SPI NOR model exposes a JESD216 table, the driver
+ * must erase with the largest block that fits and read with FAST_READ.
+ *
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#define SPI_FLASH
+#define SPI_FLASH_SFDP
+
+#include <check.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "spi_flash.c"
+#include "hal.h"
+
+/* SPI NOR model: 1 MB, 256 B pages, 4 KB / 32 KB / 64 KB erase */
+#define NOR_SIZE        (1024 * 1024)
+#define NOR_PAGE        256
+#define NOR_SFDP_SIZE   0x80
+
+static uint8_t nor[NOR_SIZE];
+static uint8_t nor_sfdp[NOR_SFDP_SIZE];
+static int nor_has_sfdp;
+static int nor_wel;
+static int nor_cs;
+static uint8_t nor_cmd;
+static int nor_pos;         /* bytes received since CS */
+static uint32_t nor_addr;
+static uint8_t nor_out;
+static int erase_4k, erase_32k, erase_64k, chip_erases;
+static int reads_slow, reads_fast, sfdp_reads;
+static uint32_t erased_lo, erased_hi;
+
+static void nor_put32(uint32_t off, uint32_t v)
+{
+    nor_sfdp[off] = (uint8_t)v;
+    nor_sfdp[off + 1] = (uint8_t)(v >> 8);
+    nor_sfdp[off + 2] = (uint8_t)(v >> 16);
+    nor_sfdp[off + 3] = (uint8_t)(v >> 24);
+}
+
+static void nor_sfdp_table(void)
+{
+    memset(nor_sfdp, 0xFF, sizeof(nor_sfdp));
+    /* Header: "SFDP", rev 1.6, 2 parameter headers */
+    nor_put32(0x00, SFDP_SIGNATURE);
+    nor_put32(0x04, 0xFF010106);
+    /* BFPT rev 1.0, 9 DWORDs, at 0x60 (garbage: superseded by rev 1.6) */
+    nor_put32(0x08, 0x09010000);
+    nor_put32(0x0C, 0xFF000060);
+    /* BFPT rev 1.6, 16 DWORDs, at 0x20 */
+    nor_put32(0x10, 0x10010600);
+    nor_put32(0x14, 0xFF000020);
+    /* 4 KB erase 20h, 3-byte address, 1-1-2, 1-2-2, 1-4-4, 1-1-4 */
+    nor_put32(0x20, 0x00712001 | (1UL << 22));
+    nor_put32(0x24, NOR_SIZE * 8 - 1);
+    nor_put32(0x28, 0x6B08EB44); /* 1-1-4: 6Bh, 8; 1-4-4: EBh, 2 + 4 */
+    nor_put32(0x2C, 0xBB403B08); /* 1-2-2: BBh, 2 + 0; 1-1-2: 3Bh, 8 */
+    nor_put32(0x30, 0);
+    nor_put32(0x34, 0);
+    nor_put32(0x38, 0);
+    /* erase types, unsorted: 64 KB D8h, 4 KB 20h, 32 KB 52h */
+    nor_put32(0x3C, 0x200CD810);
+    nor_put32(0x40, 0x0000520F);
+    nor_put32(0x44, 0);
+    nor_put32(0x48, 0x00000080); /* 256 B pages */
+    nor_put32(0x4C, 0);
+    nor_put32(0x50, 0);
+    nor_put32(0x54, 0);
+    nor_put32(0x58, 0x00400000); /* QER 4 */
+    nor_put32(0x5C, 0);
+}
+
+static void nor_reset(int has_sfdp)
+{
+    memset(nor, 0xFF, sizeof(nor));
+    nor_sfdp_table();
+    nor_has_sfdp = has_sfdp;
+    nor_wel = 0;
+    nor_cs = 0;
+    erase_4k = erase_32k = erase_64k = chip_erases = 0;
+    reads_slow = reads_fast = sfdp_reads = 0;
+    erased_lo = 0xFFFFFFFF;
+    erased_hi = 0;
+}
+
+static void nor_erase(uint32_t size)
+{
+    uint32_t a = nor_addr & ~(size - 1);
+
+    ck_assert_msg(nor_wel, "erase without WREN");
+    ck_assert_msg(a + size <= NOR_SIZE, "erase out of range");
+    memset(nor + a, 0xFF, size);
+    if (a < erased_lo)
+        erased_lo = a;
+    if (a + size > erased_hi)
+        erased_hi = a + size;
+    nor_wel = 0;
+}
+
+void spi_init(int polarity, int phase)
+{
+    (void)polarity;
+    (void)phase;
+}
+
+void spi_release(void)
+{
+}
+
+void spi_cs_on(uint32_t base, int pin)
+{
+    (void)base;
+    (void)pin;
+    nor_cs = 1;
+    nor_pos = 0;
+    nor_addr = 0;
+    nor_out = 0xFF;
+}
+
+void spi_cs_off(uint32_t base, int pin)
+{
+    (void)base;
+    (void)pin;
+    if (nor_pos == 4) {
+        switch (nor_cmd) {
+            case 0x20:
+                erase_4k++;
+                nor_erase(4096);
+                break;
+            case 0x52:
+                erase_32k++;
+                nor_erase(32 * 1024);
+                break;
+            case 0xD8:
+                erase_64k++;
+                nor_erase(64 * 1024);
+                break;
+        }
+    }
+    if (nor_pos > 4 && nor_cmd == BYTE_WRITE)
+        nor_wel = 0;
+    nor_cs = 0;
+}
+
+void spi_write(const char byte)
+{
+    uint8_t b = (uint8_t)byte;
+    int pos = nor_pos++;
+
+    ck_assert_msg(nor_cs, "SPI write without CS asserted");
+    nor_out = 0xFF;
+    if (pos == 0) {
+        nor_cmd = b;
+        switch (b) {
+            case WREN:
+                nor_wel = 1;
+                break;
+            case WRDI:
+                nor_wel = 0;
+                break;
+            case CHIP_ERASE:
+                ck_assert_msg(nor_wel, "erase without WREN");
+                memset(nor, 0xFF, sizeof(nor));
+                chip_erases++;
+                nor_wel = 0;
+                break;
+            case BYTE_READ:
+                reads_slow++;
+                break;
+            case FAST_READ:
+                reads_fast++;
+                break;
+            case SFDP_READ_CMD:
+                sfdp_reads++;
+                break;
+        }
+        return;
+    }
+    switch (nor_cmd) {
+        case MDID:
+            nor_out = (pos == 1) ? 0xEF : 0x40;
+            return;
+        case RDSR:
+            nor_out = nor_wel ? ST_WEL : 0;
+            return;
+        case WRSR:
+            return;
+    }
+    if (pos <= 3) {
+        nor_addr = (nor_addr << 8) | b;
+        return;
+    }
+    switch (nor_cmd) {
+        case BYTE_READ:
+            nor_out = nor[nor_addr++ % NOR_SIZE];
+            break;
+        case FAST_READ:
+            if (pos > 4)
+                nor_out = nor[nor_addr++ % NOR_SIZE];
+            break;
+        case SFDP_READ_CMD:
+            if (pos > 4) {
+                if (nor_has_sfdp && nor_addr < NOR_SFDP_SIZE)
+                    nor_out = nor_sfdp[nor_addr];
+                nor_addr++;
+            }
+            break;
+        case BYTE_WRITE:
+            ck_assert_msg(nor_wel, "program without WREN");
+            /* page program wraps within the page */
+            nor[(nor_addr & ~(NOR_PAGE - 1)) |
+                ((nor_addr + pos - 4) & (NOR_PAGE - 1))] &= b;
+            break;
+    }
+}
+
+uint8_t spi_read(void)
+{
+    return nor_out;
+}
+
+START_TEST(test_sfdp_parse)
+{
+    nor_reset(1);
+    ck_assert_int_eq(sfdp_probe(spi_flash_sfdp_read, &sfdp), 0);
+    ck_assert_uint_eq(sfdp.size, NOR_SIZE);
+    ck_assert_uint_eq(sfdp.page_size, 256);
+    ck_assert_uint_eq(sfdp.addr_bytes, 3);
+    ck_assert_uint_eq(sfdp.quad_enable, 4);
+    ck_assert_uint_eq(sfdp.n_erase, 3);
+    ck_assert_uint_eq(sfdp.erase[0].size, 4096);
+    ck_assert_uint_eq(sfdp.erase[0].opcode, 0x20);
+    ck_assert_uint_eq(sfdp.erase[1].size, 32 * 1024);
+    ck_assert_uint_eq(sfdp.erase[1].opcode, 0x52);
+    ck_assert_uint_eq(sfdp.erase[2].size, 64 * 1024);
+    ck_assert_uint_eq(sfdp.erase[2].opcode, 0xD8);
+    ck_assert_uint_eq(sfdp.read[SFDP_READ_1_4_4].opcode, 0xEB);
+    ck_assert_uint_eq(sfdp.read[SFDP_READ_1_4_4].mode, 2);
+    ck_assert_uint_eq(sfdp.read[SFDP_READ_1_4_4].dummy, 4);
+    ck_assert_uint_eq(sfdp.read[SFDP_READ_1_1_4].opcode, 0x6B);
+    ck_assert_uint_eq(sfdp.read[SFDP_READ_1_1_4].dummy, 8);
+    ck_assert_uint_eq(sfdp.read[SFDP_READ_1_2_2].opcode, 0xBB);
+    ck_assert_uint_eq(sfdp.read[SFDP_READ_1_1_2].opcode, 0x3B);
+
+    /* JESD216 rev 1.0 table: 9 DWORDs, 4 KB erase from DWORD 1 only */
+    nor_put32(0x04, 0xFF000100);
+    nor_put32(0x0C, 0xFF000020);
+    nor_put32(0x3C, 0);
+    nor_put32(0x40, 0);
+    ck_assert_int_eq(sfdp_probe(spi_flash_sfdp_read, &sfdp), 0);
+    ck_assert_uint_eq(sfdp.n_erase, 1);
+    ck_assert_uint_eq(sfdp.erase[0].size, 4096);
+    ck_assert_uint_eq(sfdp.page_size, 256);
+    ck_assert_uint_eq(sfdp.quad_enable, 0);
+
+    /* No signature */
+    nor_reset(0);
+    ck_assert_int_eq(sfdp_probe(spi_flash_sfdp_read, &sfdp), -1);
+}
+END_TEST
+
+START_TEST(test_sfdp_erase_blocks)
+{
+    nor_reset(1);
+    spi_flash_probe();
+    ck_assert_int_eq(sfdp_found, 1);
+
+    /* aligned 1 MB: 16 block erases instead of 256 sector erases */
+    memset(nor, 0, sizeof(nor));
+    ck_assert_int_eq(spi_flash_erase(0, NOR_SIZE), 0);
+    ck_assert_int_eq(erase_64k, 16);
+    ck_assert_int_eq(erase_32k, 0);
+    ck_assert_int_eq(erase_4k, 0);
+    ck_assert_uint_eq(nor[0], 0xFF);
+    ck_assert_uint_eq(nor[NOR_SIZE - 1], 0xFF);
+
+    /* [0x3000, 0x2B000): 4 KB up to 0x8000, 32 KB up to 0x10000,
+     * 64 KB blocks, 32 KB and 4 KB at the end */
+    nor_reset(1);
+    memset(nor, 0, sizeof(nor));
+    ck_assert_int_eq(ext_flash_erase(0x3000, 0x28000), 0);
+    ck_assert_int_eq(erase_4k, 5 + 3);
+    ck_assert_int_eq(erase_32k, 2);
+    ck_assert_int_eq(erase_64k, 1);
+    ck_assert_uint_eq(erased_lo, 0x3000);
+    ck_assert_uint_eq(erased_hi, 0x2B000);
+    ck_assert_uint_eq(nor[0x2FFF], 0x00);
+    ck_assert_uint_eq(nor[0x3000], 0xFF);
+    ck_assert_uint_eq(nor[0x2AFFF], 0xFF);
+    ck_assert_uint_eq(nor[0x2B000], 0x00);
+
+    /* unaligned bounds: the sectors touched are erased */
+    nor_reset(1);
+    ck_assert_int_eq(spi_flash_erase(0x10100, 0x100), 0);
+    ck_assert_int_eq(erase_4k, 1);
+    ck_assert_uint_eq(erased_lo, 0x10000);
+    ck_assert_uint_eq(erased_hi, 0x11000);
+}
+END_TEST
+
+START_TEST(test_sfdp_fast_read)
+{
+    uint8_t buf[600], out[600];
+    unsigned i;
+
+    nor_reset(1);
+    spi_flash_probe();
+    for (i = 0; i < sizeof(buf); i++)
+        buf[i] = (uint8_t)(i * 7 + 1);
+    ck_assert_int_eq(spi_flash_erase(0x20000, 0x1000), 0);
+    ck_assert_int_eq(spi_flash_write(0x200F0, buf, sizeof(buf)), 0);
+    reads_slow = reads_fast = 0;
+    ck_assert_int_eq(spi_flash_read(0x200F0, out, sizeof(out)), sizeof(out));
+    ck_assert_int_eq(reads_fast, 1);
+    ck_assert_int_eq(reads_slow, 0);
+    ck_assert_mem_eq(out, buf, sizeof(buf));
+    ck_assert_uint_eq(nor[0x200EF], 0xFF);
+    ck_assert_uint_eq(nor[0x200F0 + sizeof(buf)], 0xFF);
+}
+END_TEST
+
+START_TEST(test_sfdp_not_found)
+{
+    uint8_t buf[32], out[32];
+
+    nor_reset(0);
+    spi_flash_probe();
+    ck_assert_int_eq(sfdp_found, 0);
+    ck_assert_int_ge(sfdp_reads, 1);
+
+    /* fallback: sector erases and READ (03h) */
+    ck_assert_int_eq(spi_flash_erase(0x10000, 0x10000), 0);
+    ck_assert_int_eq(erase_4k, 16);
+    ck_assert_int_eq(erase_64k, 0);
+    memset(buf, 0x5A, sizeof(buf));
+    ck_assert_int_eq(spi_flash_write(0x10000, buf, sizeof(buf)), 0);
+    ck_assert_int_eq(spi_flash_read(0x10000, out, sizeof(out)), sizeof(out));
+    ck_assert_int_eq(reads_slow, 1);
+    ck_assert_int_eq(reads_fast, 0);
+    ck_assert_mem_eq(out, buf, sizeof(buf));
+}
+END_TEST
+
+Suite *wolfboot_suite(void)
+{
+    Suite *s = suite_create("wolfBoot-spi-flash-sfdp");
+    TCase *tc = tcase_create("spi-flash-sfdp");
+
+    tcase_add_test(tc, test_sfdp_parse);
+    tcase_add_test(tc, test_sfdp_erase_blocks);
+    tcase_add_test(tc, test_sfdp_fast_read);
+    tcase_add_test(tc, test_sfdp_not_found);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main(void)
+{
+    int fails;
+    Suite *s = wolfboot_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    fails = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return fails;
+}
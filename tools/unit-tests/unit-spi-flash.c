@@ -55,6 +55,8 @@ static uint8_t manuf_id;
 static uint8_t product_id;
 static int read_armed;
 static int spi_release_called;
+static int program_cmds;
+static int read_cmds;
 
 #define MOCK_FLASH_SIZE (4 * 1024)
 static uint8_t mock_flash[MOCK_FLASH_SIZE];
@@ -77,6 +79,8 @@ static void reset_spi_mock(int expected_len)
     product_id = 0x00;
     read_armed = 0;
     spi_release_called = 0;
+    program_cmds = 0;
+    read_cmds = 0;
     memset(mock_flash, 0xFF, sizeof(mock_flash));
 }
 
@@ -121,6 +125,10 @@ void spi_write(const char byte)
 
     if (phase == SPI_PHASE_CMD) {
         current_cmd = (uint8_t)byte;
+        if (current_cmd == BYTE_WRITE)
+            program_cmds++;
+        if (current_cmd == BYTE_READ)
+            read_cmds++;
         if (current_cmd == BYTE_WRITE || current_cmd == BYTE_READ ||
                 current_cmd == SECTOR_ERASE) {
             phase = SPI_PHASE_ADDR;
@@ -251,6 +259,25 @@ START_TEST(test_write_page_exact_to_boundary)
 }
 END_TEST
 
+START_TEST(test_bulk_transactions)
+{
+    static uint8_t buf[MOCK_FLASH_SIZE];
+    static uint8_t out[MOCK_FLASH_SIZE];
+    int i;
+
+    for (i = 0; i < (int)sizeof(buf); i++)
+        buf[i] = (uint8_t)(i * 13 + 7);
+    reset_spi_mock(sizeof(buf));
+
+    /* one page program per page, one read for the whole range */
+    ck_assert_int_eq(spi_flash_write(0, buf, sizeof(buf)), 0);
+    ck_assert_int_eq(program_cmds, MOCK_FLASH_SIZE / SPI_FLASH_PAGE_SIZE);
+    ck_assert_int_eq(spi_flash_read(0, out, sizeof(out)), (int)sizeof(out));
+    ck_assert_int_eq(read_cmds, 1);
+    ck_assert_int_eq(0, memcmp(out, buf, sizeof(buf)));
+}
+END_TEST
+
 START_TEST(test_write_len_zero_returns_error)
 {
     uint8_t buf[4];
@@ -357,6 +384,7 @@ Suite *spi_flash_suite(void)
     tcase_add_test(tcase_write, test_write_page_exact_to_boundary);
     tcase_add_test(tcase_write, test_write_singlebyte_mode);
     tcase_add_test(tcase_read, test_read_basic);
+    tcase_add_test(tcase_read, test_bulk_transactions);
     tcase_add_test(tcase_erase, test_sector_erase_aligns_address);
     tcase_add_test(tcase_erase, test_chip_erase_command);
     tcase_add_test(tcase_errors, test_write_len_zero_returns_error);
@@ -204,7 +204,20 @@ int wolfBoot_open_image_address(struct wolfBoot_image* img, uint8_t* image)
     return 0;
 }
 
-int wolfBoot_verify_integrity(struct wolfBoot_image* img)
+int wolfBoot_image_hash_start(struct wolfBoot_image* img)
+{
+    (void)img;
+    return 0;
+}
+
+int wolfBoot_image_hash_update(struct wolfBoot_image* img, uint32_t len)
+{
+    (void)img;
+    (void)len;
+    return 0;
+}
+
+int wolfBoot_image_hash_verify(struct wolfBoot_image* img)
 {
     img->sha_ok = 1;
     return 0;
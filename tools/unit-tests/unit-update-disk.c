@@ -9,6 +9,8 @@
 #define BOOT_PART_A 0
 #define BOOT_PART_B 1
 #define MOCK_ADDRESS_BOOT 0xCD000000
+/* Several chunks per payload, to exercise the load/decrypt/hash pipeline */
+#define DISK_BLOCK_SIZE 16
 
 #include <stdio.h>
 #include <stdint.h>
@@ -35,6 +37,10 @@ static int mock_do_boot_called;
 static const uint32_t *mock_boot_address;
 static int mock_fail_payload_part;
 static int mock_verify_integrity_ret;
+static int mock_hash_started;
+static int mock_hash_updates;
+static uint32_t mock_hashed_len;
+static uint8_t mock_hashed[TEST_PAYLOAD_SIZE];
 static int mock_verify_authenticity_ret;
 
 ChaCha chacha;
@@ -81,6 +87,10 @@ static void reset_mocks(void)
     mock_boot_address = NULL;
     mock_fail_payload_part = -1;
     mock_verify_integrity_ret = 0;
+    mock_hash_started = 0;
+    mock_hash_updates = 0;
+    mock_hashed_len = 0;
+    memset(mock_hashed, 0, sizeof(mock_hashed));
     mock_verify_authenticity_ret = 0;
     mock_flash_protect_called = 0;
     mock_flash_protect_addr = 0;
@@ -179,11 +189,34 @@ int wolfBoot_open_image_address(struct wolfBoot_image* img, uint8_t* image)
     return 0;
 }
 
-int wolfBoot_verify_integrity(struct wolfBoot_image* img)
+int wolfBoot_image_hash_start(struct wolfBoot_image* img)
 {
-    if (mock_verify_integrity_ret == 0)
+    (void)img;
+    mock_hash_started++;
+    mock_hash_updates = 0;
+    mock_hashed_len = 0;
+    return 0;
+}
+
+/* Record what the loader hands to the digest: it must be the decrypted
+ * payload, already in RAM at fw_base, in order. */
+int wolfBoot_image_hash_update(struct wolfBoot_image* img, uint32_t len)
+{
+    if ((len > img->fw_size - mock_hashed_len) ||
+            (len > sizeof(mock_hashed) - mock_hashed_len))
+        return -1;
+    memcpy(mock_hashed + mock_hashed_len, img->fw_base + mock_hashed_len,
+        len);
+    mock_hashed_len += len;
+    mock_hash_updates++;
+    return 0;
+}
+
+int wolfBoot_image_hash_verify(struct wolfBoot_image* img)
+{
+    if ((mock_verify_integrity_ret == 0) && (mock_hashed_len == img->fw_size))
         img->sha_ok = 1;
-    return mock_verify_integrity_ret;
+    return (img->sha_ok == 1) ? 0 : -1;
 }
 
 int wolfBoot_verify_authenticity(struct wolfBoot_image* img)
@@ -409,6 +442,24 @@ START_TEST(test_update_disk_rejects_invalid_signature)
 }
 END_TEST
 
+START_TEST(test_update_disk_hashes_each_chunk_while_loading)
+{
+    reset_mocks();
+    build_image(part_a_image, 7, 0xA1);
+    build_image(part_b_image, 5, 0xB2);
+
+    wolfBoot_start();
+
+    ck_assert_int_eq(wolfBoot_panicked, 0);
+    ck_assert_int_eq(mock_do_boot_called, 1);
+    ck_assert_int_eq(mock_hash_started, 1);
+    ck_assert_int_eq(mock_hash_updates, TEST_PAYLOAD_SIZE / DISK_BLOCK_SIZE);
+    ck_assert_uint_eq(mock_hashed_len, TEST_PAYLOAD_SIZE);
+    ck_assert_int_eq(memcmp(mock_hashed, part_a_image + IMAGE_HEADER_SIZE,
+        TEST_PAYLOAD_SIZE), 0);
+}
+END_TEST
+
 Suite *wolfboot_suite(void)
 {
     Suite *s = suite_create("wolfBoot");
@@ -424,6 +475,7 @@ Suite *wolfboot_suite(void)
     tcase_add_test(tc, test_update_disk_rejects_rollback_after_higher_image_failure);
     tcase_add_test(tc, test_update_disk_rejects_invalid_integrity);
     tcase_add_test(tc, test_update_disk_rejects_invalid_signature);
+    tcase_add_test(tc, test_update_disk_hashes_each_chunk_while_loading);
     suite_add_tcase(s, tc);
 
     return s;
@@ -386,6 +386,84 @@ static int add_payload_type(uint8_t part, uint32_t version, uint32_t size,
 
 }
 
+#ifdef WOLFBOOT_IMG_CHUNKS
+/* Chunked image (sign --chunk-size): HDR_IMG_CHUNKS before the digest, the
+ * chunk table after the firmware, and the digest over header and table */
+#define CHUNKS_TLV_OFF_IN_HDR 24
+#define CHUNKED_DIGEST_TLV_OFF_IN_HDR 32
+static int add_payload_chunked(uint8_t part, uint32_t version, uint32_t size,
+    uint32_t chunk_sz)
+{
+    uint32_t word;
+    uint32_t magic = WOLFBOOT_MAGIC;
+    uint32_t size_img = host_to_img_u32(size);
+    uint32_t version_img = host_to_img_u32(version);
+    uint32_t chunk_sz_img = host_to_img_u32(chunk_sz);
+    uint16_t img_type_img = host_to_img_u16(HDR_IMG_TYPE_AUTH_NONE |
+        HDR_IMG_TYPE_APP);
+    uint8_t *base = (uint8_t *)(uintptr_t)WOLFBOOT_PARTITION_BOOT_ADDRESS;
+    uint32_t table = IMAGE_HEADER_SIZE + size;
+    uint32_t off, len;
+    int i;
+    wc_Sha256 sha;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+
+    if (part == PART_UPDATE)
+        base = (uint8_t *)(uintptr_t)WOLFBOOT_PARTITION_UPDATE_ADDRESS;
+    srandom(part);
+
+    hal_flash_unlock();
+    hal_flash_write((uintptr_t)base, (void *)&magic, 4);
+    hal_flash_write((uintptr_t)base + 4, (void *)&size_img, 4);
+    word = 4 << 16 | HDR_VERSION;
+    hal_flash_write((uintptr_t)base + 8, (void *)&word, 4);
+    hal_flash_write((uintptr_t)base + 12, (void *)&version_img, 4);
+    word = 2 << 16 | HDR_IMG_TYPE;
+    hal_flash_write((uintptr_t)base + 16, (void *)&word, 4);
+    hal_flash_write((uintptr_t)base + 20, (void *)&img_type_img, 2);
+    word = 4 << 16 | HDR_IMG_CHUNKS;
+    hal_flash_write((uintptr_t)base + CHUNKS_TLV_OFF_IN_HDR, (void *)&word, 4);
+    hal_flash_write((uintptr_t)base + CHUNKS_TLV_OFF_IN_HDR + 4,
+        (void *)&chunk_sz_img, 4);
+
+    for (i = IMAGE_HEADER_SIZE; i < (int)table; i += 4) {
+        word = (random() << 16) | random();
+        hal_flash_write((uintptr_t)base + i, (void *)&word, 4);
+    }
+
+    /* Chunk table */
+    for (off = 0; off < size; off += chunk_sz) {
+        len = size - off;
+        if (len > chunk_sz)
+            len = chunk_sz;
+        if ((wc_InitSha256_ex(&sha, NULL, INVALID_DEVID) != 0) ||
+                (wc_Sha256Update(&sha, base + IMAGE_HEADER_SIZE + off,
+                    len) != 0) ||
+                (wc_Sha256Final(&sha, digest) != 0))
+            return -1;
+        wc_Sha256Free(&sha);
+        hal_flash_write((uintptr_t)base + table +
+            (off / chunk_sz) * SHA256_DIGEST_SIZE, digest, SHA256_DIGEST_SIZE);
+    }
+
+    /* Image digest: header, then the chunk table */
+    if ((wc_InitSha256_ex(&sha, NULL, INVALID_DEVID) != 0) ||
+            (wc_Sha256Update(&sha, base, CHUNKED_DIGEST_TLV_OFF_IN_HDR) != 0) ||
+            (wc_Sha256Update(&sha, base + table,
+                ((size + chunk_sz - 1) / chunk_sz) * SHA256_DIGEST_SIZE) != 0) ||
+            (wc_Sha256Final(&sha, digest) != 0))
+        return -1;
+    wc_Sha256Free(&sha);
+    word = SHA256_DIGEST_SIZE << 16 | HDR_SHA256;
+    hal_flash_write((uintptr_t)base + CHUNKED_DIGEST_TLV_OFF_IN_HDR,
+        (void *)&word, 4);
+    hal_flash_write((uintptr_t)base + CHUNKED_DIGEST_TLV_OFF_IN_HDR + 4,
+        digest, SHA256_DIGEST_SIZE);
+    hal_flash_lock();
+    return 0;
+}
+#endif
+
 #ifdef RAM_CODE
 void arch_reboot(void)
 {
@@ -876,6 +954,34 @@ START_TEST (test_forward_update_samesize) {
 }
 END_TEST
 
+#ifdef WOLFBOOT_IMG_CHUNKS
+/* The chunk table of the update starts in the last sector of the firmware
+ * and ends in the next one: the swap must copy that sector too. */
+START_TEST (test_forward_update_chunked_table_spills_sector) {
+    uint32_t fw_size = 3 * WOLFBOOT_SECTOR_SIZE - IMAGE_HEADER_SIZE - 16;
+    struct wolfBoot_image boot;
+
+    reset_mock_stats();
+    prepare_flash();
+    add_payload(PART_BOOT, 1, 1000);
+    ck_assert_int_eq(add_payload_chunked(PART_UPDATE, 2, fw_size, 512), 0);
+    wolfBoot_update_trigger();
+    wolfBoot_start();
+    ck_assert(!wolfBoot_panicked);
+    ck_assert(wolfBoot_staged_ok);
+    ck_assert(wolfBoot_current_firmware_version() == 2);
+
+    memset(&boot, 0, sizeof(boot));
+    ck_assert_int_eq(wolfBoot_open_image(&boot, PART_BOOT), 0);
+    ck_assert_uint_eq(wolfBoot_image_chunks(&boot), 6);
+    ck_assert_uint_gt(wolfBoot_image_total_size(&boot),
+        3 * WOLFBOOT_SECTOR_SIZE);
+    ck_assert_int_eq(wolfBoot_verify_integrity(&boot), 0);
+    cleanup_flash();
+}
+END_TEST
+#endif
+
 /* A failing flash write must abort the swap instead of marking the sector as
  * updated: the sector flags are the only record used to resume an
  * interrupted swap. */
@@ -897,6 +1003,59 @@ START_TEST (test_update_aborts_on_sector_copy_failure) {
 }
 END_TEST
 
+#ifdef WOLFBOOT_SWAP_SKIP_UNCHANGED
+#define TEST_SKIP_PAYLOAD_LEN \
+    (TEST_SIZE_SMALL + IMAGE_HEADER_SIZE - WOLFBOOT_SECTOR_SIZE)
+
+/* Sectors holding the same bytes in BOOT and UPDATE are flagged as updated
+ * without being copied, so fewer BOOT sectors are erased. */
+START_TEST (test_update_skips_unchanged_sectors) {
+    static uint8_t payload[TEST_SKIP_PAYLOAD_LEN];
+    int erased_full;
+
+    /* Payload differs in every sector: all of them are swapped */
+    reset_mock_stats();
+    prepare_flash();
+    add_payload(PART_BOOT, 1, TEST_SIZE_SMALL);
+    add_payload(PART_UPDATE, 2, TEST_SIZE_SMALL);
+    memset(payload, 0x5A, sizeof(payload));
+    hal_flash_unlock();
+    hal_flash_write(WOLFBOOT_PARTITION_BOOT_ADDRESS + WOLFBOOT_SECTOR_SIZE,
+        payload, sizeof(payload));
+    hal_flash_lock();
+    wolfBoot_update_trigger();
+    clear_erase_stats();
+    wolfBoot_start();
+    ck_assert(!wolfBoot_panicked);
+    ck_assert(wolfBoot_current_firmware_version() == 2);
+    erased_full = erased_boot;
+    cleanup_flash();
+
+    /* Same payload past the header sector: only sector 0 is swapped */
+    reset_mock_stats();
+    prepare_flash();
+    add_payload(PART_BOOT, 1, TEST_SIZE_SMALL);
+    add_payload(PART_UPDATE, 2, TEST_SIZE_SMALL);
+    memcpy(payload,
+        (void *)(WOLFBOOT_PARTITION_UPDATE_ADDRESS + WOLFBOOT_SECTOR_SIZE),
+        sizeof(payload));
+    hal_flash_unlock();
+    hal_flash_write(WOLFBOOT_PARTITION_BOOT_ADDRESS + WOLFBOOT_SECTOR_SIZE,
+        payload, sizeof(payload));
+    hal_flash_lock();
+    wolfBoot_update_trigger();
+    clear_erase_stats();
+    wolfBoot_start();
+    ck_assert(!wolfBoot_panicked);
+    ck_assert(wolfBoot_staged_ok);
+    ck_assert(wolfBoot_current_firmware_version() == 2);
+    ck_assert_int_eq(erased_boot, erased_full - (TEST_SKIP_PAYLOAD_LEN +
+        WOLFBOOT_SECTOR_SIZE - 1) / WOLFBOOT_SECTOR_SIZE);
+    cleanup_flash();
+}
+END_TEST
+#endif
+
 START_TEST (test_forward_update_tolarger) {
     reset_mock_stats();
     prepare_flash();
@@ -1678,6 +1837,9 @@ Suite *wolfboot_suite(void)
     TCase *swap_resume = tcase_create("Swap resume noop");
     TCase *diffbase_version = tcase_create("Diffbase version lookup");
     TCase *get_total_size = tcase_create("Total size range");
+#ifdef WOLFBOOT_IMG_CHUNKS
+    TCase *forward_update_chunked = tcase_create("Forward update chunked");
+#endif
     TCase *boot_success = tcase_create("Boot success state");
 #ifdef DELTA_UPDATES
     TCase *delta_zero_size = tcase_create("Delta zero size");
@@ -1723,6 +1885,9 @@ Suite *wolfboot_suite(void)
     tcase_add_test(sunnyday_noupdate, test_sunnyday_noupdate);
     tcase_add_test(forward_update_samesize, test_forward_update_samesize);
     tcase_add_test(forward_update_samesize, test_update_aborts_on_sector_copy_failure);
+#ifdef WOLFBOOT_SWAP_SKIP_UNCHANGED
+    tcase_add_test(forward_update_samesize, test_update_skips_unchanged_sectors);
+#endif
     tcase_add_test(forward_update_tolarger, test_forward_update_tolarger);
     tcase_add_test(forward_update_tosmaller, test_forward_update_tosmaller);
     tcase_add_test(forward_update_sameversion_denied, test_forward_update_sameversion_denied);
@@ -1743,6 +1908,10 @@ Suite *wolfboot_suite(void)
     tcase_add_test(diffbase_version, test_diffbase_version_reads);
     tcase_add_test(diffbase_version, test_diffbase_version_reads_from_little_endian_bytes);
     tcase_add_test(get_total_size, test_get_total_size_preserves_uint32_range);
+#ifdef WOLFBOOT_IMG_CHUNKS
+    tcase_add_test(forward_update_chunked,
+        test_forward_update_chunked_table_spills_sector);
+#endif
     tcase_add_test(boot_success, test_boot_success_sets_state);
 #ifdef DELTA_UPDATES
     tcase_add_test(delta_zero_size, test_delta_zero_size_valid_header_rejected_without_recovery_heuristic);
@@ -1787,6 +1956,9 @@ Suite *wolfboot_suite(void)
     suite_add_tcase(s, swap_resume);
     suite_add_tcase(s, diffbase_version);
     suite_add_tcase(s, get_total_size);
+#ifdef WOLFBOOT_IMG_CHUNKS
+    suite_add_tcase(s, forward_update_chunked);
+#endif
     suite_add_tcase(s, boot_success);
 #ifdef DELTA_UPDATES
     suite_add_tcase(s, delta_zero_size);
@@ -0,0 +1,312 @@
+/* unit-verify-cache.c
+ *
+ * Unit tests for the verification cache (src/verify_cache.c): the signature
+ * check of an unchanged boot image is replaced by the check of the stored
+ * MAC, and any change falls back to the full verification.
+ *
+ * Copyright (C) 2026 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#define WOLFBOOT_VERIFY_CACHE_ADDRESS 0xCF000000
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <check.h>
+
+#include "verify_cache.c"
+
+#include "unit-mock-flash.c"
+
+#define N_KEYS 2
+#define KEY_SIZE 64
+
+static uint8_t keys[N_KEYS][KEY_SIZE];
+static uint8_t hints[N_KEYS][WOLFBOOT_SHA_DIGEST_SIZE];
+static uint8_t header[IMAGE_HEADER_SIZE];
+static uint8_t image_digest[WOLFBOOT_SHA_DIGEST_SIZE];
+static uint32_t image_version;
+static int image_key;
+static int signature_valid;
+static int full_verifications;
+static int have_secret;
+
+/* Mocks */
+int keyslot_id_by_sha(const uint8_t *hint)
+{
+    int i;
+
+    for (i = 0; i < N_KEYS; i++) {
+        if (memcmp(hint, hints[i], WOLFBOOT_SHA_DIGEST_SIZE) == 0)
+            return i;
+    }
+    return -1;
+}
+
+uint8_t *keystore_get_buffer(int id)
+{
+    return keys[id];
+}
+
+int keystore_get_size(int id)
+{
+    (void)id;
+    return KEY_SIZE;
+}
+
+uint32_t keystore_get_mask(int id)
+{
+    (void)id;
+    return 0xFFFFFFFF;
+}
+
+uint16_t wolfBoot_get_header(struct wolfBoot_image *img, uint16_t type,
+    uint8_t **ptr)
+{
+    (void)img;
+    if (type != HDR_PUBKEY)
+        return 0;
+    *ptr = hints[image_key];
+    return WOLFBOOT_SHA_DIGEST_SIZE;
+}
+
+uint32_t wolfBoot_get_blob_version(uint8_t *blob)
+{
+    (void)blob;
+    return image_version;
+}
+
+int wolfBoot_verify_authenticity(struct wolfBoot_image *img)
+{
+    full_verifications++;
+    if (!signature_valid)
+        return -1;
+    wolfBoot_image_confirm_signature_ok(img);
+    return 0;
+}
+
+int wolfBoot_hardened_CT_compare(const uint8_t *expected,
+    const uint8_t *actual, uint32_t len)
+{
+    return memcmp(expected, actual, len) != 0;
+}
+
+int hal_verify_cache_secret(uint8_t *out, size_t out_len)
+{
+    if (!have_secret)
+        return -1;
+    memset(out, 0xC3, out_len);
+    return 0;
+}
+
+static void open_image(struct wolfBoot_image *img)
+{
+    memset(img, 0, sizeof(*img));
+    img->hdr = header;
+    img->part = PART_BOOT;
+    img->sha_hash = image_digest;
+    img->hdr_ok = 1;
+    img->sha_ok = 1;
+}
+
+/* One boot: returns the result of the authenticity check */
+static int boot(void)
+{
+    struct wolfBoot_image img;
+    int ret;
+
+    open_image(&img);
+    ret = wolfBoot_verify_authenticity_cached(&img);
+    if (ret == 0)
+        ck_assert_uint_eq(img.signature_ok, 1);
+    else
+        ck_assert_uint_ne(img.signature_ok, 1);
+    return ret;
+}
+
+static void setup(void)
+{
+    int i, ret;
+
+    ret = mmap_file("/tmp/wolfboot-unit-verify-cache.bin",
+        (void *)(uintptr_t)WOLFBOOT_VERIFY_CACHE_ADDRESS, WOLFBOOT_SECTOR_SIZE,
+        NULL);
+    ck_assert_int_ge(ret, 0);
+    memset((void *)(uintptr_t)WOLFBOOT_VERIFY_CACHE_ADDRESS, 0xFF,
+        WOLFBOOT_SECTOR_SIZE);
+    for (i = 0; i < N_KEYS; i++) {
+        memset(keys[i], 0x10 + i, KEY_SIZE);
+        memset(hints[i], 0xA0 + i, WOLFBOOT_SHA_DIGEST_SIZE);
+    }
+    memset(image_digest, 0x3C, sizeof(image_digest));
+    image_version = 7;
+    image_key = 0;
+    signature_valid = 1;
+    full_verifications = 0;
+    have_secret = 1;
+    erased_verify_cache = 0;
+}
+
+static void teardown(void)
+{
+    munmap((void *)(uintptr_t)WOLFBOOT_VERIFY_CACHE_ADDRESS,
+        WOLFBOOT_SECTOR_SIZE);
+}
+
+START_TEST(test_cache_hit)
+{
+    ck_assert_int_eq(boot(), 0);
+    ck_assert_int_eq(full_verifications, 1);
+    ck_assert_int_eq(erased_verify_cache, 1);
+    ck_assert_uint_eq(VCACHE_RECORD->magic, WOLFBOOT_VERIFY_CACHE_MAGIC);
+    ck_assert_uint_eq(VCACHE_RECORD->version, 7);
+    ck_assert_uint_eq(VCACHE_RECORD->key_slot, 0);
+
+    /* Next boots: MAC only, no flash cycle */
+    ck_assert_int_eq(boot(), 0);
+    ck_assert_int_eq(boot(), 0);
+    ck_assert_int_eq(full_verifications, 1);
+    ck_assert_int_eq(erased_verify_cache, 1);
+}
+END_TEST
+
+START_TEST(test_cache_changed_image)
+{
+    ck_assert_int_eq(boot(), 0);
+
+    /* New image, e.g. after an update */
+    image_digest[5] ^= 0x01;
+    ck_assert_int_eq(boot(), 0);
+    ck_assert_int_eq(full_verifications, 2);
+    ck_assert_int_eq(erased_verify_cache, 2);
+    ck_assert_int_eq(boot(), 0);
+    ck_assert_int_eq(full_verifications, 2);
+
+    /* Bad signature: rejected, the record of the previous image is kept */
+    image_digest[5] ^= 0x01;
+    signature_valid = 0;
+    ck_assert_int_eq(boot(), -1);
+    ck_assert_int_eq(full_verifications, 3);
+    ck_assert_int_eq(erased_verify_cache, 2);
+    /* The image of the record is not changed */
+    image_digest[5] ^= 0x01;
+    ck_assert_int_eq(boot(), 0);
+    ck_assert_int_eq(full_verifications, 3);
+}
+END_TEST
+
+START_TEST(test_cache_version_and_key)
+{
+    ck_assert_int_eq(boot(), 0);
+
+    image_version = 8;
+    ck_assert_int_eq(boot(), 0);
+    ck_assert_int_eq(full_verifications, 2);
+
+    /* Key replaced in the keystore */
+    keys[0][KEY_SIZE - 1] ^= 0x80;
+    ck_assert_int_eq(boot(), 0);
+    ck_assert_int_eq(full_verifications, 3);
+
+    /* Signed with another key */
+    image_key = 1;
+    ck_assert_int_eq(boot(), 0);
+    ck_assert_int_eq(full_verifications, 4);
+    ck_assert_uint_eq(VCACHE_RECORD->key_slot, 1);
+    ck_assert_int_eq(boot(), 0);
+    ck_assert_int_eq(full_verifications, 4);
+}
+END_TEST
+
+START_TEST(test_cache_forged_record)
+{
+    struct wolfBoot_verify_cache_record rec;
+
+    ck_assert_int_eq(boot(), 0);
+    memcpy(&rec, VCACHE_RECORD, sizeof(rec));
+    rec.mac[0] ^= 0x01;
+    hal_flash_unlock();
+    hal_flash_erase(WOLFBOOT_VERIFY_CACHE_ADDRESS, WOLFBOOT_SECTOR_SIZE);
+    hal_flash_write(WOLFBOOT_VERIFY_CACHE_ADDRESS, (const uint8_t *)&rec,
+        sizeof(rec));
+    hal_flash_lock();
+
+    signature_valid = 0;
+    ck_assert_int_eq(boot(), -1);
+    ck_assert_int_eq(full_verifications, 2);
+
+    /* Integrity not checked: never served from the cache */
+    {
+        struct wolfBoot_image img;
+
+        signature_valid = 1;
+        ck_assert_int_eq(boot(), 0);
+        open_image(&img);
+        img.sha_ok = 0;
+        ck_assert_int_eq(wolfBoot_verify_cache_check(&img), -1);
+        ck_assert_uint_ne(img.signature_ok, 1);
+    }
+}
+END_TEST
+
+START_TEST(test_cache_no_secret)
+{
+    have_secret = 0;
+    ck_assert_int_eq(boot(), 0);
+    ck_assert_int_eq(boot(), 0);
+    ck_assert_int_eq(full_verifications, 2);
+    ck_assert_int_eq(erased_verify_cache, 0);
+
+    /* A record keyed with another secret is not accepted */
+    have_secret = 1;
+    ck_assert_int_eq(boot(), 0);
+    ck_assert_int_eq(erased_verify_cache, 1);
+    have_secret = 0;
+    ck_assert_int_eq(boot(), 0);
+    ck_assert_int_eq(full_verifications, 4);
+}
+END_TEST
+
+Suite *wolfboot_suite(void)
+{
+    Suite *s = suite_create("wolfBoot-verify-cache");
+    TCase *tc = tcase_create("verify-cache");
+
+    tcase_add_checked_fixture(tc, setup, teardown);
+    tcase_add_test(tc, test_cache_hit);
+    tcase_add_test(tc, test_cache_changed_image);
+    tcase_add_test(tc, test_cache_version_and_key);
+    tcase_add_test(tc, test_cache_forged_record);
+    tcase_add_test(tc, test_cache_no_secret);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main(void)
+{
+    int fails;
+    Suite *s = wolfboot_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    fails = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return fails;
+}